@@ -28,7 +28,44 @@ enum pixel_type {
 	PIXEL_TYPE_SHORT, 
 	PIXEL_TYPE_UNSIGNED_INT, 
 	PIXEL_TYPE_INT, 
-	PIXEL_TYPE_FLOAT 
+	PIXEL_TYPE_FLOAT, 
+	PIXEL_TYPE_UNSIGNED_SHORT_5_6_5, 
+	PIXEL_TYPE_HALF_FLOAT 
+};
+
+enum texture_format {
+	TEXTURE_FORMAT_FLOAT,
+	TEXTURE_FORMAT_RGBA8,
+	TEXTURE_FORMAT_RGB8,
+	TEXTURE_FORMAT_L8,
+	TEXTURE_FORMAT_LA8,
+	TEXTURE_FORMAT_RGB565,
+	TEXTURE_FORMAT_HALF
+};
+
+enum texture_storage {
+	TEXTURE_STORAGE_NATIVE,
+	TEXTURE_STORAGE_8BIT,
+	TEXTURE_STORAGE_RGB565,
+	TEXTURE_STORAGE_HALF
+};
+
+enum texture_layout {
+	TEXTURE_LAYOUT_LINEAR,
+	TEXTURE_LAYOUT_BLOCKED_4X4,
+	TEXTURE_LAYOUT_BLOCKED_8X8,
+	TEXTURE_LAYOUT_MORTON
+};
+
+enum texture_filter {
+	TEXTURE_FILTER_LINEAR,
+	TEXTURE_FILTER_NEAREST_MIPMAP,
+	TEXTURE_FILTER_TRILINEAR
+};
+
+enum mipmap_filter {
+	MIPMAP_FILTER_BOX,
+	MIPMAP_FILTER_KAISER
 };
 
 enum shade_model {
@@ -36,6 +73,79 @@ enum shade_model {
 	SHADE_SMOOTH
 };
 
+enum shading_level {
+	SHADING_LEVEL_FLAT,
+	SHADING_LEVEL_GOURAUD,
+	SHADING_LEVEL_PHONG
+};
+
+enum program_vertex {
+	PROGRAM_VERTEX_SHADED,
+	PROGRAM_VERTEX_TEXTURED
+};
+
+enum math_precision {
+	MATH_PRECISION_EXACT,
+	MATH_PRECISION_FAST,
+	MATH_PRECISION_FASTEST
+};
+
+enum color_format {
+	COLOR_FORMAT_RGBA8,
+	COLOR_FORMAT_RGB10A2,
+	COLOR_FORMAT_FLOAT
+};
+
+enum depth_format {
+	DEPTH_FORMAT_32F,
+	DEPTH_FORMAT_24,
+	DEPTH_FORMAT_16
+};
+
+enum framebuffer_layout {
+	FRAMEBUFFER_LAYOUT_LINEAR,
+	FRAMEBUFFER_LAYOUT_TILED,
+	FRAMEBUFFER_LAYOUT_TOP_DOWN
+};
+
+enum stream_format {
+	STREAM_FORMAT_Y4M,
+	STREAM_FORMAT_RGB,
+	STREAM_FORMAT_YUV,
+	STREAM_FORMAT_DELTA
+};
+
+enum channel_order {
+	CHANNEL_ORDER_RGBA,
+	CHANNEL_ORDER_BGRA,
+	CHANNEL_ORDER_RGB,
+	CHANNEL_ORDER_BGR
+};
+
+enum color_encoding {
+	COLOR_ENCODING_LINEAR,
+	COLOR_ENCODING_SRGB_TABLE,
+	COLOR_ENCODING_SRGB_POLYNOMIAL
+};
+
+enum depth_func {
+	DEPTH_FUNC_LESS,
+	DEPTH_FUNC_LEQUAL,
+	DEPTH_FUNC_EQUAL
+};
+
+enum render_pass {
+	RENDER_PASS_FORWARD,
+	RENDER_PASS_DEPTH,
+	RENDER_PASS_SHADE
+};
+
+enum draw_order {
+	DRAW_ORDER_SUBMISSION,
+	DRAW_ORDER_FRONT_TO_BACK,
+	DRAW_ORDER_STATE
+};
+
 enum light_model {
 	LIGHT_AMBIENT,
 	LIGHT_LOCAL_VIEWER,
@@ -0,0 +1,140 @@
+#ifndef __PIPELINE_DAMAGE_H
+#define __PIPELINE_DAMAGE_H
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+#include "core/common.h"
+#include "core/framebuffer.h"
+
+namespace pixelpipe {
+
+/**
+ * A rectangle of pixels, in framebuffer coordinates (row 0 is the bottom row).
+ */
+struct DamageRect {
+	unsigned x;			//!< the left column
+	unsigned y;			//!< the bottom row
+	unsigned width;		//!< the number of columns
+	unsigned height;	//!< the number of rows
+};
+
+/*!
+ * \class DamageTracker "core/damage.h"
+ * \brief Finds the framebuffer tiles whose color changed since the previous frame.
+ *
+ * update() compares the tile signatures of a frame with those of the frame
+ * before it. Tiles that were not written since the last clear are compared by
+ * their clear color without reading any pixels, so the cost follows the area
+ * covered by geometry. The first frame, and every frame after a change of size
+ * or a reset(), is damaged everywhere.
+ *
+ * The damage is reported at the full size of the frames. When only a region of
+ * the framebuffer was rendered (dynamic resolution), the changed tiles of the
+ * region are mapped to the pixels they are upscaled to, and a change of the
+ * region damages the whole frame.
+ *
+ * The damaged tiles are listed individually and as a few rectangles: runs of
+ * damaged tiles in a row of tiles, merged with the run of the same columns in
+ * the row below.
+ */
+class DamageTracker {
+public:
+	DamageTracker();
+
+	/**
+	 * Computes the damage of a frame relative to the previous frame given to
+	 * update(), which may have been rendered into another framebuffer.
+	 *
+	 * @param fb the framebuffer holding the new frame
+	 */
+	void update(const FrameBuffer& fb);
+
+	/**
+	 * Forgets the previous frame, so that the next frame is damaged everywhere
+	 * (for instance when a new viewer connects).
+	 */
+	void reset() { m_signatures.clear(); }
+
+	/**
+	 * @return the width of the frames, in pixels.
+	 */
+	unsigned width() const { return m_width; }
+
+	/**
+	 * @return the height of the frames, in pixels.
+	 */
+	unsigned height() const { return m_height; }
+
+	/**
+	 * @return the width and the height of a tile, in pixels.
+	 */
+	unsigned tileSize() const { return FrameBuffer::TILE_SIZE; }
+
+	/**
+	 * @return the number of tiles in a row of tiles.
+	 */
+	unsigned tilesX() const { return m_tilesX; }
+
+	/**
+	 * @return the number of rows of tiles.
+	 */
+	unsigned tilesY() const { return m_tilesY; }
+
+	/**
+	 * @return whether the tile (tx, ty) changed, row 0 being the bottom row.
+	 */
+	bool damaged(unsigned tx, unsigned ty) const { return m_damaged[(size_t) ty * m_tilesX + tx] != 0; }
+
+	/**
+	 * @return the damaged tiles, numbered row by row from the bottom left tile.
+	 */
+	const std::vector<unsigned>& getTiles() const { return m_tiles; }
+
+	/**
+	 * @return the rectangles covering the damaged tiles, clipped to the frame.
+	 */
+	const std::vector<DamageRect>& getRegions() const { return m_regions; }
+
+	/**
+	 * @return whether no tile changed since the previous frame.
+	 */
+	bool empty() const { return m_tiles.empty(); }
+
+protected:
+	unsigned m_width;						//!< the width of the frames
+	unsigned m_height;						//!< the height of the frames
+	unsigned m_regionWidth;					//!< the width of the rendered region of the frames
+	unsigned m_regionHeight;				//!< the height of the rendered region of the frames
+	unsigned m_tilesX;						//!< the number of tiles in a row of tiles
+	unsigned m_tilesY;						//!< the number of rows of tiles
+	std::vector<uint64_t> m_signatures;		//!< the tile signatures of the previous frame
+	std::vector<unsigned char> m_damaged;	//!< whether each tile is damaged
+	std::vector<unsigned> m_tiles;			//!< the damaged tiles
+	std::vector<DamageRect> m_regions;		//!< the rectangles covering the damaged tiles
+
+	/**
+	 * Damages the tiles of the full frame that a changed tile of the rendered
+	 * region is upscaled to.
+	 */
+	void damageUpscaled(unsigned tx, unsigned ty);
+
+	/**
+	 * Merges the damaged tiles into rectangles.
+	 */
+	void buildRegions();
+
+};	// class DamageTracker
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::DamageTracker& damage)
+{
+	return out << "[ DamageTracker ]";
+}
+
+#endif	// __PIPELINE_DAMAGE_H
@@ -0,0 +1,158 @@
+#ifndef __PIPELINE_DRAW_QUEUE_H
+#define __PIPELINE_DRAW_QUEUE_H
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+#include "core/common.h"
+#include "cg/vecmath/vec2.hpp"
+#include "cg/vecmath/vec3.hpp"
+#include "cg/vecmath/color.h"
+#include "cg/vecmath/mat4.hpp"
+
+namespace pixelpipe {
+
+/*!
+ * \class DrawQueue "core/draw_queue.h"
+ * \brief Records the opaque objects of a frame so they can be drawn in a better order.
+ * 
+ * Each draw is the geometry submitted between Pipeline::beginObject() and
+ * Pipeline::endObject(), recorded in object coordinates together with the
+ * matrices, the texture unit and the processor state in effect when the object
+ * started. The depth of a draw is the view depth of the nearest point of the
+ * object's bounding sphere.
+ * 
+ * DRAW_ORDER_FRONT_TO_BACK sorts by depth only, so that the depth test rejects
+ * as many hidden fragments as possible before they are shaded.
+ * DRAW_ORDER_STATE sorts by the key (state, texture, depth), so that processor
+ * and texture switches happen once per group of draws, and the draws of a
+ * group are still drawn front to back.
+ * 
+ * The transforms and the bound texture must not change between beginObject()
+ * and endObject().
+ */
+class DrawQueue {
+public:
+	/**
+	 * The kinds of recorded pipeline calls.
+	 */
+	enum command_type {
+		COMMAND_BEGIN,					//!< Pipeline::begin()
+		COMMAND_VERTEX,					//!< Pipeline::vertex()
+		COMMAND_TRIANGLE,				//!< Pipeline::renderTriangle() with texture coordinates
+		COMMAND_TRIANGLE_UNTEXTURED,	//!< Pipeline::renderTriangle() without texture coordinates
+		COMMAND_END						//!< Pipeline::end()
+	};
+	
+	/**
+	 * A recorded pipeline call.
+	 */
+	struct Command {
+		command_type type;	//!< the recorded call
+		drawing_mode mode;	//!< the drawing mode of a COMMAND_BEGIN
+		unsigned first;		//!< the first vertex used by the call
+	};
+	
+	/**
+	 * The arguments of a recorded vertex.
+	 */
+	struct QueuedVertex {
+		cg::vecmath::Vector3f v;	//!< the position in object coordinates
+		cg::vecmath::Color3f c;		//!< the color
+		cg::vecmath::Vector3f n;	//!< the normal
+		cg::vecmath::Vector2f t;	//!< the texture coordinates
+	};
+	
+	/**
+	 * A recorded object.
+	 */
+	struct Draw {
+		cg::vecmath::Matrix4f modelview;	//!< the model-view matrix of the object
+		cg::vecmath::Matrix4f projection;	//!< the projection matrix of the object
+		int texture;						//!< the bound texture unit, -1 if none
+		unsigned state;						//!< the processor state of the draw, e.g. its shading_level (8 bits)
+		cg::vecmath::Vector3f center;		//!< the center of the bounding sphere
+		float radius;						//!< the radius of the bounding sphere
+		float depth;						//!< the view depth of the nearest point of the bounding sphere
+		unsigned first;						//!< the first command of the draw
+		unsigned count;						//!< the number of commands of the draw
+	};
+	
+	DrawQueue();
+	
+	/**
+	 * Starts recording a draw. The commands of the draw are set by the queue.
+	 */
+	void open(const Draw& draw);
+	
+	/**
+	 * Ends the draw being recorded.
+	 */
+	void close() { m_open = false; }
+	
+	/**
+	 * @return whether a draw is being recorded
+	 */
+	bool isOpen() const { return m_open; }
+	
+	void begin(drawing_mode mode);
+	void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t);
+	void triangle(const cg::vecmath::Vector3f* v, const cg::vecmath::Color3f* c, const cg::vecmath::Vector3f* n, const cg::vecmath::Vector2f* t);
+	void end();
+	
+	/**
+	 * Orders the draws. Draws with equal keys keep their submission order.
+	 * 
+	 * @param order the drawing order, DRAW_ORDER_SUBMISSION leaves the draws as they are
+	 */
+	void sort(draw_order order);
+	
+	/**
+	 * Computes the 64 bit key of a draw for DRAW_ORDER_STATE: the state in
+	 * the upper 8 bits, the texture unit in the next 24 bits and the depth in
+	 * the lower 32 bits.
+	 */
+	static uint64_t stateKey(const Draw& draw);
+	
+	/**
+	 * Discards all draws, keeping the allocated storage for the next frame.
+	 */
+	void clear();
+	
+	bool empty() const { return m_draws.empty(); }
+	
+	size_t size() const { return m_draws.size(); }
+	
+	/**
+	 * @return the i-th draw, in sorted order once sort() was called
+	 */
+	const Draw& draw(size_t i) const { return m_draws[m_order[i]]; }
+	
+	const Command& command(size_t i) const { return m_commands[i]; }
+	
+	const QueuedVertex& queuedVertex(size_t i) const { return m_vertices[i]; }
+	
+protected:
+	bool m_open;								//!< whether a draw is being recorded
+	std::vector<Draw> m_draws;					//!< the draws in submission order
+	std::vector<unsigned> m_order;				//!< the draw indices in drawing order
+	std::vector<uint64_t> m_keys;				//!< the sort key of each draw
+	std::vector<Command> m_commands;			//!< the commands of all draws
+	std::vector<QueuedVertex> m_vertices;		//!< the vertices of all commands
+	
+	void push(command_type type, drawing_mode mode = PIPELINE_MODE_NONE);
+	
+};	// class DrawQueue
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::DrawQueue& q)
+{
+	return out << "[ DrawQueue: " << q.size() << " draws ]";
+}
+
+#endif	// __PIPELINE_DRAW_QUEUE_H
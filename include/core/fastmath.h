@@ -0,0 +1,228 @@
+#ifndef __PIPELINE_FASTMATH_H
+#define __PIPELINE_FASTMATH_H
+
+#include <string.h>
+#include <math.h>
+
+#include "core/common.h"
+#include "cg/vecmath/vec3.hpp"
+
+namespace pixelpipe {
+
+/*!
+ * \class FastMath "core/fastmath.h"
+ * \brief Approximations of the transcendental functions used by the shading stages.
+ *
+ * Each function takes a math_precision tier. MATH_PRECISION_EXACT defers to the
+ * C library, MATH_PRECISION_FAST uses 5th degree polynomials (exp2 relative
+ * error below 1e-6, log2 absolute error below 2e-5) and MATH_PRECISION_FASTEST
+ * uses 3rd degree polynomials (1e-4 and 1e-3 respectively). The approximations
+ * assume finite, normalized inputs; they do not handle NaN or infinity.
+ *
+ * @see SpecularTable
+ */
+class FastMath {
+public:
+	/**
+	 * Computes 2^x.
+	 *
+	 * @param x the exponent
+	 * @param precision the precision tier to use
+	 */
+	static inline float exp2(float x, math_precision precision = MATH_PRECISION_FAST)
+	{
+		if(precision == MATH_PRECISION_EXACT) return ::exp2f(x);
+
+		if(x < -126.0f) return 0.0f;
+		if(x > 127.0f) x = 127.0f;
+
+		// split into integer and fractional parts, 2^i is built from the exponent bits
+		float fi = ::floorf(x);
+		float f = x - fi;
+		float p;
+		if(precision == MATH_PRECISION_FASTEST){
+			p = 0.999927827f + f * (0.695777096f + f * (0.226233194f + f * 0.0779071638f));
+		}
+		else{
+			p = 0.999999927f + f * (0.693152968f + f * (0.24015453f + f * (0.0558236055f + f * (0.00899258288f + f * 0.00187623341f))));
+		}
+
+		int bits = ((int) fi + 127) << 23;
+		float scale;
+		memcpy(&scale, &bits, sizeof(float));
+
+		return p * scale;
+	}
+
+	/**
+	 * Computes log2(x) for x > 0.
+	 *
+	 * @param x the (strictly positive) input
+	 * @param precision the precision tier to use
+	 */
+	static inline float log2(float x, math_precision precision = MATH_PRECISION_FAST)
+	{
+		if(precision == MATH_PRECISION_EXACT) return ::log2f(x);
+
+		// x = m * 2^e with m in [1, 2)
+		int bits;
+		memcpy(&bits, &x, sizeof(float));
+		float e = (float) (((bits >> 23) & 0xff) - 127);
+		bits = (bits & 0x007fffff) | 0x3f800000;
+		float m;
+		memcpy(&m, &bits, sizeof(float));
+		float t = m - 1.0f;
+
+		float p;
+		if(precision == MATH_PRECISION_FASTEST){
+			p = t * (1.42310164f + t * (-0.584524981f + t * 0.162076932f));
+		}
+		else{
+			p = t * (1.4418799f + t * (-0.708865218f + t * (0.415245562f + t * (-0.193516526f + t * 0.0452682933f))));
+		}
+
+		return e + p;
+	}
+
+	/**
+	 * Computes e^x.
+	 *
+	 * @param x the exponent
+	 * @param precision the precision tier to use
+	 */
+	static inline float exp(float x, math_precision precision = MATH_PRECISION_FAST)
+	{
+		if(precision == MATH_PRECISION_EXACT) return ::expf(x);
+
+		return exp2(x * 1.44269504f, precision);
+	}
+
+	/**
+	 * Computes x^y. Non-positive bases return zero on the approximate paths,
+	 * which is the behavior the shading code wants for back-facing half vectors.
+	 *
+	 * @param x the base
+	 * @param y the exponent
+	 * @param precision the precision tier to use
+	 */
+	static inline float pow(float x, float y, math_precision precision = MATH_PRECISION_FAST)
+	{
+		if(precision == MATH_PRECISION_EXACT) return ::powf(x, y);
+		if(x <= 0.0f) return 0.0f;
+
+		return exp2(y * log2(x, precision), precision);
+	}
+
+	/**
+	 * Computes 1 / sqrt(x) for x > 0. The approximate tiers start from the
+	 * integer bit trick and refine with Newton-Raphson (two steps for
+	 * MATH_PRECISION_FAST and one step for MATH_PRECISION_FASTEST).
+	 *
+	 * @param x the (strictly positive) input
+	 * @param precision the precision tier to use
+	 */
+	static inline float rsqrt(float x, math_precision precision = MATH_PRECISION_FAST)
+	{
+		if(precision == MATH_PRECISION_EXACT) return 1.0f / ::sqrtf(x);
+
+		float half = 0.5f * x;
+		int bits;
+		memcpy(&bits, &x, sizeof(float));
+		bits = 0x5f375a86 - (bits >> 1);
+		float y;
+		memcpy(&y, &bits, sizeof(float));
+
+		y = y * (1.5f - half * y * y);
+		if(precision == MATH_PRECISION_FAST){
+			y = y * (1.5f - half * y * y);
+		}
+
+		return y;
+	}
+
+	/**
+	 * Normalizes the vector in place using the selected rsqrt tier. Zero
+	 * length vectors are left untouched.
+	 *
+	 * @param v the vector to normalize
+	 * @param precision the precision tier to use
+	 */
+	static inline void normalize(cg::vecmath::Vector3f& v, math_precision precision = MATH_PRECISION_FAST)
+	{
+		if(precision == MATH_PRECISION_EXACT){
+			v.normalize();
+			return;
+		}
+
+		float len2 = v.x * v.x + v.y * v.y + v.z * v.z;
+		if(len2 == 0.0f) return;
+
+		v *= rsqrt(len2, precision);
+	}
+
+};	// class FastMath
+
+/*!
+ * \class SpecularTable "core/fastmath.h"
+ * \brief A lookup table for the specular term pow(nDotH, exponent) over [0, 1].
+ *
+ * The table is sampled with linear interpolation. It has to be rebuilt whenever
+ * the specular exponent changes, which the State does in setSpecularExponent().
+ */
+class SpecularTable {
+public:
+	static const int SIZE = 1024;	//!< the number of intervals in the table
+
+	/**
+	 * Builds a table for the given exponent.
+	 *
+	 * @param exponent the specular exponent
+	 */
+	SpecularTable(float exponent = 1.0f);
+
+	/**
+	 * Re-samples the table for a new specular exponent.
+	 *
+	 * @param exponent the new specular exponent
+	 */
+	void rebuild(float exponent);
+
+	/**
+	 * Accessor method for the exponent the table was built for.
+	 */
+	float getExponent() const { return m_exponent; }
+
+	/**
+	 * Looks up pow(x, exponent). Inputs outside [0, 1] are clamped.
+	 *
+	 * @param x the cosine of the angle between the normal and the half vector
+	 */
+	inline float lookup(float x) const
+	{
+		if(x <= 0.0f) return m_table[0];
+		if(x >= 1.0f) return m_table[SIZE];
+
+		float s = x * SIZE;
+		int i = (int) s;
+		float t = s - i;
+
+		return m_table[i] + t * (m_table[i+1] - m_table[i]);
+	}
+
+protected:
+	float m_exponent;			//!< the exponent the table was sampled for
+	float m_table[SIZE + 1];	//!< the sampled values, including both end points
+
+};	// class SpecularTable
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::SpecularTable& t)
+{
+	return out << "[ SpecularTable: exponent=" << t.getExponent() << " ]";
+}
+
+#endif	// __PIPELINE_FASTMATH_H
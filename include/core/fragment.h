@@ -19,6 +19,7 @@ public:
 	Fragment(int n=0) {
 		length = n;
 		y = x = -1;
+		derivatives[0] = derivatives[1] = derivatives[2] = derivatives[3] = 0.0f;
 		if(length > 0){
 			attributes = (float*) malloc(length*sizeof(float));
 		}
@@ -43,6 +44,7 @@ public:
 	int y;				//!< TThe screen space y coordinate of this fragment.
 	float* attributes;	//!< TThe attributes associated with this fragment.
 	int length;			//!< TThe number of attributes associated with this fragment
+	float derivatives[4];	//!< The screen space derivatives of the texture coordinate: du/dx, dv/dx, du/dy and dv/dy.
 };
 
 }
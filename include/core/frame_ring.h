@@ -0,0 +1,169 @@
+#ifndef __PIPELINE_FRAME_RING_H
+#define __PIPELINE_FRAME_RING_H
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "core/common.h"
+#include "core/framebuffer.h"
+#include "core/damage.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class FrameConsumer "core/frame_ring.h"
+ * \brief Receives the completed frames of a SoftwarePipeline.
+ *
+ * With a FrameRing the frames are consumed on the ring's worker thread, while
+ * the next frame is rendered, so implementations must not call the pipeline.
+ */
+class FrameConsumer {
+public:
+	virtual ~FrameConsumer() {}
+
+	/**
+	 * Called once per completed frame.
+	 *
+	 * @param color the row major color data, valid until this method returns
+	 * @param width the width of the frame
+	 * @param height the height of the frame
+	 * @param format the storage format of the color data
+	 * @param damage the changes since the previous frame, or NULL when the
+	 * pipeline does not track damage
+	 */
+	virtual void consume(const void* color, unsigned width, unsigned height, color_format format, const DamageTracker* damage) = 0;
+
+};	// class FrameConsumer
+
+/*!
+ * \class FrameRing "core/frame_ring.h"
+ * \brief A ring of framebuffers that are resolved and consumed on a worker thread.
+ *
+ * One framebuffer of the ring is the render target. submit() queues it for the
+ * worker thread and makes the next framebuffer of the ring the render target,
+ * so rendering continues while the submitted frame is resolved into row major
+ * color data and handed to the FrameConsumer. Each framebuffer has a fence: a
+ * queued framebuffer becomes the render target again only once the worker has
+ * completed it, and latest() only returns completed frames. With N
+ * framebuffers, up to N - 1 frames are in flight.
+ */
+class FrameRing {
+public:
+	/**
+	 * Creates the framebuffers and starts the worker thread.
+	 *
+	 * @param count The number of framebuffers, at least 2.
+	 * @param width The width of the framebuffers.
+	 * @param height The height of the framebuffers.
+	 * @param color The storage format of the color planes.
+	 * @param depth The storage format of the depth planes.
+	 * @param layout The memory layout of the planes.
+	 */
+	FrameRing(unsigned count, unsigned width, unsigned height, color_format color, depth_format depth, framebuffer_layout layout);
+
+	/**
+	 * Completes the queued frames and stops the worker thread.
+	 */
+	~FrameRing();
+
+	/**
+	 * Allocates the OpenGL resources of the framebuffers.
+	 */
+	void init();
+
+	/**
+	 * @return the number of framebuffers in the ring.
+	 */
+	unsigned size() const { return (unsigned) m_slots.size(); }
+
+	/**
+	 * @return the framebuffer currently used as the render target.
+	 */
+	FrameBuffer& current() const { return *m_slots[m_current].framebuffer; }
+
+	/**
+	 * Queues the render target for the worker thread and makes the next
+	 * framebuffer the render target, waiting for its fence if it is still in
+	 * flight.
+	 */
+	void submit();
+
+	/**
+	 * Returns the most recently completed frame, waiting for the oldest frame in
+	 * flight when no frame is completed yet.
+	 *
+	 * @param color set to the row major color data of the frame.
+	 * @return the framebuffer of the frame, or NULL when no frame was submitted.
+	 */
+	const FrameBuffer* latest(const void** color);
+
+	/**
+	 * Waits until all submitted frames are completed.
+	 */
+	void finish();
+
+	/**
+	 * Sets the consumer of the completed frames, or NULL for none. The ring does
+	 * not take ownership.
+	 */
+	void setConsumer(FrameConsumer* consumer);
+
+	/**
+	 * Sets the tracker updated with each completed frame before it is consumed,
+	 * or NULL for none. The ring does not take ownership.
+	 */
+	void setDamageTracker(DamageTracker* damage);
+
+protected:
+	/**
+	 * The fence state of a framebuffer.
+	 */
+	enum slot_state {
+		SLOT_IDLE,		//!< the framebuffer holds no frame, or a completed one
+		SLOT_QUEUED,	//!< the framebuffer waits for the worker thread
+		SLOT_BUSY		//!< the worker thread is resolving and consuming the framebuffer
+	};
+
+	/**
+	 * A framebuffer of the ring.
+	 */
+	struct Slot {
+		FrameBuffer* framebuffer;	//!< the framebuffer
+		slot_state state;			//!< the fence state
+		const void* color;			//!< the resolved color data of a completed frame, or NULL
+	};
+
+	std::vector<Slot> m_slots;		//!< the framebuffers of the ring
+	unsigned m_current;				//!< the slot of the render target
+	int m_latest;					//!< the slot of the most recently completed frame, or -1
+	std::deque<unsigned> m_queue;	//!< the submitted slots, oldest first
+	FrameConsumer* m_consumer;		//!< the consumer of the completed frames
+	DamageTracker* m_damage;		//!< the damage tracker of the completed frames
+	bool m_stop;					//!< whether the worker thread should stop
+	std::mutex m_mutex;				//!< guards the slot states, the queue, the consumer and the tracker
+	std::condition_variable m_queued;		//!< signaled when a slot is queued or the worker should stop
+	std::condition_variable m_completed;	//!< signaled when a slot is completed
+	std::thread m_thread;			//!< the worker thread
+
+	/**
+	 * The worker thread loop.
+	 */
+	void run();
+
+};	// class FrameRing
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::FrameRing& ring)
+{
+	return out << "[ FrameRing ]";
+}
+
+#endif	// __PIPELINE_FRAME_RING_H
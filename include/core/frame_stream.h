@@ -0,0 +1,130 @@
+#ifndef __PIPELINE_FRAME_STREAM_H
+#define __PIPELINE_FRAME_STREAM_H
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "core/common.h"
+#include "core/frame_ring.h"
+#include "core/pixel_converter.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class FrameStream "core/frame_stream.h"
+ * \brief A FrameConsumer writing raw video frames to a file, a FIFO or stdout.
+ *
+ * Each frame is converted from the framebuffer color data straight into one
+ * output buffer, top row first, and written with a single call, so the stream
+ * can be piped into an external video encoder. The rows are converted by
+ * several threads.
+ *
+ * STREAM_FORMAT_Y4M writes a YUV4MPEG2 stream (4:2:0, BT.601 video range),
+ * STREAM_FORMAT_RGB writes packed 8 bit RGB frames, and STREAM_FORMAT_YUV writes
+ * the planar 4:2:0 frames of the Y4M stream without any headers. Odd frame
+ * dimensions are rounded up for the chroma planes.
+ *
+ * STREAM_FORMAT_DELTA only writes the tiles that changed since the previous
+ * frame, as reported by the DamageTracker of the pipeline (every tile when the
+ * damage is not tracked). Each frame starts with five native 32 bit integers:
+ * the magic 0x54445050 ("PPDT" in little endian), the width and the height of
+ * the frame, the tile size and the number of tiles that follow. Each tile is
+ * four native 16 bit integers, its x, y, width and height in image
+ * coordinates (row 0 at the top, edge tiles are clipped), followed by its
+ * pixels as packed 8 bit RGB, top row first.
+ *
+ * The compact color formats are streamed as they are stored (the top 8 bits of
+ * RGB10A2). COLOR_FORMAT_FLOAT frames are quantized by a PixelConverter, with
+ * the encoding and dither selected by setEncoding(), as HeadlessRenderer
+ * writes its images.
+ */
+class FrameStream : public FrameConsumer {
+public:
+	/**
+	 * Opens the output.
+	 *
+	 * @param path the output file or FIFO, or "-" for stdout.
+	 * @param format the format of the stream.
+	 * @param fps the frame rate written into the Y4M header.
+	 * @param threads the number of conversion threads, or 0 for one per core.
+	 */
+	FrameStream(const std::string& path, stream_format format, unsigned fps = 30, unsigned threads = 0);
+
+	/**
+	 * Flushes and closes the output.
+	 */
+	~FrameStream();
+
+	virtual void consume(const void* color, unsigned width, unsigned height, color_format format, const DamageTracker* damage);
+
+	/**
+	 * Selects how COLOR_FORMAT_FLOAT frames are quantized.
+	 *
+	 * @param encoding the transfer function of the streamed frames
+	 * @param dither whether to quantize with an ordered dither
+	 */
+	void setEncoding(color_encoding encoding, bool dither = false)
+	{
+		m_converter.setEncoding(encoding);
+		m_converter.setDither(dither);
+	}
+
+	/**
+	 * @return the number of frames written so far.
+	 */
+	unsigned long frames() const { return m_frames; }
+
+protected:
+	FILE* m_file;						//!< the output
+	bool m_close;						//!< whether the output is closed by the destructor (not stdout)
+	stream_format m_format;				//!< the format of the stream
+	unsigned m_fps;						//!< the frame rate of the Y4M header
+	unsigned m_threads;					//!< the number of conversion threads
+	unsigned m_width;					//!< the width of the stream, set by the first frame
+	unsigned m_height;					//!< the height of the stream, set by the first frame
+	unsigned long m_frames;				//!< the number of frames written
+	std::vector<unsigned char> m_buffer;	//!< the converted frame
+	std::vector<unsigned> m_tiles;			//!< the tiles of a delta frame
+	std::vector<size_t> m_offsets;			//!< the position of each tile of a delta frame in the buffer
+	PixelConverter m_converter;				//!< the quantization of float frames
+
+	/**
+	 * Unpacks consecutive pixels of the color data into 8 bit RGB.
+	 *
+	 * @param first the position of the first pixel in the color data
+	 * @param count the number of pixels
+	 * @param y the row of the pixels in the output frame, which selects the dither pattern
+	 * @param out the RGB output
+	 */
+	void unpack(const void* color, color_format format, size_t first, unsigned count, unsigned y, unsigned char* out) const;
+
+	/**
+	 * Converts the rows [first, last) of the output frame.
+	 */
+	void convert(const void* color, color_format format, unsigned first, unsigned last);
+
+	/**
+	 * Packs the tiles [first, last) of a delta frame.
+	 */
+	void pack(const void* color, color_format format, unsigned first, unsigned last);
+
+	/**
+	 * Converts the tiles of a delta frame into the buffer.
+	 */
+	void delta(const void* color, color_format format, const DamageTracker* damage);
+
+};	// class FrameStream
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::FrameStream& stream)
+{
+	return out << "[ FrameStream ]";
+}
+
+#endif	// __PIPELINE_FRAME_STREAM_H
@@ -3,10 +3,14 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <stdint.h>
 
 #include "core/common.h"
 #include "core/texture.h"
+#include "cg/vecmath/color.h"
 
+#ifndef PIXELPIPE_HEADLESS
 #ifdef __APPLE__
 #include <GLUT/glut.h>
 #include <OpenGL/gl.h>
@@ -16,6 +20,7 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 #endif
+#endif
 
 namespace pixelpipe {
 
@@ -24,24 +29,78 @@ namespace pixelpipe {
  * \brief Simple class providing a render target interface for the Rasterizer.
  * 
  * This class holds all of the data for a frame. A frame is rendered (blit) off screen,  
- * then transferred onto the screen. The z buffer is also held in this frame buffer class.
+ * then transferred onto the screen. The color and the depth of each pixel are held
+ * in two separate planes, so that the depth test only touches the depth plane.
+ * 
+ * The color plane is stored as RGBA8 (4 bytes per pixel, the default), RGB10A2
+ * (a 32 bit word per pixel, red in the low bits) or as float RGBA. Only the float
+ * format keeps the color in the Texture raster. The depth plane holds 32 bit
+ * floats, or the window depth (z + 1) / 2 as a 24 bit or a 16 bit unsigned
+ * normalized integer. The depth test of the integer formats compares values in
+ * the precision of the buffer, so that an equal depth test is exact.
+ * 
+ * Both planes are laid out row by row, or in tiles of TILE_SIZE x TILE_SIZE
+ * pixels. The tiles follow each other row by row, and the pixels of a tile are
+ * in Morton (Z) order, so that a triangle touches few cache lines and pages.
+ * The top down layout stores the rows from the top, as image files do.
+ * getColorData() and getDepthData() return row major copies, bottom row first,
+ * of tiled and top down planes.
+ * 
+ * An RGBA8 color plane may live in memory owned by the caller, such as the
+ * pixels of a memory mapped image file (see MappedImage), so that the frame is
+ * rendered in place into its final destination.
+ * 
+ * When PIXELPIPE_HEADLESS is defined, no OpenGL resources are allocated and
+ * drawing the framebuffer does nothing.
+ * 
+ * Clearing is lazy: clear() only flags every tile as cleared. The first write
+ * into a flagged tile (or the first read of the raw planes) fills it with the
+ * clear values, and the depth test of a flagged tile compares with the clear
+ * depth without touching the depth plane.
+ * 
+ * The tiles whose color was written since the last clear are flagged, so that
+ * a DamageTracker only has to inspect those tiles to find the changes between
+ * frames.
+ * 
+ * A framebuffer is also a Texture: a render texture of the SoftwarePipeline is
+ * rendered into and then sampled in place by later passes, whatever its color
+ * format and layout (see sample()).
+ * 
+ * For dynamic resolution, a frame may be rendered into the bottom left region
+ * of the buffer only (see setRegion()). getColorData() then upscales the region
+ * to the full size of the buffer with a bilinear filter.
  * 
  */
 class FrameBuffer : public Texture {
 public:
+	static const int TILE_SIZE = 8;	//!< The width and height of a tile of the tiled layout.
 	
 	/**
 	 * Constructs a new frame buffer with the given dimensions.
 	 * 
-	 * @param newNx The width of the new frame buffer.
-	 * @param newNy The height of the new frame buffer.
+	 * @param width The width of the new frame buffer.
+	 * @param height The height of the new frame buffer.
+	 * @param color The storage format of the color plane.
+	 * @param depth The storage format of the depth plane.
+	 * @param layout The memory layout of both planes.
 	 */
-	FrameBuffer(const unsigned width, const unsigned height, const unsigned channels = 4);
-	~FrameBuffer();
+	FrameBuffer(const unsigned width, const unsigned height, color_format color = COLOR_FORMAT_RGBA8, depth_format depth = DEPTH_FORMAT_32F,
+		framebuffer_layout layout = FRAMEBUFFER_LAYOUT_LINEAR);
 	
-	// char* getData() const { return m_cData; }
-	// const int getWidth() const { return m_width; }
-	// const int getHeight() const { return m_height; }
+	/**
+	 * Constructs a new frame buffer whose RGBA8 color plane is held by the
+	 * caller. The memory must outlive the frame buffer. Only the linear and top
+	 * down layouts are supported.
+	 * 
+	 * @param width The width of the new frame buffer.
+	 * @param height The height of the new frame buffer.
+	 * @param color The color plane, width * height * 4 bytes.
+	 * @param depth The storage format of the depth plane.
+	 * @param layout The memory layout of both planes.
+	 */
+	FrameBuffer(const unsigned width, const unsigned height, unsigned char* color, depth_format depth = DEPTH_FORMAT_32F,
+		framebuffer_layout layout = FRAMEBUFFER_LAYOUT_TOP_DOWN);
+	~FrameBuffer();
 	
 	/**
 	 * Allocates resources for rendering including the GL framebuffer for
@@ -49,6 +108,68 @@ public:
 	 */
 	void init();
 	
+	/**
+	 * Accessor method for the storage format of the color plane.
+	 */
+	color_format getColorFormat() const { return m_colorFormat; }
+	
+	/**
+	 * Accessor method for the storage format of the depth plane.
+	 */
+	depth_format getDepthFormat() const { return m_depthFormat; }
+	
+	/**
+	 * Accessor method for the memory layout of the planes.
+	 */
+	framebuffer_layout getLayout() const { return m_layout; }
+	
+	/**
+	 * Sets the bottom left region of the buffer holding the rendered frame, which
+	 * getColorData() upscales to the full size. The region is reset to the full
+	 * size by passing the dimensions of the buffer.
+	 * 
+	 * @param width The width of the region, in [1, width()].
+	 * @param height The height of the region, in [1, height()].
+	 */
+	void setRegion(unsigned width, unsigned height);
+	
+	/**
+	 * Accessor method for the width of the rendered region.
+	 */
+	unsigned regionWidth() const { return m_regionWidth; }
+	
+	/**
+	 * Accessor method for the height of the rendered region.
+	 */
+	unsigned regionHeight() const { return m_regionHeight; }
+	
+	/**
+	 * Accessor method for the number of tiles in a row of tiles.
+	 */
+	unsigned tilesX() const { return m_tilesX; }
+	
+	/**
+	 * Accessor method for the number of rows of tiles.
+	 */
+	unsigned tilesY() const { return m_tilesY; }
+	
+	/**
+	 * Returns whether the color of a tile was written since the last clear. The
+	 * tiles are numbered row by row, from the bottom left tile.
+	 */
+	bool tileWritten(size_t tile) const { return m_written[tile] != 0; }
+	
+	/**
+	 * Computes a 64 bit signature of the color of a tile. Tiles that were not
+	 * written since the last clear get a signature of the clear color, written
+	 * tiles a hash of their pixels, so equal signatures mean (up to hash
+	 * collisions) an equal color, while some equal colors have different
+	 * signatures.
+	 * 
+	 * @param tile The tile, numbered row by row from the bottom left tile.
+	 */
+	uint64_t tileSignature(size_t tile) const;
+	
 	/**
 	 * Returns the z value of the currently stored fragment for the given (x, y)
 	 * coordinate.
@@ -57,7 +178,19 @@ public:
 	 * @param y The y coordinate.
 	 * @return The z value of the fragment stored at that point.
 	 */
-	float getZ(const int x, const int y) const;
+	inline float getZ(const int x, const int y) const;
+	
+	/**
+	 * Compares a fragment depth with the stored depth, in the precision of the
+	 * depth plane.
+	 * 
+	 * @param x The x coordinate.
+	 * @param y The y coordinate.
+	 * @param z The z value of the fragment.
+	 * @param func The comparison.
+	 * @return whether the fragment passes the depth test.
+	 */
+	inline bool testZ(const int x, const int y, float z, depth_func func) const;
 	
 	/**
 	 * Sets the color (r, g, b) and z value for a given (x, y) location.
@@ -69,7 +202,50 @@ public:
 	 * @param b The blue color channel (in the range [0, 1].
 	 * @param z The z value of the new fragment.
 	 */
-	void set(int ix, int iy, float r, float g, float b, float z);
+	inline void set(int ix, int iy, float r, float g, float b, float z);
+	
+	/**
+	 * Sets the z value for a given (x, y) location, leaving the color untouched.
+	 * 
+	 * @param ix The x coordinate.
+	 * @param iy The y coordinate.
+	 * @param z The z value of the new fragment.
+	 */
+	inline void setZ(int ix, int iy, float z);
+	
+	/**
+	 * Reads back the color of a given (x, y) location.
+	 * 
+	 * @param x The x coordinate.
+	 * @param y The y coordinate.
+	 * @return The stored color.
+	 */
+	cg::vecmath::Color3f getColor(const int x, const int y) const;
+	
+	/**
+	 * Unpacks consecutive pixels of color data, as returned by getColorData(),
+	 * into packed 8 bit RGB. The compact formats keep their stored bits (the
+	 * top 8 bits of RGB10A2), float colors are clamped to [0, 1] and rounded.
+	 * 
+	 * @param color The color data.
+	 * @param format The storage format of the color data.
+	 * @param first The position of the first pixel in the color data.
+	 * @param count The number of pixels.
+	 * @param out The RGB output, with room for count * 3 bytes.
+	 */
+	static void unpackRow(const void* color, color_format format, size_t first, unsigned count, unsigned char* out);
+	
+	/**
+	 * Samples the rendered region of the color plane with a bilinear filter,
+	 * reading the planes in place. The coordinates are clamped to the edges,
+	 * and (0, 0) is the bottom left corner.
+	 * 
+	 * @param u The horizontal texture coordinate, in [0, 1].
+	 * @param v The vertical texture coordinate, in [0, 1].
+	 * @return The filtered color.
+	 */
+	virtual cg::vecmath::Color3f sample(const float u, const float v) const;
+	using Texture::sample;
 	
 	/**
 	 * Sets all data in the frame buffer to be the same color triple and depth
@@ -82,6 +258,31 @@ public:
 	 */
 	void clear(float r, float g, float b, float z);
 	
+	/**
+	 * Fills the tiles that still hold the values of the last clear, so that the
+	 * planes hold the whole frame. This is needed before the color plane of the
+	 * caller is read directly.
+	 */
+	void flush() { materializeAll(); }
+	
+	/**
+	 * Accessor method for the raw color plane, laid out as described by the
+	 * color format. The rows follow each other from the bottom, the tiled and
+	 * top down layouts are resolved into a copy that stays valid until the next
+	 * call. When only a region of
+	 * the buffer was rendered, the copy holds the region upscaled to the full
+	 * size.
+	 */
+	const void* getColorData() const;
+	
+	/**
+	 * Accessor method for the raw depth plane, laid out as described by the
+	 * depth format. The rows follow each other from the bottom, the tiled and
+	 * top down layouts are resolved into a copy that stays valid until the next
+	 * call.
+	 */
+	const void* getDepthData() const;
+	
 	/**
 	 * Draws this framebuffer by copying the buffer data to an OpenGL texture and 
 	 * drawing the texture.
@@ -89,15 +290,157 @@ public:
 	 * @param x the specified x location at which to start drawing
 	 * @param x the specified y location at which to start drawing
 	 */
-	void draw(float x=0, float y=0) const { this->drawGLTexture(x,y); };
+	void draw(float x=0, float y=0) const { this->drawGLTexture(this->getColorData(), x, y); };
+	
+	/**
+	 * Draws color data that was previously read from this framebuffer with
+	 * getColorData(), without resolving the planes again.
+	 * 
+	 * @param color the row major color data
+	 * @param x the specified x location at which to start drawing
+	 * @param x the specified y location at which to start drawing
+	 */
+	void draw(const void* color, float x=0, float y=0) const { this->drawGLTexture(color, x, y); };
 
 protected:
-	// int m_width;				//!< The width of the image in the frame buffer.
-	// int m_height;				//!< The height of the image in the frame buffer.
-	// char* m_cData;				//!< The rgb data that forms the image.
-	// float* m_zData;				//!< The z buffer - holds the z value of the current fragment.
-	GLuint m_textureHandle;		//!< The OpenGL texture handle (used for drawing the framebuffer to the screen).
+	color_format m_colorFormat;			//!< The storage format of the color plane.
+	depth_format m_depthFormat;			//!< The storage format of the depth plane.
+	framebuffer_layout m_layout;		//!< The memory layout of both planes.
+	unsigned m_tilesX;					//!< The number of tiles in a row of tiles.
+	unsigned m_tilesY;					//!< The number of rows of tiles.
+	size_t m_pixels;					//!< The number of pixels stored in each plane, including the padding of the tiles.
+	unsigned m_regionWidth;				//!< The width of the rendered region.
+	unsigned m_regionHeight;			//!< The height of the rendered region.
+	std::vector<unsigned char> m_rgba8;	//!< The color plane in COLOR_FORMAT_RGBA8, unless it is held by the caller.
+	unsigned char* m_color8;			//!< The color plane in COLOR_FORMAT_RGBA8 (m_rgba8, or the memory of the caller).
+	std::vector<uint32_t> m_rgb10a2;	//!< The color plane in COLOR_FORMAT_RGB10A2.
+	std::vector<float> m_rgba32f;		//!< The tiled color plane in COLOR_FORMAT_FLOAT.
+	float* m_float;						//!< The color plane in COLOR_FORMAT_FLOAT (the raster, or m_rgba32f when tiled).
+	std::vector<float> m_depth32f;		//!< The depth plane in DEPTH_FORMAT_32F.
+	std::vector<uint32_t> m_depth24;	//!< The depth plane in DEPTH_FORMAT_24.
+	std::vector<uint16_t> m_depth16;	//!< The depth plane in DEPTH_FORMAT_16.
+	unsigned int m_textureHandle;	//!< The OpenGL texture handle (used for drawing the framebuffer to the screen).
 	bool m_bAllocated;			//!< The flag used for indicating whether or not the OpenGL texture was allocated yet.
+	mutable std::vector<unsigned char> m_linearColor;	//!< The row major copy of a tiled or top down color plane.
+	mutable std::vector<unsigned char> m_linearDepth;	//!< The row major copy of a tiled or top down depth plane.
+	mutable std::vector<unsigned char> m_scaledColor;	//!< The rendered region of the color plane upscaled to the full size.
+	mutable std::vector<unsigned char> m_display;		//!< The BGRA8 copy of a float color plane uploaded by drawGLTexture.
+	std::vector<unsigned char> m_cleared;	//!< Whether each tile still holds the last clear values.
+	std::vector<unsigned char> m_written;	//!< Whether the color of each tile was written since the last clear.
+	size_t m_clearedTiles;				//!< The number of flagged tiles.
+	cg::vecmath::Color3f m_clearColor;	//!< The color of the last clear.
+	cg::vecmath::Color3f m_clearStoredColor;	//!< The color of the last clear, in the precision of the color plane.
+	float m_clearZ;						//!< The depth of the last clear.
+	float m_clearStoredZ;				//!< The depth of the last clear, in the precision of the depth plane.
+	uint32_t m_clearDepthBits;			//!< The depth of the last clear, as stored in an integer depth plane.
+	
+	/**
+	 * @return the tile holding the pixel (x, y).
+	 */
+	inline size_t tile(int x, int y) const
+	{
+		unsigned ux = x, uy = y;
+		return (size_t) (uy / TILE_SIZE) * m_tilesX + ux / TILE_SIZE;
+	}
+	
+	/**
+	 * Interleaves the bits of the coordinates of a pixel within its tile.
+	 */
+	static inline unsigned morton(unsigned x, unsigned y)
+	{
+		return (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+	}
+	
+	/**
+	 * @return the position of the pixel (x, y) in the planes.
+	 */
+	inline size_t index(int x, int y) const
+	{
+		if(m_layout == FRAMEBUFFER_LAYOUT_LINEAR) return (size_t) y * this->width() + x;
+		if(m_layout == FRAMEBUFFER_LAYOUT_TOP_DOWN) return (size_t) (this->height() - 1 - y) * this->width() + x;
+		return tile(x, y) * TILE_SIZE * TILE_SIZE + morton((unsigned) x % TILE_SIZE, (unsigned) y % TILE_SIZE);
+	}
+	
+	/**
+	 * Allocates the planes and the tile flags.
+	 * 
+	 * @param color The RGBA8 color plane held by the caller, or NULL to allocate it.
+	 */
+	void allocate(unsigned char* color);
+	
+	/**
+	 * Copies a tiled or top down plane into row major order, bottom row first.
+	 * 
+	 * @param src The tiled or top down plane.
+	 * @param dst The row major plane, with room for width * height pixels.
+	 * @param pixelSize The number of bytes per pixel.
+	 */
+	void linearize(const unsigned char* src, unsigned char* dst, size_t pixelSize) const;
+	
+	/**
+	 * Upscales the rendered region of a row major color plane to the full size
+	 * with a bilinear filter.
+	 * 
+	 * @param src The row major plane.
+	 * @param dst The upscaled plane, with room for width * height pixels.
+	 */
+	void upscale(const unsigned char* src, unsigned char* dst) const;
+	
+	/**
+	 * Fills a flagged tile with the clear values and removes its flag.
+	 */
+	void materialize(size_t tile);
+	
+	/**
+	 * Fills all flagged tiles with the clear values. The contents seen through
+	 * the accessors do not change, so this is allowed on constant buffers.
+	 */
+	void materializeAll() const;
+	
+	/**
+	 * Encodes a color into the color plane.
+	 */
+	inline void writeColor(size_t i, float r, float g, float b);
+	
+	/**
+	 * Encodes a depth into the depth plane.
+	 */
+	inline void writeDepth(size_t i, float z);
+	
+	/**
+	 * Converts a depth to a window depth unsigned normalized integer.
+	 * 
+	 * @param z The z value, in [-1, 1].
+	 * @param max The largest integer, 2^bits - 1.
+	 */
+	static inline uint32_t unorm(float z, float max)
+	{
+		float d = z * 0.5f + 0.5f;
+		if(d <= 0.0f) return 0;
+		if(d >= 1.0f) return (uint32_t) max;
+		return (uint32_t) (d * max + 0.5f);
+	}
+	
+	/**
+	 * Converts a color channel to an unsigned normalized integer.
+	 */
+	static inline uint32_t channel(float c, float max)
+	{
+		if(c <= 0.0f) return 0;
+		if(c >= 1.0f) return (uint32_t) max;
+		return (uint32_t) (c * max + 0.5f);
+	}
+	
+	template<class T>
+	static inline bool compare(T z, T stored, depth_func func)
+	{
+		switch(func){
+			case DEPTH_FUNC_EQUAL: return z == stored;
+			case DEPTH_FUNC_LEQUAL: return z <= stored;
+			default:
+			case DEPTH_FUNC_LESS: return z < stored;
+		}
+	}
 	
 	/**
 	 * Allocates the texture object using OpenGL. Sets the bAllocated and textureHandle 
@@ -113,13 +456,92 @@ protected:
 	/**
 	 * Copies the frame buffer data to the allocated OpenGL texture and draws it.
 	 * 
+	 * @param color the row major color data
 	 * @param x the specified x location at which to start drawing
 	 * @param x the specified y location at which to start drawing
 	 */
-	void drawGLTexture(float x=0, float y=0) const;
+	void drawGLTexture(const void* color, float x=0, float y=0) const;
 
 };	// class FrameBuffer
 
+inline float FrameBuffer::getZ(const int x, const int y) const
+{
+	if(m_cleared[tile(x, y)]) return m_clearStoredZ;
+	
+	size_t i = index(x, y);
+	switch(m_depthFormat){
+		case DEPTH_FORMAT_24: return m_depth24[i] * (2.0f / 16777215.0f) - 1.0f;
+		case DEPTH_FORMAT_16: return m_depth16[i] * (2.0f / 65535.0f) - 1.0f;
+		default:
+		case DEPTH_FORMAT_32F: return m_depth32f[i];
+	}
+}
+
+inline bool FrameBuffer::testZ(const int x, const int y, float z, depth_func func) const
+{
+	bool cleared = m_cleared[tile(x, y)] != 0;
+	switch(m_depthFormat){
+		case DEPTH_FORMAT_24: return compare(unorm(z, 16777215.0f), cleared ? m_clearDepthBits : m_depth24[index(x, y)], func);
+		case DEPTH_FORMAT_16: return compare(unorm(z, 65535.0f), cleared ? m_clearDepthBits : (uint32_t) m_depth16[index(x, y)], func);
+		default:
+		case DEPTH_FORMAT_32F: return compare(z, cleared ? m_clearZ : m_depth32f[index(x, y)], func);
+	}
+}
+
+inline void FrameBuffer::writeDepth(size_t i, float z)
+{
+	switch(m_depthFormat){
+		case DEPTH_FORMAT_24: m_depth24[i] = unorm(z, 16777215.0f); break;
+		case DEPTH_FORMAT_16: m_depth16[i] = (uint16_t) unorm(z, 65535.0f); break;
+		default:
+		case DEPTH_FORMAT_32F: m_depth32f[i] = z; break;
+	}
+}
+
+inline void FrameBuffer::writeColor(size_t i, float r, float g, float b)
+{
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8:{
+			unsigned char* pixel = m_color8 + i * 4;
+			pixel[0] = (unsigned char) channel(r, 255.0f);
+			pixel[1] = (unsigned char) channel(g, 255.0f);
+			pixel[2] = (unsigned char) channel(b, 255.0f);
+			pixel[3] = 255;
+			break;
+		}
+		case COLOR_FORMAT_RGB10A2:
+			m_rgb10a2[i] = channel(r, 1023.0f) | (channel(g, 1023.0f) << 10) | (channel(b, 1023.0f) << 20) | (3u << 30);
+			break;
+		default:
+		case COLOR_FORMAT_FLOAT:{
+			float* pixel = m_float + i * 4;
+			pixel[0] = r;
+			pixel[1] = g;
+			pixel[2] = b;
+			pixel[3] = 1.0f;
+			break;
+		}
+	}
+}
+
+inline void FrameBuffer::setZ(int ix, int iy, float z)
+{
+	size_t t = tile(ix, iy);
+	if(m_cleared[t]) materialize(t);
+	writeDepth(index(ix, iy), z);
+}
+
+inline void FrameBuffer::set(int ix, int iy, float r, float g, float b, float z)
+{
+	size_t t = tile(ix, iy);
+	if(m_cleared[t]) materialize(t);
+	m_written[t] = 1;
+	
+	size_t i = index(ix, iy);
+	writeColor(i, r, g, b);
+	writeDepth(i, z);
+}
+
 }	// namespace pixelpipe
 
 
@@ -0,0 +1,112 @@
+#ifndef __PIPELINE_GBUFFER_H
+#define __PIPELINE_GBUFFER_H
+
+#include <iostream>
+
+#include "core/framebuffer.h"
+#include "cg/vecmath/mat4.hpp"
+
+namespace pixelpipe {
+
+/*!
+ * \class GBuffer "core/gbuffer.h"
+ * \brief The geometry buffer used by the deferred shading mode.
+ * 
+ * The geometry pass stores the depth, the eye space normal, the albedo and the
+ * texture coordinates of the nearest fragment of every pixel. The lighting pass
+ * then evaluates the Phong model of the PhongShadedFP once per covered pixel,
+ * reconstructing the eye space position from the depth. Each attribute is kept
+ * in its own array so that the passes only touch the channels they use.
+ * 
+ * @see GBufferVP
+ * @see GBufferFP
+ */
+class GBuffer {
+public:
+	/**
+	 * Allocates a geometry buffer of the given size.
+	 * 
+	 * @param width the width in pixels
+	 * @param height the height in pixels
+	 */
+	GBuffer(const unsigned width, const unsigned height);
+	~GBuffer();
+	
+	unsigned width() const { return m_width; }
+	unsigned height() const { return m_height; }
+	
+	/**
+	 * Resets every pixel to the far plane and marks it as uncovered.
+	 */
+	void clear();
+	
+	/**
+	 * Returns the depth stored for the given pixel.
+	 */
+	float getDepth(const int x, const int y) const { return m_depth[y * m_width + x]; }
+	
+	/**
+	 * Stores the attributes of a fragment.
+	 * 
+	 * @param x The x coordinate.
+	 * @param y The y coordinate.
+	 * @param z The depth of the fragment.
+	 * @param normal The eye space normal (3 floats, not necessarily normalized).
+	 * @param albedo The surface color (3 floats).
+	 * @param u The first texture coordinate.
+	 * @param v The second texture coordinate.
+	 */
+	void set(int x, int y, float z, const float* normal, const float* albedo, float u, float v)
+	{
+		size_t i = y * m_width + x;
+		m_depth[i] = z;
+		m_normal[3*i] = normal[0];
+		m_normal[3*i+1] = normal[1];
+		m_normal[3*i+2] = normal[2];
+		m_albedo[3*i] = albedo[0];
+		m_albedo[3*i+1] = albedo[1];
+		m_albedo[3*i+2] = albedo[2];
+		m_uv[2*i] = u;
+		m_uv[2*i+1] = v;
+	}
+	
+	/**
+	 * The lighting pass. Shades every covered pixel once and writes the result
+	 * into the framebuffer; uncovered pixels are left untouched.
+	 * 
+	 * @param fb the framebuffer receiving the shaded pixels
+	 * @param screenToEye the inverse of the viewport * projection matrix
+	 * @param texturedAmbient whether the ambient term is modulated by the albedo, as in TexturedPhongFP
+	 */
+	void shade(FrameBuffer& fb, const cg::vecmath::Matrix4f& screenToEye, bool texturedAmbient) const;
+	
+	const float* depth() const { return m_depth; }
+	const float* normals() const { return m_normal; }
+	const float* albedo() const { return m_albedo; }
+	const float* uv() const { return m_uv; }
+	
+protected:
+	unsigned m_width;	//!< the width of the buffer
+	unsigned m_height;	//!< the height of the buffer
+	float* m_depth;		//!< the depth of each pixel, 1 where nothing was drawn
+	float* m_normal;	//!< the eye space normal of each pixel
+	float* m_albedo;	//!< the surface color of each pixel
+	float* m_uv;		//!< the texture coordinates of each pixel
+	
+private:
+	GBuffer(const GBuffer&);
+	GBuffer& operator=(const GBuffer&);
+	
+};	// class GBuffer
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::GBuffer& g)
+{
+	return out << "[ GBuffer: " << g.width() << "x" << g.height() << " ]";
+}
+
+#endif	// __PIPELINE_GBUFFER_H
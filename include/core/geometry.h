@@ -3,6 +3,7 @@
 
 #include <string>
 
+#ifndef PIXELPIPE_HEADLESS
 #ifdef __APPLE__
 #include <GLUT/glut.h>
 #include <OpenGL/gl.h>
@@ -12,6 +13,7 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 #endif
+#endif
 
 #include "cg/vecmath/vec2.hpp"
 #include "cg/vecmath/vec3.hpp"
@@ -103,7 +105,9 @@ public:
 	 */
 	static void plane(Color3f c, Pipeline& pipe)
 	{
+		pipe.beginObject(Vector3f(1.0f, 0.0f, 0.0f), 1.41421356f);
 		quad(pnn, ppn, ppp, pnp, rNormal, c, pipe);
+		pipe.endObject();
 	}
 
 	/**
@@ -112,12 +116,14 @@ public:
 	 */
 	static void cube(Pipeline& pipe)
 	{
+		pipe.beginObject(Vector3f(0.0f, 0.0f, 0.0f), 1.73205081f);
 		quad(nnn, nnp, npp, npn, lNormal, lColor, pipe);
 		quad(pnn, ppn, ppp, pnp, rNormal, rColor, pipe);
 		quad(nnn, pnn, pnp, nnp, dNormal, dColor, pipe);
 		quad(npn, npp, ppp, ppn, uNormal, uColor, pipe);
 		quad(nnn, npn, ppn, pnn, bNormal, bColor, pipe);
 		quad(nnp, pnp, ppp, npp, fNormal, fColor, pipe);
+		pipe.endObject();
 	}
 	
 	/**
@@ -125,6 +131,7 @@ public:
 	 */
 	static void sphere(int n, Color3f c, Pipeline& pipe)
 	{
+		pipe.beginObject(Vector3f(0.0f, 0.0f, 0.0f), 1.0f);
 		spheretri(n, v_p00, v_0p0, v_00p, c, pipe);
 		spheretri(n, v_00n, v_0p0, v_p00, c, pipe);
 		spheretri(n, v_n00, v_0p0, v_00n, c, pipe);
@@ -133,6 +140,7 @@ public:
 		spheretri(n, v_p00, v_0n0, v_00n, c, pipe);
 		spheretri(n, v_00n, v_0n0, v_n00, c, pipe);
 		spheretri(n, v_n00, v_0n0, v_00p, c, pipe);
+		pipe.endObject();
 	}
 	
 	
@@ -0,0 +1,221 @@
+#ifndef __PIPELINE_HEADLESS_H
+#define __PIPELINE_HEADLESS_H
+
+#include <string>
+#include <vector>
+
+#include "core/common.h"
+#include "core/pipeline_software.h"
+#include "core/camera.h"
+#include "core/scene.h"
+#include "core/texture.h"
+#include "core/resolution.h"
+#include "core/mapped_image.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class HeadlessRenderer "core/headless.h"
+ * \brief Renders scenes with the software pipeline into memory, without a window.
+ *
+ * This is the counterpart of PixelPipeWindow for machines without a display:
+ * the scene, camera and lights are set up the same way, but nothing depends on
+ * OpenGL or GLUT, and the frames are read back or written to image files.
+ *
+ */
+class HeadlessRenderer {
+public:
+	/**
+	 * The scenes that can be rendered.
+	 */
+	enum scene_type {
+		SCENE_CUBE,			//!< SceneCube
+		SCENE_SPHERES,		//!< SceneSpheres
+		SCENE_SPHERE_PLANE	//!< SceneSpherePlane
+	};
+
+	/**
+	 * @param width the width of the frames
+	 * @param height the height of the frames
+	 */
+	HeadlessRenderer(int width=800, int height=600);
+	~HeadlessRenderer();
+
+	/**
+	 * Selects the scene, before init().
+	 */
+	void setScene(scene_type scene) { m_sceneType = scene; }
+
+	/**
+	 * Adds a texture image used by the scene, before init(). Texturing is
+	 * enabled when at least one texture was added.
+	 *
+	 * @param filename the path to a TIFF, JPEG or PNG image
+	 */
+	void addTexture(const std::string& filename);
+
+	/**
+	 * @see PixelPipeWindow::setFragmentProgram
+	 */
+	void setFragmentProgram(const std::string& filename) { m_fragmentProgram = filename; }
+
+	/**
+	 * @see PixelPipeWindow::setDeferredShading
+	 */
+	void setDeferredShading(bool value) { m_deferredShading = value; }
+
+	/**
+	 * @see PixelPipeWindow::setVisibilityBuffer
+	 */
+	void setVisibilityBuffer(bool value) { m_visibilityBuffer = value; }
+
+	/**
+	 * @see PixelPipeWindow::setDrawOrder
+	 */
+	void setDrawOrder(draw_order order) { m_drawOrder = order; }
+
+	/**
+	 * @see PixelPipeWindow::setFrameBufferFormat
+	 */
+	void setFrameBufferFormat(color_format color, depth_format depth, framebuffer_layout layout = FRAMEBUFFER_LAYOUT_LINEAR)
+	{
+		m_colorFormat = color;
+		m_depthFormat = depth;
+		m_framebufferLayout = layout;
+	}
+
+	/**
+	 * @see PixelPipeWindow::setFrameCount
+	 */
+	void setFrameCount(unsigned count) { m_frameCount = count; }
+
+	/**
+	 * Selects how write() quantizes a COLOR_FORMAT_FLOAT framebuffer. The
+	 * compact color formats are already quantized and written as they are.
+	 *
+	 * @param encoding the transfer function of the written image
+	 * @param dither whether to quantize with an ordered dither
+	 */
+	void setOutputEncoding(color_encoding encoding, bool dither = false)
+	{
+		m_outputEncoding = encoding;
+		m_outputDither = dither;
+	}
+
+	/**
+	 * @see PixelPipeWindow::setFrameTimeBudget
+	 */
+	void setFrameTimeBudget(float milliseconds) { m_frameBudget = milliseconds; }
+
+	/**
+	 * Renders the frames straight into a memory mapped PAM image, before
+	 * init(). The image is a render texture of the pipeline with an RGBA8
+	 * color plane laid out top down, so each frame overwrites the pixels of
+	 * the file in place and nothing is encoded or written afterwards. The
+	 * frames are neither presented to the frame consumer nor scaled, and the
+	 * shading has to be forward.
+	 *
+	 * @param filename the path of the image, empty for none
+	 */
+	void setMappedOutput(const std::string& filename) { m_mappedFile = filename; }
+
+	/**
+	 * Configures the pipeline and loads the scene.
+	 */
+	void init();
+
+	/**
+	 * Renders one frame of the scene and presents it to the frame consumer of
+	 * the pipeline, or into the mapped image.
+	 */
+	void render();
+
+	/**
+	 * Waits for the last rendered frame and returns its color data.
+	 *
+	 * @see SoftwarePipeline::getFrameData
+	 */
+	const void* getFrameData();
+
+	/**
+	 * Writes the last rendered frame to a binary PPM image, top row first.
+	 *
+	 * @param filename the path of the image
+	 */
+	void write(const std::string& filename);
+
+	/**
+	 * Renders one image larger than the framebuffer and streams it to a
+	 * binary PPM image. The image is cut into tiles of the size of the
+	 * framebuffer, each rendered through the part of the view frustum that it
+	 * covers, and the tiles are rendered by horizontal bands from the top:
+	 * only one band of 8 bit pixels is held in memory, and each band is
+	 * written as soon as its tiles are done. Objects outside of a tile are
+	 * culled by the pipeline. The render scale is ignored.
+	 *
+	 * @param filename the path of the image
+	 * @param width the width of the image, in pixels
+	 * @param height the height of the image, in pixels
+	 */
+	void renderBands(const std::string& filename, unsigned width, unsigned height);
+
+	/**
+	 * Accessor method for the pipeline.
+	 */
+	SoftwarePipeline& getPipeline() const { return *m_pipeline; }
+
+	/**
+	 * Accessor method for the camera.
+	 */
+	Camera& getCamera() const { return *m_camera; }
+
+	/**
+	 * Accessor method for the render scale controller, NULL without a frame time budget.
+	 */
+	const ResolutionController* getResolution() const { return m_resolution; }
+
+protected:
+	int m_width;						//!< the width of the frames
+	int m_height;						//!< the height of the frames
+	scene_type m_sceneType;				//!< the scene created by init()
+	Scene* m_scene;						//!< the current scene instance
+	Camera* m_camera;					//!< the camera instance being used
+	SoftwarePipeline* m_pipeline;		//!< the pipeline instance
+	State* m_state;						//!< the global renderer state
+	std::vector<Texture*> m_textures;	//!< the textures loaded from external files.
+	std::string m_fragmentProgram;		//!< the fragment program file.
+	bool m_deferredShading;				//!< whether the pipeline shades through a GBuffer.
+	bool m_visibilityBuffer;			//!< whether the pipeline shades through a VisibilityBuffer.
+	draw_order m_drawOrder;				//!< the order in which the pipeline draws objects.
+	color_format m_colorFormat;			//!< the storage format of the framebuffer color.
+	depth_format m_depthFormat;			//!< the storage format of the framebuffer depth.
+	framebuffer_layout m_framebufferLayout;	//!< the memory layout of the framebuffer.
+	unsigned m_frameCount;				//!< the number of framebuffers.
+	color_encoding m_outputEncoding;	//!< the encoding of float framebuffers in written images.
+	bool m_outputDither;				//!< whether float framebuffers are dithered in written images.
+	float m_frameBudget;				//!< the frame time budget of the dynamic resolution, in milliseconds.
+	ResolutionController* m_resolution;	//!< the render scale controller, or NULL without a budget.
+	std::string m_mappedFile;			//!< the mapped output image file, empty for none.
+	MappedImage* m_mappedImage;			//!< the mapped output image, or NULL.
+	FrameBuffer* m_mappedFrame;			//!< the framebuffer over the mapped image, owned by the pipeline.
+	unsigned m_mappedUnit;				//!< the texture unit of m_mappedFrame.
+
+	/**
+	 * Clears the framebuffer and draws the scene through an off-axis frustum
+	 * into the bottom left width x height pixels of the framebuffer.
+	 */
+	void renderView(float left, float right, float bottom, float top, int width, int height);
+
+};	// class HeadlessRenderer
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::HeadlessRenderer& renderer)
+{
+	return out << "[ HeadlessRenderer ]";
+}
+
+#endif	// __PIPELINE_HEADLESS_H
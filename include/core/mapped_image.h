@@ -0,0 +1,79 @@
+#ifndef __PIPELINE_MAPPED_IMAGE_H
+#define __PIPELINE_MAPPED_IMAGE_H
+
+#include <string>
+#include <iostream>
+
+#include "core/common.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class MappedImage "core/mapped_image.h"
+ * \brief An uncompressed image file mapped into memory.
+ *
+ * The file is a PAM (portable arbitrary map) image of RGBA8 pixels: a short
+ * text header followed by the rows of pixels, top row first. The whole file is
+ * mapped shared, so the pixels written through pixels() land in the page
+ * cache and reach the file without an encode and write pass. A FrameBuffer
+ * with the top down layout renders straight into them.
+ *
+ * @see FrameBuffer
+ */
+class MappedImage {
+public:
+	/**
+	 * Creates (or truncates) the file, writes the header and maps it.
+	 *
+	 * @param filename the path of the image
+	 * @param width the width of the image, in pixels
+	 * @param height the height of the image, in pixels
+	 */
+	MappedImage(const std::string& filename, unsigned width, unsigned height);
+
+	/**
+	 * Unmaps and closes the file, the pixels are written back by the system.
+	 */
+	~MappedImage();
+
+	/**
+	 * Accessor method for the pixels, width * height * 4 bytes, top row first.
+	 */
+	unsigned char* pixels() const { return m_pixels; }
+
+	/**
+	 * Accessor method for the width of the image.
+	 */
+	unsigned width() const { return m_width; }
+
+	/**
+	 * Accessor method for the height of the image.
+	 */
+	unsigned height() const { return m_height; }
+
+	/**
+	 * Waits until the pixels are written to the file.
+	 */
+	void sync();
+
+protected:
+	unsigned m_width;			//!< the width of the image
+	unsigned m_height;			//!< the height of the image
+	int m_file;					//!< the file descriptor
+	size_t m_size;				//!< the size of the file and of the mapping, in bytes
+	unsigned char* m_data;		//!< the mapping of the whole file
+	unsigned char* m_pixels;	//!< the first pixel, after the header
+
+};	// class MappedImage
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::MappedImage& image)
+{
+	return out << "[ MappedImage: width=" << image.width() << ", height=" << image.height() << " ]";
+}
+
+#endif	// __PIPELINE_MAPPED_IMAGE_H
@@ -24,6 +24,11 @@ namespace pixelpipe {
  */
 class Pipeline {
 public:		
+	/**
+	 * Destructor, the pipelines are deleted through this class.
+	 */
+	virtual ~Pipeline() {}
+	
 	/**
 	 * Configures the pipeline so that the triangle and fragment processors are
 	 * now up to date. Forces some reinitialization in order to set up things like
@@ -311,6 +316,34 @@ public:
 	 */
 	virtual void renderTriangle(const cg::vecmath::Vector3f* v, const cg::vecmath::Color3f* c, const cg::vecmath::Vector3f* n, const cg::vecmath::Vector2f* t) = 0;
 	
+	/**
+	 * Marks the start of the geometry of one object. The bounding sphere, in
+	 * the current object coordinates, lets the pipeline adapt the rendering of
+	 * the object to its size on screen.
+	 * 
+	 * @param center the center of the object's bounding sphere
+	 * @param radius the radius of the object's bounding sphere
+	 * @see State::enableShadingLOD
+	 */
+	virtual void beginObject(const cg::vecmath::Vector3f& center, float radius) = 0;
+	
+	/**
+	 * Marks the end of the geometry started with beginObject().
+	 */
+	virtual void endObject() = 0;
+	
+	/**
+	 * Selects how the following geometry is rendered. The depth pass writes
+	 * depth only, with no color writes and no interpolated attributes. The
+	 * shading pass draws the same geometry again with an equal depth test, so
+	 * that fragments are only shaded for the surface left by the depth pass.
+	 * The forward pass is the default single pass rendering.
+	 * 
+	 * @param pass the new render pass
+	 * @see State::enableZPrepass
+	 */
+	virtual void setRenderPass(render_pass pass) = 0;
+	
 };	// class Pipeline
 
 }	// namespace pixelpipe
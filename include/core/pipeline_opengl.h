@@ -221,6 +221,21 @@ public:
 	 * @param t The 3 texture coordinates of the triangle - one for each vertex.
 	 */
 	virtual void renderTriangle(const cg::vecmath::Vector3f* v, const cg::vecmath::Color3f* c, const cg::vecmath::Vector3f* n, const cg::vecmath::Vector2f* t);
+	
+	/**
+	 * ! @copydoc Pipeline::beginObject()
+	 */
+	virtual void beginObject(const cg::vecmath::Vector3f& center, float radius);
+	
+	/**
+	 * ! @copydoc Pipeline::endObject()
+	 */
+	virtual void endObject();
+	
+	/**
+	 * ! @copydoc Pipeline::setRenderPass()
+	 */
+	virtual void setRenderPass(render_pass pass);
 
 protected:
 	GLuint m_textureHandle;
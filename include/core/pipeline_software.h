@@ -21,6 +21,15 @@ namespace pixelpipe {
 
 class VertexProcessor;
 class FragmentProcessor;
+class ShaderProgram;
+class ShaderBytecode;
+class GBuffer;
+class VisibilityBuffer;
+class VisibilityFP;
+class DrawQueue;
+class FrameRing;
+class FrameConsumer;
+class DamageTracker;
 
 /*!
  * \class SoftwarePipeline "core/pipeline_software.h"
@@ -30,6 +39,8 @@ class FragmentProcessor;
  */
 class SoftwarePipeline : public Pipeline {
 public:	
+	static const unsigned DEFAULT_FRAMEBUFFER = ~0u;	//!< The name of the framebuffer presented by drawFrameBuffer().
+	
 	SoftwarePipeline(int nx=800, int ny=600);
 	~SoftwarePipeline();
 	
@@ -74,6 +85,153 @@ public:
 	 */
 	virtual void setVertexProcessor(const VertexProcessor* vertProc);
 	
+	/**
+	 * Accessor method to install a compile-time composed shader program. While a
+	 * program is installed it replaces the vertex processor, the rasterizer and the 
+	 * fragment processor. Passing NULL returns to the processors.
+	 *
+	 * @param program the new shader program to use (the pipeline takes ownership)
+	 * @see StaticShaderProgram
+	 */
+	virtual void setShaderProgram(const ShaderProgram* program);
+	
+	/**
+	 * Accessor method to install an interpreted fragment program. configure()
+	 * then pairs a BytecodeFP running the program with the vertex processor the
+	 * program declares, in place of the processors it would otherwise select.
+	 * Passing NULL returns to those processors. Throws, deleting the program,
+	 * when it is written for a different number of lights than the State has.
+	 *
+	 * @param program the new fragment program to use (the pipeline takes ownership)
+	 * @see ShaderBytecode
+	 */
+	void setFragmentProgram(ShaderBytecode* program);
+	
+	/**
+	 * When enabled, configure() installs the prebuilt StaticShaderProgram that 
+	 * matches the selected processors, if there is one.
+	 *
+	 * @param value the new flag value
+	 */
+	void enableStaticShaders(bool value = true) { m_staticShaders = value; }
+	
+	/**
+	 * When enabled, configure() sets up deferred shading for lit rendering: the
+	 * geometry pass fills a GBuffer and the lighting pass shades each visible
+	 * pixel once before the frame is drawn or read back.
+	 *
+	 * @param value the new flag value
+	 * @see GBuffer
+	 */
+	void enableDeferredShading(bool value = true) { m_deferredShading = value; }
+	
+	/**
+	 * When enabled, configure() renders smooth shaded scenes through a
+	 * VisibilityBuffer: the geometry is rasterized with depth only, and the
+	 * fragment processor runs once per visible pixel before the frame is drawn
+	 * or read back. Deferred shading takes precedence when both are enabled.
+	 *
+	 * @param value the new flag value
+	 * @see VisibilityBuffer
+	 */
+	void enableVisibilityBuffer(bool value = true) { m_visibilityBuffer = value; }
+	
+	/**
+	 * Replaces the framebuffer with one of the same dimensions that stores its
+	 * color and depth planes in the given formats and layout. The contents are
+	 * lost, so this should be called before init().
+	 *
+	 * @param color the storage format of the color plane
+	 * @param depth the storage format of the depth plane
+	 * @param layout the memory layout of both planes
+	 * @see FrameBuffer
+	 */
+	void setFrameBufferFormat(color_format color, depth_format depth, framebuffer_layout layout = FRAMEBUFFER_LAYOUT_LINEAR);
+	
+	/**
+	 * Selects the number of framebuffers. With a single framebuffer, frames are
+	 * presented and read back synchronously. With more, the framebuffers form a
+	 * FrameRing: drawFrameBuffer() and getFrameData() submit the rendered frame
+	 * to a worker thread and rendering continues into the next framebuffer, while
+	 * the worker resolves the frame and hands it to the FrameConsumer. Then
+	 * drawFrameBuffer() presents and getFrameData() returns the most recently
+	 * completed frame, which may be up to count - 1 frames old; call
+	 * finishFrames() first to read back the frame just rendered. The contents are
+	 * lost, so this should be called before init().
+	 *
+	 * @param count the number of framebuffers
+	 * @see FrameRing
+	 */
+	void setFrameCount(unsigned count);
+	
+	/**
+	 * Submits the rendered frame to the FrameRing and waits until all submitted
+	 * frames are completed, so that getFrameData() returns the rendered frame.
+	 */
+	void finishFrames();
+	
+	/**
+	 * Sets the consumer of the presented frames, or NULL for none. Without a
+	 * FrameRing the consumer is called from drawFrameBuffer(). The pipeline does
+	 * not take ownership.
+	 *
+	 * @param consumer the new consumer
+	 */
+	void setFrameConsumer(FrameConsumer* consumer);
+	
+	/**
+	 * Renders the following frames into the bottom left region of the
+	 * framebuffer, scaled by the given factor in both dimensions, and upscales
+	 * them to the full size when they are presented or read back. The scale
+	 * applies from the next call to viewport(), which maps the requested
+	 * viewport into the region.
+	 *
+	 * @param scale the render scale, in (0, 1]
+	 * @see ResolutionController
+	 */
+	void setRenderScale(float scale);
+	
+	/**
+	 * Accessor method for the render scale.
+	 */
+	float getRenderScale() const { return m_renderScale; }
+	
+	/**
+	 * Enables the tracking of the tiles that change from one presented frame to
+	 * the next. The damage is computed when a frame is presented (on the worker
+	 * thread of a FrameRing) and handed to the FrameConsumer with the frame.
+	 *
+	 * @param value whether to track the damage
+	 * @see DamageTracker
+	 */
+	void enableDamageTracking(bool value = true);
+	
+	/**
+	 * Accessor method for the damage of the last presented frame, or NULL when
+	 * the damage is not tracked. With a FrameRing it is updated by the worker
+	 * thread, so it should only be read after finishFrames().
+	 */
+	const DamageTracker* getDamage() const { return m_damage; }
+	
+	/**
+	 * Selects the order in which objects are drawn. With any order but
+	 * DRAW_ORDER_SUBMISSION, the objects submitted between beginObject() and
+	 * endObject() are queued and drawn in that order when the frame is drawn or
+	 * read back, or when the render pass or the configuration changes. Geometry
+	 * outside of an object is drawn immediately.
+	 *
+	 * @param order the new drawing order
+	 * @see DrawQueue
+	 */
+	void setDrawOrder(draw_order order);
+	
+	/**
+	 * Draws the queued objects in the selected order and empties the queue.
+	 * Textures are bound and processors switched only when they differ from
+	 * those of the previous draw.
+	 */
+	void flushDraws();
+	
 	/**
 	 * Clears the current frame buffer.
 	 */
@@ -224,6 +382,55 @@ public:
 	 * ! @copydoc Pipeline::loadTexture2D()
 	 */
 	virtual void loadTexture2D(const unsigned width, const unsigned height, const pixel_format format, const pixel_type type, const void* data);
+	
+	/**
+	 * Allocates a render texture: a framebuffer held in a new texture unit. It
+	 * is rendered into while it is bound with bindFrameBuffer(), and sampled in
+	 * place, without a copy, when its unit is bound with bindTexture(). The
+	 * texture coordinate (0, 0) is the bottom left corner of the rendered image.
+	 * The pipeline owns the framebuffer until deleteTexture() is called.
+	 * 
+	 * @param width measured in pixels
+	 * @param height measured in pixels
+	 * @param color the storage format of the color plane
+	 * @param depth the storage format of the depth plane
+	 * @param layout the memory layout of both planes
+	 * @return the texture unit of the render texture
+	 * @see http://www.opengl.org/sdk/docs/man/xhtml/glGenFramebuffers.xml
+	 */
+	unsigned generateFrameBuffer(unsigned width, unsigned height, color_format color = COLOR_FORMAT_RGBA8,
+		depth_format depth = DEPTH_FORMAT_32F, framebuffer_layout layout = FRAMEBUFFER_LAYOUT_LINEAR);
+	
+	/**
+	 * Adds a framebuffer created by the caller as a render texture, such as
+	 * one whose color plane is a memory mapped image. The pipeline owns the
+	 * framebuffer until deleteTexture() is called.
+	 * 
+	 * @param framebuffer the framebuffer
+	 * @return the texture unit of the render texture
+	 */
+	unsigned attachFrameBuffer(FrameBuffer* framebuffer);
+	
+	/**
+	 * Selects the framebuffer that the following draws and clears render
+	 * into: a render texture allocated by generateFrameBuffer(), or
+	 * DEFAULT_FRAMEBUFFER. The queued draws are drawn into the previous target
+	 * first. The viewport is not changed, and the render scale only applies to
+	 * the default framebuffer. Render textures are shaded forward, so they
+	 * cannot be bound with deferred shading or the visibility buffer, and a
+	 * render texture must not be sampled while it is bound.
+	 * 
+	 * @param texture the texture unit of a render texture, or DEFAULT_FRAMEBUFFER
+	 * @see http://www.opengl.org/sdk/docs/man/xhtml/glBindFramebuffer.xml
+	 */
+	void bindFrameBuffer(unsigned texture);
+	
+	/**
+	 * Accessor method for the bound framebuffer.
+	 * 
+	 * @return the texture unit of the bound render texture, or DEFAULT_FRAMEBUFFER
+	 */
+	unsigned getBoundFrameBuffer() const;
 
 	/**
 	 * ! @copydoc Pipeline::getViewportMatrix()
@@ -269,6 +476,48 @@ public:
 	 * @param t The 3 texture coordinates of the triangle - one for each vertex.
 	 */
 	virtual void renderTriangle(const cg::vecmath::Vector3f* v, const cg::vecmath::Color3f* c, const cg::vecmath::Vector3f* n, const cg::vecmath::Vector2f* t);
+	
+	/**
+	 * Selects the processors for the object from the projected size of its
+	 * bounding sphere when the shading level of detail is enabled. Large objects
+	 * are shaded per fragment, medium objects per vertex and small objects once
+	 * per triangle. Has no effect while a shader program is installed.
+	 * 
+	 * Objects whose bounding sphere is outside of the view volume are culled:
+	 * their geometry is ignored until endObject(), so that rendering a small
+	 * part of the view (a band of a large image) only processes what it shows.
+	 * 
+	 * ! @copydoc Pipeline::beginObject()
+	 */
+	virtual void beginObject(const cg::vecmath::Vector3f& center, float radius);
+	
+	/**
+	 * Restores the processors selected by configure().
+	 * 
+	 * ! @copydoc Pipeline::endObject()
+	 */
+	virtual void endObject();
+	
+	/**
+	 * The depth pass uses a DepthOnlyVP, a DepthFP and a rasterizer without
+	 * attributes, whatever the configured processors. The shading pass sets
+	 * DEPTH_FUNC_EQUAL on the fragment processors and the shader program. The
+	 * deferred and visibility buffer modes already shade each pixel once and
+	 * keep their own depth, so they skip the depth pass.
+	 * 
+	 * ! @copydoc Pipeline::setRenderPass()
+	 */
+	virtual void setRenderPass(render_pass pass);
+	
+	/**
+	 * Computes the radius, in pixels, of a bounding sphere projected with the
+	 * current matrices.
+	 * 
+	 * @param center the center of the sphere in object coordinates
+	 * @param radius the radius of the sphere in object coordinates
+	 * @return the projected radius, FLT_MAX if the sphere contains the eye
+	 */
+	float projectedRadius(const cg::vecmath::Vector3f& center, float radius) const;
 
 protected:
 	matrix_mode m_matrixMode;		//!< The currently selected matrix mode.
@@ -295,14 +544,157 @@ private:
 	Clipper* m_clipper;				//!< The geometry clipper being used to perform frustum culling.
 	Rasterizer* m_rasterizer;		//!< An instance of the rasterizer being used to perform blitting.
 	FragmentProcessor* m_fp;		//!< The current fragment processor being used.
-	FrameBuffer* m_framebuffer;		//!< The current framebuffer being used as the render target.
+	FrameBuffer* m_framebuffer;		//!< The default framebuffer, presented by drawFrameBuffer().
+	FrameBuffer* m_renderTarget;	//!< The bound render texture, or NULL when rendering into m_framebuffer.
+	std::vector<FrameBuffer*> m_renderTextures;	//!< The render textures allocated by generateFrameBuffer() or attached.
+	FrameRing* m_frames;			//!< The ring owning the framebuffers, or NULL when m_framebuffer is the only one.
+	FrameConsumer* m_consumer;		//!< The consumer of the presented frames.
+	DamageTracker* m_damage;		//!< The damage of the presented frames, or NULL when it is not tracked.
+	float m_renderScale;			//!< The scale of the rendered region of the framebuffer.
+	bool m_frameDirty;				//!< Whether the render target was cleared or drawn into since it was submitted.
+	ShaderProgram* m_program;		//!< The compile-time composed shader program, overrides the processors when set.
+	ShaderBytecode* m_fragmentProgram;	//!< The interpreted fragment program installed by configure(), or NULL.
+	bool m_staticShaders;			//!< Whether configure() should install a prebuilt shader program.
+	bool m_deferredShading;			//!< Whether configure() should set up deferred shading.
+	GBuffer* m_gbuffer;				//!< The geometry buffer of the deferred mode, NULL in forward mode.
+	bool m_gbufferResolved;			//!< Whether the lighting pass already ran for the current frame.
+	bool m_visibilityBuffer;		//!< Whether configure() should set up the visibility buffer.
+	VisibilityBuffer* m_visbuffer;	//!< The visibility buffer, NULL when fragments are shaded as they are rasterized.
+	VisibilityFP* m_visFP;			//!< The fragment processor of the visibility pass.
+	Rasterizer* m_visRasterizer;	//!< The depth only rasterizer of the visibility pass.
+	bool m_visbufferResolved;		//!< Whether the resolve pass already ran for the current frame.
+	render_pass m_pass;				//!< The current render pass.
+	VertexProcessor* m_depthVP;		//!< The position only vertex processor of the depth pass.
+	FragmentProcessor* m_depthFP;	//!< The depth writing fragment processor of the depth pass.
+	Clipper* m_depthClipper;		//!< The clipper of the depth pass, without attributes.
+	Rasterizer* m_depthRasterizer;	//!< The rasterizer of the depth pass, without attributes.
+	DrawQueue* m_drawQueue;			//!< The queue of sorted objects, NULL when draws are not sorted.
+	draw_order m_drawOrder;			//!< The order in which the queued objects are drawn.
+	bool m_replaying;				//!< Whether the queued draws are being executed.
+	
+	/**
+	 * The processors and the matching rasterizer used for one shading level.
+	 */
+	struct ProcessorSet {
+		VertexProcessor* vp;
+		FragmentProcessor* fp;
+		Rasterizer* rasterizer;
+	};
+	
+	ProcessorSet m_levels[3];		//!< The processors for each shading_level, empty when the shading LOD is disabled.
+	ProcessorSet m_configured;		//!< The processors selected by configure() while an object overrides them.
+	bool m_inObject;				//!< Whether an object has replaced the configured processors.
+	bool m_culled;					//!< Whether the current object is outside of the view volume.
 	
 	Vertex m_vertexCache[4];		//!< The vertex cache used to transfer geometry to through the pipeline.
+	cg::vecmath::Vector3f m_positionCache[4];	//!< The positions of the cached vertices, for the processors that light triangles.
+	cg::vecmath::Color3f m_colorCache[4];		//!< The colors of the cached vertices.
+	cg::vecmath::Vector3f m_normalCache[4];		//!< The normals of the cached vertices.
+	cg::vecmath::Vector2f m_texcoordCache[4];	//!< The texture coordinates of the cached vertices.
+	bool m_assembling;				//!< Whether the cached vertices are processed as whole triangles.
 	Vertex m_triangle1[3];			//!< The local copy of the first triangle stored after clipping.
 	Vertex m_triangle2[3];			//!< The local copy of the second triangle stored after clipping.
+	Vertex m_depthTriangle1[3];		//!< The first clipped triangle of the depth pass.
+	Vertex m_depthTriangle2[3];		//!< The second clipped triangle of the depth pass.
 	
 	void swap(Vertex* va, int i, int j) const;
 	
+	/**
+	 * Swaps two vertices of the cache, and their inputs while assembling triangles.
+	 */
+	void swapCached(int i, int j);
+	
+	/**
+	 * Renders the first three vertices of the cache, processing their inputs
+	 * as a triangle first while assembling triangles.
+	 */
+	void renderCached();
+	
+	/**
+	 * @return the framebuffer being rendered into.
+	 */
+	FrameBuffer& target() const { return m_renderTarget ? *m_renderTarget : *m_framebuffer; }
+	
+	/**
+	 * Sets the frame size of the rasterizers and of the shader program to the
+	 * dimensions of the framebuffer being rendered into.
+	 */
+	void updateTargetSize();
+	
+	/**
+	 * Runs the deferred lighting pass if the current frame has not been shaded yet.
+	 */
+	void resolveGBuffer();
+	
+	/**
+	 * Runs the fragment processor over the visibility buffer if the current
+	 * frame has not been shaded yet.
+	 */
+	void resolveVisibility();
+	
+	/**
+	 * Submits the render target to the FrameRing if it was cleared or drawn
+	 * into, and renders into the next framebuffer of the ring.
+	 */
+	void submitFrame();
+	
+	/**
+	 * Deletes the visibility buffer and its processors.
+	 */
+	void deleteVisibility();
+	
+	/**
+	 * Applies the depth test of the current render pass to the fragment
+	 * processors and the shader program.
+	 */
+	void updateDepthFunc();
+	
+	/**
+	 * Notifies the processors and the shader program of new matrices.
+	 */
+	void updateTransforms();
+	
+	/**
+	 * Computes the radius of a sphere scaled by the model-view matrix.
+	 */
+	float scaledRadius(float radius) const;
+	
+	/**
+	 * Tests a bounding sphere against the planes of the view volume of the
+	 * current matrices.
+	 * 
+	 * @param center the center of the sphere in object coordinates
+	 * @param radius the radius of the sphere in object coordinates
+	 * @return whether the sphere is entirely outside of the view volume
+	 */
+	bool outsideView(const cg::vecmath::Vector3f& center, float radius) const;
+	
+	/**
+	 * @return whether objects are drawn with the processors of a shading level
+	 */
+	bool usesLevels() const;
+	
+	/**
+	 * Replaces the configured processors with those of a shading level.
+	 */
+	void useLevel(shading_level level);
+	
+	/**
+	 * Creates the processors of the shading level of detail for the current state.
+	 */
+	void createLevels();
+	
+	/**
+	 * Deletes the processors of the shading level of detail.
+	 */
+	void deleteLevels();
+	
+	/**
+	 * Makes the given processors current and brings them up to date with the
+	 * matrices, the lights and the bound texture.
+	 */
+	void useProcessors(const ProcessorSet& set);
+	
 	/**
 	 * Renders a triangle from already-processed vertices.
 	 * 
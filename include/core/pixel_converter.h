@@ -0,0 +1,100 @@
+#ifndef __PIPELINE_PIXEL_CONVERTER_H
+#define __PIPELINE_PIXEL_CONVERTER_H
+
+#include <iostream>
+
+#include "core/common.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class PixelConverter "core/pixel_converter.h"
+ * \brief Converts float RGB(A) pixels to 8 bit unsigned normalized pixels.
+ *
+ * The channels are clamped to [0, 1], optionally encoded with the sRGB transfer
+ * function, quantized (rounded, or with a 4x4 ordered dither) and stored in the
+ * selected channel order. The alpha channel is never sRGB encoded, and the RGB
+ * and BGR orders drop it. Sources with 3 channels get an alpha of 1.
+ *
+ * COLOR_ENCODING_SRGB_TABLE looks the encoded values up in a 4096 entry table
+ * (within one step of the exact result), and COLOR_ENCODING_SRGB_POLYNOMIAL
+ * evaluates the FastMath MATH_PRECISION_FAST log2 and exp2 polynomials.
+ *
+ * The rows are processed with SSE2 when it is available (defining
+ * PIXELPIPE_NO_SSE2 selects the scalar path), and large images are split in row
+ * bands across threads.
+ */
+class PixelConverter {
+public:
+	static const unsigned PARALLEL_PIXELS = 1 << 16;	//!< the smallest image split across threads
+
+	/**
+	 * @param order the channel order of the output pixels
+	 * @param encoding the transfer function applied to the color channels
+	 * @param dither whether the channels are quantized with an ordered dither
+	 */
+	PixelConverter(channel_order order = CHANNEL_ORDER_RGBA, color_encoding encoding = COLOR_ENCODING_LINEAR, bool dither = false);
+
+	void setChannelOrder(channel_order order) { m_order = order; }
+	void setEncoding(color_encoding encoding) { m_encoding = encoding; }
+	void setDither(bool value) { m_dither = value; }
+
+	channel_order getChannelOrder() const { return m_order; }
+	color_encoding getEncoding() const { return m_encoding; }
+	bool getDither() const { return m_dither; }
+
+	/**
+	 * @return the number of channels (bytes) of an output pixel.
+	 */
+	unsigned channels() const { return (m_order == CHANNEL_ORDER_RGB || m_order == CHANNEL_ORDER_BGR) ? 3 : 4; }
+
+	/**
+	 * Converts one row.
+	 *
+	 * @param src the source pixels
+	 * @param srcChannels the number of channels of the source pixels, 3 or 4
+	 * @param width the number of pixels
+	 * @param y the row number, which selects the dither pattern
+	 * @param dst the output row of width * channels() bytes
+	 */
+	void convertRow(const float* src, unsigned srcChannels, unsigned width, unsigned y, unsigned char* dst) const;
+
+	/**
+	 * Converts an image of tightly packed rows.
+	 *
+	 * @param src the source pixels
+	 * @param srcChannels the number of channels of the source pixels, 3 or 4
+	 * @param width the width of the image
+	 * @param height the height of the image
+	 * @param dst the output image of width * height * channels() bytes
+	 * @param flip whether the rows are written in the reverse order (to turn the
+	 * bottom to top rows of a framebuffer into top to bottom image rows)
+	 * @param threads the number of threads, or 0 for one per core
+	 */
+	void convert(const float* src, unsigned srcChannels, unsigned width, unsigned height, unsigned char* dst,
+		bool flip = false, unsigned threads = 0) const;
+
+protected:
+	channel_order m_order;			//!< the channel order of the output
+	color_encoding m_encoding;		//!< the transfer function of the color channels
+	bool m_dither;					//!< whether to dither instead of rounding
+
+	/**
+	 * Converts the rows [first, last) of an image.
+	 */
+	void convertRows(const float* src, unsigned srcChannels, unsigned width, unsigned height, unsigned char* dst,
+		bool flip, unsigned first, unsigned last) const;
+
+};	// class PixelConverter
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::PixelConverter& converter)
+{
+	return out << "[ PixelConverter ]";
+}
+
+#endif	// __PIPELINE_PIXEL_CONVERTER_H
@@ -12,6 +12,7 @@
 #include "core/camera.h"
 #include "core/geometry.h"
 #include "core/scene.h"
+#include "core/resolution.h"
 
 namespace pixelpipe {
 
@@ -40,6 +41,72 @@ public:
 	 */
 	std::string getModeStr() const;
 	
+	/**
+	 * Shades the software pipeline with an interpreted fragment program, fed by
+	 * the vertex processor the program declares.
+	 * 
+	 * @param filename the path to the program text, or an empty string for the built-in shaders
+	 * @see ShaderBytecode
+	 */
+	void setFragmentProgram(const std::string& filename) { m_fragmentProgram = filename; }
+	
+	/**
+	 * Selects deferred shading for the software pipeline.
+	 * 
+	 * @param value true to shade lit scenes through a GBuffer
+	 * @see SoftwarePipeline::enableDeferredShading
+	 */
+	void setDeferredShading(bool value) { m_deferredShading = value; }
+	
+	/**
+	 * Selects the visibility buffer for the software pipeline.
+	 * 
+	 * @param value true to shade each visible pixel once after the depth only pass
+	 * @see SoftwarePipeline::enableVisibilityBuffer
+	 */
+	void setVisibilityBuffer(bool value) { m_visibilityBuffer = value; }
+	
+	/**
+	 * Selects the order in which the software pipeline draws objects.
+	 * 
+	 * @param order the drawing order of the objects of each frame
+	 * @see SoftwarePipeline::setDrawOrder
+	 */
+	void setDrawOrder(draw_order order) { m_drawOrder = order; }
+	
+	/**
+	 * Selects the storage formats of the software pipeline framebuffer.
+	 * 
+	 * @param color the storage format of the color plane
+	 * @param depth the storage format of the depth plane
+	 * @param layout the memory layout of both planes
+	 * @see SoftwarePipeline::setFrameBufferFormat
+	 */
+	void setFrameBufferFormat(color_format color, depth_format depth, framebuffer_layout layout = FRAMEBUFFER_LAYOUT_LINEAR)
+	{
+		m_colorFormat = color;
+		m_depthFormat = depth;
+		m_framebufferLayout = layout;
+	}
+	
+	/**
+	 * Selects the number of framebuffers of the software pipeline.
+	 * 
+	 * @param count 1 to present synchronously, more to present on a worker thread
+	 * @see SoftwarePipeline::setFrameCount
+	 */
+	void setFrameCount(unsigned count) { m_frameCount = count; }
+	
+	/**
+	 * Enables dynamic resolution for the software pipeline: the time of each
+	 * call to render() is measured and a ResolutionController picks the render
+	 * scale of the next frame to hold the budget.
+	 * 
+	 * @param milliseconds the frame time budget, or 0 to always render at full resolution
+	 * @see SoftwarePipeline::setRenderScale
+	 */
+	void setFrameTimeBudget(float milliseconds) { m_frameBudget = milliseconds; }
+	
 protected:		
 	render_mode m_mode;		//!< the current mode the pipeline is rendering in
 	Scene* m_scene;			//!< the current scene instance
@@ -47,6 +114,16 @@ protected:
 	Pipeline* m_pipeline;	//!< the pipeline instance
 	State* m_state;			//!< the global renderer state
 	std::vector<Texture*> m_textures;	//!< the textures to be loaded from external files. 
+	std::string m_fragmentProgram;		//!< the fragment program file used by the software pipeline.
+	bool m_deferredShading;				//!< whether the software pipeline shades through a GBuffer.
+	bool m_visibilityBuffer;			//!< whether the software pipeline shades through a VisibilityBuffer.
+	draw_order m_drawOrder;				//!< the order in which the software pipeline draws objects.
+	color_format m_colorFormat;			//!< the storage format of the software framebuffer color.
+	depth_format m_depthFormat;			//!< the storage format of the software framebuffer depth.
+	framebuffer_layout m_framebufferLayout;	//!< the memory layout of the software framebuffer.
+	unsigned m_frameCount;				//!< the number of software framebuffers.
+	float m_frameBudget;				//!< the frame time budget of the dynamic resolution, in milliseconds.
+	ResolutionController* m_resolution;	//!< the render scale controller, or NULL without a budget.
 	
 	virtual int render();
 	virtual int resize(int width, int height);
@@ -47,11 +47,34 @@ public:
 	 */
 	void setAttributeCount(int count);
 	
+	/**
+	 * Sets the dimensions of the framebuffers being rendered into, to which
+	 * the triangles are clamped.
+	 * 
+	 * @param nx The width of the image.
+	 * @param ny The height of the image.
+	 */
+	void setFrameSize(int nx, int ny) { m_frameWidth = nx; m_frameHeight = ny; }
+	
+	/**
+	 * Enables flat shading. The attributes of the last (provoking) vertex are
+	 * copied into every fragment of the triangle and only the depth is
+	 * interpolated.
+	 * 
+	 * @param value true to enable flat shading
+	 */
+	void setFlatShading(bool value) { m_flat = value; }
+	
+	/**
+	 * Accessor method for the flat shading flag.
+	 */
+	bool getFlatShading() const { return m_flat; }
 	
 protected:
 	int m_attributes;	//!< the number of attributes to be expected for each vertex being rasterized
 	int m_frameWidth;	//!< the width of the target framebuffer
 	int m_frameHeight;	//!< the height of the target framebuffer
+	bool m_flat;		//!< whether the attributes are constant across each triangle
 	float* m_vData;		//!< The array of vertex & attribute floats that are computed during rasterization
 	float* m_xInc;		//!< The x increment value used during the rasterization process.
 	float* m_yInc;		//!< The y increment value used during the rasterization process.
@@ -0,0 +1,84 @@
+#ifndef __PIPELINE_RESOLUTION_H
+#define __PIPELINE_RESOLUTION_H
+
+#include <iostream>
+
+#include "core/common.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class ResolutionController "core/resolution.h"
+ * \brief Picks the render scale of each frame to hold a frame time budget.
+ *
+ * The cost of a frame is assumed to grow with its number of pixels, that is
+ * with the square of the scale. After each frame, update() smooths the measured
+ * frame time and moves the scale towards scale * sqrt(budget / time). To avoid
+ * oscillating between sizes, the scale only changes when the smoothed time is
+ * more than 5% away from the budget, by at most 10% per frame, and in steps of
+ * 1/64.
+ *
+ * Near the smallest scales a step of 1/64 changes the frame time by more than
+ * 10%, and the rounding would cancel the steps the time asks for. The scale
+ * then moves by a single step when that brings the time closer to the budget,
+ * and no step is taken that would not, so the scale settles on the step whose
+ * time is nearest the budget even when none is within 5% of it.
+ *
+ * @see SoftwarePipeline::setRenderScale
+ */
+class ResolutionController {
+public:
+	/**
+	 * @param budget the target frame time, in milliseconds
+	 * @param minScale the smallest scale
+	 * @param maxScale the largest scale
+	 */
+	ResolutionController(float budget, float minScale = 0.25f, float maxScale = 1.0f);
+
+	/**
+	 * Feeds the time of the last frame and returns the scale of the next one.
+	 *
+	 * @param milliseconds the measured time of the last frame
+	 */
+	float update(float milliseconds);
+
+	/**
+	 * Accessor method for the current scale.
+	 */
+	float getScale() const { return m_scale; }
+
+	/**
+	 * Accessor method for the smoothed frame time, in milliseconds.
+	 */
+	float getFrameTime() const { return m_time; }
+
+	/**
+	 * Accessor method for the frame time budget, in milliseconds.
+	 */
+	float getBudget() const { return m_budget; }
+
+	/**
+	 * Sets the frame time budget, in milliseconds.
+	 */
+	void setBudget(float budget) { m_budget = budget; }
+
+protected:
+	float m_budget;			//!< the target frame time
+	float m_minScale;		//!< the smallest scale
+	float m_maxScale;		//!< the largest scale
+	float m_scale;			//!< the current scale
+	float m_time;			//!< the smoothed frame time, or 0 before the first frame
+
+};	// class ResolutionController
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::ResolutionController& controller)
+{
+	return out << "[ ResolutionController scale=" << controller.getScale() << ", time=" << controller.getFrameTime() << " ]";
+}
+
+#endif	// __PIPELINE_RESOLUTION_H
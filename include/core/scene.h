@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 
+#ifndef PIXELPIPE_HEADLESS
 #ifdef __APPLE__
 #include <GLUT/glut.h>
 #include <OpenGL/gl.h>
@@ -14,6 +15,7 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 #endif
+#endif
 
 #include "core/pipeline.h"
 #include "core/geometry.h"
@@ -36,7 +38,7 @@ public:
 		m_textures->reserve(32);
 	}
 	
-	~Scene() {
+	virtual ~Scene() {
 		m_textures->clear();
 		delete m_textures;
 	}
@@ -105,10 +107,10 @@ public:
 			Texture* image1 = m_textures->at(1);
 			tex0 = m_pipeline.generateTexture();
 			m_pipeline.bindTexture(tex0);
-			m_pipeline.loadTexture2D(image0->width(), image0->height(), PIXEL_FORMAT_RGB, PIXEL_TYPE_UNSIGNED_BYTE, image0->getTextureBytes());
+			m_pipeline.loadTexture2D(image0->width(), image0->height(), PIXEL_FORMAT_RGB, PIXEL_TYPE_FLOAT, image0->getTextureBytes());
 			tex1 = m_pipeline.generateTexture();
 			m_pipeline.bindTexture(tex1);
-			m_pipeline.loadTexture2D(image1->width(), image1->height(), PIXEL_FORMAT_RGB, PIXEL_TYPE_UNSIGNED_BYTE, image1->getTextureBytes());
+			m_pipeline.loadTexture2D(image1->width(), image1->height(), PIXEL_FORMAT_RGB, PIXEL_TYPE_FLOAT, image1->getTextureBytes());
 		}
 	}
 	
@@ -193,7 +195,7 @@ public:
 			Texture* image0 = m_textures->at(0);
 			tex0 = m_pipeline.generateTexture();
 			m_pipeline.bindTexture(tex0);
-			m_pipeline.loadTexture2D(image0->width(), image0->height(), PIXEL_FORMAT_RGB, PIXEL_TYPE_UNSIGNED_BYTE, image0->getTextureBytes());
+			m_pipeline.loadTexture2D(image0->width(), image0->height(), PIXEL_FORMAT_RGB, PIXEL_TYPE_FLOAT, image0->getTextureBytes());
 		}
 	}
 	
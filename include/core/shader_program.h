@@ -0,0 +1,388 @@
+#ifndef __PIPELINE_SHADER_PROGRAM_H
+#define __PIPELINE_SHADER_PROGRAM_H
+
+#include <type_traits>
+#include <algorithm>
+#include <math.h>
+
+#include "core/common.h"
+#include "core/framebuffer.h"
+#include "core/pipeline_software.h"
+#include "core/state.h"
+#include "core/texture.h"
+#include "core/vertex.h"
+#include "cg/vecmath/vec2.hpp"
+#include "cg/vecmath/vec3.hpp"
+#include "cg/vecmath/vec4.hpp"
+#include "cg/vecmath/mat4.hpp"
+
+namespace pixelpipe {
+
+/*!
+ * \class ShaderProgram "core/shader_program.h"
+ * \brief Base class for a vertex stage and a fragment stage that are compiled together.
+ *
+ * A shader program replaces the VertexProcessor, Rasterizer and FragmentProcessor
+ * trio of the SoftwarePipeline. It is only called through a virtual method once
+ * per vertex and once per triangle; everything that happens per fragment is
+ * resolved at compile time by StaticShaderProgram.
+ *
+ * @see StaticShaderProgram
+ */
+class ShaderProgram {
+public:
+	virtual ~ShaderProgram() {}
+
+	/**
+	 * Returns the number of varying floats passed from the vertex stage to the fragment stage.
+	 */
+	virtual int nAttr() const = 0;
+
+	/**
+	 * @copydoc VertexProcessor::updateTransforms()
+	 */
+	virtual void updateTransforms(const SoftwarePipeline& pipe) = 0;
+
+	/**
+	 * @copydoc VertexProcessor::updateLightModel()
+	 */
+	virtual void updateLightModel(const SoftwarePipeline& pipe) = 0;
+
+	/**
+	 * @copydoc VertexProcessor::vertex()
+	 */
+	virtual void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, Vertex& output) = 0;
+
+	/**
+	 * Rasterizes an already clipped triangle and shades its fragments.
+	 *
+	 * @param vs The array of 3 vertices produced by ShaderProgram::vertex.
+	 * @param fb A reference to the framebuffer to which the fragments will be written.
+	 */
+	virtual void rasterize(const Vertex* vs, FrameBuffer& fb) = 0;
+
+	/**
+	 * Sets the texture sampled by the fragment stage.
+	 *
+	 * @param texture a reference to the texture to use.
+	 */
+	virtual void setTexture(const Texture* texture) = 0;
+
+	/**
+	 * Accessor method for the dimensions of the render target.
+	 *
+	 * @param width the framebuffer width
+	 * @param height the framebuffer height
+	 */
+	virtual void setFrameSize(int width, int height) = 0;
+
+	/**
+	 * @copydoc FragmentProcessor::setDepthFunc()
+	 */
+	virtual void setDepthFunc(depth_func func) = 0;
+
+};	// class ShaderProgram
+
+/*!
+ * \class VertexStage "core/shader_program.h"
+ * \brief Base class for the vertex half of a StaticShaderProgram.
+ *
+ * Derived stages must declare a varying_type and a non-virtual method:
+ *
+ *   void vertex(const Vector3f& v, const Color3f& c, const Vector3f& n,
+ *               const Vector2f& t, Vector4f& position, varying_type& out);
+ */
+class VertexStage {
+public:
+	VertexStage()
+	{
+		modelViewMatrix.identity();
+		MVP.identity();
+	}
+
+	/**
+	 * @copydoc VertexProcessor::updateTransforms()
+	 */
+	inline void updateTransforms(const SoftwarePipeline& pipe)
+	{
+		modelViewMatrix = pipe.modelViewMatrix();
+		MVP = pipe.viewportMatrix() * (pipe.projectionMatrix() * modelViewMatrix);
+	}
+
+	/**
+	 * @copydoc VertexProcessor::updateLightModel()
+	 */
+	inline void updateLightModel(const SoftwarePipeline& pipe) { }
+
+protected:
+	cg::vecmath::Matrix4f modelViewMatrix;	//!< the local model-view matrix
+	cg::vecmath::Matrix4f MVP;				//!< the modelview * projection * viewport matrix
+
+};	// class VertexStage
+
+/*!
+ * \class FragmentStage "core/shader_program.h"
+ * \brief Base class for the fragment half of a StaticShaderProgram.
+ *
+ * Derived stages must declare a varying_type and a non-virtual method:
+ *
+ *   void fragment(int x, int y, float z, const varying_type& in, FrameBuffer& fb);
+ */
+class FragmentStage {
+public:
+	FragmentStage() : m_texture(NULL), m_depthFunc(DEPTH_FUNC_LESS)
+	{
+		m_derivatives[0] = m_derivatives[1] = m_derivatives[2] = m_derivatives[3] = 0.0f;
+	}
+
+	/**
+	 * @copydoc FragmentProcessor::setTexture()
+	 */
+	void setTexture(const Texture* newTexture) {
+		m_texture = const_cast<Texture*>(newTexture);
+	}
+
+	/**
+	 * @copydoc FragmentProcessor::setDepthFunc()
+	 */
+	void setDepthFunc(depth_func func) { m_depthFunc = func; }
+
+	/**
+	 * Called by the StaticRasterizer before each fragment whose varyings hold
+	 * a texture coordinate.
+	 *
+	 * @param derivatives du/dx, dv/dx, du/dy and dv/dy
+	 */
+	inline void setDerivatives(const float* derivatives)
+	{
+		m_derivatives[0] = derivatives[0];
+		m_derivatives[1] = derivatives[1];
+		m_derivatives[2] = derivatives[2];
+		m_derivatives[3] = derivatives[3];
+	}
+
+protected:
+	Texture* m_texture;			//!< A reference to the currently bound texture.
+	depth_func m_depthFunc;		//!< The comparison used by the depth test.
+	float m_derivatives[4];		//!< The screen space derivatives of the texture coordinate of the fragment.
+
+	/**
+	 * @param x the x coordinate of the incoming fragment
+	 * @param y the y coordinate of the incoming fragment
+	 * @param z the depth of the incoming fragment
+	 * @param fb the framebuffer holding the stored depth
+	 * @return whether the fragment passes the depth test
+	 */
+	inline bool depthTest(int x, int y, float z, const FrameBuffer& fb) const
+	{
+		return fb.testZ(x, y, z, m_depthFunc);
+	}
+
+};	// class FragmentStage
+
+/*!
+ * \class StaticRasterizer "core/shader_program.h"
+ * \brief A Rasterizer specialized for a varying layout known at compile time.
+ *
+ * This performs exactly the same triangle setup and perspective correct
+ * interpolation as Rasterizer::rasterize, but the attribute count is a
+ * constant and the fragment stage is called directly, so the compiler can
+ * unroll the interpolation and inline the shading code. When
+ * Varying::texcoordIndex is not negative, the screen space derivatives of the
+ * texture coordinate at that index are handed to the stage for mip mapping.
+ *
+ * @see Rasterizer
+ */
+template<class Varying>
+class StaticRasterizer {
+public:
+	static const int N = 5 + Varying::count;	//!< barycentrics, depth, varyings and 1/w
+
+	StaticRasterizer(int nx = 0, int ny = 0) : m_frameWidth(nx), m_frameHeight(ny) {}
+
+	/**
+	 * Accessor method for the dimensions of the render target.
+	 */
+	void setFrameSize(int nx, int ny)
+	{
+		m_frameWidth = nx;
+		m_frameHeight = ny;
+	}
+
+	/**
+	 * @copydoc Rasterizer::rasterize()
+	 */
+	template<class FS>
+	inline void rasterize(const Vertex* vs, FS& fs, FrameBuffer& fb)
+	{
+		cg::vecmath::Vector4f posn[3];
+		for (int iv = 0; iv < 3; iv++) {
+			float invW = 1.0f / vs[iv].v.w;
+			posn[iv] = vs[iv].v * invW;
+			for (int k = 0; k < 3; k++){
+				m_vData[iv][k] = (k == iv ? 1 : 0);
+			}
+			m_vData[iv][3] = posn[iv].z;
+			for (int ia = 0; ia < Varying::count; ia++){
+				m_vData[iv][4 + ia] = invW * vs[iv].attributes[ia];
+			}
+			m_vData[iv][4 + Varying::count] = invW;
+		}
+
+		int ixMin = std::max(0, (int) std::ceil(std::min(std::min(posn[0].x, posn[1].x), posn[2].x)));
+		int ixMax = std::min(m_frameWidth - 1, (int) std::floor(std::max(std::max(posn[0].x, posn[1].x), posn[2].x)));
+		int iyMin = std::max(0, (int) std::ceil(std::min(std::min(posn[0].y, posn[1].y), posn[2].y)));
+		int iyMax = std::min(m_frameHeight - 1, (int) std::floor(std::max(std::max(posn[0].y, posn[1].y), posn[2].y)));
+		if (ixMin > ixMax || iyMin > iyMax){
+			return;
+		}
+
+		float dx1 = posn[1].x - posn[0].x, dy1 = posn[1].y - posn[0].y;
+		float dx2 = posn[2].x - posn[0].x, dy2 = posn[2].y - posn[0].y;
+		float det = dx1 * dy2 - dx2 * dy1;
+		if (det < 0){
+			return;
+		}
+
+		for (int k = 0; k < N; k++) {
+			float da1 = m_vData[1][k] - m_vData[0][k];
+			float da2 = m_vData[2][k] - m_vData[0][k];
+			m_xInc[k] = (da1 * dy2 - da2 * dy1) / det;
+			m_yInc[k] = (da2 * dx1 - da1 * dx2) / det;
+			m_rowData[k] = m_vData[0][k] + (ixMin - posn[0].x) * m_xInc[k] + (iyMin - posn[0].y) * m_yInc[k];
+		}
+
+		float* varyings = reinterpret_cast<float*>(&m_varying);
+		for (int y = iyMin; y <= iyMax; y++) {
+			for (int k = 0; k < N; k++){
+				m_pixData[k] = m_rowData[k];
+			}
+			for (int x = ixMin; x <= ixMax; x++) {
+				if (m_pixData[0] >= 0 && m_pixData[1] >= 0 && m_pixData[2] >= 0) {
+					float w = 1.0f / m_pixData[4 + Varying::count];
+					for (int ia = 0; ia < Varying::count; ia++){
+						varyings[ia] = m_pixData[4 + ia] * w;
+					}
+					if (Varying::texcoordIndex >= 0) {
+						const int t = Varying::texcoordIndex >= 0 ? Varying::texcoordIndex : 0;
+						const int iw = 4 + Varying::count;
+						float u = varyings[t], v = varyings[t + 1];
+						float derivatives[4] = {
+							(m_xInc[4 + t] - u * m_xInc[iw]) * w, (m_xInc[5 + t] - v * m_xInc[iw]) * w,
+							(m_yInc[4 + t] - u * m_yInc[iw]) * w, (m_yInc[5 + t] - v * m_yInc[iw]) * w
+						};
+						fs.setDerivatives(derivatives);
+					}
+					fs.fragment(x, y, m_pixData[3], m_varying, fb);
+				}
+				for (int k = 0; k < N; k++){
+					m_pixData[k] += m_xInc[k];
+				}
+			}
+			for (int k = 0; k < N; k++){
+				m_rowData[k] += m_yInc[k];
+			}
+		}
+	}
+
+protected:
+	int m_frameWidth;		//!< the width of the target framebuffer
+	int m_frameHeight;		//!< the height of the target framebuffer
+	float m_vData[3][N];	//!< The vertex & attribute floats that are computed during rasterization
+	float m_xInc[N];		//!< The x increment value used during the rasterization process.
+	float m_yInc[N];		//!< The y increment value used during the rasterization process.
+	float m_rowData[N];		//!< The local copy of row data used during the rasterization process.
+	float m_pixData[N];		//!< The local copy of fragment data used during the rasterization process.
+	Varying m_varying;		//!< The interpolated varyings handed to the fragment stage.
+
+};	// class StaticRasterizer
+
+/*!
+ * \class StaticShaderProgram "core/shader_program.h"
+ * \brief Composes a vertex stage and a fragment stage into one statically typed program.
+ *
+ * Both stages name the varying struct they produce or consume as varying_type.
+ * Composing stages that disagree on the varying layout is a compile error rather
+ * than the runtime "Unsupported configuration." check done for processors.
+ *
+ * A varying struct is a plain aggregate of floats (or vecmath types of floats)
+ * that declares its size in floats as a static constant named count.
+ */
+template<class VS, class FS>
+class StaticShaderProgram : public ShaderProgram {
+public:
+	typedef typename VS::varying_type varying_type;
+
+	static_assert(std::is_same<typename VS::varying_type, typename FS::varying_type>::value,
+		"The vertex stage and the fragment stage must use the same varying type.");
+	static_assert(sizeof(varying_type) == varying_type::count * sizeof(float),
+		"A varying type must be a tightly packed aggregate of exactly count floats.");
+
+	StaticShaderProgram(int width = 0, int height = 0) : m_rasterizer(width, height) {}
+
+	virtual int nAttr() const { return varying_type::count; }
+
+	virtual void updateTransforms(const SoftwarePipeline& pipe) { m_vs.updateTransforms(pipe); }
+
+	virtual void updateLightModel(const SoftwarePipeline& pipe) { m_vs.updateLightModel(pipe); }
+
+	virtual void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, Vertex& output)
+	{
+		varying_type out;
+		m_vs.vertex(v, c, n, t, output.v, out);
+
+		output.setAttrs(varying_type::count);
+		memcpy(output.attributes, &out, sizeof(varying_type));
+	}
+
+	virtual void rasterize(const Vertex* vs, FrameBuffer& fb)
+	{
+		m_rasterizer.rasterize(vs, m_fs, fb);
+	}
+
+	virtual void setTexture(const Texture* texture) { m_fs.setTexture(texture); }
+
+	virtual void setFrameSize(int width, int height) { m_rasterizer.setFrameSize(width, height); }
+
+	virtual void setDepthFunc(depth_func func) { m_fs.setDepthFunc(func); }
+
+	/**
+	 * Accessor method for the vertex stage.
+	 */
+	VS& vertexStage() { return m_vs; }
+
+	/**
+	 * Accessor method for the fragment stage.
+	 */
+	FS& fragmentStage() { return m_fs; }
+
+protected:
+	VS m_vs;										//!< The vertex stage.
+	FS m_fs;										//!< The fragment stage.
+	StaticRasterizer<varying_type> m_rasterizer;	//!< The rasterizer specialized for the varying layout.
+
+};	// class StaticShaderProgram
+
+/**
+ * Creates the prebuilt StaticShaderProgram matching the vertex and fragment
+ * processors SoftwarePipeline::configure would select for the given state.
+ *
+ * @param state the rendering state
+ * @param width the framebuffer width
+ * @param height the framebuffer height
+ * @return a new program, or NULL when there is no specialization for the state
+ *         (per-fragment lighting is specialized for 1 to 4 lights).
+ */
+ShaderProgram* createShaderProgram(const State& state, int width, int height);
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::ShaderProgram& p)
+{
+	return out << "[ ShaderProgram ]";
+}
+
+#endif	// __PIPELINE_SHADER_PROGRAM_H
@@ -0,0 +1,413 @@
+#ifndef __PIPELINE_SHADER_STAGES_H
+#define __PIPELINE_SHADER_STAGES_H
+
+#include "core/common.h"
+#include "core/fastmath.h"
+#include "core/framebuffer.h"
+#include "core/pointlight.h"
+#include "core/shader_program.h"
+#include "core/state.h"
+#include "cg/vecmath/vec2.hpp"
+#include "cg/vecmath/vec3.hpp"
+#include "cg/vecmath/vec4.hpp"
+#include "cg/vecmath/color.h"
+
+namespace pixelpipe {
+
+//--------------------------------------------------------------------------------
+// Varying layouts
+//--------------------------------------------------------------------------------
+
+/*!
+ * \brief A single interpolated color. Used by constant and Gouraud shading.
+ */
+struct ColorVarying {
+	static const int count = 3;
+	static const int texcoordIndex = -1;	//!< no texture coordinate
+	cg::vecmath::Color3f color;		//!< the vertex color
+};
+
+/*!
+ * \brief An interpolated color and texture coordinate. Used by Gouraud shaded texturing.
+ */
+struct TexturedColorVarying {
+	static const int count = 5;
+	static const int texcoordIndex = 3;		//!< the index of the texture coordinate
+	cg::vecmath::Color3f color;			//!< the lit vertex color
+	cg::vecmath::Vector2f texcoord;		//!< the texture coordinate
+};
+
+/*!
+ * \brief The per-light vectors interpolated for per-fragment lighting.
+ */
+struct LightVarying {
+	cg::vecmath::Vector3f light;	//!< the vector towards the light
+	cg::vecmath::Vector3f half;		//!< the half vector between the light and the view vector
+};
+
+/*!
+ * \brief The varyings for per-fragment Phong shading with a fixed number of lights.
+ */
+template<int LIGHTS>
+struct PhongVarying {
+	static const int count = 9 + 6 * LIGHTS;
+	static const int texcoordIndex = -1;		//!< no texture coordinate
+	cg::vecmath::Color3f color;			//!< the vertex color
+	cg::vecmath::Vector3f normal;		//!< the eye space normal
+	cg::vecmath::Vector3f view;			//!< the vector towards the eye
+	LightVarying lights[LIGHTS];		//!< the light and half vectors for each light
+};
+
+/*!
+ * \brief The varyings for textured per-fragment Phong shading with a fixed number of lights.
+ */
+template<int LIGHTS>
+struct TexturedPhongVarying {
+	static const int count = 8 + 6 * LIGHTS;
+	static const int texcoordIndex = 0;		//!< the index of the texture coordinate
+	cg::vecmath::Vector2f texcoord;		//!< the texture coordinate
+	cg::vecmath::Vector3f normal;		//!< the eye space normal
+	cg::vecmath::Vector3f view;			//!< the vector towards the eye
+	LightVarying lights[LIGHTS];		//!< the light and half vectors for each light
+};
+
+//--------------------------------------------------------------------------------
+// Vertex stages
+//--------------------------------------------------------------------------------
+
+/*!
+ * \class ConstColorStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of ConstColorVP.
+ */
+class ConstColorStage : public VertexStage {
+public:
+	typedef ColorVarying varying_type;
+
+	inline void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, cg::vecmath::Vector4f& position, varying_type& out)
+	{
+		position = MVP * cg::vecmath::Vector4f(v.x, v.y, v.z, 1.0f);
+		out.color = c;
+	}
+};
+
+/*!
+ * \class GouraudStage "core/shader_stages.h"
+ * \brief Shared per-vertex lighting used by the Gouraud stages. Mirrors SmoothShadedVP.
+ */
+class GouraudStage : public VertexStage {
+protected:
+	inline cg::vecmath::Color3f light(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n)
+	{
+		using namespace cg::vecmath;
+		State* state = State::getInstance();
+		math_precision precision = state->getMathPrecision();
+
+		Vector4f vert = modelViewMatrix * Vector4f(v.x, v.y, v.z, 1.0f);
+		Vector3f transformedVertex(vert.x, vert.y, vert.z);
+
+		Vector3f temp3 = n;
+		FastMath::normalize(temp3, precision);
+		Vector4f normal = modelViewMatrix * Vector4f(temp3.x, temp3.y, temp3.z, 0.0f);
+		Vector3f transformedNormal(normal.x, normal.y, normal.z);
+		FastMath::normalize(transformedNormal, precision);
+
+		Vector3f viewVector = -transformedVertex;
+		FastMath::normalize(viewVector, precision);
+
+		float ambient = state->getAmbientIntensity();
+		Color3f outColor(ambient, ambient, ambient);
+
+		std::vector<PointLight>& lights = state->getLights();
+		for(size_t i = 0; i < lights.size(); i++){
+			Vector3f lightVector = lights[i].getPosition() - transformedVertex;
+			FastMath::normalize(lightVector, precision);
+
+			float nDotL = dot(transformedNormal, lightVector);
+			const Color3f& intensity = lights[i].getIntensity();
+			outColor.x += c.x * nDotL * intensity.x;
+			outColor.y += c.y * nDotL * intensity.y;
+			outColor.z += c.z * nDotL * intensity.z;
+
+			Vector3f halfVector = viewVector + lightVector;
+			FastMath::normalize(halfVector, precision);
+
+			float specularIntensity = state->specular(dot(transformedNormal, halfVector));
+			specularIntensity = std::min(std::max(specularIntensity, 0.0f), 1.0f);
+
+			outColor += state->getSpecularColor() * specularIntensity;
+		}
+
+		for(int k = 0; k < 3; k++){
+			if(outColor[k] < 0.0f) outColor[k] = ambient;
+			if(outColor[k] > 1.0f) outColor[k] = 1.0f;
+		}
+
+		return outColor;
+	}
+};
+
+/*!
+ * \class SmoothShadedStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of SmoothShadedVP.
+ */
+class SmoothShadedStage : public GouraudStage {
+public:
+	typedef ColorVarying varying_type;
+
+	inline void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, cg::vecmath::Vector4f& position, varying_type& out)
+	{
+		out.color = light(v, c, n);
+		position = MVP * cg::vecmath::Vector4f(v.x, v.y, v.z, 1.0f);
+	}
+};
+
+/*!
+ * \class TexturedShadedStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of TexturedShadedVP.
+ */
+class TexturedShadedStage : public GouraudStage {
+public:
+	typedef TexturedColorVarying varying_type;
+
+	inline void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, cg::vecmath::Vector4f& position, varying_type& out)
+	{
+		// like TexturedShadedVP, the surface color comes from the texture alone
+		out.color = light(v, cg::vecmath::Color3f(0, 0, 0), n);
+		out.texcoord = t;
+		position = MVP * cg::vecmath::Vector4f(v.x, v.y, v.z, 1.0f);
+	}
+};
+
+/*!
+ * \class FragmentShadedStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of FragmentShadedVP for a fixed number of lights.
+ */
+template<int LIGHTS>
+class FragmentShadedStage : public VertexStage {
+public:
+	typedef PhongVarying<LIGHTS> varying_type;
+
+	inline void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, cg::vecmath::Vector4f& position, varying_type& out)
+	{
+		out.color = c;
+		lightVectors(v, n, out.normal, out.view, out.lights);
+		position = MVP * cg::vecmath::Vector4f(v.x, v.y, v.z, 1.0f);
+	}
+
+protected:
+	inline void lightVectors(const cg::vecmath::Vector3f& v, const cg::vecmath::Vector3f& n, cg::vecmath::Vector3f& normal, cg::vecmath::Vector3f& view, LightVarying* lights)
+	{
+		using namespace cg::vecmath;
+		State* state = State::getInstance();
+		math_precision precision = state->getMathPrecision();
+
+		Vector4f vert = modelViewMatrix * Vector4f(v.x, v.y, v.z, 1.0f);
+		Vector3f transformedVertex(vert.x, vert.y, vert.z);
+
+		Vector3f temp3 = n;
+		FastMath::normalize(temp3, precision);
+		Vector4f tn = modelViewMatrix * Vector4f(temp3.x, temp3.y, temp3.z, 0.0f);
+		normal.set(tn.x, tn.y, tn.z);
+		FastMath::normalize(normal, precision);
+
+		view = -transformedVertex;
+		FastMath::normalize(view, precision);
+
+		std::vector<PointLight>& sceneLights = state->getLights();
+		for(int i = 0; i < LIGHTS; i++){
+			lights[i].light = sceneLights[i].getPosition() - transformedVertex;
+			FastMath::normalize(lights[i].light, precision);
+
+			lights[i].half = view + lights[i].light;
+			FastMath::normalize(lights[i].half, precision);
+		}
+	}
+};
+
+/*!
+ * \class TexturedFragmentShadedStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of TexturedFragmentShadedVP for a fixed number of lights.
+ */
+template<int LIGHTS>
+class TexturedFragmentShadedStage : public FragmentShadedStage<LIGHTS> {
+public:
+	typedef TexturedPhongVarying<LIGHTS> varying_type;
+
+	inline void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, cg::vecmath::Vector4f& position, varying_type& out)
+	{
+		out.texcoord = t;
+		this->lightVectors(v, n, out.normal, out.view, out.lights);
+		position = this->MVP * cg::vecmath::Vector4f(v.x, v.y, v.z, 1.0f);
+	}
+};
+
+//--------------------------------------------------------------------------------
+// Fragment stages
+//--------------------------------------------------------------------------------
+
+/*!
+ * \class ColorStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of ColorFP (no depth test).
+ */
+class ColorStage : public FragmentStage {
+public:
+	typedef ColorVarying varying_type;
+
+	inline void fragment(int x, int y, float z, const varying_type& in, FrameBuffer& fb)
+	{
+		fb.set(x, y, in.color.x, in.color.y, in.color.z, 0);
+	}
+};
+
+/*!
+ * \class ZBufferStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of ZBufferFP.
+ */
+class ZBufferStage : public FragmentStage {
+public:
+	typedef ColorVarying varying_type;
+
+	inline void fragment(int x, int y, float z, const varying_type& in, FrameBuffer& fb)
+	{
+		if(this->depthTest(x, y, z, fb)){
+			fb.set(x, y, in.color.x, in.color.y, in.color.z, z);
+		}
+	}
+};
+
+/*!
+ * \class TexturedStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of TexturedFP.
+ */
+class TexturedStage : public FragmentStage {
+public:
+	typedef TexturedColorVarying varying_type;
+
+	inline void fragment(int x, int y, float z, const varying_type& in, FrameBuffer& fb)
+	{
+		if(this->depthTest(x, y, z, fb)){
+			cg::vecmath::Color3f color = m_texture->sample(in.texcoord.x, in.texcoord.y, m_derivatives);
+			fb.set(x, y, color.x * in.color.x, color.y * in.color.y, color.z * in.color.z, z);
+		}
+	}
+};
+
+/*!
+ * \class PhongStage "core/shader_stages.h"
+ * \brief Per-fragment Phong lighting shared by PhongShadedStage and TexturedPhongStage.
+ */
+template<int LIGHTS>
+class PhongStage : public FragmentStage {
+protected:
+	/**
+	 * Computes the lit color for a surface color. The ambient term is scaled
+	 * by ambientColor, which is white for PhongShadedFP and the texture color
+	 * for TexturedPhongFP.
+	 */
+	inline cg::vecmath::Color3f shade(const cg::vecmath::Color3f& surface, const cg::vecmath::Color3f& ambientColor, cg::vecmath::Vector3f normal, const LightVarying* lights)
+	{
+		using namespace cg::vecmath;
+		State* state = State::getInstance();
+		math_precision precision = state->getMathPrecision();
+		std::vector<PointLight>& sceneLights = state->getLights();
+
+		FastMath::normalize(normal, precision);
+
+		Color3f outColor(0.0f, 0.0f, 0.0f);
+		for(int i = 0; i < LIGHTS; i++){
+			Vector3f lightVector = lights[i].light;
+			FastMath::normalize(lightVector, precision);
+			Vector3f halfVector = lights[i].half;
+			FastMath::normalize(halfVector, precision);
+
+			float nDotL = dot(normal, lightVector);
+			float nDotH = dot(normal, halfVector);
+
+			const Color3f& intensity = sceneLights[i].getIntensity();
+			outColor.x += surface.x * nDotL * intensity.x;
+			outColor.y += surface.y * nDotL * intensity.y;
+			outColor.z += surface.z * nDotL * intensity.z;
+
+			float specularIntensity = state->specular(nDotH);
+			specularIntensity = std::min(std::max(specularIntensity, 0.0f), 1.0f);
+
+			outColor += state->getSpecularColor() * specularIntensity;
+		}
+
+		float ambient = state->getAmbientIntensity();
+		for(int k = 0; k < 3; k++){
+			if(outColor[k] < 0.0f) outColor[k] = 0.0f;
+			outColor[k] += ambient * ambientColor[k];
+			if(outColor[k] > 1.0f) outColor[k] = 1.0f;
+		}
+
+		return outColor;
+	}
+};
+
+/*!
+ * \class PhongShadedStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of PhongShadedFP for a fixed number of lights.
+ */
+template<int LIGHTS>
+class PhongShadedStage : public PhongStage<LIGHTS> {
+public:
+	typedef PhongVarying<LIGHTS> varying_type;
+
+	inline void fragment(int x, int y, float z, const varying_type& in, FrameBuffer& fb)
+	{
+		if(this->depthTest(x, y, z, fb)){
+			cg::vecmath::Color3f c = this->shade(in.color, cg::vecmath::Color3f(1.0f, 1.0f, 1.0f), in.normal, in.lights);
+			fb.set(x, y, c.x, c.y, c.z, z);
+		}
+	}
+};
+
+/*!
+ * \class TexturedPhongStage "core/shader_stages.h"
+ * \brief The compile-time counterpart of TexturedPhongFP for a fixed number of lights.
+ */
+template<int LIGHTS>
+class TexturedPhongStage : public PhongStage<LIGHTS> {
+public:
+	typedef TexturedPhongVarying<LIGHTS> varying_type;
+
+	inline void fragment(int x, int y, float z, const varying_type& in, FrameBuffer& fb)
+	{
+		if(this->depthTest(x, y, z, fb)){
+			cg::vecmath::Color3f texColor = this->m_texture->sample(in.texcoord.x, in.texcoord.y, this->m_derivatives);
+			cg::vecmath::Color3f c = this->shade(texColor, texColor, in.normal, in.lights);
+			fb.set(x, y, c.x, c.y, c.z, z);
+		}
+	}
+};
+
+//--------------------------------------------------------------------------------
+// Prebuilt specializations of the existing processor pairs
+//--------------------------------------------------------------------------------
+
+typedef StaticShaderProgram<ConstColorStage, ColorStage> ConstColorProgram;			//!< ConstColorVP + ColorFP
+typedef StaticShaderProgram<ConstColorStage, ZBufferStage> ConstColorZBufferProgram;	//!< ConstColorVP + ZBufferFP
+typedef StaticShaderProgram<SmoothShadedStage, ColorStage> SmoothShadedProgram;			//!< SmoothShadedVP + ColorFP
+typedef StaticShaderProgram<SmoothShadedStage, ZBufferStage> SmoothShadedZBufferProgram;	//!< SmoothShadedVP + ZBufferFP
+typedef StaticShaderProgram<TexturedShadedStage, TexturedStage> TexturedShadedProgram;	//!< TexturedShadedVP + TexturedFP
+
+/*!
+ * \brief FragmentShadedVP + PhongShadedFP with LIGHTS lights.
+ */
+template<int LIGHTS>
+struct PhongShadedProgram {
+	typedef StaticShaderProgram<FragmentShadedStage<LIGHTS>, PhongShadedStage<LIGHTS> > type;
+};
+
+/*!
+ * \brief TexturedFragmentShadedVP + TexturedPhongFP with LIGHTS lights.
+ */
+template<int LIGHTS>
+struct TexturedPhongProgram {
+	typedef StaticShaderProgram<TexturedFragmentShadedStage<LIGHTS>, TexturedPhongStage<LIGHTS> > type;
+};
+
+}	// namespace pixelpipe
+
+#endif	// __PIPELINE_SHADER_STAGES_H
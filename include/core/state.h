@@ -2,8 +2,10 @@
 #define __PIPELINE_STATE_H
 
 #include <vector>
+#include <cmath>
 
 #include "core/common.h"
+#include "core/fastmath.h"
 #include "core/pointlight.h"
 #include "cg/vecmath/color.h"
 #include "cg/vecmath/vec3.hpp"
@@ -95,6 +97,146 @@ public:
 	 */
 	void setSpecularExponent(float value);
 
+	/**
+	 * Selects the precision tier used by the shading hot paths (specular
+	 * power and vector normalization).
+	 * 
+	 * @param value the new precision tier
+	 */
+	void setMathPrecision(const math_precision value);
+
+	/**
+	 * Accessor method for the shading precision tier
+	 */
+	math_precision getMathPrecision() const { return this->m_mathPrecision; }
+
+	/**
+	 * Computes the specular term pow(nDotH, specularExponent) using the current
+	 * precision tier. MATH_PRECISION_FASTEST reads from the specular lookup 
+	 * table which is rebuilt whenever the specular exponent changes.
+	 * 
+	 * @param nDotH the dot product of the normal and the half vector
+	 * @return the unclamped specular intensity
+	 */
+	float specular(float nDotH) const
+	{
+		switch(this->m_mathPrecision){
+			case MATH_PRECISION_FASTEST:
+				return this->m_specularTable->lookup(nDotH);
+			case MATH_PRECISION_FAST:
+				return FastMath::pow(nDotH, this->specularExponent, MATH_PRECISION_FAST);
+			default:
+			case MATH_PRECISION_EXACT:
+				return std::pow(nDotH, this->specularExponent);
+		}
+	}
+
+	/**
+	 * Enables the per-object shading level of detail: each object submitted
+	 * between Pipeline::beginObject() and Pipeline::endObject() is shaded at a
+	 * cost chosen from its projected size.
+	 */
+	void enableShadingLOD(bool value = true);
+
+	/**
+	 * Accessor method for the shading level of detail flag
+	 */
+	bool getShadingLOD() const { return this->m_shadingLODEnabled; }
+
+	/**
+	 * Enables the depth prepass: each frame is drawn twice, first with the
+	 * depth only pass and then with the shading pass, so that the fragment
+	 * processor only runs for the visible surface.
+	 * 
+	 * @see Pipeline::setRenderPass()
+	 */
+	void enableZPrepass(bool value = true);
+	
+	/**
+	 * Accessor method for the depth prepass flag
+	 */
+	bool getZPrepass() const { return this->m_zPrepassEnabled; }
+	
+	/**
+	 * Selects how the textures loaded from then on are filtered. The mip
+	 * filters build the mip chain of each texture when it is loaded.
+	 * 
+	 * @param filter the texture filter
+	 * @param mipmaps the filter that builds the mip chains
+	 * @see Texture::setFilter()
+	 * @see Texture::generateMipmaps()
+	 */
+	void setTextureFilter(texture_filter filter, mipmap_filter mipmaps = MIPMAP_FILTER_BOX);
+	
+	/**
+	 * Accessor method for the texture filter
+	 */
+	texture_filter getTextureFilter() const { return this->m_textureFilter; }
+	
+	/**
+	 * Accessor method for the filter of the mip chains
+	 */
+	mipmap_filter getMipmapFilter() const { return this->m_mipmapFilter; }
+	
+	/**
+	 * Selects how the textures loaded from then on store their texels. The
+	 * compact formats take a half to a sixteenth of the memory of floats.
+	 * 
+	 * @param storage TEXTURE_STORAGE_NATIVE keeps the type of the pixels loaded,
+	 * the others convert them to 8 bits per component, RGB565 or half floats
+	 * @see Texture::storageFormat()
+	 */
+	void setTextureStorage(texture_storage storage);
+	
+	/**
+	 * Accessor method for the texture storage
+	 */
+	texture_storage getTextureStorage() const { return this->m_textureStorage; }
+	
+	/**
+	 * Selects the order of the texels of the compact textures loaded from then on.
+	 * 
+	 * @param layout row major, blocks of 4x4 or 8x8 texels, or Morton order
+	 * @see Texture::setTextureData()
+	 */
+	void setTextureLayout(texture_layout layout);
+	
+	/**
+	 * Accessor method for the texture layout
+	 */
+	texture_layout getTextureLayout() const { return this->m_textureLayout; }
+	
+	/**
+	 * Sets the projected radii (in pixels) above which objects are shaded per
+	 * fragment and per vertex respectively. Smaller objects are flat shaded.
+	 * 
+	 * @param phong the smallest radius shaded per fragment
+	 * @param gouraud the smallest radius shaded per vertex
+	 */
+	void setShadingLODThresholds(float phong, float gouraud);
+
+	/**
+	 * Accessor method for the per fragment shading threshold
+	 */
+	float getPhongThreshold() const { return this->m_phongThreshold; }
+
+	/**
+	 * Accessor method for the per vertex shading threshold
+	 */
+	float getGouraudThreshold() const { return this->m_gouraudThreshold; }
+
+	/**
+	 * Selects the shading level for an object of the given projected size.
+	 * 
+	 * @param radius the projected radius of the object's bounding sphere in pixels
+	 */
+	shading_level selectShadingLevel(float radius) const
+	{
+		if(radius >= this->m_phongThreshold) return SHADING_LEVEL_PHONG;
+		if(radius >= this->m_gouraudThreshold) return SHADING_LEVEL_GOURAUD;
+		return SHADING_LEVEL_FLAT;
+	}
+
 	/**
 	 * Accessor method for the global ambient intensity
 	 */
@@ -137,6 +279,7 @@ protected:
 	float specularExponent;					//!< The global specular component of the lighting model.
 	cg::vecmath::Color3f* specularColor;	//!< The global specular color of the global environment light.
 	std::vector<PointLight>* lights;		//!< The list of lights used for shading.
+	SpecularTable* m_specularTable;			//!< The specular lookup table for the current specular exponent.
 	
 private:
 	/**
@@ -153,6 +296,15 @@ private:
 	bool m_lightingEnabled;
 	bool m_depthTestEnabled;
 	bool m_texture2dEnabled;
+	math_precision m_mathPrecision;
+	bool m_shadingLODEnabled;
+	bool m_zPrepassEnabled;
+	texture_filter m_textureFilter;
+	mipmap_filter m_mipmapFilter;
+	texture_storage m_textureStorage;
+	texture_layout m_textureLayout;
+	float m_phongThreshold;
+	float m_gouraudThreshold;
 	unsigned m_activeTextureUnit;
 	
 };
@@ -2,6 +2,8 @@
 #define __PIPELINE_TEXTURE_H
 
 #include <string>
+#include <string.h>
+#include <vector>
 
 #include "core/common.h"
 #include "cg/image/raster.h"
@@ -16,6 +18,25 @@ namespace pixelpipe {
  * data. This class essentially acts as a wrapper for the cg::image::ByteRaster
  * data structure and augments it with special sampling functions.
  * 
+ * A texture may hold a chain of mip levels, each half the size of the previous
+ * one down to 1x1 (see generateMipmaps()). Minified textures are then sampled
+ * in the level whose texels are about the size of a pixel, so that the cost of
+ * a sample and the memory it touches do not grow with the size of the texture,
+ * and distant surfaces do not alias.
+ * 
+ * The texels are stored as floats (TEXTURE_FORMAT_FLOAT) in the raster, or in
+ * one of the compact formats (8 bit RGBA, RGB, luminance and luminance alpha,
+ * RGB565 and half float RGBA). A compact texture packs each of its levels in a
+ * ByteRaster whose channels are the bytes of a texel, and samples them with the
+ * bilinear sampler of its format; the 8 bit formats are filtered in integers.
+ * Its raster has no channels and only gives the size of the texture.
+ * 
+ * The levels of a compact texture are laid out row major, in blocks of 4x4 or
+ * 8x8 texels, or in Morton order (see texture_layout). The 2x2 texels of a
+ * bilinear sample, and the neighbouring samples of a minified or rotated
+ * surface, then fall in one or two cache lines instead of two rows apart.
+ * Blocked levels are padded to whole blocks, Morton levels to powers of two.
+ * 
  */
 class Texture {
 public:
@@ -46,6 +67,7 @@ public:
 	 */
 	Texture(const Texture& tex)
 	{
+		m_raster = NULL;
 		*this = tex;
 	}
 	
@@ -54,10 +76,26 @@ public:
 	 */
 	Texture& operator=(const Texture& tex)
 	{
-		*(this->m_raster) = tex.getTextureData();
-		// if(m_raster!=NULL) delete m_raster;
-		// m_raster = new cg::image::ByteRaster(tex.getTextureData().width(), tex.getTextureData().height(), tex.getTextureData().channels());
-		// *m_raster = tex.getTextureData();
+		if(this == &tex) return *this;
+		
+		// the raster has no copy assignment, its data is copied
+		const cg::image::FloatRaster& raster = tex.getTextureData();
+		if(m_raster!=NULL) delete m_raster;
+		m_raster = new cg::image::FloatRaster(raster.width(), raster.height(), raster.channels());
+		memcpy(m_raster->head(), raster.head(), sizeof(float) * raster.length());
+		
+		m_filter = tex.m_filter;
+		deleteMipmaps();
+		deleteTexels();
+		m_format = tex.m_format;
+		m_layout = tex.m_layout;
+		m_sampler = tex.m_sampler;
+		for(unsigned i = 0; i < tex.m_texels.size(); i++){
+			cg::image::ByteRaster* level = tex.m_texels[i];
+			m_texels.push_back(new cg::image::ByteRaster(level->width(), level->height(), level->channels(), level->head()));
+		}
+		m_mipmapFilter = tex.m_mipmapFilter;
+		if(m_format == TEXTURE_FORMAT_FLOAT && tex.levels() > 1) generateMipmaps(tex.m_mipmapFilter);
 		
 		return *this;
 	}
@@ -65,7 +103,7 @@ public:
 	/**
 	 * Destructor.
 	 */
-	~Texture();
+	virtual ~Texture();
 
 	/**
 	 * Accessor method for the texture width.
@@ -78,13 +116,76 @@ public:
 	int height() const;
 	
 	/**
-	 * Samples this texture for a given 2D location using linear interpolation. 
-	 * Places the result in the color parameter.
+	 * Samples the base level of this texture bilinearly, with texel centers at
+	 * (i + 0.5) / size and repeating coordinates, whatever its storage format.
 	 * 
-	 * @param p The 2D texture coordinate.
-	 * @param cOut The result of sampling the texture.
+	 * @param u The horizontal texture coordinate.
+	 * @param v The vertical texture coordinate.
+	 * @return The filtered color.
 	 */
-	cg::vecmath::Color3f sample(const float u, const float v) const;
+	virtual cg::vecmath::Color3f sample(const float u, const float v) const;
+	
+	/**
+	 * Samples this texture with the filter selected by setFilter(), in the mip
+	 * level chosen from the screen space derivatives of the texture coordinate.
+	 * The coordinates repeat outside of [0, 1]. Without mip levels, with
+	 * TEXTURE_FILTER_LINEAR, or for a magnified pixel, this is sample(u, v).
+	 * 
+	 * @param u The horizontal texture coordinate.
+	 * @param v The vertical texture coordinate.
+	 * @param derivatives du/dx, dv/dx, du/dy and dv/dy
+	 * @return The filtered color.
+	 */
+	cg::vecmath::Color3f sample(const float u, const float v, const float* derivatives) const;
+	
+	/**
+	 * Computes the level of detail of a pixel: the log2 of its footprint in
+	 * texels of the base level, measured along the longer of the derivative
+	 * vectors. Magnified pixels have a level of detail of 0.
+	 * 
+	 * @param derivatives du/dx, dv/dx, du/dy and dv/dy
+	 */
+	float lod(const float* derivatives) const;
+	
+	/**
+	 * Builds the mip chain from the base level, replacing the previous one.
+	 * Each level is filtered from the previous one, separably and in bands of
+	 * rows on worker threads. The texture coordinates repeat at the edges.
+	 * 
+	 * @param filter MIPMAP_FILTER_BOX averages 2x2 texels, MIPMAP_FILTER_KAISER
+	 * applies an 8 tap Kaiser windowed sinc, which keeps more detail and aliases less
+	 * @param threads the number of worker threads, 0 for one per core
+	 */
+	void generateMipmaps(mipmap_filter filter = MIPMAP_FILTER_BOX, unsigned threads = 0);
+	
+	/**
+	 * Deletes the mip chain, leaving the base level.
+	 */
+	void deleteMipmaps();
+	
+	/**
+	 * Accessor method for the number of mip levels, including the base level.
+	 */
+	unsigned levels() const { return m_texels.empty() ? 1 + (unsigned) m_mipmaps.size() : (unsigned) m_texels.size(); }
+	
+	/**
+	 * Selects how sample(u, v, derivatives) filters the texture.
+	 * 
+	 * @param filter TEXTURE_FILTER_LINEAR samples the base level bilinearly,
+	 * TEXTURE_FILTER_NEAREST_MIPMAP the nearest mip level bilinearly, and
+	 * TEXTURE_FILTER_TRILINEAR blends the two nearest mip levels.
+	 */
+	void setFilter(texture_filter filter) { m_filter = filter; }
+	
+	/**
+	 * Accessor method for the texture filter.
+	 */
+	texture_filter getFilter() const { return m_filter; }
+	
+	/**
+	 * Accessor method for the filter of the last mip chain.
+	 */
+	mipmap_filter getMipmapFilter() const { return m_mipmapFilter; }
 	
 	/**
 	 * Accessor method for updating the texture buffer data.
@@ -103,6 +204,66 @@ public:
 	 * @param data the raw byte data of the new texture
 	 */
 	void setTextureData(const unsigned width, const unsigned height, const unsigned channels, const void* data);
+	
+	/**
+	 * Resets the texture to the pixels supplied, converted to the given storage
+	 * format. Any pre-existing data and mip levels are deleted. The BGR orders
+	 * are swizzled, the single component formats are stored as luminance.
+	 * 
+	 * @param width the width of the new texture information
+	 * @param height the height of the new texture information
+	 * @param format the layout of the pixels supplied
+	 * @param type the type of the components of the pixels supplied
+	 * @param data the pixels, row by row
+	 * @param storage the format of the texels
+	 * @param layout the order of the texels of a compact format, float
+	 * textures are always row major
+	 */
+	void setTextureData(const unsigned width, const unsigned height, const pixel_format format, const pixel_type type, const void* data, const texture_format storage, const texture_layout layout = TEXTURE_LAYOUT_LINEAR);
+	
+	/**
+	 * Picks the format that stores the pixels of a given layout and type. The
+	 * native storage keeps floats, half floats and RGB565 as they are, and the
+	 * integer types in 8 bits per component.
+	 * 
+	 * @param format the layout of the pixels
+	 * @param type the type of the components of the pixels
+	 * @param storage TEXTURE_STORAGE_NATIVE follows the type, the others force
+	 * 8 bits per component, RGB565 or half floats
+	 */
+	static texture_format storageFormat(const pixel_format format, const pixel_type type, const texture_storage storage = TEXTURE_STORAGE_NATIVE);
+	
+	/**
+	 * Accessor method for the size of a texel of a compact format, in bytes.
+	 * The size of a TEXTURE_FORMAT_FLOAT texel depends on its channels, this is 0.
+	 */
+	static unsigned texelSize(const texture_format format);
+	
+	/**
+	 * Converts a half float to a float, subnormals, infinities and NaNs included.
+	 */
+	static float halfToFloat(const unsigned short h);
+	
+	/**
+	 * Converts a float to the nearest half float. Overflows give infinities,
+	 * and values below half of the smallest subnormal give zeros.
+	 */
+	static unsigned short floatToHalf(const float f);
+	
+	/**
+	 * Accessor method for the storage format of the texels.
+	 */
+	texture_format getFormat() const { return m_format; }
+	
+	/**
+	 * Accessor method for the layout of the texels.
+	 */
+	texture_layout getLayout() const { return m_layout; }
+	
+	/**
+	 * Accessor method for the memory held by the texels of all the levels, in bytes.
+	 */
+	size_t memory() const;
 
 	/**
 	 * Attempts to write the current texture out to a PNG file.
@@ -112,7 +273,8 @@ public:
 	void write(std::string filename);
 	
 	/**
-	 * Accessor method for the ByteRaster object.
+	 * Accessor method for the ByteRaster object. The raster of a compact
+	 * texture has no channels.
 	 * 
 	 * @return a const reference to the current Raster object.
 	 */
@@ -129,6 +291,36 @@ public:
 protected:
 	// std::string m_filename;				//!< The name of the file from where the data was loaded.
 	cg::image::FloatRaster* m_raster;	//!< The RGB data for each pixel.
+	std::vector<cg::image::FloatRaster*> m_mipmaps;	//!< The mip levels after the base level, each half the size of the previous one.
+	texture_filter m_filter;			//!< The filter of sample(u, v, derivatives).
+	mipmap_filter m_mipmapFilter;		//!< The filter of the mip chain.
+	texture_format m_format;			//!< The storage format of the texels.
+	texture_layout m_layout;			//!< The order of the texels of a compact format.
+	std::vector<cg::image::ByteRaster*> m_texels;	//!< The levels of a compact format, base level first, a texel in the channels of each pixel.
+	
+	/**
+	 * The bilinear sampler of a level of a compact format in its layout. The
+	 * raster of a padded level is larger than the level.
+	 */
+	typedef cg::vecmath::Color3f (*Sampler)(const cg::image::ByteRaster& level, int width, int height, float u, float v);
+	
+	Sampler m_sampler;					//!< The sampler of the compact format and layout.
+	
+	/**
+	 * Samples a level bilinearly, with texel centers at (i + 0.5) / size and
+	 * repeating coordinates.
+	 */
+	cg::vecmath::Color3f sampleLevel(const cg::image::FloatRaster& level, float u, float v) const;
+	
+	/**
+	 * Samples a mip level bilinearly, 0 being the base level, whatever the format.
+	 */
+	cg::vecmath::Color3f sampleMip(int level, float u, float v) const;
+	
+	/**
+	 * Deletes the levels of a compact format.
+	 */
+	void deleteTexels();
 
 };	// class Texture
 
@@ -19,6 +19,7 @@ public:
 	 */
 	Vertex(int n=0) {
 		length = n;
+		attributes = NULL;
 		if(length > 0){
 			attributes = (float*) malloc(length*sizeof(float));
 		}
@@ -0,0 +1,170 @@
+#ifndef __PIPELINE_VISIBILITY_BUFFER_H
+#define __PIPELINE_VISIBILITY_BUFFER_H
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+#include "core/fragment.h"
+#include "core/framebuffer.h"
+#include "core/texture.h"
+#include "core/vertex.h"
+#include "fragment/frag_processor.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class VisibilityBuffer "core/visbuffer.h"
+ * \brief Stores the depth and the id of the visible triangle of every pixel.
+ * 
+ * The visibility pass rasterizes depth only and keeps, for each pixel, a 32 bit
+ * id packing the draw (the upper DRAW_BITS) and the triangle within that draw.
+ * The processed vertices of every triangle are kept aside so that the resolve
+ * pass can recompute the perspective correct attributes of each visible pixel
+ * and run the fragment processor exactly once per pixel.
+ * 
+ * A new draw starts whenever the texture bound to the triangles changes, since
+ * the texture is the only state the resolve pass needs besides the fragment
+ * processor.
+ * 
+ * @see VisibilityFP
+ */
+class VisibilityBuffer {
+public:
+	static const unsigned DRAW_BITS = 12;								//!< the number of bits identifying the draw
+	static const unsigned TRIANGLE_BITS = 32 - DRAW_BITS;				//!< the number of bits identifying the triangle in a draw
+	static const uint32_t MAX_TRIANGLES = (1u << TRIANGLE_BITS) - 1;	//!< the largest number of triangles in a draw
+	static const uint32_t INVALID_ID = 0xffffffff;						//!< the id of uncovered pixels
+	
+	/**
+	 * Allocates a visibility buffer of the given size.
+	 * 
+	 * @param width the width in pixels
+	 * @param height the height in pixels
+	 * @param attributes the number of attributes of the processed vertices
+	 */
+	VisibilityBuffer(const unsigned width, const unsigned height, int attributes);
+	
+	unsigned width() const { return m_width; }
+	unsigned height() const { return m_height; }
+	
+	/**
+	 * Accessor method for the number of vertex attributes. Discards the
+	 * stored triangles.
+	 */
+	void setAttributeCount(int count);
+	
+	/**
+	 * Clears the ids, the depths and the stored triangles.
+	 */
+	void clear();
+	
+	/**
+	 * Stores a processed triangle.
+	 * 
+	 * @param vs the 3 clipped vertices, as handed to the rasterizer
+	 * @param texture the texture bound while the triangle was drawn
+	 * @return the packed id of the triangle
+	 */
+	uint32_t addTriangle(const Vertex* vs, const Texture* texture);
+	
+	float getDepth(const int x, const int y) const { return m_depth[y * m_width + x]; }
+	
+	uint32_t getId(const int x, const int y) const { return m_ids[y * m_width + x]; }
+	
+	void set(const int x, const int y, float z, uint32_t id)
+	{
+		size_t i = y * m_width + x;
+		m_depth[i] = z;
+		m_ids[i] = id;
+	}
+	
+	/**
+	 * Unpacks the draw index of an id.
+	 */
+	static uint32_t drawOf(uint32_t id) { return id >> TRIANGLE_BITS; }
+	
+	/**
+	 * Unpacks the triangle index of an id.
+	 */
+	static uint32_t triangleOf(uint32_t id) { return id & MAX_TRIANGLES; }
+	
+	/**
+	 * The resolve pass. Reconstructs the attributes of every covered pixel from
+	 * its triangle and hands the fragment to the fragment processor.
+	 * 
+	 * @param fp the fragment processor shading the visible pixels
+	 * @param fb the framebuffer the fragment processor writes into
+	 */
+	void resolve(FragmentProcessor& fp, FrameBuffer& fb);
+	
+	/**
+	 * @return the number of triangles stored for the current frame
+	 */
+	size_t triangleCount() const { return m_vertices.size() / (3 * m_stride); }
+	
+protected:
+	/**
+	 * A run of triangles drawn with the same texture.
+	 */
+	struct Draw {
+		const Texture* texture;	//!< the texture bound during the draw
+		uint32_t first;			//!< the index of the first triangle of the draw
+	};
+	
+	unsigned m_width;				//!< the width of the buffer
+	unsigned m_height;				//!< the height of the buffer
+	int m_attributes;				//!< the number of attributes of each vertex
+	int m_stride;					//!< the number of floats stored per vertex
+	std::vector<float> m_depth;		//!< the depth of each pixel
+	std::vector<uint32_t> m_ids;	//!< the packed id of each pixel
+	std::vector<float> m_vertices;	//!< screen x, y, z, 1/w and the attributes divided by w for each vertex
+	std::vector<Draw> m_draws;		//!< the draws of the current frame
+	
+};	// class VisibilityBuffer
+
+/*!
+ * \class VisibilityFP "core/visbuffer.h"
+ * \brief Writes the depth and the triangle id into a VisibilityBuffer.
+ * 
+ * This fragment processor takes no attributes, the rasterizer only has to
+ * interpolate the depth.
+ */
+class VisibilityFP : public FragmentProcessor {
+public:
+	/**
+	 * @param buffer the visibility buffer to write into (not owned)
+	 */
+	VisibilityFP(VisibilityBuffer* buffer) : m_buffer(buffer), m_id(VisibilityBuffer::INVALID_ID) {}
+	
+	virtual int nAttr() const { return 0; }
+	
+	virtual void fragment(Fragment& f, FrameBuffer& fb)
+	{
+		if(f.attributes[0] < m_buffer->getDepth(f.x, f.y)){
+			m_buffer->set(f.x, f.y, f.attributes[0], m_id);
+		}
+	}
+	
+	/**
+	 * Sets the id written for the next fragments.
+	 */
+	void setTriangle(uint32_t id) { m_id = id; }
+	
+protected:
+	VisibilityBuffer* m_buffer;	//!< the visibility buffer being written
+	uint32_t m_id;				//!< the id of the triangle being rasterized
+	
+};	// class VisibilityFP
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::VisibilityBuffer& v)
+{
+	return out << "[ VisibilityBuffer: " << v.width() << "x" << v.height() << " ]";
+}
+
+#endif	// __PIPELINE_VISIBILITY_BUFFER_H
@@ -0,0 +1,278 @@
+#ifndef __PIPELINE_BYTECODE_FRAG_H
+#define __PIPELINE_BYTECODE_FRAG_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "core/fragment.h"
+#include "core/framebuffer.h"
+#include "fragment/frag_processor.h"
+
+namespace pixelpipe {
+
+/**
+ * The instruction set of the fragment bytecode. Scalar operations work on one
+ * register, the *3 operations work on three consecutive registers.
+ */
+enum bytecode_op {
+	BYTECODE_MOV,	//!< dst = a
+	BYTECODE_ADD,	//!< dst = a + b
+	BYTECODE_SUB,	//!< dst = a - b
+	BYTECODE_MUL,	//!< dst = a * b
+	BYTECODE_MAD,	//!< dst = a * b + c
+	BYTECODE_DIV,	//!< dst = a / b
+	BYTECODE_MIN,	//!< dst = min(a, b)
+	BYTECODE_MAX,	//!< dst = max(a, b)
+	BYTECODE_SAT,	//!< dst = clamp(a, 0, 1)
+	BYTECODE_RSQ,	//!< dst = 1 / sqrt(a)
+	BYTECODE_SQRT,	//!< dst = sqrt(a)
+	BYTECODE_POW,	//!< dst = pow(a, b)
+	BYTECODE_EXP2,	//!< dst = 2^a
+	BYTECODE_LOG2,	//!< dst = log2(a)
+	BYTECODE_SPEC,	//!< dst = State::specular(a)
+	BYTECODE_DOT3,	//!< dst = dot(a.xyz, b.xyz)
+	BYTECODE_NRM3,	//!< dst.xyz = normalize(a.xyz)
+	BYTECODE_TEX,	//!< dst.xyz = texture(a, b)
+	BYTECODE_OUT	//!< color = (a, b, c)
+};
+
+/*!
+ * \class ShaderBytecode "fragment/frag_bytecode.h"
+ * \brief A register based fragment program, built in C++ or compiled from text.
+ *
+ * Registers hold one float per lane. The first 1 + nAttr() registers are the
+ * interpolated fragment attributes (v0 is the depth, v1.. are the varyings sent
+ * by the vertex processor), followed by constants, uniforms and temporaries.
+ *
+ * The text form has one statement per line, '#' starts a comment:
+ *
+ *   varyings 15              the number of varyings expected from the vertex processor
+ *   vertex textured          the vertex processor feeding the program, shaded (the
+ *                            default, FragmentShadedVP) or textured (TexturedFragmentShadedVP)
+ *   depthtest off            disables the z-buffer test (on by default)
+ *   n = nrm3 v4              assigns a temporary; vector results take three registers
+ *   d = dot3 n l
+ *   c = mad v1 d ambient     operands are vN, temporaries, numbers or uniforms
+ *   out c.x c.y c.z          .x .y .z select a component of a vector temporary
+ *
+ * The built-in uniforms are ambient, specular_color and light0 .. lightN (the
+ * light intensities); their registers are rewritten when the State changes.
+ * Both vertex processors send 9 + 6 * lights varyings, so a program is written
+ * for a fixed number of lights and SoftwarePipeline::setFragmentProgram()
+ * rejects it when the State has a different count.
+ */
+class ShaderBytecode {
+public:
+	/**
+	 * An encoded instruction.
+	 */
+	struct Instruction {
+		unsigned short op;	//!< the bytecode_op
+		unsigned short dst;	//!< the destination register
+		unsigned short a;	//!< the first operand register
+		unsigned short b;	//!< the second operand register
+		unsigned short c;	//!< the third operand register
+	};
+
+	/**
+	 * Creates an empty program.
+	 *
+	 * @param varyings the number of varyings expected from the vertex processor
+	 */
+	ShaderBytecode(int varyings);
+
+	/**
+	 * Compiles a program from its text form.
+	 *
+	 * @param source the program text
+	 * @return a new program. Throws a string describing the first error.
+	 */
+	static ShaderBytecode* compile(const std::string& source);
+
+	/**
+	 * Reads and compiles a program file.
+	 *
+	 * @param filename the path to the program text
+	 */
+	static ShaderBytecode* load(const std::string& filename);
+
+	/**
+	 * @return the number of varyings this program expects
+	 */
+	int nAttr() const { return m_varyings; }
+
+	/**
+	 * @return the number of lights read by the program, one more than the
+	 * highest lightN uniform, or 0 when it reads none
+	 */
+	int lightCount() const { return m_lights; }
+
+	/**
+	 * @return the register holding attribute i (0 is the depth)
+	 */
+	int varying(int i) const;
+
+	/**
+	 * @return a register holding the given constant
+	 */
+	int constant(float value);
+
+	/**
+	 * @return the first register of a named uniform, allocating it if necessary
+	 */
+	int uniform(const std::string& name, int components = 1);
+
+	/**
+	 * Sets the value of a uniform. Unknown names are ignored.
+	 */
+	void setUniform(const std::string& name, const float* values, int components = 1);
+
+	/**
+	 * Allocates temporary registers.
+	 *
+	 * @param components the number of consecutive registers
+	 * @return the first register
+	 */
+	int temp(int components = 1);
+
+	/**
+	 * Appends an instruction writing into a new temporary.
+	 *
+	 * @return the destination register
+	 */
+	int emit(bytecode_op op, int a, int b = 0, int c = 0);
+
+	/**
+	 * Appends an instruction writing into an existing register.
+	 */
+	void emitTo(int dst, bytecode_op op, int a, int b = 0, int c = 0);
+
+	int add(int a, int b) { return emit(BYTECODE_ADD, a, b); }
+	int sub(int a, int b) { return emit(BYTECODE_SUB, a, b); }
+	int mul(int a, int b) { return emit(BYTECODE_MUL, a, b); }
+	int mad(int a, int b, int c) { return emit(BYTECODE_MAD, a, b, c); }
+	int saturate(int a) { return emit(BYTECODE_SAT, a); }
+	int specular(int a) { return emit(BYTECODE_SPEC, a); }
+	int dot3(int a, int b) { return emit(BYTECODE_DOT3, a, b); }
+	int normalize3(int a) { return emit(BYTECODE_NRM3, a); }
+	int sample(int u, int v) { return emit(BYTECODE_TEX, u, v); }
+
+	/**
+	 * Sets the registers written to the framebuffer.
+	 */
+	void output(int r, int g, int b) { emitTo(0, BYTECODE_OUT, r, g, b); }
+
+	/**
+	 * Enables or disables the z-buffer test.
+	 */
+	void setDepthTest(bool value) { m_depthTest = value; }
+
+	bool getDepthTest() const { return m_depthTest; }
+
+	/**
+	 * Selects the vertex processor that configure() installs in front of the
+	 * program, its varyings must match nAttr().
+	 */
+	void setVertexProcessor(program_vertex value) { m_vertex = value; }
+
+	program_vertex getVertexProcessor() const { return m_vertex; }
+
+	/**
+	 * @return the total number of registers used by this program
+	 */
+	int registerCount() const { return (int) m_initial.size(); }
+
+	const std::vector<Instruction>& code() const { return m_code; }
+
+	/**
+	 * @return the initial register values (constants and uniforms)
+	 */
+	const std::vector<float>& initialValues() const { return m_initial; }
+
+	const std::map<std::string, int>& uniforms() const { return m_uniforms; }
+
+	/**
+	 * @return a counter incremented whenever setUniform() changes a value
+	 */
+	unsigned revision() const { return m_revision; }
+
+protected:
+	int m_varyings;								//!< the number of varyings expected from the vertex processor
+	bool m_depthTest;							//!< whether fragments are z-buffer tested
+	program_vertex m_vertex;					//!< the vertex processor feeding the program
+	int m_lights;								//!< the number of lights read by the program
+	unsigned m_revision;						//!< incremented by setUniform()
+	std::vector<Instruction> m_code;			//!< the instruction stream
+	std::vector<float> m_initial;				//!< the initial value of every register
+	std::map<float, int> m_constants;			//!< the registers holding constants
+	std::map<std::string, int> m_uniforms;		//!< the first register of each uniform
+
+	int allocate(int components, float value = 0.0f);
+	int checked(int reg) const;
+
+};	// class ShaderBytecode
+
+/*!
+ * \class BytecodeFP "fragment/frag_bytecode.h"
+ * \brief A fragment processor that interprets a ShaderBytecode program.
+ *
+ * Fragments that pass the depth test are gathered into packets of LANES
+ * fragments. Each instruction is decoded once per packet and applied to all
+ * lanes in a tight loop, so the dispatch cost is amortized. Packets never span
+ * triangles: the Rasterizer calls flush() after every triangle, so the early
+ * depth test is not affected by deferred writes. The rsq, nrm3, pow, exp2 and
+ * log2 instructions follow the math precision selected in the State.
+ */
+class BytecodeFP : public FragmentProcessor {
+public:
+	static const int LANES = 8;	//!< the number of fragments processed per packet
+
+	/**
+	 * @param program the program to interpret (the processor takes ownership)
+	 */
+	BytecodeFP(ShaderBytecode* program);
+	~BytecodeFP();
+
+	virtual int nAttr() const { return m_program->nAttr(); }
+	virtual void fragment(Fragment& f, FrameBuffer& fb);
+	virtual void flush(FrameBuffer& fb);
+
+	/**
+	 * Accessor method for the program, e.g. for setting uniforms. Values set
+	 * through it are picked up before the next packet.
+	 */
+	ShaderBytecode& getProgram() { return *m_program; }
+
+protected:
+	ShaderBytecode* m_program;	//!< the interpreted program
+	float* m_registers;			//!< the register file, LANES floats per register
+	int m_x[LANES];				//!< the x coordinates of the queued fragments
+	int m_y[LANES];				//!< the y coordinates of the queued fragments
+	int m_count;				//!< the number of queued fragments
+	int m_attributes;			//!< the number of attribute registers (depth and varyings)
+	bool m_stale;				//!< whether the uniforms must be compared with the State before the next packet
+	int m_ambient;				//!< the register of the ambient uniform, or -1
+	int m_specularColor;		//!< the first register of the specular_color uniform, or -1
+	std::vector<int> m_lights;	//!< the first register of each lightN uniform, or -1
+	std::vector<float> m_state;	//!< the State values held by the built-in uniform registers
+	std::vector<float> m_current;	//!< the current State values, compared with m_state
+	unsigned m_revision;		//!< the program revision held by the uniform registers
+
+	void execute(FrameBuffer& fb);
+	void refreshUniforms();
+	void broadcast(int reg, const float* values, int components);
+
+};	// class BytecodeFP
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::BytecodeFP& fp)
+{
+	return out << "[ BytecodeFragmentProcessor ]";
+}
+
+#endif	// __PIPELINE_BYTECODE_FRAG_H
@@ -0,0 +1,41 @@
+#ifndef __PIPELINE_DEPTH_FRAG_H
+#define __PIPELINE_DEPTH_FRAG_H
+
+#include "core/fragment.h"
+#include "core/framebuffer.h"
+#include "fragment/frag_processor.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class DepthFP "fragment/frag_depth.h"
+ * \brief Writes the depth of the nearest fragment and no color.
+ * 
+ * This fragment processor takes no attributes; it is used by the depth pass
+ * that precedes the shading pass of a Z-prepass.
+ * 
+ */
+class DepthFP : public FragmentProcessor {
+public:
+	virtual int nAttr() const { return 0; }
+	
+	virtual void fragment(Fragment& f, FrameBuffer& fb)
+	{
+		if(depthTest(f, fb)){
+			fb.setZ(f.x, f.y, f.attributes[0]);
+		}
+	}
+	
+};	// class DepthFP
+
+}	// namespace pixelpipe
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::DepthFP& fp)
+{
+	return out << "[ DepthFragmentProcessor ]";
+}
+
+#endif	// __PIPELINE_DEPTH_FRAG_H
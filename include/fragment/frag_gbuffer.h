@@ -0,0 +1,48 @@
+#ifndef __PIPELINE_GBUFFER_FRAG_H
+#define __PIPELINE_GBUFFER_FRAG_H
+
+#include "core/fragment.h"
+#include "core/framebuffer.h"
+#include "core/gbuffer.h"
+#include "fragment/frag_processor.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class GBufferFP "fragment/frag_gbuffer.h"
+ * \brief Writes the nearest surface of each pixel into a GBuffer.
+ * 
+ * This is the geometry pass of the deferred mode. The depth test is done against
+ * the GBuffer; the framebuffer is only written by the lighting pass. When
+ * texturing is enabled the albedo is the texture color, otherwise it is the
+ * interpolated vertex color.
+ * 
+ * @see GBufferVP
+ */
+class GBufferFP : public FragmentProcessor {
+public:
+	/**
+	 * @param gbuffer the geometry buffer to write into (not owned)
+	 */
+	GBufferFP(GBuffer* gbuffer);
+	
+	virtual int nAttr() const { return 8; }
+	virtual int texcoordAttribute() const { return 6; }
+	virtual void fragment(Fragment& f, FrameBuffer& fb);
+	
+protected:
+	GBuffer* m_gbuffer;		//!< the geometry buffer being written
+	
+};
+
+}
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::GBufferFP& fp)
+{
+	return out << "[ GBufferFragmentProcessor ]";
+}
+
+#endif	// __PIPELINE_GBUFFER_FRAG_H
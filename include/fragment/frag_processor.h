@@ -18,9 +18,29 @@ namespace pixelpipe {
  */
 class FragmentProcessor {
 public:	
+	FragmentProcessor() : m_texture(NULL), m_depthFunc(DEPTH_FUNC_LESS) {}
+	virtual ~FragmentProcessor() {}
+	
 	virtual int nAttr() const = 0;
 	virtual void fragment(Fragment& f, FrameBuffer& fb) = 0;
 	
+	/**
+	 * Called by the Rasterizer after the last fragment of a triangle. Processors
+	 * that batch fragments must write out any pending work here.
+	 * 
+	 * @param fb the framebuffer the pending fragments are written to.
+	 */
+	virtual void flush(FrameBuffer& fb) {}
+	
+	/**
+	 * The index of the vertex attribute holding the (u, v) texture coordinate.
+	 * The Rasterizer fills the derivatives of the fragments with the screen
+	 * space derivatives of that coordinate, which select the mip level.
+	 * 
+	 * @return the index of u, or -1 when the processor does not sample textures
+	 */
+	virtual int texcoordAttribute() const { return -1; }
+	
 	/**
 	 * This sets the texture that the fragment processor should use.
 	 * 
@@ -30,8 +50,29 @@ public:
 		m_texture = const_cast<Texture*>(newTexture);
 	}
 	
+	/**
+	 * Selects the comparison used by the depth test. The shading pass after a
+	 * depth prepass uses DEPTH_FUNC_EQUAL.
+	 * 
+	 * @param func the new depth comparison
+	 */
+	void setDepthFunc(depth_func func) { m_depthFunc = func; }
+	
+	depth_func getDepthFunc() const { return m_depthFunc; }
+	
 protected:
-	Texture* m_texture;	//!< A reference to the currently loaded texture.
+	Texture* m_texture;			//!< A reference to the currently loaded texture.
+	depth_func m_depthFunc;		//!< The comparison used by the depth test.
+	
+	/**
+	 * @param f the incoming fragment
+	 * @param fb the framebuffer holding the stored depth
+	 * @return whether the fragment passes the depth test
+	 */
+	inline bool depthTest(const Fragment& f, const FrameBuffer& fb) const
+	{
+		return fb.testZ(f.x, f.y, f.attributes[0], m_depthFunc);
+	}
 	
 };	// class FragmentProcessor
 
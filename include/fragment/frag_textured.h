@@ -21,6 +21,7 @@ class TexturedFP : public FragmentProcessor
 {
 public:
 	virtual int nAttr() const { return 5; }
+	virtual int texcoordAttribute() const { return 3; }
 	virtual void fragment(Fragment& f, FrameBuffer& fb);
 	
 protected:
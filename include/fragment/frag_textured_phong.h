@@ -23,6 +23,7 @@ class TexturedPhongFP : public FragmentProcessor
 public:
 	TexturedPhongFP();
 	virtual int nAttr() const { return size; }
+	virtual int texcoordAttribute() const { return 0; }
 	virtual void fragment(Fragment& f, FrameBuffer& fb);
 	
 protected:
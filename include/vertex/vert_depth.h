@@ -0,0 +1,50 @@
+#ifndef __PIPELINE_DEPTH_ONLY_PROCESSOR_H
+#define __PIPELINE_DEPTH_ONLY_PROCESSOR_H
+
+#include "cg/vecmath/vec2.hpp"
+#include "cg/vecmath/vec3.hpp"
+#include "cg/vecmath/color.h"
+#include "core/vertex.h"
+#include "vertex/vert_processor.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class DepthOnlyVP "vertex/vert_depth.h"
+ * \brief Transforms positions only, for the depth pass.
+ * 
+ * No attributes are produced, so the clipper and the rasterizer only have to
+ * handle the positions. The attribute arrays of the output vertices are left
+ * untouched, which lets the pipeline reuse its vertex cache across passes.
+ * The transform is the same as in every other vertex processor so that the
+ * depth written here is bit for bit the depth computed again by the shading
+ * pass.
+ * 
+ */
+class DepthOnlyVP : public VertexProcessor {
+public:	
+	virtual int nAttr() const { return 0; }
+	virtual void triangle(	const cg::vecmath::Vector3f* vs, 
+					const cg::vecmath::Color3f* cs_ign, 
+					const cg::vecmath::Vector3f* ns_ign, 
+					const cg::vecmath::Vector2f* ts_ign, 
+					Vertex* output);
+	virtual void vertex(const cg::vecmath::Vector3f& v, 
+				const cg::vecmath::Color3f& c_ign, 
+				const cg::vecmath::Vector3f& n_ign, 
+				const cg::vecmath::Vector2f& t_ign, 
+				Vertex& output);
+	
+};
+
+}
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::DepthOnlyVP& vp)
+{
+	return out << "[ DepthOnlyVertexProcessor ]";
+}
+
+#endif	// __PIPELINE_DEPTH_ONLY_PROCESSOR_H
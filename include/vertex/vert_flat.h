@@ -0,0 +1,49 @@
+#ifndef __PIPELINE_FLAT_SHADED_PROCESSOR_H
+#define __PIPELINE_FLAT_SHADED_PROCESSOR_H
+
+#include "cg/vecmath/vec2.hpp"
+#include "cg/vecmath/vec3.hpp"
+#include "cg/vecmath/color.h"
+#include "core/vertex.h"
+#include "vertex/vert_shaded.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class FlatShadedVP "vertex/vert_flat.h"
+ * \brief This class lights each triangle once and gives it a single color.
+ * 
+ * The lighting model is the same as the SmoothShadedVP, but it is evaluated
+ * once per triangle at its centroid using the average of the vertex normals.
+ * The resulting color is written to all three vertices so that the rasterizer,
+ * in flat shading mode, only has to interpolate the depth. Vertices submitted
+ * one at a time are assembled into triangles by the pipeline first (see
+ * lightsTriangles()), so they are lit once per triangle as well.
+ * 
+ */
+class FlatShadedVP : public SmoothShadedVP {
+public:
+	FlatShadedVP();
+	virtual void triangle(	const cg::vecmath::Vector3f* vs, 
+					const cg::vecmath::Color3f* cs, 
+					const cg::vecmath::Vector3f* ns, 
+					const cg::vecmath::Vector2f* ts_ign, 
+					Vertex* output);
+	virtual bool lightsTriangles() const { return true; }
+	
+protected:
+	Vertex face;	//!< temporary vertex holding the lit centroid of the triangle
+	
+};
+
+}
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::FlatShadedVP& vp)
+{
+	return out << "[ FlatShadedVertexProcessor ]";
+}
+
+#endif	// __PIPELINE_FLAT_SHADED_PROCESSOR_H
@@ -0,0 +1,54 @@
+#ifndef __PIPELINE_GBUFFER_VERTEX_PROCESSOR_H
+#define __PIPELINE_GBUFFER_VERTEX_PROCESSOR_H
+
+#include "cg/vecmath/vec2.hpp"
+#include "cg/vecmath/vec3.hpp"
+#include "cg/vecmath/vec4.hpp"
+#include "cg/vecmath/color.h"
+#include "core/vertex.h"
+#include "vertex/vert_processor.h"
+
+namespace pixelpipe {
+
+/*!
+ * \class GBufferVP "vertex/vert_gbuffer.h"
+ * \brief Provides the surface attributes for the geometry pass of the deferred mode.
+ * 
+ * Outputs the vertex color, the eye space normal and the texture coordinates.
+ * No lighting is done here; the light and view vectors are recovered from the
+ * depth during the lighting pass, so the number of varyings does not grow with
+ * the number of lights.
+ * 
+ * @see GBuffer
+ */
+class GBufferVP : public VertexProcessor {
+public:
+	virtual int nAttr() const { return 8; }
+	virtual void triangle(	const cg::vecmath::Vector3f* vs, 
+					const cg::vecmath::Color3f* cs, 
+					const cg::vecmath::Vector3f* ns, 
+					const cg::vecmath::Vector2f* ts, 
+					Vertex* output);
+	virtual void vertex(const cg::vecmath::Vector3f& v, 
+				const cg::vecmath::Color3f& c, 
+				const cg::vecmath::Vector3f& n, 
+				const cg::vecmath::Vector2f& t, 
+				Vertex& output);
+	
+protected:
+	cg::vecmath::Vector4f vert;					//!< temporary copy of the input vertex position
+	cg::vecmath::Vector4f normal;				//!< temporary copy of the transformed vertex normal
+	
+};
+
+}
+
+/**
+ * Output utility function for logging and debugging purposes.
+ */
+inline std::ostream& operator<<(std::ostream &out, const pixelpipe::GBufferVP& vp)
+{
+	return out << "[ GBufferVertexProcessor ]";
+}
+
+#endif	// __PIPELINE_GBUFFER_VERTEX_PROCESSOR_H
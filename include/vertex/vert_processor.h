@@ -26,7 +26,7 @@ namespace pixelpipe {
 class VertexProcessor {
 public:
 	VertexProcessor();
-	~VertexProcessor();
+	virtual ~VertexProcessor();
 	
 	/**
 	 * Returns the number of attributes this triangle processor will provide.
@@ -84,6 +84,13 @@ public:
 	 */
 	virtual void vertex(const cg::vecmath::Vector3f& v, const cg::vecmath::Color3f& c, const cg::vecmath::Vector3f& n, const cg::vecmath::Vector2f& t, Vertex& output) = 0;
 	
+	/**
+	 * Processors that light whole triangles return true, the pipeline then
+	 * assembles the vertices of begin()/end() primitives and sends them through
+	 * triangle() instead of vertex().
+	 */
+	virtual bool lightsTriangles() const { return false; }
+	
 protected:
 	cg::vecmath::Matrix4f modelViewMatrix;	//!< the local model-view matrix
 	cg::vecmath::Matrix4f MVP;				//!< the modelview * projection * viewport matrix
@@ -0,0 +1,118 @@
+#include <math.h>
+#include <algorithm>
+
+#include "core/damage.h"
+
+namespace pixelpipe {
+
+DamageTracker::DamageTracker()
+	: m_width(0), m_height(0), m_regionWidth(0), m_regionHeight(0), m_tilesX(0), m_tilesY(0)
+{
+}
+
+void DamageTracker::update(const FrameBuffer& fb)
+{
+	size_t count = (size_t) fb.tilesX() * fb.tilesY();
+	bool all = m_signatures.size() != count || m_width != (unsigned) fb.width() || m_height != (unsigned) fb.height()
+		|| m_regionWidth != fb.regionWidth() || m_regionHeight != fb.regionHeight();
+
+	m_width = fb.width();
+	m_height = fb.height();
+	m_regionWidth = fb.regionWidth();
+	m_regionHeight = fb.regionHeight();
+	m_tilesX = fb.tilesX();
+	m_tilesY = fb.tilesY();
+	m_signatures.resize(count);
+	m_damaged.assign(count, all ? 1 : 0);
+	m_tiles.clear();
+
+	// only the tiles of the rendered region hold the frame
+	unsigned size = this->tileSize();
+	unsigned regionTilesX = (m_regionWidth + size - 1) / size;
+	unsigned regionTilesY = (m_regionHeight + size - 1) / size;
+	bool scaled = m_regionWidth != m_width || m_regionHeight != m_height;
+	for(unsigned ty = 0; ty < regionTilesY; ty++){
+		for(unsigned tx = 0; tx < regionTilesX; tx++){
+			size_t t = (size_t) ty * m_tilesX + tx;
+			uint64_t signature = fb.tileSignature(t);
+			if(signature != m_signatures[t] && !all){
+				if(scaled) damageUpscaled(tx, ty);
+				else m_damaged[t] = 1;
+			}
+			m_signatures[t] = signature;
+		}
+	}
+
+	for(size_t t = 0; t < count; t++){
+		if(m_damaged[t]) m_tiles.push_back((unsigned) t);
+	}
+
+	buildRegions();
+}
+
+void DamageTracker::damageUpscaled(unsigned tx, unsigned ty)
+{
+	// the pixels of the full frame whose bilinear footprint (see FrameBuffer::upscale)
+	// reaches into the tile, with a margin for the rounding
+	unsigned size = this->tileSize();
+	float sx = (float) m_width / (float) m_regionWidth;
+	float sy = (float) m_height / (float) m_regionHeight;
+	int x0 = (int) floorf((tx * size - 0.5f) * sx - 0.5f) - 1;
+	int x1 = (int) ceilf((std::min((tx + 1) * size, m_regionWidth) + 0.5f) * sx - 0.5f) + 1;
+	int y0 = (int) floorf((ty * size - 0.5f) * sy - 0.5f) - 1;
+	int y1 = (int) ceilf((std::min((ty + 1) * size, m_regionHeight) + 0.5f) * sy - 0.5f) + 1;
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, (int) m_width);
+	y1 = std::min(y1, (int) m_height);
+
+	for(int y = y0 / (int) size; y <= (y1 - 1) / (int) size; y++){
+		for(int x = x0 / (int) size; x <= (x1 - 1) / (int) size; x++) m_damaged[(size_t) y * m_tilesX + x] = 1;
+	}
+}
+
+void DamageTracker::buildRegions()
+{
+	m_regions.clear();
+
+	// the rectangles (in tiles) that end in the previous row of tiles
+	std::vector<size_t> open;
+	std::vector<size_t> next;
+	for(unsigned ty = 0; ty < m_tilesY; ty++){
+		next.clear();
+		unsigned tx = 0;
+		while(tx < m_tilesX){
+			if(!damaged(tx, ty)){
+				tx++;
+				continue;
+			}
+			unsigned first = tx;
+			while(tx < m_tilesX && damaged(tx, ty)) tx++;
+
+			size_t r = 0;
+			while(r < open.size() && (m_regions[open[r]].x != first || m_regions[open[r]].width != tx - first)) r++;
+			if(r < open.size()){
+				m_regions[open[r]].height++;
+				next.push_back(open[r]);
+			}
+			else{
+				DamageRect rect = { first, ty, tx - first, 1 };
+				next.push_back(m_regions.size());
+				m_regions.push_back(rect);
+			}
+		}
+		open.swap(next);
+	}
+
+	// from tiles to pixels
+	unsigned size = this->tileSize();
+	for(size_t r = 0; r < m_regions.size(); r++){
+		DamageRect& rect = m_regions[r];
+		rect.x *= size;
+		rect.y *= size;
+		rect.width = std::min(rect.width * size, m_width - rect.x);
+		rect.height = std::min(rect.height * size, m_height - rect.y);
+	}
+}
+
+}	// namespace pixelpipe
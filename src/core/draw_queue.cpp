@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <string.h>
+
+#include "core/draw_queue.h"
+
+using namespace cg::vecmath;
+
+namespace pixelpipe {
+
+/**
+ * Orders draw indices by their sort keys.
+ */
+struct DrawKeyLess {
+	const std::vector<uint64_t>& keys;
+	
+	DrawKeyLess(const std::vector<uint64_t>& k) : keys(k) {}
+	
+	bool operator()(unsigned a, unsigned b) const { return keys[a] < keys[b]; }
+};
+
+/**
+ * Maps a float to an unsigned integer with the same ordering.
+ */
+static inline uint32_t orderedBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x80000000u)? ~bits : (bits | 0x80000000u);
+}
+
+DrawQueue::DrawQueue()
+{
+	m_open = false;
+}
+
+void DrawQueue::open(const Draw& draw)
+{
+	m_draws.push_back(draw);
+	m_draws.back().first = (unsigned) m_commands.size();
+	m_draws.back().count = 0;
+	m_order.push_back((unsigned) m_order.size());
+	m_open = true;
+}
+
+void DrawQueue::push(command_type type, drawing_mode mode)
+{
+	Command command;
+	command.type = type;
+	command.mode = mode;
+	command.first = (unsigned) m_vertices.size();
+	m_commands.push_back(command);
+	m_draws.back().count++;
+}
+
+void DrawQueue::begin(drawing_mode mode)
+{
+	push(COMMAND_BEGIN, mode);
+}
+
+void DrawQueue::vertex(const Vector3f& v, const Color3f& c, const Vector3f& n, const Vector2f& t)
+{
+	push(COMMAND_VERTEX);
+	
+	QueuedVertex qv;
+	qv.v = v;
+	qv.c = c;
+	qv.n = n;
+	qv.t = t;
+	m_vertices.push_back(qv);
+}
+
+void DrawQueue::triangle(const Vector3f* v, const Color3f* c, const Vector3f* n, const Vector2f* t)
+{
+	push((t != NULL)? COMMAND_TRIANGLE : COMMAND_TRIANGLE_UNTEXTURED);
+	
+	for(int k = 0; k < 3; k++){
+		QueuedVertex qv;
+		qv.v = v[k];
+		qv.c = c[k];
+		qv.n = n[k];
+		if(t != NULL) qv.t = t[k];
+		m_vertices.push_back(qv);
+	}
+}
+
+void DrawQueue::end()
+{
+	push(COMMAND_END);
+}
+
+uint64_t DrawQueue::stateKey(const Draw& draw)
+{
+	uint64_t state = draw.state & 0xff;
+	uint64_t texture = (uint64_t) (draw.texture + 1) & 0xffffff;
+	return (state << 56) | (texture << 32) | orderedBits(draw.depth);
+}
+
+void DrawQueue::sort(draw_order order)
+{
+	if(order == DRAW_ORDER_SUBMISSION) return;
+	
+	m_keys.resize(m_draws.size());
+	for(size_t i = 0; i < m_draws.size(); i++){
+		if(order == DRAW_ORDER_STATE) m_keys[i] = stateKey(m_draws[i]);
+		else m_keys[i] = orderedBits(m_draws[i].depth);
+	}
+	
+	std::stable_sort(m_order.begin(), m_order.end(), DrawKeyLess(m_keys));
+}
+
+void DrawQueue::clear()
+{
+	m_open = false;
+	m_draws.clear();
+	m_order.clear();
+	m_commands.clear();
+	m_vertices.clear();
+}
+
+}	// namespace pixelpipe
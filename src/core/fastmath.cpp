@@ -0,0 +1,21 @@
+#include <math.h>
+
+#include "core/fastmath.h"
+
+namespace pixelpipe {
+
+SpecularTable::SpecularTable(float exponent)
+{
+	rebuild(exponent);
+}
+
+void SpecularTable::rebuild(float exponent)
+{
+	m_exponent = exponent;
+
+	for(int i = 0; i <= SIZE; i++){
+		m_table[i] = ::powf((float) i / (float) SIZE, exponent);
+	}
+}
+
+}	// namespace pixelpipe
@@ -0,0 +1,120 @@
+
+#include "core/frame_ring.h"
+
+namespace pixelpipe {
+
+FrameRing::FrameRing(unsigned count, unsigned width, unsigned height, color_format color, depth_format depth, framebuffer_layout layout)
+	: m_current(0), m_latest(-1), m_consumer(NULL), m_damage(NULL), m_stop(false)
+{
+	if(count < 2) throw "A frame ring needs at least two framebuffers.";
+
+	m_slots.resize(count);
+	for(unsigned i = 0; i < count; i++){
+		m_slots[i].framebuffer = new FrameBuffer(width, height, color, depth, layout);
+		m_slots[i].state = SLOT_IDLE;
+		m_slots[i].color = NULL;
+	}
+
+	m_thread = std::thread(&FrameRing::run, this);
+}
+
+FrameRing::~FrameRing()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_queued.notify_one();
+	m_thread.join();
+
+	for(unsigned i = 0; i < m_slots.size(); i++) delete m_slots[i].framebuffer;
+}
+
+void FrameRing::init()
+{
+	for(unsigned i = 0; i < m_slots.size(); i++) m_slots[i].framebuffer->init();
+}
+
+void FrameRing::submit()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_slots[m_current].state = SLOT_QUEUED;
+	m_slots[m_current].color = NULL;
+	m_queue.push_back(m_current);
+	m_queued.notify_one();
+
+	// wait for the fence of the next render target
+	m_current = (m_current + 1) % m_slots.size();
+	Slot& next = m_slots[m_current];
+	while(next.state != SLOT_IDLE) m_completed.wait(lock);
+
+	next.color = NULL;
+	if(m_latest == (int) m_current) m_latest = -1;
+}
+
+const FrameBuffer* FrameRing::latest(const void** color)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while(m_latest < 0 && !m_queue.empty()) m_completed.wait(lock);
+
+	// nothing was submitted since the render target was last completed
+	if(m_latest < 0){
+		*color = NULL;
+		return NULL;
+	}
+
+	*color = m_slots[m_latest].color;
+	return m_slots[m_latest].framebuffer;
+}
+
+void FrameRing::finish()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(!m_queue.empty()) m_completed.wait(lock);
+}
+
+void FrameRing::setConsumer(FrameConsumer* consumer)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_consumer = consumer;
+}
+
+void FrameRing::setDamageTracker(DamageTracker* damage)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_damage = damage;
+}
+
+void FrameRing::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while(true){
+		while(!m_stop && m_queue.empty()) m_queued.wait(lock);
+		if(m_queue.empty()) break;
+
+		unsigned index = m_queue.front();
+		Slot& slot = m_slots[index];
+		slot.state = SLOT_BUSY;
+		FrameConsumer* consumer = m_consumer;
+		DamageTracker* damage = m_damage;
+		lock.unlock();
+
+		// the framebuffer is not touched by the render thread until its fence is signaled
+		const FrameBuffer& fb = *slot.framebuffer;
+		if(damage != NULL) damage->update(fb);
+		const void* color = fb.getColorData();
+		if(consumer != NULL) consumer->consume(color, fb.width(), fb.height(), fb.getColorFormat(), damage);
+
+		lock.lock();
+		slot.color = color;
+		slot.state = SLOT_IDLE;
+		m_latest = (int) index;
+		m_queue.pop_front();
+		m_completed.notify_all();
+	}
+}
+
+}	// namespace pixelpipe
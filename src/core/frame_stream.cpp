@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <algorithm>
+#include <thread>
+
+#include "core/frame_stream.h"
+
+namespace pixelpipe {
+
+FrameStream::FrameStream(const std::string& path, stream_format format, unsigned fps, unsigned threads)
+	: m_format(format), m_fps(fps), m_width(0), m_height(0), m_frames(0), m_converter(CHANNEL_ORDER_RGB)
+{
+	if(path == "-"){
+		m_file = stdout;
+		m_close = false;
+	}
+	else{
+		m_file = fopen(path.c_str(), "wb");
+		m_close = true;
+	}
+	if(m_file == NULL) throw "Unable to open the frame stream output.";
+
+	m_threads = threads;
+	if(m_threads == 0) m_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+FrameStream::~FrameStream()
+{
+	if(m_close) fclose(m_file);
+	else fflush(m_file);
+}
+
+void FrameStream::consume(const void* color, unsigned width, unsigned height, color_format format, const DamageTracker* damage)
+{
+	if(m_frames == 0){
+		m_width = width;
+		m_height = height;
+
+		size_t chroma = (size_t) ((m_width + 1) / 2) * ((m_height + 1) / 2);
+		switch(m_format){
+			case STREAM_FORMAT_RGB:
+				m_buffer.resize((size_t) m_width * m_height * 3);
+				break;
+			case STREAM_FORMAT_Y4M:
+				fprintf(m_file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", m_width, m_height, m_fps);
+				m_buffer.resize(6 + (size_t) m_width * m_height + 2 * chroma);
+				memcpy(&m_buffer[0], "FRAME\n", 6);
+				break;
+			case STREAM_FORMAT_DELTA:
+				break;
+			default:
+			case STREAM_FORMAT_YUV:
+				m_buffer.resize((size_t) m_width * m_height + 2 * chroma);
+				break;
+		}
+	}
+	// the consumer may run on the frame ring worker, so frames of another size are dropped
+	if(width != m_width || height != m_height) return;
+
+	if(m_format == STREAM_FORMAT_DELTA){
+		delta(color, format, damage);
+		fwrite(&m_buffer[0], 1, m_buffer.size(), m_file);
+		fflush(m_file);
+		m_frames++;
+		return;
+	}
+
+	// bands of an even number of rows, so that each thread owns whole chroma rows
+	unsigned threads = std::min(m_threads, std::max(1u, m_height / 16));
+	unsigned band = ((m_height + threads - 1) / threads + 1) & ~1u;
+	std::vector<std::thread> workers;
+	for(unsigned first = band; first < m_height; first += band){
+		workers.push_back(std::thread(&FrameStream::convert, this, color, format, first, std::min(first + band, m_height)));
+	}
+	convert(color, format, 0, std::min(band, m_height));
+	for(unsigned i = 0; i < workers.size(); i++) workers[i].join();
+
+	fwrite(&m_buffer[0], 1, m_buffer.size(), m_file);
+	fflush(m_file);
+	m_frames++;
+}
+
+void FrameStream::unpack(const void* color, color_format format, size_t first, unsigned count, unsigned y, unsigned char* out) const
+{
+	if(format == COLOR_FORMAT_FLOAT) m_converter.convertRow((const float*) color + first * 4, 4, count, y, out);
+	else FrameBuffer::unpackRow(color, format, first, count, out);
+}
+
+void FrameStream::convert(const void* color, color_format format, unsigned first, unsigned last)
+{
+	unsigned w = m_width;
+
+	if(m_format == STREAM_FORMAT_RGB){
+		// the framebuffer rows go from bottom to top
+		for(unsigned y = first; y < last; y++){
+			unpack(color, format, (size_t) (m_height - 1 - y) * w, w, y, &m_buffer[(size_t) y * w * 3]);
+		}
+		return;
+	}
+
+	unsigned cw = (w + 1) / 2;
+	unsigned ch = (m_height + 1) / 2;
+	unsigned char* luma = &m_buffer[m_format == STREAM_FORMAT_Y4M ? 6 : 0];
+	unsigned char* cb = luma + (size_t) w * m_height;
+	unsigned char* cr = cb + (size_t) cw * ch;
+
+	// BT.601 video range, the chroma is the average of each 2x2 block
+	std::vector<unsigned char> rows((size_t) w * 6);
+	for(unsigned y = first; y < last; y += 2){
+		unsigned height = std::min(2u, m_height - y);
+		for(unsigned dy = 0; dy < height; dy++){
+			unpack(color, format, (size_t) (m_height - 1 - (y + dy)) * w, w, y + dy, &rows[(size_t) dy * w * 3]);
+		}
+		for(unsigned x = 0; x < w; x += 2){
+			int u = 0, v = 0, count = 0;
+			for(unsigned dy = 0; dy < height; dy++){
+				for(unsigned dx = 0; dx < 2 && x + dx < w; dx++){
+					const unsigned char* rgb = &rows[((size_t) dy * w + x + dx) * 3];
+					luma[(size_t) (y + dy) * w + x + dx] = (unsigned char) (((66 * rgb[0] + 129 * rgb[1] + 25 * rgb[2] + 128) >> 8) + 16);
+					u += ((-38 * rgb[0] - 74 * rgb[1] + 112 * rgb[2] + 128) >> 8) + 128;
+					v += ((112 * rgb[0] - 94 * rgb[1] - 18 * rgb[2] + 128) >> 8) + 128;
+					count++;
+				}
+			}
+			size_t c = (size_t) (y / 2) * cw + x / 2;
+			cb[c] = (unsigned char) ((u + count / 2) / count);
+			cr[c] = (unsigned char) ((v + count / 2) / count);
+		}
+	}
+}
+
+void FrameStream::delta(const void* color, color_format format, const DamageTracker* damage)
+{
+	unsigned size = FrameBuffer::TILE_SIZE;
+	unsigned tilesX = (m_width + size - 1) / size;
+	unsigned tilesY = (m_height + size - 1) / size;
+	if(damage != NULL && damage->width() == m_width && damage->height() == m_height){
+		m_tiles = damage->getTiles();
+	}
+	else{
+		m_tiles.resize(tilesX * tilesY);
+		for(unsigned t = 0; t < m_tiles.size(); t++) m_tiles[t] = t;
+	}
+
+	// the tiles have known sizes, so each one can be packed independently
+	size_t offset = 5 * sizeof(uint32_t);
+	m_offsets.resize(m_tiles.size());
+	for(size_t i = 0; i < m_tiles.size(); i++){
+		unsigned tx = m_tiles[i] % tilesX, ty = m_tiles[i] / tilesX;
+		unsigned w = std::min(size, m_width - tx * size);
+		unsigned h = std::min(size, m_height - ty * size);
+		m_offsets[i] = offset;
+		offset += 4 * sizeof(uint16_t) + (size_t) w * h * 3;
+	}
+	m_buffer.resize(offset);
+
+	uint32_t header[5] = { 0x54445050u, m_width, m_height, size, (uint32_t) m_tiles.size() };
+	memcpy(&m_buffer[0], header, sizeof(header));
+
+	unsigned count = (unsigned) m_tiles.size();
+	unsigned threads = std::min(m_threads, std::max(1u, count / 256));
+	unsigned band = (count + threads - 1) / threads;
+	std::vector<std::thread> workers;
+	for(unsigned first = band; first < count; first += band){
+		workers.push_back(std::thread(&FrameStream::pack, this, color, format, first, std::min(first + band, count)));
+	}
+	pack(color, format, 0, std::min(band, count));
+	for(unsigned i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+void FrameStream::pack(const void* color, color_format format, unsigned first, unsigned last)
+{
+	unsigned size = FrameBuffer::TILE_SIZE;
+	unsigned tilesX = (m_width + size - 1) / size;
+
+	for(unsigned i = first; i < last; i++){
+		unsigned x0 = (m_tiles[i] % tilesX) * size;
+		unsigned y0 = (m_tiles[i] / tilesX) * size;
+		unsigned w = std::min(size, m_width - x0);
+		unsigned h = std::min(size, m_height - y0);
+
+		// the framebuffer rows go from bottom to top
+		unsigned char* out = &m_buffer[m_offsets[i]];
+		uint16_t rect[4] = { (uint16_t) x0, (uint16_t) (m_height - y0 - h), (uint16_t) w, (uint16_t) h };
+		memcpy(out, rect, sizeof(rect));
+		out += sizeof(rect);
+		// the tiles start on multiples of the dither pattern, so it lines up with the full frame
+		for(unsigned y = y0 + h; y-- > y0; out += w * 3) unpack(color, format, (size_t) y * m_width + x0, w, m_height - 1 - y, out);
+	}
+}
+
+}	// namespace pixelpipe
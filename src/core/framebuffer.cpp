@@ -1,14 +1,72 @@
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 #include "core/common.h"
 #include "core/framebuffer.h"
+#include "core/pixel_converter.h"
 
 namespace pixelpipe {
 
-FrameBuffer::FrameBuffer(const unsigned width, const unsigned height, const unsigned channels) : Texture(width, height, channels)
+const int FrameBuffer::TILE_SIZE;
+
+FrameBuffer::FrameBuffer(const unsigned width, const unsigned height, color_format color, depth_format depth, framebuffer_layout layout)
+	: Texture(width, height, (color == COLOR_FORMAT_FLOAT && layout != FRAMEBUFFER_LAYOUT_TILED) ? 4 : 0),
+	m_colorFormat(color), m_depthFormat(depth), m_layout(layout), m_color8(NULL), m_float(NULL),
+	m_clearedTiles(0), m_clearZ(1), m_clearStoredZ(1), m_clearDepthBits(0)
+{
+	allocate(NULL);
+}
+
+FrameBuffer::FrameBuffer(const unsigned width, const unsigned height, unsigned char* color, depth_format depth, framebuffer_layout layout)
+	: Texture(width, height, 0),
+	m_colorFormat(COLOR_FORMAT_RGBA8), m_depthFormat(depth), m_layout(layout), m_color8(NULL), m_float(NULL),
+	m_clearedTiles(0), m_clearZ(1), m_clearStoredZ(1), m_clearDepthBits(0)
+{
+	if(m_layout == FRAMEBUFFER_LAYOUT_TILED) throw "External color planes cannot be tiled.";
+	allocate(color);
+}
+
+void FrameBuffer::allocate(unsigned char* color)
 {
+	unsigned width = this->width();
+	unsigned height = this->height();
 	m_bAllocated = false;
+	m_regionWidth = width;
+	m_regionHeight = height;
+	
+	m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	if(m_layout == FRAMEBUFFER_LAYOUT_TILED) m_pixels = (size_t) m_tilesX * m_tilesY * TILE_SIZE * TILE_SIZE;
+	else m_pixels = (size_t) width * height;
+	
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8:
+			if(color == NULL){
+				m_rgba8.resize(m_pixels * 4);
+				color = &m_rgba8[0];
+			}
+			m_color8 = color;
+			break;
+		case COLOR_FORMAT_RGB10A2: m_rgb10a2.resize(m_pixels); break;
+		default:
+		case COLOR_FORMAT_FLOAT:
+			if(m_layout == FRAMEBUFFER_LAYOUT_TILED){
+				m_rgba32f.resize(m_pixels * 4);
+				m_float = &m_rgba32f[0];
+			}
+			else m_float = m_raster->head();
+			break;
+	}
+	m_cleared.resize((size_t) m_tilesX * m_tilesY, 0);
+	m_written.resize(m_cleared.size(), 1);
+	
+	switch(m_depthFormat){
+		case DEPTH_FORMAT_24: m_depth24.resize(m_pixels); break;
+		case DEPTH_FORMAT_16: m_depth16.resize(m_pixels); break;
+		default:
+		case DEPTH_FORMAT_32F: m_depth32f.resize(m_pixels); break;
+	}
 }
 
 FrameBuffer::~FrameBuffer()
@@ -21,48 +79,407 @@ void FrameBuffer::init()
 	allocateGLTexture();
 }
 
-float FrameBuffer::getZ(const int x, const int y) const
+cg::vecmath::Color3f FrameBuffer::getColor(const int x, const int y) const
 {
-	if(m_raster==NULL) return 0;
-	
-	// TODO: this requires bounds checking on the channels
-	float* pixel = (*m_raster).pixel(x,y);
-	float z = pixel[3];
+	if(m_cleared[tile(x, y)]) return m_clearStoredColor;
 	
-	return z;
+	size_t i = index(x, y);
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8:{
+			const unsigned char* pixel = m_color8 + i * 4;
+			return cg::vecmath::Color3f(pixel[0] / 255.0f, pixel[1] / 255.0f, pixel[2] / 255.0f);
+		}
+		case COLOR_FORMAT_RGB10A2:{
+			uint32_t pixel = m_rgb10a2[i];
+			return cg::vecmath::Color3f((pixel & 1023) / 1023.0f, ((pixel >> 10) & 1023) / 1023.0f, ((pixel >> 20) & 1023) / 1023.0f);
+		}
+		default:
+		case COLOR_FORMAT_FLOAT:{
+			const float* pixel = m_float + i * 4;
+			return cg::vecmath::Color3f(pixel[0], pixel[1], pixel[2]);
+		}
+	}
+}
+
+void FrameBuffer::unpackRow(const void* color, color_format format, size_t first, unsigned count, unsigned char* out)
+{
+	switch(format){
+		case COLOR_FORMAT_RGBA8:{
+			const unsigned char* pixel = (const unsigned char*) color + first * 4;
+			for(unsigned x = 0; x < count; x++, pixel += 4, out += 3){
+				out[0] = pixel[0];
+				out[1] = pixel[1];
+				out[2] = pixel[2];
+			}
+			break;
+		}
+		case COLOR_FORMAT_RGB10A2:{
+			const uint32_t* pixel = (const uint32_t*) color + first;
+			for(unsigned x = 0; x < count; x++, pixel++, out += 3){
+				out[0] = (unsigned char) ((*pixel & 1023) >> 2);
+				out[1] = (unsigned char) (((*pixel >> 10) & 1023) >> 2);
+				out[2] = (unsigned char) (((*pixel >> 20) & 1023) >> 2);
+			}
+			break;
+		}
+		case COLOR_FORMAT_FLOAT:{
+			const float* pixel = (const float*) color + first * 4;
+			for(unsigned x = 0; x < count; x++, pixel += 4, out += 3){
+				for(int c = 0; c < 3; c++) out[c] = (unsigned char) channel(pixel[c], 255.0f);
+			}
+			break;
+		}
+		default:
+			throw "Unknown color format.";
+	}
 }
 
-void FrameBuffer::set(int ix, int iy, float r, float g, float b, float z)
+cg::vecmath::Color3f FrameBuffer::sample(const float u, const float v) const
 {
-	if(m_raster==NULL) return;
+	// texel centers are at (i + 0.5) / size, the taps are clamped to the region
+	float fx = std::max(0.0f, std::min(u * m_regionWidth - 0.5f, (float) (m_regionWidth - 1)));
+	float fy = std::max(0.0f, std::min(v * m_regionHeight - 0.5f, (float) (m_regionHeight - 1)));
+	int x0 = (int) fx, y0 = (int) fy;
+	int x1 = std::min(x0 + 1, (int) m_regionWidth - 1);
+	int y1 = std::min(y0 + 1, (int) m_regionHeight - 1);
+	float ax = fx - x0, ay = fy - y0;
 	
-	size_t offset = (iy * this->width() + ix) * 4;
-	(*this->m_raster).at(offset) = r;
-	(*this->m_raster).at(offset+1) = g;
-	(*this->m_raster).at(offset+2) = b;
-	(*this->m_raster).at(offset+3) = z;
+	cg::vecmath::Color3f bottom = getColor(x0, y0) * (1.0f - ax) + getColor(x1, y0) * ax;
+	cg::vecmath::Color3f top = getColor(x0, y1) * (1.0f - ax) + getColor(x1, y1) * ax;
+	return bottom * (1.0f - ay) + top * ay;
 }
 
 void FrameBuffer::clear(float r, float g, float b, float z)
 {
-	if(m_raster==NULL) return;
+	m_clearColor = cg::vecmath::Color3f(r, g, b);
+	m_clearZ = z;
+	
+	// the values seen through the accessors until a tile is written
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8:
+			m_clearStoredColor = cg::vecmath::Color3f(channel(r, 255.0f) / 255.0f, channel(g, 255.0f) / 255.0f, channel(b, 255.0f) / 255.0f);
+			break;
+		case COLOR_FORMAT_RGB10A2:
+			m_clearStoredColor = cg::vecmath::Color3f(channel(r, 1023.0f) / 1023.0f, channel(g, 1023.0f) / 1023.0f, channel(b, 1023.0f) / 1023.0f);
+			break;
+		default:
+		case COLOR_FORMAT_FLOAT:
+			m_clearStoredColor = m_clearColor;
+			break;
+	}
+	switch(m_depthFormat){
+		case DEPTH_FORMAT_24:
+			m_clearDepthBits = unorm(z, 16777215.0f);
+			m_clearStoredZ = m_clearDepthBits * (2.0f / 16777215.0f) - 1.0f;
+			break;
+		case DEPTH_FORMAT_16:
+			m_clearDepthBits = unorm(z, 65535.0f);
+			m_clearStoredZ = m_clearDepthBits * (2.0f / 65535.0f) - 1.0f;
+			break;
+		default:
+		case DEPTH_FORMAT_32F:
+			m_clearStoredZ = z;
+			break;
+	}
+	
+	std::fill(m_cleared.begin(), m_cleared.end(), 1);
+	std::fill(m_written.begin(), m_written.end(), 0);
+	m_clearedTiles = m_cleared.size();
+}
+
+/**
+ * Mixes 8 bytes into a hash.
+ */
+static inline uint64_t mix(uint64_t hash, uint64_t word)
+{
+	hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+	return hash ^ (hash >> 29);
+}
+
+/**
+ * Hashes a run of bytes, 8 at a time.
+ */
+static inline uint64_t mix(uint64_t hash, const unsigned char* bytes, size_t count)
+{
+	uint64_t word;
+	for(; count >= 8; count -= 8, bytes += 8){
+		memcpy(&word, bytes, 8);
+		hash = mix(hash, word);
+	}
+	if(count > 0){
+		word = 0;
+		memcpy(&word, bytes, count);
+		hash = mix(hash, word);
+	}
+	return hash;
+}
+
+uint64_t FrameBuffer::tileSignature(size_t tile) const
+{
+	if(!m_written[tile]){
+		// the tile holds the clear color, whether it was materialized or not
+		uint32_t bits[3];
+		memcpy(bits, &m_clearStoredColor.x, sizeof(float));
+		memcpy(bits + 1, &m_clearStoredColor.y, sizeof(float));
+		memcpy(bits + 2, &m_clearStoredColor.z, sizeof(float));
+		return mix(mix(mix(0x636c656172ull, bits[0]), bits[1]), bits[2]);
+	}
+	
+	const unsigned char* plane;
+	size_t pixelSize;
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8: plane = m_color8; pixelSize = 4; break;
+		case COLOR_FORMAT_RGB10A2: plane = (const unsigned char*) &m_rgb10a2[0]; pixelSize = 4; break;
+		default:
+		case COLOR_FORMAT_FLOAT: plane = (const unsigned char*) m_float; pixelSize = 4 * sizeof(float); break;
+	}
+	
+	uint64_t hash = 0x7772697474656eull;
+	if(m_layout == FRAMEBUFFER_LAYOUT_TILED){
+		// the pixels of a tile are contiguous
+		return mix(hash, plane + tile * TILE_SIZE * TILE_SIZE * pixelSize, TILE_SIZE * TILE_SIZE * pixelSize);
+	}
 	
-	unsigned int w = this->width();
-	unsigned int h = this->height();
+	unsigned w = this->width();
+	unsigned x0 = (unsigned) (tile % m_tilesX) * TILE_SIZE;
+	unsigned y0 = (unsigned) (tile / m_tilesX) * TILE_SIZE;
+	unsigned x1 = std::min<unsigned>(x0 + TILE_SIZE, w);
+	unsigned y1 = std::min<unsigned>(y0 + TILE_SIZE, this->height());
+	for(unsigned y = y0; y < y1; y++){
+		hash = mix(hash, plane + index(x0, y) * pixelSize, (x1 - x0) * pixelSize);
+	}
+	return hash;
+}
 
-	for (unsigned i = 0; i < this->height(); i++) {
-		for (unsigned j = 0; j < this->width(); j++) {
-			size_t offset = (i*w+j)*4;
-			(*this->m_raster)[offset + 0] = r;
-			(*this->m_raster)[offset + 1] = g;
-			(*this->m_raster)[offset + 2] = b;
-			(*this->m_raster)[offset + 3] = z;
+void FrameBuffer::materialize(size_t tile)
+{
+	float r = m_clearColor.x, g = m_clearColor.y, b = m_clearColor.z;
+	
+	if(m_layout == FRAMEBUFFER_LAYOUT_TILED){
+		// the pixels of a tile are contiguous
+		size_t first = tile * TILE_SIZE * TILE_SIZE;
+		for(size_t i = first; i < first + TILE_SIZE * TILE_SIZE; i++){
+			writeColor(i, r, g, b);
+			writeDepth(i, m_clearZ);
+		}
+	}
+	else{
+		unsigned w = this->width();
+		unsigned x0 = (unsigned) (tile % m_tilesX) * TILE_SIZE;
+		unsigned y0 = (unsigned) (tile / m_tilesX) * TILE_SIZE;
+		unsigned x1 = std::min<unsigned>(x0 + TILE_SIZE, w);
+		unsigned y1 = std::min<unsigned>(y0 + TILE_SIZE, this->height());
+		for(unsigned y = y0; y < y1; y++){
+			size_t first = index(x0, y);
+			for(size_t i = first; i < first + (x1 - x0); i++){
+				writeColor(i, r, g, b);
+				writeDepth(i, m_clearZ);
+			}
+		}
+	}
+	
+	m_cleared[tile] = 0;
+	m_clearedTiles--;
+}
+
+void FrameBuffer::materializeAll() const
+{
+	if(m_clearedTiles == 0) return;
+	
+	FrameBuffer* self = const_cast<FrameBuffer*>(this);
+	for(size_t t = 0; t < m_cleared.size(); t++){
+		if(m_cleared[t]) self->materialize(t);
+	}
+}
+
+const void* FrameBuffer::getColorData() const
+{
+	materializeAll();
+	
+	const unsigned char* plane;
+	size_t pixelSize;
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8: plane = m_color8; pixelSize = 4; break;
+		case COLOR_FORMAT_RGB10A2: plane = m_rgb10a2.empty() ? NULL : (const unsigned char*) &m_rgb10a2[0]; pixelSize = 4; break;
+		default:
+		case COLOR_FORMAT_FLOAT: plane = (const unsigned char*) m_float; pixelSize = 4 * sizeof(float); break;
+	}
+	if(plane == NULL) return plane;
+	
+	if(m_layout != FRAMEBUFFER_LAYOUT_LINEAR){
+		m_linearColor.resize((size_t) this->width() * this->height() * pixelSize);
+		linearize(plane, &m_linearColor[0], pixelSize);
+		plane = &m_linearColor[0];
+	}
+	if(m_regionWidth == (unsigned) this->width() && m_regionHeight == (unsigned) this->height()) return plane;
+	
+	m_scaledColor.resize((size_t) this->width() * this->height() * pixelSize);
+	upscale(plane, &m_scaledColor[0]);
+	return &m_scaledColor[0];
+}
+
+void FrameBuffer::setRegion(unsigned width, unsigned height)
+{
+	m_regionWidth = std::max(1u, std::min(width, (unsigned) this->width()));
+	m_regionHeight = std::max(1u, std::min(height, (unsigned) this->height()));
+}
+
+/**
+ * The source pixels and the weight (in 1/256) of the second one, for each pixel
+ * of an upscaled row or column.
+ */
+struct UpscaleTaps {
+	std::vector<unsigned> first;
+	std::vector<unsigned> second;
+	std::vector<unsigned> weight;
+	
+	UpscaleTaps(unsigned size, unsigned region) : first(size), second(size), weight(size)
+	{
+		float scale = (float) region / (float) size;
+		for(unsigned i = 0; i < size; i++){
+			// sample at the pixel centers
+			float u = (i + 0.5f) * scale - 0.5f;
+			u = std::max(0.0f, std::min(u, (float) (region - 1)));
+			first[i] = (unsigned) u;
+			second[i] = std::min(first[i] + 1, region - 1);
+			weight[i] = (unsigned) ((u - first[i]) * 256.0f + 0.5f);
+		}
+	}
+};
+
+void FrameBuffer::upscale(const unsigned char* src, unsigned char* dst) const
+{
+	unsigned w = this->width();
+	unsigned h = this->height();
+	UpscaleTaps columns(w, m_regionWidth);
+	UpscaleTaps rows(h, m_regionHeight);
+	
+	for(unsigned y = 0; y < h; y++){
+		size_t row0 = (size_t) rows.first[y] * w;
+		size_t row1 = (size_t) rows.second[y] * w;
+		unsigned fy = rows.weight[y];
+		size_t out = (size_t) y * w;
+		
+		switch(m_colorFormat){
+			case COLOR_FORMAT_RGBA8:
+				for(unsigned x = 0; x < w; x++){
+					const unsigned char* p00 = src + (row0 + columns.first[x]) * 4;
+					const unsigned char* p10 = src + (row0 + columns.second[x]) * 4;
+					const unsigned char* p01 = src + (row1 + columns.first[x]) * 4;
+					const unsigned char* p11 = src + (row1 + columns.second[x]) * 4;
+					unsigned fx = columns.weight[x];
+					unsigned char* pixel = dst + (out + x) * 4;
+					for(int c = 0; c < 4; c++){
+						unsigned bottom = p00[c] * (256 - fx) + p10[c] * fx;
+						unsigned top = p01[c] * (256 - fx) + p11[c] * fx;
+						pixel[c] = (unsigned char) ((bottom * (256 - fy) + top * fy + 32768) >> 16);
+					}
+				}
+				break;
+			case COLOR_FORMAT_RGB10A2:{
+				const uint32_t* plane = (const uint32_t*) src;
+				uint32_t* pixels = (uint32_t*) dst;
+				for(unsigned x = 0; x < w; x++){
+					uint32_t p00 = plane[row0 + columns.first[x]];
+					uint32_t p10 = plane[row0 + columns.second[x]];
+					uint32_t p01 = plane[row1 + columns.first[x]];
+					uint32_t p11 = plane[row1 + columns.second[x]];
+					unsigned fx = columns.weight[x];
+					uint32_t pixel = 3u << 30;
+					for(int shift = 0; shift < 30; shift += 10){
+						unsigned bottom = ((p00 >> shift) & 1023) * (256 - fx) + ((p10 >> shift) & 1023) * fx;
+						unsigned top = ((p01 >> shift) & 1023) * (256 - fx) + ((p11 >> shift) & 1023) * fx;
+						pixel |= (uint32_t) ((bottom * (256 - fy) + top * fy + 32768) >> 16) << shift;
+					}
+					pixels[out + x] = pixel;
+				}
+				break;
+			}
+			default:
+			case COLOR_FORMAT_FLOAT:{
+				const float* plane = (const float*) src;
+				float* pixels = (float*) dst;
+				float wy = fy / 256.0f;
+				for(unsigned x = 0; x < w; x++){
+					const float* p00 = plane + (row0 + columns.first[x]) * 4;
+					const float* p10 = plane + (row0 + columns.second[x]) * 4;
+					const float* p01 = plane + (row1 + columns.first[x]) * 4;
+					const float* p11 = plane + (row1 + columns.second[x]) * 4;
+					float wx = columns.weight[x] / 256.0f;
+					float* pixel = pixels + (out + x) * 4;
+					for(int c = 0; c < 4; c++){
+						float bottom = p00[c] + (p10[c] - p00[c]) * wx;
+						float top = p01[c] + (p11[c] - p01[c]) * wx;
+						pixel[c] = bottom + (top - bottom) * wy;
+					}
+				}
+				break;
+			}
+		}
+	}
+}
+
+const void* FrameBuffer::getDepthData() const
+{
+	materializeAll();
+	
+	const unsigned char* plane;
+	size_t pixelSize;
+	switch(m_depthFormat){
+		case DEPTH_FORMAT_24: plane = m_depth24.empty() ? NULL : (const unsigned char*) &m_depth24[0]; pixelSize = sizeof(uint32_t); break;
+		case DEPTH_FORMAT_16: plane = m_depth16.empty() ? NULL : (const unsigned char*) &m_depth16[0]; pixelSize = sizeof(uint16_t); break;
+		default:
+		case DEPTH_FORMAT_32F: plane = m_depth32f.empty() ? NULL : (const unsigned char*) &m_depth32f[0]; pixelSize = sizeof(float); break;
+	}
+	if(m_layout == FRAMEBUFFER_LAYOUT_LINEAR || plane == NULL) return plane;
+	
+	m_linearDepth.resize((size_t) this->width() * this->height() * pixelSize);
+	linearize(plane, &m_linearDepth[0], pixelSize);
+	return &m_linearDepth[0];
+}
+
+void FrameBuffer::linearize(const unsigned char* src, unsigned char* dst, size_t pixelSize) const
+{
+	unsigned w = this->width();
+	unsigned h = this->height();
+	if(m_layout == FRAMEBUFFER_LAYOUT_TOP_DOWN){
+		size_t rowBytes = (size_t) w * pixelSize;
+		for(unsigned y = 0; y < h; y++) memcpy(dst + (size_t) y * rowBytes, src + (size_t) (h - 1 - y) * rowBytes, rowBytes);
+		return;
+	}
+	
+	size_t tileBytes = TILE_SIZE * TILE_SIZE * pixelSize;
+	
+	// the offsets of the pixels of a tile row, relative to the start of the tile
+	size_t offsets[TILE_SIZE * TILE_SIZE];
+	for(int y = 0; y < TILE_SIZE; y++){
+		for(int x = 0; x < TILE_SIZE; x++) offsets[y * TILE_SIZE + x] = morton(x, y) * pixelSize;
+	}
+	
+	for(unsigned ty = 0; ty < m_tilesY; ty++){
+		for(unsigned tx = 0; tx < m_tilesX; tx++){
+			const unsigned char* tile = src + ((size_t) ty * m_tilesX + tx) * tileBytes;
+			unsigned x0 = tx * TILE_SIZE;
+			unsigned y0 = ty * TILE_SIZE;
+			unsigned columns = std::min<unsigned>(TILE_SIZE, w - x0);
+			unsigned rows = std::min<unsigned>(TILE_SIZE, h - y0);
+			
+			for(unsigned y = 0; y < rows; y++){
+				unsigned char* row = dst + ((size_t) (y0 + y) * w + x0) * pixelSize;
+				const size_t* offset = offsets + y * TILE_SIZE;
+				
+				// pairs of horizontal neighbours are adjacent in Morton order
+				unsigned x = 0;
+				for(; x + 1 < columns; x += 2) memcpy(row + x * pixelSize, tile + offset[x], 2 * pixelSize);
+				if(x < columns) memcpy(row + x * pixelSize, tile + offset[x], pixelSize);
+			}
 		}
 	}
 }
 
 void FrameBuffer::allocateGLTexture()
 {	
+#ifndef PIXELPIPE_HEADLESS
 	if(!this->m_bAllocated){
 		glGenTextures(1, &(this->m_textureHandle));
 		glBindTexture(GL_TEXTURE_2D, this->m_textureHandle);
@@ -70,23 +487,41 @@ void FrameBuffer::allocateGLTexture()
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		this->m_bAllocated = true;
 	}
+#endif
 }
 void FrameBuffer::deallocateGLTexture()
 {	
+#ifndef PIXELPIPE_HEADLESS
 	if(!this->m_bAllocated){
 		glDeleteTextures(1, &(this->m_textureHandle));
 		this->m_bAllocated = false;
 	}
+#endif
 }
 
-void FrameBuffer::drawGLTexture(float x, float y) const 
+void FrameBuffer::drawGLTexture(const void* color, float x, float y) const 
 {
+#ifndef PIXELPIPE_HEADLESS
 	// Draw the texture using OpenGL
 	unsigned w = this->width();
 	unsigned h = this->height();
 	glEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, this->m_textureHandle);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGBA, GL_FLOAT, this->m_raster->head());
+	switch(m_colorFormat){
+		case COLOR_FORMAT_RGBA8:
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+			break;
+		case COLOR_FORMAT_RGB10A2:
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, w, h, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, color);
+			break;
+		default:
+		case COLOR_FORMAT_FLOAT:
+			// quantize on the CPU, a quarter of the float data is uploaded in the native BGRA order
+			m_display.resize((size_t) w * h * 4);
+			PixelConverter(CHANNEL_ORDER_BGRA).convert((const float*) color, 4, w, h, &m_display[0]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, w, h, 0, GL_BGRA, GL_UNSIGNED_BYTE, &m_display[0]);
+			break;
+	}
 	
 	glBegin(GL_QUADS);
 	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
@@ -97,6 +532,7 @@ void FrameBuffer::drawGLTexture(float x, float y) const
 	glEnd();
 	
 	glDisable(GL_TEXTURE_2D);
+#endif
 }
 
 }
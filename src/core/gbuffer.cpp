@@ -0,0 +1,111 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "core/gbuffer.h"
+#include "core/state.h"
+#include "core/fastmath.h"
+
+using namespace cg::vecmath;
+
+namespace pixelpipe {
+
+GBuffer::GBuffer(const unsigned width, const unsigned height)
+{
+	m_width = width;
+	m_height = height;
+	
+	size_t n = (size_t) width * height;
+	m_depth = new float[n];
+	m_normal = new float[3 * n];
+	m_albedo = new float[3 * n];
+	m_uv = new float[2 * n];
+	
+	clear();
+}
+
+GBuffer::~GBuffer()
+{
+	delete [] m_depth;
+	delete [] m_normal;
+	delete [] m_albedo;
+	delete [] m_uv;
+}
+
+void GBuffer::clear()
+{
+	// the other channels are only read where a fragment was stored
+	size_t n = (size_t) m_width * m_height;
+	for(size_t i = 0; i < n; i++){
+		m_depth[i] = 1.0f;
+	}
+}
+
+void GBuffer::shade(FrameBuffer& fb, const Matrix4f& screenToEye, bool texturedAmbient) const
+{
+	State* state = State::getInstance();
+	math_precision precision = state->getMathPrecision();
+	std::vector<PointLight>& lights = state->getLights();
+	const Color3f& specularColor = state->getSpecularColor();
+	float ambient = state->getAmbientIntensity();
+	
+	Vector3f normal, position, viewVector, lightVector, halfVector;
+	Color3f outColor;
+	
+	for(unsigned y = 0; y < m_height; y++){
+		for(unsigned x = 0; x < m_width; x++){
+			size_t i = y * m_width + x;
+			float z = m_depth[i];
+			if(z >= 1.0f) continue;
+			
+			// reconstruct the eye space position of the fragment
+			Vector4f screen((float) x, (float) y, z, 1.0f);
+			Vector4f eye = screenToEye * screen;
+			float invW = 1.0f / eye.w;
+			position.set(eye.x * invW, eye.y * invW, eye.z * invW);
+			
+			normal.set(m_normal[3*i], m_normal[3*i+1], m_normal[3*i+2]);
+			FastMath::normalize(normal, precision);
+			
+			viewVector.set(-position.x, -position.y, -position.z);
+			FastMath::normalize(viewVector, precision);
+			
+			const float* albedo = m_albedo + 3*i;
+			outColor.set(0.0f, 0.0f, 0.0f);
+			for(unsigned l = 0; l < lights.size(); l++){
+				lightVector = lights[l].getPosition();
+				lightVector = lightVector - position;
+				FastMath::normalize(lightVector, precision);
+				
+				halfVector = viewVector;
+				halfVector += lightVector;
+				FastMath::normalize(halfVector, precision);
+				
+				float nDotL = dot(normal, lightVector);
+				float nDotH = dot(normal, halfVector);
+				
+				const Color3f& intensity = lights[l].getIntensity();
+				outColor.x += albedo[0] * nDotL * intensity.x;
+				outColor.y += albedo[1] * nDotL * intensity.y;
+				outColor.z += albedo[2] * nDotL * intensity.z;
+				
+				float specularIntensity = state->specular(nDotH);
+				if(specularIntensity < 0.0f) specularIntensity = 0.0f;
+				else if(specularIntensity > 1.0f) specularIntensity = 1.0f;
+				
+				outColor.x += specularColor.x * specularIntensity;
+				outColor.y += specularColor.y * specularIntensity;
+				outColor.z += specularColor.z * specularIntensity;
+			}
+			
+			//clamp colors and add ambient
+			outColor.x = std::max(outColor.x, 0.0f) + ambient * (texturedAmbient ? albedo[0] : 1.0f);
+			outColor.y = std::max(outColor.y, 0.0f) + ambient * (texturedAmbient ? albedo[1] : 1.0f);
+			outColor.z = std::max(outColor.z, 0.0f) + ambient * (texturedAmbient ? albedo[2] : 1.0f);
+			
+			fb.set(x, y, std::min(outColor.x, 1.0f), std::min(outColor.y, 1.0f), std::min(outColor.z, 1.0f), z);
+		}
+	}
+}
+
+}	// namespace pixelpipe
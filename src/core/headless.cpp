@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "core/headless.h"
+#include "core/pointlight.h"
+#include "core/pixel_converter.h"
+#include "fragment/frag_bytecode.h"
+
+using namespace cg::vecmath;
+
+namespace pixelpipe {
+
+HeadlessRenderer::HeadlessRenderer(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+	// the same view as PixelPipeWindow
+	float near = 1.0;
+	float far = 1000.0;
+	float ht = 0.6;
+	m_camera = new Camera(Vector3f(3.0, 3.0, 3.0), Vector3f(0.0, 0.0, 0.0), Vector3f(0.0, 1.0, 0.0), near, far, ht);
+	m_camera->setAspect((float) m_width / (float) m_height);
+
+	m_state = State::getInstance();
+	m_state->getLights().push_back(PointLight(Vector3f(-2.0, -2.0, 0), Color3f(1.0, 0.5, 0.5)));
+	m_state->getLights().push_back(PointLight(Vector3f(2.0, 2.0, 0), Color3f(0.5, 0.5, 1.0)));
+
+	m_sceneType = SCENE_CUBE;
+	m_scene = NULL;
+	m_deferredShading = false;
+	m_visibilityBuffer = false;
+	m_drawOrder = DRAW_ORDER_SUBMISSION;
+	m_colorFormat = COLOR_FORMAT_RGBA8;
+	m_depthFormat = DEPTH_FORMAT_32F;
+	m_framebufferLayout = FRAMEBUFFER_LAYOUT_LINEAR;
+	m_frameCount = 1;
+	m_outputEncoding = COLOR_ENCODING_LINEAR;
+	m_outputDither = false;
+	m_frameBudget = 0;
+	m_resolution = NULL;
+	m_mappedImage = NULL;
+	m_mappedFrame = NULL;
+	m_mappedUnit = SoftwarePipeline::DEFAULT_FRAMEBUFFER;
+
+	m_pipeline = new SoftwarePipeline(m_width, m_height);
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+	delete m_scene;
+	delete m_pipeline;
+	delete m_camera;
+	delete m_resolution;
+	delete m_mappedImage;	// after the pipeline, which owns the framebuffer over it
+	for(unsigned i = 0; i < m_textures.size(); i++) delete m_textures[i];
+}
+
+void HeadlessRenderer::addTexture(const std::string& filename)
+{
+	m_textures.push_back(new Texture(filename));
+}
+
+void HeadlessRenderer::init()
+{
+	m_pipeline->setFrameBufferFormat(m_colorFormat, m_depthFormat, m_framebufferLayout);
+	m_pipeline->setFrameCount(m_frameCount);
+	m_pipeline->init();
+	if(m_frameBudget > 0) m_resolution = new ResolutionController(m_frameBudget);
+	if(!m_mappedFile.empty()){
+		m_mappedImage = new MappedImage(m_mappedFile, m_width, m_height);
+		m_mappedFrame = new FrameBuffer(m_width, m_height, m_mappedImage->pixels(), m_depthFormat);
+		m_mappedUnit = m_pipeline->attachFrameBuffer(m_mappedFrame);
+	}
+
+	switch(m_sceneType){
+		case SCENE_SPHERES: m_scene = new SceneSpheres(*m_pipeline); break;
+		case SCENE_SPHERE_PLANE: m_scene = new SceneSpherePlane(*m_pipeline); break;
+		default:
+		case SCENE_CUBE: m_scene = new SceneCube(*m_pipeline); break;
+	}
+
+	m_state->enableLighting(true);
+	m_state->enableDepthTest(true);
+	m_state->enableTexturing2D(!m_textures.empty());
+	if(!m_textures.empty()){
+		// the scenes use up to two textures
+		m_scene->setTexture(m_textures.at(0), 0);
+		m_scene->setTexture(m_textures.at(m_textures.size() > 1 ? 1 : 0), 1);
+	}
+
+	m_pipeline->enableDeferredShading(m_deferredShading);
+	m_pipeline->enableVisibilityBuffer(m_visibilityBuffer);
+	m_pipeline->setDrawOrder(m_drawOrder);
+	if(!m_fragmentProgram.empty()) m_pipeline->setFragmentProgram(ShaderBytecode::load(m_fragmentProgram));
+	m_pipeline->configure();
+
+	m_scene->init();
+}
+
+void HeadlessRenderer::render()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	float ht = m_camera->getHt();
+	float aspect = m_camera->getAspectRatio();
+	if(m_mappedImage){
+		m_pipeline->bindFrameBuffer(m_mappedUnit);
+		renderView(-ht * aspect, ht * aspect, -ht, ht, m_width, m_height);
+		m_pipeline->bindFrameBuffer(SoftwarePipeline::DEFAULT_FRAMEBUFFER);
+
+		// the tiles left as cleared only exist as flags
+		m_mappedFrame->flush();
+	}
+	else{
+		renderView(-ht * aspect, ht * aspect, -ht, ht, m_width, m_height);
+
+		// without a window this only hands the frame to the frame consumer
+		m_pipeline->drawFrameBuffer();
+	}
+
+	if(m_resolution){
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		m_pipeline->setRenderScale(m_resolution->update(elapsed.count()));
+	}
+}
+
+void HeadlessRenderer::renderView(float left, float right, float bottom, float top, int width, int height)
+{
+	m_pipeline->clearFrameBuffer();
+
+	m_pipeline->setMatrixMode(MATRIX_PROJECTION);
+	m_pipeline->loadIdentity();
+	m_pipeline->frustum(left, right, bottom, top, m_camera->getNear(), m_camera->getFar());
+	m_pipeline->viewport(0, 0, width, height);
+
+	m_pipeline->setMatrixMode(MATRIX_MODELVIEW);
+	m_pipeline->loadIdentity();
+	m_pipeline->lookAt(m_camera->getEye(), m_camera->getTarget(), m_camera->getUp());
+
+	if(m_state->getZPrepass()){
+		m_pipeline->setRenderPass(RENDER_PASS_DEPTH);
+		m_pipeline->pushMatrix();
+		m_scene->render();
+		m_pipeline->popMatrix();
+
+		m_pipeline->setRenderPass(RENDER_PASS_SHADE);
+		m_pipeline->pushMatrix();
+		m_scene->render();
+		m_pipeline->popMatrix();
+
+		m_pipeline->setRenderPass(RENDER_PASS_FORWARD);
+	}
+	else{
+		m_scene->render();
+	}
+}
+
+void HeadlessRenderer::renderBands(const std::string& filename, unsigned width, unsigned height)
+{
+	if(width == 0 || height == 0) throw "Invalid image size.";
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if(file == NULL) throw "Unable to open the output image.";
+
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+	// the frustum of the whole image, with the aspect ratio of the image
+	float ht = m_camera->getHt();
+	float wt = ht * width / height;
+	float pixelWidth = 2.0f * wt / width;
+	float pixelHeight = 2.0f * ht / height;
+
+	float scale = m_pipeline->getRenderScale();
+	m_pipeline->setRenderScale(1.0f);
+
+	PixelConverter converter(CHANNEL_ORDER_RGB, m_outputEncoding, m_outputDither);
+	std::vector<unsigned char> band((size_t) width * m_height * 3);
+	for(unsigned top = 0; top < height; top += m_height){
+		unsigned rows = std::min((unsigned) m_height, height - top);
+		unsigned bottom = height - top - rows;
+
+		for(unsigned left = 0; left < width; left += m_width){
+			unsigned columns = std::min((unsigned) m_width, width - left);
+			renderView(-wt + left * pixelWidth, -wt + (left + columns) * pixelWidth,
+				-ht + bottom * pixelHeight, -ht + (bottom + rows) * pixelHeight, columns, rows);
+			m_pipeline->drawFrameBuffer();
+			const void* color = this->getFrameData();
+
+			// the framebuffer rows go from bottom to top
+			for(unsigned y = 0; y < rows; y++){
+				size_t first = (size_t) (rows - 1 - y) * m_width;
+				unsigned char* out = &band[((size_t) y * width + left) * 3];
+				if(m_colorFormat == COLOR_FORMAT_FLOAT) converter.convertRow((const float*) color + first * 4, 4, columns, top + y, out);
+				else FrameBuffer::unpackRow(color, m_colorFormat, first, columns, out);
+			}
+		}
+		fwrite(&band[0], 1, (size_t) width * rows * 3, file);
+	}
+
+	m_pipeline->setRenderScale(scale);
+	fclose(file);
+}
+
+const void* HeadlessRenderer::getFrameData()
+{
+	m_pipeline->finishFrames();
+	return m_pipeline->getFrameData();
+}
+
+void HeadlessRenderer::write(const std::string& filename)
+{
+	const void* color = this->getFrameData();
+	if(color == NULL) throw "No frame was rendered.";
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if(file == NULL) throw "Unable to open the output image.";
+
+	fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+
+	if(m_colorFormat == COLOR_FORMAT_FLOAT){
+		std::vector<unsigned char> image((size_t) m_width * m_height * 3);
+		PixelConverter converter(CHANNEL_ORDER_RGB, m_outputEncoding, m_outputDither);
+		converter.convert((const float*) color, 4, m_width, m_height, &image[0], true);
+		fwrite(&image[0], 1, image.size(), file);
+		fclose(file);
+		return;
+	}
+
+	// the framebuffer rows go from bottom to top
+	std::vector<unsigned char> row(m_width * 3);
+	for(int y = m_height - 1; y >= 0; y--){
+		FrameBuffer::unpackRow(color, m_colorFormat, (size_t) y * m_width, m_width, &row[0]);
+		fwrite(&row[0], 1, row.size(), file);
+	}
+
+	fclose(file);
+}
+
+}	// namespace pixelpipe
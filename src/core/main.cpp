@@ -82,10 +82,25 @@ int main(int argc, char **argv)
 	image_size.push_back(800);
 	image_size.push_back(600);
 	std::string inputfile = "";
+	std::string fragmentProgram = "";
+	std::vector<float> shadingLOD;
+	bool deferredShading = false;
+	bool visibilityBuffer = false;
+	bool tiledFrameBuffer = false;
+	unsigned frameCount = 1;
+	float frameBudget = 0;
+	int textureFilter = pixelpipe::TEXTURE_FILTER_LINEAR;
+	int mipmapFilter = pixelpipe::MIPMAP_FILTER_BOX;
+	int textureStorage = pixelpipe::TEXTURE_STORAGE_NATIVE;
+	int textureLayout = pixelpipe::TEXTURE_LAYOUT_LINEAR;
+	int drawOrder = pixelpipe::DRAW_ORDER_SUBMISSION;
+	int colorFormat = pixelpipe::COLOR_FORMAT_RGBA8;
+	int depthFormat = pixelpipe::DEPTH_FORMAT_32F;
 	
 	pixelpipe::render_mode r_mode;
 	int pipeMode = pixelpipe::RENDER_SOFTWARE;
 	int loggerLevel;
+	int mathPrecision = pixelpipe::MATH_PRECISION_EXACT;
 	try {
 		po::options_description desc("Allowed options");
 		desc.add_options()
@@ -93,6 +108,23 @@ int main(int argc, char **argv)
 			("input-file,I", po::value<std::string>(&inputfile), "input scene file")
 			("image-size,S", po::value< std::vector<int> >(&image_size)->multitoken(), "[ X Y ]")
 			("pipeline-mode,m", po::value<int>(&pipeMode), "[ 0=software | 1=opengl ]")
+			("math-precision,P", po::value<int>(&mathPrecision), "[ 0=exact | 1=fast | 2=fastest ]")
+			("flat-shading,f", "light each triangle once (software mode, untextured)")
+			("shading-lod,L", po::value< std::vector<float> >(&shadingLOD)->multitoken(), "per-object shading by projected radius [ PHONG GOURAUD ] in pixels")
+			("deferred,D", "deferred shading through a G-buffer (software mode)")
+			("visibility-buffer,B", "shade each visible pixel once through a visibility buffer (software mode)")
+			("z-prepass,Z", "draw a depth only pass before shading with an equal depth test")
+			("draw-order,O", po::value<int>(&drawOrder), "[ 0=submission | 1=front to back | 2=state, texture, depth ] (software mode)")
+			("color-format,C", po::value<int>(&colorFormat), "[ 0=rgba8 | 1=rgb10a2 | 2=float ] framebuffer color (software mode)")
+			("depth-format,d", po::value<int>(&depthFormat), "[ 0=32 bit float | 1=24 bit | 2=16 bit ] framebuffer depth (software mode)")
+			("tiled-framebuffer,T", "store the framebuffer in 8x8 Morton ordered tiles (software mode)")
+			("frames,N", po::value<unsigned>(&frameCount), "number of framebuffers, more than 1 presents on a worker thread (software mode)")
+			("frame-budget,b", po::value<float>(&frameBudget), "frame time budget in ms, lowers the render resolution to hold it (software mode)")
+			("texture-filter,i", po::value<int>(&textureFilter), "[ 0=linear | 1=nearest mip level | 2=trilinear ] texture filter (software mode)")
+			("mipmap-filter,k", po::value<int>(&mipmapFilter), "[ 0=box | 1=kaiser ] filter of the mip levels (software mode)")
+			("texture-storage,u", po::value<int>(&textureStorage), "[ 0=as loaded | 1=8 bit | 2=rgb565 | 3=half float ] storage of the textures (software mode)")
+			("texture-layout,l", po::value<int>(&textureLayout), "[ 0=row major | 1=4x4 blocks | 2=8x8 blocks | 3=morton ] texel order of the compact textures (software mode)")
+			("fragment-program,F", po::value<std::string>(&fragmentProgram), "fragment program file (software mode)")
 			("verbose,V", po::value<int>(&loggerLevel)->default_value(1), "Verbose logging?");
 
         po::variables_map vm;
@@ -125,6 +157,42 @@ int main(int argc, char **argv)
 				break;
 		}
 		std::cout << "Pipeline mode: " << mode_str << std::endl;
+		
+		switch(mathPrecision){
+			case pixelpipe::MATH_PRECISION_FAST:
+				pixelpipe::State::getInstance()->setMathPrecision(pixelpipe::MATH_PRECISION_FAST);
+				break;
+			case pixelpipe::MATH_PRECISION_FASTEST:
+				pixelpipe::State::getInstance()->setMathPrecision(pixelpipe::MATH_PRECISION_FASTEST);
+				break;
+			default:
+			case pixelpipe::MATH_PRECISION_EXACT:
+				pixelpipe::State::getInstance()->setMathPrecision(pixelpipe::MATH_PRECISION_EXACT);
+				break;
+		}
+
+		if (vm.count("flat-shading")) {
+			pixelpipe::State::getInstance()->setShadeModel(pixelpipe::SHADE_FLAT);
+		}
+
+		if (vm.count("z-prepass")) {
+			pixelpipe::State::getInstance()->enableZPrepass(true);
+		}
+
+		pixelpipe::State::getInstance()->setTextureFilter((pixelpipe::texture_filter) textureFilter, (pixelpipe::mipmap_filter) mipmapFilter);
+		pixelpipe::State::getInstance()->setTextureStorage((pixelpipe::texture_storage) textureStorage);
+		pixelpipe::State::getInstance()->setTextureLayout((pixelpipe::texture_layout) textureLayout);
+
+		deferredShading = (vm.count("deferred") > 0);
+		visibilityBuffer = (vm.count("visibility-buffer") > 0);
+		tiledFrameBuffer = (vm.count("tiled-framebuffer") > 0);
+
+		if (vm.count("shading-lod")) {
+			pixelpipe::State::getInstance()->enableShadingLOD(true);
+			if (shadingLOD.size() >= 2) {
+				pixelpipe::State::getInstance()->setShadingLODThresholds(shadingLOD.at(0), shadingLOD.at(1));
+			}
+		}
 
 		std::string levelLabel = "";
 		if(loggerLevel >= 0){
@@ -154,6 +222,14 @@ int main(int argc, char **argv)
 
 	// start it up!
 	pixelpipe::PixelPipeWindow* app = new pixelpipe::PixelPipeWindow("PixelPipe", image_size.at(0), image_size.at(1), r_mode);
+	app->setFragmentProgram(fragmentProgram);
+	app->setDeferredShading(deferredShading);
+	app->setVisibilityBuffer(visibilityBuffer);
+	app->setDrawOrder((pixelpipe::draw_order) drawOrder);
+	app->setFrameBufferFormat((pixelpipe::color_format) colorFormat, (pixelpipe::depth_format) depthFormat,
+		tiledFrameBuffer ? pixelpipe::FRAMEBUFFER_LAYOUT_TILED : pixelpipe::FRAMEBUFFER_LAYOUT_LINEAR);
+	app->setFrameCount(frameCount);
+	app->setFrameTimeBudget(frameBudget);
 	app->init();
 	
 	return app->run();
@@ -0,0 +1,203 @@
+/**
+ * @file
+ * @author  Caleb Johnston <caleb.johnston@example.com>
+ * @version 0.125
+ *
+ * @section LICENSE
+ *
+ * Object-order rendering pipeline
+ * Copyright (C) 2018 by Caleb Johnston
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Offscreen renderer for machines without a display
+ */
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "core/headless.h"
+#include "core/frame_stream.h"
+#include "logger/logger.h"
+#include "logger/stdiowriter.h"
+
+#ifndef TARGET_VERSION_MAJOR
+#define TARGET_VERSION_MAJOR 99
+#endif
+
+#ifndef TARGET_VERSION_MINOR
+#define TARGET_VERSION_MINOR 99
+#endif
+
+/**
+ * Main function, process inputs
+ *
+ * @return integer status of the program of range [0,1]
+ */
+int main(int argc, char **argv)
+{
+	std::vector<int> image_size;
+	image_size.push_back(800);
+	image_size.push_back(600);
+	std::string outputfile = "pixelpipe.ppm";
+	std::string mappedfile = "";
+	std::string fragmentProgram = "";
+	std::vector<std::string> textures;
+	int scene = pixelpipe::HeadlessRenderer::SCENE_CUBE;
+	int frames = 1;
+	int drawOrder = pixelpipe::DRAW_ORDER_SUBMISSION;
+	int colorFormat = pixelpipe::COLOR_FORMAT_RGBA8;
+	int depthFormat = pixelpipe::DEPTH_FORMAT_32F;
+	unsigned frameCount = 1;
+	int mathPrecision = pixelpipe::MATH_PRECISION_EXACT;
+	std::string streamfile = "";
+	int streamFormat = pixelpipe::STREAM_FORMAT_Y4M;
+	int outputEncoding = pixelpipe::COLOR_ENCODING_LINEAR;
+	float frameBudget = 0;
+	int textureFilter = pixelpipe::TEXTURE_FILTER_LINEAR;
+	int mipmapFilter = pixelpipe::MIPMAP_FILTER_BOX;
+	int textureStorage = pixelpipe::TEXTURE_STORAGE_NATIVE;
+	int textureLayout = pixelpipe::TEXTURE_LAYOUT_LINEAR;
+	std::vector<unsigned> bandedSize;
+
+	po::variables_map vm;
+	try {
+		po::options_description desc("Allowed options");
+		desc.add_options()
+		    ("help,H", "produce help message")
+			("image-size,S", po::value< std::vector<int> >(&image_size)->multitoken(), "[ X Y ]")
+			("output,o", po::value<std::string>(&outputfile), "output image file (binary PPM), empty for none")
+			("mapped-output,M", po::value<std::string>(&mappedfile), "render straight into a memory mapped image file (PAM), instead of the output image")
+			("scene,s", po::value<int>(&scene), "[ 0=cube | 1=spheres | 2=sphere and plane ]")
+			("texture,t", po::value< std::vector<std::string> >(&textures)->multitoken(), "texture image files, enables texturing")
+			("texture-filter,i", po::value<int>(&textureFilter), "[ 0=linear | 1=nearest mip level | 2=trilinear ] texture filter")
+			("mipmap-filter,k", po::value<int>(&mipmapFilter), "[ 0=box | 1=kaiser ] filter of the mip levels")
+			("texture-storage,u", po::value<int>(&textureStorage), "[ 0=as loaded | 1=8 bit | 2=rgb565 | 3=half float ] storage of the textures")
+			("texture-layout,l", po::value<int>(&textureLayout), "[ 0=row major | 1=4x4 blocks | 2=8x8 blocks | 3=morton ] texel order of the compact textures")
+			("render-count,R", po::value<int>(&frames), "number of frames to render")
+			("math-precision,P", po::value<int>(&mathPrecision), "[ 0=exact | 1=fast | 2=fastest ]")
+			("flat-shading,f", "light each triangle once (untextured)")
+			("deferred,D", "deferred shading through a G-buffer")
+			("visibility-buffer,B", "shade each visible pixel once through a visibility buffer")
+			("z-prepass,Z", "draw a depth only pass before shading with an equal depth test")
+			("draw-order,O", po::value<int>(&drawOrder), "[ 0=submission | 1=front to back | 2=state, texture, depth ]")
+			("color-format,C", po::value<int>(&colorFormat), "[ 0=rgba8 | 1=rgb10a2 | 2=float ] framebuffer color")
+			("depth-format,d", po::value<int>(&depthFormat), "[ 0=32 bit float | 1=24 bit | 2=16 bit ] framebuffer depth")
+			("tiled-framebuffer,T", "store the framebuffer in 8x8 Morton ordered tiles")
+			("frames,N", po::value<unsigned>(&frameCount), "number of framebuffers, more than 1 resolves frames on a worker thread")
+			("banded,G", po::value< std::vector<unsigned> >(&bandedSize)->multitoken(), "[ X Y ] render one large image in tiles of the image size, streamed by bands to the output")
+			("frame-budget,b", po::value<float>(&frameBudget), "frame time budget in ms, lowers the render resolution to hold it")
+			("output-encoding,E", po::value<int>(&outputEncoding), "[ 0=linear | 1=sRGB table | 2=sRGB polynomial ] encoding of float framebuffers in the output image and stream")
+			("dither,Y", "dither float framebuffers in the output image and stream")
+			("stream,x", po::value<std::string>(&streamfile), "stream every frame to a file or FIFO, - for stdout")
+			("stream-format,X", po::value<int>(&streamFormat), "[ 0=y4m | 1=rgb | 2=yuv | 3=changed tiles ] format of the frame stream")
+			("fragment-program,F", po::value<std::string>(&fragmentProgram), "fragment program file");
+
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+
+		if (vm.count("help")) {
+			std::cout << "PixelPipe headless version " << TARGET_VERSION_MAJOR << "." << TARGET_VERSION_MINOR << " of " << __DATE__ << " at " << __TIME__ << std::endl;
+			std::cout << "Usage: pixelpipe-headless [options]\n";
+			std::cout << desc;
+			return 0;
+		}
+	}
+	catch(std::exception& e) {
+		std::cerr << " * error: " << e.what() << "\n";
+		return 1;
+	}
+
+	// frames streamed to stdout must not be mixed with any text
+	std::ostream& status = (streamfile == "-") ? std::cerr : std::cout;
+	status << "PixelPipe headless version " << TARGET_VERSION_MAJOR << "." << TARGET_VERSION_MINOR << " of " << __DATE__ << " at " << __TIME__ << std::endl;
+
+	pixelpipe::Logger::SetIdentity("PixelPipe");
+	if(streamfile != "-") pixelpipe::Logger::RegisterWriter(new pixelpipe::StdOutWriter());
+
+	pixelpipe::State* state = pixelpipe::State::getInstance();
+	state->setMathPrecision((pixelpipe::math_precision) mathPrecision);
+	if (vm.count("flat-shading")) state->setShadeModel(pixelpipe::SHADE_FLAT);
+	if (vm.count("z-prepass")) state->enableZPrepass(true);
+	state->setTextureFilter((pixelpipe::texture_filter) textureFilter, (pixelpipe::mipmap_filter) mipmapFilter);
+	state->setTextureStorage((pixelpipe::texture_storage) textureStorage);
+	state->setTextureLayout((pixelpipe::texture_layout) textureLayout);
+
+	pixelpipe::FrameStream* stream = NULL;
+	try {
+		if(!streamfile.empty()){
+			stream = new pixelpipe::FrameStream(streamfile, (pixelpipe::stream_format) streamFormat);
+			stream->setEncoding((pixelpipe::color_encoding) outputEncoding, vm.count("dither") > 0);
+		}
+
+		pixelpipe::HeadlessRenderer renderer(image_size.at(0), image_size.at(1));
+		renderer.setScene((pixelpipe::HeadlessRenderer::scene_type) scene);
+		for(unsigned i = 0; i < textures.size(); i++) renderer.addTexture(textures[i]);
+		renderer.setFragmentProgram(fragmentProgram);
+		renderer.setDeferredShading(vm.count("deferred") > 0);
+		renderer.setVisibilityBuffer(vm.count("visibility-buffer") > 0);
+		renderer.setDrawOrder((pixelpipe::draw_order) drawOrder);
+		renderer.setFrameBufferFormat((pixelpipe::color_format) colorFormat, (pixelpipe::depth_format) depthFormat,
+			vm.count("tiled-framebuffer") ? pixelpipe::FRAMEBUFFER_LAYOUT_TILED : pixelpipe::FRAMEBUFFER_LAYOUT_LINEAR);
+		renderer.setFrameCount(frameCount);
+		renderer.setFrameTimeBudget(frameBudget);
+		renderer.setOutputEncoding((pixelpipe::color_encoding) outputEncoding, vm.count("dither") > 0);
+		renderer.setMappedOutput(mappedfile);
+		renderer.init();
+		if(stream) renderer.getPipeline().setFrameConsumer(stream);
+		if(streamFormat == pixelpipe::STREAM_FORMAT_DELTA) renderer.getPipeline().enableDamageTracking(true);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if(bandedSize.size() == 2){
+			if(outputfile.empty()) throw "Banded rendering needs an output image.";
+			renderer.renderBands(outputfile, bandedSize.at(0), bandedSize.at(1));
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			status << "Rendered " << bandedSize.at(0) << "x" << bandedSize.at(1) << " in tiles of " << image_size.at(0) << "x" << image_size.at(1)
+				<< " in " << elapsed.count() << " ms" << std::endl;
+			status << "Wrote " << outputfile << std::endl;
+		}
+		else{
+			for(int i = 0; i < frames; i++) renderer.render();
+			renderer.getFrameData();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			status << "Rendered " << frames << " frames of " << image_size.at(0) << "x" << image_size.at(1)
+				<< " in " << elapsed.count() << " ms" << std::endl;
+			if(renderer.getResolution()) status << "Render scale " << renderer.getResolution()->getScale() << std::endl;
+
+			if(!mappedfile.empty()) status << "Rendered into " << mappedfile << std::endl;
+			else if(!outputfile.empty()){
+				renderer.write(outputfile);
+				status << "Wrote " << outputfile << std::endl;
+			}
+		}
+	}
+	catch(const char* message) {
+		std::cerr << " * error: " << message << "\n";
+		delete stream;
+		return 1;
+	}
+
+	if(stream) status << "Streamed " << stream->frames() << " frames to " << streamfile << std::endl;
+	delete stream;
+
+	return 0;
+}
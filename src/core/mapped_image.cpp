@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "core/mapped_image.h"
+
+namespace pixelpipe {
+
+MappedImage::MappedImage(const std::string& filename, unsigned width, unsigned height)
+	: m_width(width), m_height(height), m_file(-1), m_size(0), m_data(NULL), m_pixels(NULL)
+{
+	if(width == 0 || height == 0) throw "Invalid image size.";
+
+	char header[128];
+	int length = snprintf(header, sizeof(header), "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+	m_size = length + (size_t) width * height * 4;
+
+	m_file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(m_file < 0) throw "Unable to open the output image.";
+
+	// the file is sized up front, its pages are only allocated when written
+	if(ftruncate(m_file, (off_t) m_size) != 0){
+		close(m_file);
+		throw "Unable to size the output image.";
+	}
+
+	void* data = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+	if(data == MAP_FAILED){
+		close(m_file);
+		throw "Unable to map the output image.";
+	}
+
+	m_data = (unsigned char*) data;
+	memcpy(m_data, header, length);
+	m_pixels = m_data + length;
+}
+
+MappedImage::~MappedImage()
+{
+	munmap(m_data, m_size);
+	close(m_file);
+}
+
+void MappedImage::sync()
+{
+	msync(m_data, m_size, MS_SYNC);
+}
+
+}	// namespace pixelpipe
@@ -53,7 +53,7 @@ void OpenGLPipeline::configure()
 		glDisable(GL_TEXTURE_2D);
 	}
 	
-	glShadeModel(GL_SMOOTH);
+	glShadeModel(isFlatShaded() ? GL_FLAT : GL_SMOOTH);
 	if(state->getLighting()){
 		if(state->getTexturing2D()){
 			if(true){
@@ -71,7 +71,7 @@ void OpenGLPipeline::configure()
 		}
 		
 		glEnable(GL_LIGHTING);
-		glShadeModel(GL_SMOOTH);
+		glShadeModel(isFlatShaded() ? GL_FLAT : GL_SMOOTH);
 		// removed this, so the specular component is modulated with the texture - not added on top.
 		glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SEPARATE_SPECULAR_COLOR);
 		
@@ -127,10 +127,9 @@ bool OpenGLPipeline::validConfiguration()
 	return (glGetError() == GL_NO_ERROR);
 }
 
-/** NOT YET IMPLEMENTED */
 bool OpenGLPipeline::isFlatShaded()
 {
-	return false;
+	return State::getInstance()->getShadeModel() == SHADE_FLAT;
 }
 
 void OpenGLPipeline::clearFrameBuffer()
@@ -390,6 +389,12 @@ void OpenGLPipeline::loadTexture2D(const unsigned width, const unsigned height,
 			break;
 		case PIXEL_TYPE_FLOAT: ptype = GL_FLOAT;
 			break;
+		case PIXEL_TYPE_UNSIGNED_SHORT_5_6_5: ptype = GL_UNSIGNED_SHORT_5_6_5;
+			break;
+#ifdef GL_HALF_FLOAT
+		case PIXEL_TYPE_HALF_FLOAT: ptype = GL_HALF_FLOAT;
+			break;
+#endif
 	}
 	
 	switch(format){
@@ -432,5 +437,36 @@ void OpenGLPipeline::renderTriangle(const Vector3f* v, const Color3f* c, const V
 		this->vertex(v[k], c[k], n[k], t[k]);
 	}
 }
+
+void OpenGLPipeline::beginObject(const Vector3f& center, float radius)
+{
+	// the fixed function pipeline shades every object the same way
+}
+
+void OpenGLPipeline::endObject()
+{
+}
+
+void OpenGLPipeline::setRenderPass(render_pass pass)
+{
+	switch(pass){
+		case RENDER_PASS_DEPTH:
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS);
+			break;
+		case RENDER_PASS_SHADE:
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthMask(GL_FALSE);
+			glDepthFunc(GL_EQUAL);
+			break;
+		default:
+		case RENDER_PASS_FORWARD:
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS);
+			break;
+	}
+}
 	
 }	// namespace pixelpipe
@@ -1,11 +1,26 @@
+#include <cfloat>
+#include <algorithm>
+#include <math.h>
 
 #include "core/pipeline_software.h"
+#include "core/shader_program.h"
+#include "core/gbuffer.h"
+#include "core/visbuffer.h"
+#include "core/draw_queue.h"
+#include "core/frame_ring.h"
+#include "core/damage.h"
 #include "vertex/vert_color.h"
+#include "vertex/vert_depth.h"
+#include "vertex/vert_flat.h"
 #include "vertex/vert_frag_shaded.h"
 #include "vertex/vert_frag_textured.h"
+#include "vertex/vert_gbuffer.h"
 #include "vertex/vert_shaded.h"
 #include "vertex/vert_textured_shaded.h"
+#include "fragment/frag_bytecode.h"
 #include "fragment/frag_color.h"
+#include "fragment/frag_depth.h"
+#include "fragment/frag_gbuffer.h"
 #include "fragment/frag_phong.h"
 #include "fragment/frag_textured.h"
 #include "fragment/frag_textured_phong.h"
@@ -25,6 +40,12 @@ namespace pixelpipe {
 SoftwarePipeline::SoftwarePipeline(int nx, int ny)
 {	
 	m_framebuffer = new FrameBuffer(nx, ny);
+	m_renderTarget = NULL;
+	m_frames = NULL;
+	m_consumer = NULL;
+	m_damage = NULL;
+	m_renderScale = 1.0f;
+	m_frameDirty = false;
 	
 	m_textureUnits = new std::vector<Texture*>();
 	m_textureUnits->reserve(32);
@@ -51,6 +72,33 @@ SoftwarePipeline::SoftwarePipeline(int nx, int ny)
 	m_rasterizer = NULL;
 	m_vp = NULL;
 	m_fp = NULL;
+	m_program = NULL;
+	m_fragmentProgram = NULL;
+	m_staticShaders = false;
+	m_deferredShading = false;
+	m_gbuffer = NULL;
+	m_gbufferResolved = true;
+	m_visibilityBuffer = false;
+	m_visbuffer = NULL;
+	m_visFP = NULL;
+	m_visRasterizer = NULL;
+	m_visbufferResolved = true;
+	m_pass = RENDER_PASS_FORWARD;
+	m_depthVP = new DepthOnlyVP();
+	m_depthFP = new DepthFP();
+	m_depthClipper = new Clipper(0);
+	m_depthRasterizer = new Rasterizer(0, nx, ny);
+	m_drawQueue = NULL;
+	m_drawOrder = DRAW_ORDER_SUBMISSION;
+	m_replaying = false;
+	m_inObject = false;
+	m_culled = false;
+	m_assembling = false;
+	for(int i = 0; i < 3; i++){
+		m_levels[i].vp = NULL;
+		m_levels[i].fp = NULL;
+		m_levels[i].rasterizer = NULL;
+	}
 }
 
 SoftwarePipeline::~SoftwarePipeline()
@@ -63,38 +111,123 @@ SoftwarePipeline::~SoftwarePipeline()
 	delete m_projectionMatrix;
 	delete m_viewportMatrix;
 	
+	if(m_inObject) endObject();
+	deleteLevels();
+	
 	if(m_vp) delete m_vp;
 	if(m_fp) delete m_fp;
+	if(m_program) delete m_program;
+	if(m_fragmentProgram) delete m_fragmentProgram;
+	if(m_gbuffer) delete m_gbuffer;
+	deleteVisibility();
+	delete m_depthVP;
+	delete m_depthFP;
+	delete m_depthClipper;
+	delete m_depthRasterizer;
+	delete m_drawQueue;
 	if(m_clipper) delete m_clipper;
 	if(m_rasterizer) delete m_rasterizer;
-	if(m_framebuffer) delete m_framebuffer;
+	if(m_frames) delete m_frames;
+	else if(m_framebuffer) delete m_framebuffer;
+	delete m_damage;
+	for(unsigned i = 0; i < m_renderTextures.size(); i++) delete m_renderTextures[i];
 }
 
 void SoftwarePipeline::init()
 {
-	m_framebuffer->init();
+	if(m_frames) m_frames->init();
+	else m_framebuffer->init();
 }
 
 void SoftwarePipeline::setFragmentProcessor(const FragmentProcessor* fragProc)
 {
+	flushDraws();
+	if(m_inObject) endObject();
 	if(m_fp != NULL) delete m_fp;
 	
 	m_fp = const_cast<FragmentProcessor*>(fragProc);
-	if(m_rasterizer==NULL) m_rasterizer = new Rasterizer(m_fp->nAttr(), m_framebuffer->width(), m_framebuffer->height());
+	if(m_rasterizer==NULL) m_rasterizer = new Rasterizer(m_fp->nAttr(), target().width(), target().height());
+	else m_rasterizer->setAttributeCount(m_fp->nAttr());
+	if(m_program == NULL) m_clipper->setAttributeCount(m_fp->nAttr());
+	if(m_visbuffer) m_visbuffer->setAttributeCount(m_fp->nAttr());
+	updateDepthFunc();
 }
 
 void SoftwarePipeline::setVertexProcessor(const VertexProcessor* vertProc)
 {
+	flushDraws();
+	if(m_inObject) endObject();
 	if(m_vp != NULL) delete m_vp;
 	
 	m_vp = const_cast<VertexProcessor*>(vertProc);
 }
 
+void SoftwarePipeline::setShaderProgram(const ShaderProgram* program)
+{
+	flushDraws();
+	if(m_program != NULL) delete m_program;
+	
+	m_program = const_cast<ShaderProgram*>(program);
+	if(m_program == NULL){
+		if(m_fp != NULL) m_clipper->setAttributeCount(m_fp->nAttr());
+		return;
+	}
+	
+	m_program->setFrameSize(target().width(), target().height());
+	m_clipper->setAttributeCount(m_program->nAttr());
+	m_program->updateTransforms(*this);
+	m_program->updateLightModel(*this);
+	m_program->setDepthFunc(m_pass == RENDER_PASS_SHADE ? DEPTH_FUNC_EQUAL : DEPTH_FUNC_LESS);
+	
+	if(m_textureUnits->size() > (unsigned) m_textureIndex){
+		m_program->setTexture(m_textureUnits->at(m_textureIndex));
+	}
+}
+
+void SoftwarePipeline::setFragmentProgram(ShaderBytecode* program)
+{
+	// the shading vertex processors send a light and a half vector per light
+	int lights = (int) State::getInstance()->getLights().size();
+	if(program != NULL && program->lightCount() > 0 && program->lightCount() != lights){
+		delete program;
+		throw "The fragment program reads a different number of lights than the state has.";
+	}
+	if(program != NULL && program->nAttr() != 9 + 6 * lights){
+		delete program;
+		throw "The fragment program expects varyings for a different number of lights than the state has.";
+	}
+	
+	if(m_fragmentProgram != NULL) delete m_fragmentProgram;
+	
+	m_fragmentProgram = program;
+}
+
 void SoftwarePipeline::configure()
 {		
 	State* state = State::getInstance();
 	
-	if(state->getTexturing2D()){
+	flushDraws();
+	if(m_inObject) endObject();
+	deleteLevels();
+	
+	if(m_gbuffer){
+		delete m_gbuffer;
+		m_gbuffer = NULL;
+	}
+	deleteVisibility();
+	
+	if(m_fragmentProgram != NULL){
+		// each configuration interprets its own copy, the BytecodeFP owns it
+		if(m_fragmentProgram->getVertexProcessor() == PROGRAM_VERTEX_TEXTURED) m_vp = new TexturedFragmentShadedVP();
+		else m_vp = new FragmentShadedVP();
+		m_fp = new BytecodeFP(new ShaderBytecode(*m_fragmentProgram));
+	}
+	else if(m_deferredShading && state->getLighting()){
+		m_gbuffer = new GBuffer(m_framebuffer->width(), m_framebuffer->height());
+		m_vp = new GBufferVP();
+		m_fp = new GBufferFP(m_gbuffer);
+	}
+	else if(state->getTexturing2D()){
 		if(true){
 			m_vp = new TexturedFragmentShadedVP();
 			m_fp = new TexturedPhongFP();
@@ -106,7 +239,8 @@ void SoftwarePipeline::configure()
 	}
 	else{
 		if(state->getLighting()){
-			m_vp = new SmoothShadedVP();
+			if(isFlatShaded()) m_vp = new FlatShadedVP();
+			else m_vp = new SmoothShadedVP();
 			if(state->getDepthTest()){
 				m_fp = new ZBufferFP();
 			}else{
@@ -125,12 +259,320 @@ void SoftwarePipeline::configure()
 	
 	if(m_fp->nAttr() != m_vp->nAttr()) throw "Unsupported configuration.";
 	
-	m_rasterizer = new Rasterizer(m_fp->nAttr(), m_framebuffer->width(), m_framebuffer->height());
+	m_rasterizer = new Rasterizer(m_fp->nAttr(), target().width(), target().height());
 	m_rasterizer->setAttributeCount(m_fp->nAttr());
+	m_rasterizer->setFlatShading(isFlatShaded());
 	m_clipper->setAttributeCount(m_fp->nAttr());
 		
 	m_vp->updateTransforms(*this);
 	m_vp->updateLightModel(*this);
+	
+	// flat shading is already cheap per fragment, it is left to the rasterizer
+	if(m_visibilityBuffer && m_gbuffer == NULL && !isFlatShaded()){
+		m_visbuffer = new VisibilityBuffer(m_framebuffer->width(), m_framebuffer->height(), m_fp->nAttr());
+		m_visFP = new VisibilityFP(m_visbuffer);
+		m_visRasterizer = new Rasterizer(0, m_framebuffer->width(), m_framebuffer->height());
+	}
+	
+	// the deferred and visibility modes have a single set of processors
+	if(m_gbuffer == NULL && m_visbuffer == NULL && m_fragmentProgram == NULL && state->getShadingLOD() && state->getLighting()){
+		createLevels();
+	}
+	
+	if(m_gbuffer == NULL && m_visbuffer == NULL && m_fragmentProgram == NULL && m_staticShaders){
+		setShaderProgram(createShaderProgram(*state, target().width(), target().height()));
+	}
+	
+	updateDepthFunc();
+}
+
+void SoftwarePipeline::createLevels()
+{
+	State* state = State::getInstance();
+	
+	for(int i = 0; i < 3; i++){
+		ProcessorSet& set = m_levels[i];
+		
+		if(state->getTexturing2D()){
+			// textured objects keep interpolating coordinates, the smallest level shades per vertex
+			if(i == SHADING_LEVEL_PHONG){
+				set.vp = new TexturedFragmentShadedVP();
+				set.fp = new TexturedPhongFP();
+			}
+			else{
+				set.vp = new TexturedShadedVP();
+				set.fp = new TexturedFP();
+			}
+		}
+		else{
+			if(i == SHADING_LEVEL_PHONG){
+				set.vp = new FragmentShadedVP();
+				set.fp = new PhongShadedFP();
+			}
+			else{
+				if(i == SHADING_LEVEL_FLAT) set.vp = new FlatShadedVP();
+				else set.vp = new SmoothShadedVP();
+				
+				if(state->getDepthTest()) set.fp = new ZBufferFP();
+				else set.fp = new ColorFP();
+			}
+		}
+		
+		if(set.fp->nAttr() != set.vp->nAttr()) throw "Unsupported configuration.";
+		
+		set.rasterizer = new Rasterizer(set.fp->nAttr(), target().width(), target().height());
+		set.rasterizer->setFlatShading(i == SHADING_LEVEL_FLAT && !state->getTexturing2D());
+	}
+}
+
+void SoftwarePipeline::deleteLevels()
+{
+	for(int i = 0; i < 3; i++){
+		delete m_levels[i].vp;
+		delete m_levels[i].fp;
+		delete m_levels[i].rasterizer;
+		m_levels[i].vp = NULL;
+		m_levels[i].fp = NULL;
+		m_levels[i].rasterizer = NULL;
+	}
+}
+
+void SoftwarePipeline::useProcessors(const ProcessorSet& set)
+{
+	m_vp = set.vp;
+	m_fp = set.fp;
+	m_rasterizer = set.rasterizer;
+	m_clipper->setAttributeCount(m_fp->nAttr());
+	
+	m_vp->updateTransforms(*this);
+	m_vp->updateLightModel(*this);
+	if(m_textureUnits->size() > (unsigned) m_textureIndex){
+		m_fp->setTexture(m_textureUnits->at(m_textureIndex));
+	}
+}
+
+float SoftwarePipeline::projectedRadius(const Vector3f& center, float radius) const
+{
+	const Matrix4f& mv = *m_modelviewMatrix;
+	const Matrix4f& p = *m_projectionMatrix;
+	
+	float r = scaledRadius(radius);
+	
+	Vector4f c(center.x, center.y, center.z, 1.0f);
+	Vector4f e = mv * c;
+	
+	// w is the distance along the view direction for a perspective projection and 1 for an orthographic one
+	float w = p[3][0] * e.x + p[3][1] * e.y + p[3][2] * e.z + p[3][3];
+	if(p[3][3] == 0.0f && w <= r) return FLT_MAX;
+	if(w <= 0.0f) return FLT_MAX;
+	
+	return r * fabsf(p[1][1]) * fabsf((*m_viewportMatrix)[1][1]) / w;
+}
+
+bool SoftwarePipeline::outsideView(const Vector3f& center, float radius) const
+{
+	const Matrix4f& mv = *m_modelviewMatrix;
+	const Matrix4f& p = *m_projectionMatrix;
+	
+	Vector4f c(center.x, center.y, center.z, 1.0f);
+	Vector4f e = mv * c;
+	float r = scaledRadius(radius);
+	
+	// the planes of the view volume, in eye coordinates, are the sums and differences of the last row of the projection with the other rows
+	for(int k = 0; k < 3; k++){
+		for(int sign = -1; sign <= 1; sign += 2){
+			float a = p[3][0] + sign * p[k][0];
+			float b = p[3][1] + sign * p[k][1];
+			float d = p[3][2] + sign * p[k][2];
+			float w = p[3][3] + sign * p[k][3];
+			float length = sqrtf(a * a + b * b + d * d);
+			if(length > 0.0f && a * e.x + b * e.y + d * e.z + w < -r * length) return true;
+		}
+	}
+	return false;
+}
+
+float SoftwarePipeline::scaledRadius(float radius) const
+{
+	const Matrix4f& mv = *m_modelviewMatrix;
+	
+	// the largest scale factor of the model-view matrix bounds the scaled radius
+	float sx = mv[0][0] * mv[0][0] + mv[1][0] * mv[1][0] + mv[2][0] * mv[2][0];
+	float sy = mv[0][1] * mv[0][1] + mv[1][1] * mv[1][1] + mv[2][1] * mv[2][1];
+	float sz = mv[0][2] * mv[0][2] + mv[1][2] * mv[1][2] + mv[2][2] * mv[2][2];
+	return radius * sqrtf(std::max(sx, std::max(sy, sz)));
+}
+
+void SoftwarePipeline::setDrawOrder(draw_order order)
+{
+	flushDraws();
+	m_drawOrder = order;
+	
+	if(order != DRAW_ORDER_SUBMISSION && m_drawQueue == NULL){
+		m_drawQueue = new DrawQueue();
+	}
+	else if(order == DRAW_ORDER_SUBMISSION && m_drawQueue != NULL){
+		delete m_drawQueue;
+		m_drawQueue = NULL;
+	}
+}
+
+void SoftwarePipeline::flushDraws()
+{
+	if(m_drawQueue == NULL || m_drawQueue->empty()) return;
+	
+	m_drawQueue->close();
+	m_drawQueue->sort(m_drawOrder);
+	m_replaying = true;
+	
+	// the queued draws were not culled when they were recorded
+	bool culled = m_culled;
+	m_culled = false;
+	
+	int texture = m_textureIndex;
+	Vector3f v[3];
+	Color3f c[3];
+	Vector3f n[3];
+	Vector2f t[3];
+	
+	for(size_t i = 0; i < m_drawQueue->size(); i++){
+		const DrawQueue::Draw& draw = m_drawQueue->draw(i);
+		
+		if(draw.texture >= 0 && draw.texture != m_textureIndex) bindTexture(draw.texture);
+		
+		// the shading level was selected when the draw was recorded
+		if(usesLevels() && !(m_inObject && m_vp == m_levels[draw.state].vp)){
+			useLevel((shading_level) draw.state);
+		}
+		
+		*m_modelviewMatrix = draw.modelview;
+		*m_projectionMatrix = draw.projection;
+		updateTransforms();
+		
+		for(unsigned k = draw.first; k < draw.first + draw.count; k++){
+			const DrawQueue::Command& command = m_drawQueue->command(k);
+			switch(command.type){
+				case DrawQueue::COMMAND_BEGIN:
+					begin(command.mode);
+					break;
+				case DrawQueue::COMMAND_VERTEX:{
+					const DrawQueue::QueuedVertex& qv = m_drawQueue->queuedVertex(command.first);
+					vertex(qv.v, qv.c, qv.n, qv.t);
+					break;
+				}
+				case DrawQueue::COMMAND_TRIANGLE:
+				case DrawQueue::COMMAND_TRIANGLE_UNTEXTURED:
+					for(int iv = 0; iv < 3; iv++){
+						const DrawQueue::QueuedVertex& qv = m_drawQueue->queuedVertex(command.first + iv);
+						v[iv] = qv.v;
+						c[iv] = qv.c;
+						n[iv] = qv.n;
+						t[iv] = qv.t;
+					}
+					renderTriangle(v, c, n, (command.type == DrawQueue::COMMAND_TRIANGLE)? t : NULL);
+					break;
+				case DrawQueue::COMMAND_END:
+					end();
+					break;
+			}
+		}
+	}
+	
+	endObject();
+	m_replaying = false;
+	m_culled = culled;
+	m_drawQueue->clear();
+	
+	// restore the state of the caller
+	recomputeMatrix();
+	if(m_textureUnits->size() > (unsigned) texture) bindTexture(texture);
+}
+
+void SoftwarePipeline::beginObject(const Vector3f& center, float radius)
+{
+	m_culled = outsideView(center, radius);
+	if(m_culled) return;
+	
+	if(m_drawQueue && !m_replaying){
+		DrawQueue::Draw draw;
+		draw.modelview = *m_modelviewMatrix;
+		draw.projection = *m_projectionMatrix;
+		draw.texture = (m_textureUnits->size() > (unsigned) m_textureIndex)? m_textureIndex : -1;
+		draw.center = center;
+		draw.radius = radius;
+		
+		// the eye looks down -z, the key is the distance to the nearest point of the sphere
+		const Matrix4f& mv = *m_modelviewMatrix;
+		float z = mv[2][0] * center.x + mv[2][1] * center.y + mv[2][2] * center.z + mv[2][3];
+		draw.depth = -z - scaledRadius(radius);
+		draw.state = 0;
+		if(usesLevels()) draw.state = State::getInstance()->selectShadingLevel(projectedRadius(center, radius));
+		
+		m_drawQueue->open(draw);
+		return;
+	}
+	
+	if(!usesLevels()) return;
+	if(m_inObject) endObject();
+	
+	useLevel(State::getInstance()->selectShadingLevel(projectedRadius(center, radius)));
+}
+
+bool SoftwarePipeline::usesLevels() const
+{
+	return m_program == NULL && m_levels[0].vp != NULL && m_pass != RENDER_PASS_DEPTH;
+}
+
+void SoftwarePipeline::useLevel(shading_level level)
+{
+	if(!m_inObject){
+		m_configured.vp = m_vp;
+		m_configured.fp = m_fp;
+		m_configured.rasterizer = m_rasterizer;
+		m_inObject = true;
+	}
+	
+	useProcessors(m_levels[level]);
+}
+
+void SoftwarePipeline::endObject()
+{
+	if(m_culled){
+		m_culled = false;
+		return;
+	}
+	
+	if(m_drawQueue && m_drawQueue->isOpen()){
+		m_drawQueue->close();
+		return;
+	}
+	
+	if(!m_inObject) return;
+	
+	m_inObject = false;
+	useProcessors(m_configured);
+}
+
+void SoftwarePipeline::setRenderPass(render_pass pass)
+{
+	flushDraws();
+	
+	m_pass = pass;
+	updateDepthFunc();
+}
+
+void SoftwarePipeline::updateDepthFunc()
+{
+	// the deferred and visibility modes skip the depth pass, their final pass tests against a cleared depth
+	depth_func func = DEPTH_FUNC_LESS;
+	if(m_pass == RENDER_PASS_SHADE && m_gbuffer == NULL && m_visbuffer == NULL) func = DEPTH_FUNC_EQUAL;
+	
+	if(m_fp) m_fp->setDepthFunc(func);
+	if(m_inObject) m_configured.fp->setDepthFunc(func);
+	for(int i = 0; i < 3; i++){
+		if(m_levels[i].fp) m_levels[i].fp->setDepthFunc(func);
+	}
+	if(m_program) m_program->setDepthFunc(func);
 }
 
 bool SoftwarePipeline::validConfiguration()
@@ -140,24 +582,202 @@ bool SoftwarePipeline::validConfiguration()
 
 bool SoftwarePipeline::isFlatShaded()
 {
-	return false;
+	// texturing needs interpolated coordinates, flat shading does not apply to it
+	State* state = State::getInstance();
+	return state->getShadeModel() == SHADE_FLAT && !state->getTexturing2D();
 }
 
 void SoftwarePipeline::clearFrameBuffer()
 {
+	if(m_drawQueue) m_drawQueue->clear();
+	if(m_renderTarget){
+		m_renderTarget->clear(0, 0, 0, 1);
+		return;
+	}
+	
+	m_frameDirty = true;
 	m_framebuffer->clear(0, 0, 0, 1);
+	if(m_gbuffer){
+		m_gbuffer->clear();
+		m_gbufferResolved = false;
+	}
+	if(m_visbuffer){
+		m_visbuffer->clear();
+		m_visbufferResolved = false;
+	}
+}
+
+void SoftwarePipeline::resolveGBuffer()
+{
+	if(m_gbuffer == NULL || m_gbufferResolved) return;
+	
+	Matrix4f screen = (*m_viewportMatrix) * (*m_projectionMatrix);
+	Matrix4f screenToEye;
+	invert(screenToEye, screen);
+	
+	m_gbuffer->shade(*m_framebuffer, screenToEye, State::getInstance()->getTexturing2D());
+	m_gbufferResolved = true;
+}
+
+void SoftwarePipeline::resolveVisibility()
+{
+	if(m_visbuffer == NULL || m_visbufferResolved) return;
+	
+	m_visbuffer->resolve(*m_fp, *m_framebuffer);
+	m_visbufferResolved = true;
+	
+	// the resolve pass binds the texture of each draw
+	if(m_textureUnits->size() > (unsigned) m_textureIndex){
+		m_fp->setTexture(m_textureUnits->at(m_textureIndex));
+	}
+}
+
+void SoftwarePipeline::deleteVisibility()
+{
+	delete m_visbuffer;
+	delete m_visFP;
+	delete m_visRasterizer;
+	m_visbuffer = NULL;
+	m_visFP = NULL;
+	m_visRasterizer = NULL;
+	m_visbufferResolved = true;
 }
 
 void SoftwarePipeline::drawFrameBuffer()
 {
-	m_framebuffer->draw();
+	flushDraws();
+	resolveGBuffer();
+	resolveVisibility();
 	
+	if(m_frames){
+		submitFrame();
+		const void* color;
+		const FrameBuffer* frame = m_frames->latest(&color);
+		if(frame) frame->draw(color);
+	}
+	else{
+		if(m_damage) m_damage->update(*m_framebuffer);
+		const void* color = m_framebuffer->getColorData();
+		if(m_consumer) m_consumer->consume(color, m_framebuffer->width(), m_framebuffer->height(), m_framebuffer->getColorFormat(), m_damage);
+		m_framebuffer->draw(color);
+	}
+	
+#ifndef PIXELPIPE_HEADLESS
 	glutSwapBuffers();
+#endif
 }
 
 const void* SoftwarePipeline::getFrameData()
 {
-	return (unsigned char*) m_framebuffer->getTextureBytes();
+	flushDraws();
+	resolveGBuffer();
+	resolveVisibility();
+	
+	if(m_frames){
+		submitFrame();
+		const void* color;
+		m_frames->latest(&color);
+		return color;
+	}
+	return m_framebuffer->getColorData();
+}
+
+void SoftwarePipeline::submitFrame()
+{
+	if(!m_frameDirty) return;
+	
+	unsigned regionWidth = m_framebuffer->regionWidth();
+	unsigned regionHeight = m_framebuffer->regionHeight();
+	m_frames->submit();
+	m_framebuffer = &m_frames->current();
+	m_framebuffer->setRegion(regionWidth, regionHeight);
+	m_frameDirty = false;
+}
+
+void SoftwarePipeline::setFrameBufferFormat(color_format color, depth_format depth, framebuffer_layout layout)
+{
+	if(m_framebuffer->getColorFormat() == color && m_framebuffer->getDepthFormat() == depth && m_framebuffer->getLayout() == layout) return;
+	
+	flushDraws();
+	if(m_frames){
+		unsigned count = m_frames->size();
+		FrameRing* frames = new FrameRing(count, m_framebuffer->width(), m_framebuffer->height(), color, depth, layout);
+		delete m_frames;
+		m_frames = frames;
+		m_frames->setConsumer(m_consumer);
+		m_frames->setDamageTracker(m_damage);
+		m_framebuffer = &m_frames->current();
+		return;
+	}
+	
+	FrameBuffer* framebuffer = new FrameBuffer(m_framebuffer->width(), m_framebuffer->height(), color, depth, layout);
+	delete m_framebuffer;
+	m_framebuffer = framebuffer;
+}
+
+void SoftwarePipeline::setFrameCount(unsigned count)
+{
+	unsigned current = m_frames ? m_frames->size() : 1;
+	if(count < 1) count = 1;
+	if(count == current) return;
+	
+	flushDraws();
+	unsigned width = m_framebuffer->width();
+	unsigned height = m_framebuffer->height();
+	color_format color = m_framebuffer->getColorFormat();
+	depth_format depth = m_framebuffer->getDepthFormat();
+	framebuffer_layout layout = m_framebuffer->getLayout();
+	
+	if(m_frames) delete m_frames;
+	else delete m_framebuffer;
+	m_frames = NULL;
+	m_frameDirty = false;
+	
+	if(count == 1){
+		m_framebuffer = new FrameBuffer(width, height, color, depth, layout);
+	}
+	else{
+		m_frames = new FrameRing(count, width, height, color, depth, layout);
+		m_frames->setConsumer(m_consumer);
+		m_frames->setDamageTracker(m_damage);
+		m_framebuffer = &m_frames->current();
+	}
+}
+
+void SoftwarePipeline::finishFrames()
+{
+	if(m_frames == NULL) return;
+	
+	flushDraws();
+	resolveGBuffer();
+	resolveVisibility();
+	submitFrame();
+	m_frames->finish();
+}
+
+void SoftwarePipeline::setFrameConsumer(FrameConsumer* consumer)
+{
+	m_consumer = consumer;
+	if(m_frames) m_frames->setConsumer(consumer);
+}
+
+void SoftwarePipeline::enableDamageTracking(bool value)
+{
+	if(value == (m_damage != NULL)) return;
+	
+	if(value){
+		m_damage = new DamageTracker();
+		if(m_frames) m_frames->setDamageTracker(m_damage);
+		return;
+	}
+	
+	// the worker thread may be updating the tracker
+	if(m_frames){
+		m_frames->finish();
+		m_frames->setDamageTracker(NULL);
+	}
+	delete m_damage;
+	m_damage = NULL;
 }
 
 void SoftwarePipeline::loadIdentity()
@@ -212,7 +832,14 @@ void SoftwarePipeline::recomputeMatrix()
 		(*m_projectionMatrix) = *(m_projectionStack->back());
 	}
 	
+	updateTransforms();
+}
+
+void SoftwarePipeline::updateTransforms()
+{
 	m_vp->updateTransforms(*this);
+	m_depthVP->updateTransforms(*this);
+	if(m_program) m_program->updateTransforms(*this);
 }
 
 void SoftwarePipeline::lookAt(Vector3f eye, Vector3f target, Vector3f up)
@@ -265,17 +892,34 @@ void SoftwarePipeline::ortho(float l, float r, float b, float t, float n, float
 
 void SoftwarePipeline::viewport(int x, int y, int w, int h)
 {
-	float cx = x + 0.5 * w;
-	float cy = y + 0.5 * h;
+	// map the viewport into the rendered region of the framebuffer
+	unsigned width = target().width();
+	unsigned height = target().height();
+	unsigned regionWidth = width, regionHeight = height;
+	if(m_renderScale < 1.0f && m_renderTarget == NULL){
+		regionWidth = std::max(1u, (unsigned) (width * m_renderScale + 0.5f));
+		regionHeight = std::max(1u, (unsigned) (height * m_renderScale + 0.5f));
+	}
+	target().setRegion(regionWidth, regionHeight);
+	float sx = (float) regionWidth / (float) width;
+	float sy = (float) regionHeight / (float) height;
+	
+	float cx = (x + 0.5 * w) * sx;
+	float cy = (y + 0.5 * h) * sy;
 	m_viewportMatrix->identity();
-	(*m_viewportMatrix)[0][0] = 0.5 * w;
+	(*m_viewportMatrix)[0][0] = 0.5 * w * sx;
 	(*m_viewportMatrix)[0][3] = cx;
-	(*m_viewportMatrix)[1][1] = 0.5 * h;
+	(*m_viewportMatrix)[1][1] = 0.5 * h * sy;
 	(*m_viewportMatrix)[1][3] = cy;
 	
 	recomputeMatrix();
 }
 
+void SoftwarePipeline::setRenderScale(float scale)
+{
+	m_renderScale = std::max(0.0f, std::min(scale, 1.0f));
+}
+
 void SoftwarePipeline::pushMatrix(Matrix4f* matrix)
 {
 	bool recompute = true;
@@ -323,6 +967,8 @@ void SoftwarePipeline::popMatrix()
 		default:
 		break;
 	}
+	
+	recomputeMatrix();
 }
 
 void SoftwarePipeline::loadMatrix(const Matrix4f& matrix)
@@ -375,6 +1021,11 @@ void SoftwarePipeline::loadTransposeMatrixMultiply(const Matrix4f& matrix)
 
 void SoftwarePipeline::begin(const drawing_mode mode)
 {
+	if(m_drawQueue && m_drawQueue->isOpen()){
+		m_drawQueue->begin(mode);
+		return;
+	}
+	
 	this->m_mode = mode;
 	this->m_vertexIndex = 0;
 	this->m_stripParity = 0;
@@ -382,12 +1033,29 @@ void SoftwarePipeline::begin(const drawing_mode mode)
 
 void SoftwarePipeline::vertex(const Vector3f& v, const Color3f& c, const Vector3f& n, const Vector2f& t)
 {
-	m_vp->vertex(v, c, n, t, m_vertexCache[m_vertexIndex]);
+	if(m_culled) return;
+	
+	if(m_drawQueue && m_drawQueue->isOpen()){
+		m_drawQueue->vertex(v, c, n, t);
+		return;
+	}
+	
+	// a processor that lights triangles gets the inputs once they are assembled
+	m_assembling = m_pass != RENDER_PASS_DEPTH && !m_program && m_vp->lightsTriangles();
+	if(m_assembling){
+		m_positionCache[m_vertexIndex] = v;
+		m_colorCache[m_vertexIndex] = c;
+		m_normalCache[m_vertexIndex] = n;
+		m_texcoordCache[m_vertexIndex] = t;
+	}
+	else if(m_pass == RENDER_PASS_DEPTH) m_depthVP->vertex(v, c, n, t, m_vertexCache[m_vertexIndex]);
+	else if(m_program) m_program->vertex(v, c, n, t, m_vertexCache[m_vertexIndex]);
+	else m_vp->vertex(v, c, n, t, m_vertexCache[m_vertexIndex]);
 	
 	switch (m_mode) {
 	case TRIANGLES:
 		if (m_vertexIndex == 2) {
-			renderTriangle(m_vertexCache);
+			renderCached();
 			m_vertexIndex = 0;
 		} else
 			m_vertexIndex++;
@@ -395,8 +1063,8 @@ void SoftwarePipeline::vertex(const Vector3f& v, const Color3f& c, const Vector3
 		
 	case TRIANGLE_STRIP:
 		if (m_vertexIndex == 2) {
-			renderTriangle(m_vertexCache);
-			swap(m_vertexCache, m_stripParity, 2);
+			renderCached();
+			swapCached(m_stripParity, 2);
 			m_stripParity ^= 1;
 		} else
 			m_vertexIndex++;
@@ -404,18 +1072,18 @@ void SoftwarePipeline::vertex(const Vector3f& v, const Color3f& c, const Vector3
 		
 	case TRIANGLE_FAN:
 		if (m_vertexIndex == 2) {
-			renderTriangle(m_vertexCache);
-			swap(m_vertexCache, 1, 2);
+			renderCached();
+			swapCached(1, 2);
 		} else
 			m_vertexIndex++;
 		break;
 		
 	case QUADS:
 		if (m_vertexIndex == 3) {
-			renderTriangle(m_vertexCache);
-			swap(m_vertexCache, 1, 2);
-			swap(m_vertexCache, 2, 3);
-			renderTriangle(m_vertexCache);
+			renderCached();
+			swapCached(1, 2);
+			swapCached(2, 3);
+			renderCached();
 			m_vertexIndex = 0;
 		} else
 			m_vertexIndex++;
@@ -423,12 +1091,12 @@ void SoftwarePipeline::vertex(const Vector3f& v, const Color3f& c, const Vector3
 		
 	case QUAD_STRIP:
 		if (m_vertexIndex == 3) {
-			swap(m_vertexCache, 2, 3);
-			renderTriangle(m_vertexCache);
-			swap(m_vertexCache, 1, 2);
-			swap(m_vertexCache, 2, 3);
-			renderTriangle(m_vertexCache);
-			swap(m_vertexCache, 0, 2);
+			swapCached(2, 3);
+			renderCached();
+			swapCached(1, 2);
+			swapCached(2, 3);
+			renderCached();
+			swapCached(0, 2);
 			m_vertexIndex = 2;
 		} else
 			m_vertexIndex++;
@@ -453,6 +1121,11 @@ Matrix4f SoftwarePipeline::getProjectionMatrix()
 
 void SoftwarePipeline::end()
 {
+	if(m_drawQueue && m_drawQueue->isOpen()){
+		m_drawQueue->end();
+		return;
+	}
+	
 	m_mode = PIPELINE_MODE_NONE;
 }
 
@@ -484,6 +1157,14 @@ void SoftwarePipeline::deleteTexture(unsigned* texture)
 		throw "Invalid texture unit.";
 	}
 	
+	// render textures are owned by the pipeline
+	std::vector<FrameBuffer*>::iterator it = std::find(m_renderTextures.begin(), m_renderTextures.end(), m_textureUnits->at(tex_offset));
+	if(it != m_renderTextures.end()){
+		if(*it == m_renderTarget) bindFrameBuffer(DEFAULT_FRAMEBUFFER);
+		delete *it;
+		m_renderTextures.erase(it);
+	}
+	
 	m_textureUnits->erase(m_textureUnits->begin() + tex_offset);
 }
 
@@ -497,49 +1178,79 @@ void SoftwarePipeline::bindTexture(unsigned texture)
 	Texture* currentTexture = m_textureUnits->at(m_textureIndex);
 	// TODO: we should verify that it's allocated here
 	m_fp->setTexture(currentTexture);
+	if(m_program) m_program->setTexture(currentTexture);
 }
 
 void SoftwarePipeline::loadTexture2D(const unsigned width, const unsigned height, const pixel_format format, const pixel_type type, const void* data)
 {
-	int channels = 0;
-	switch(format){
-		case PIXEL_FORMAT_LUMINANCE:
-		case PIXEL_FORMAT_LUMINANCE_ALPHA:
-		case PIXEL_FORMAT_COLOR_INDEX:
-		case PIXEL_FORMAT_RED:
-		case PIXEL_FORMAT_GREEN:
-		case PIXEL_FORMAT_BLUE:
-		case PIXEL_FORMAT_ALPHA:
-			channels = 1;
-			break;
-		case PIXEL_FORMAT_RGB:
-		case PIXEL_FORMAT_BGR:
-			channels = 3;
-			break;
-		case PIXEL_FORMAT_RGBA:
-		case PIXEL_FORMAT_BGRA:
-			channels = 4;
-			break;
-	}
+	// the texels keep the type of the pixels, unless the state asks for a compact storage
+	State* state = State::getInstance();
+	Texture* texture = m_textureUnits->at(m_textureIndex);
+	texture->setTextureData(width, height, format, type, data, Texture::storageFormat(format, type, state->getTextureStorage()), state->getTextureLayout());
 	
-	void* image = NULL;
-	switch(type){
-		case PIXEL_TYPE_BYTE: 
-		case PIXEL_TYPE_UNSIGNED_BYTE:
-		case PIXEL_TYPE_UNSIGNED_SHORT:
-		case PIXEL_TYPE_UNSIGNED_INT:
-		case PIXEL_TYPE_SHORT:
-		case PIXEL_TYPE_INT:
-			m_textureUnits->at(m_textureIndex)->setTextureData(width, height, channels, (unsigned char*) data);
-			break;
-		case PIXEL_TYPE_FLOAT:
-			// TODO: Modify Texture class to support a variety of types.
-			// image = new FloatRaster(width, height, channels, (float)data);
-			break;
-	}
+	// the filter of the state applies to the textures loaded from now on
+	texture->setFilter(state->getTextureFilter());
+	if(texture->getFilter() != TEXTURE_FILTER_LINEAR) texture->generateMipmaps(state->getMipmapFilter());
 	
 	// TODO: This should probably not happen here.
 	m_fp->setTexture(m_textureUnits->at(m_textureIndex));
+	if(m_program) m_program->setTexture(m_textureUnits->at(m_textureIndex));
+}
+
+unsigned SoftwarePipeline::generateFrameBuffer(unsigned width, unsigned height, color_format color, depth_format depth, framebuffer_layout layout)
+{
+	FrameBuffer* framebuffer = new FrameBuffer(width, height, color, depth, layout);
+	framebuffer->clear(0, 0, 0, 1);
+	return attachFrameBuffer(framebuffer);
+}
+
+unsigned SoftwarePipeline::attachFrameBuffer(FrameBuffer* framebuffer)
+{
+	m_renderTextures.push_back(framebuffer);
+	m_textureUnits->push_back(framebuffer);
+	return (unsigned) m_textureUnits->size()-1;
+}
+
+void SoftwarePipeline::bindFrameBuffer(unsigned texture)
+{
+	FrameBuffer* framebuffer = NULL;
+	if(texture != DEFAULT_FRAMEBUFFER){
+		if(texture >= m_textureUnits->size()) throw "Invalid texture unit.";
+		
+		std::vector<FrameBuffer*>::iterator it = std::find(m_renderTextures.begin(), m_renderTextures.end(), m_textureUnits->at(texture));
+		if(it == m_renderTextures.end()) throw "The texture unit does not hold a render texture.";
+		if(m_gbuffer || m_visbuffer) throw "Render textures need forward shading.";
+		framebuffer = *it;
+	}
+	if(framebuffer == m_renderTarget) return;
+	
+	// the queued draws belong to the previous target
+	flushDraws();
+	m_renderTarget = framebuffer;
+	updateTargetSize();
+}
+
+unsigned SoftwarePipeline::getBoundFrameBuffer() const
+{
+	if(m_renderTarget == NULL) return DEFAULT_FRAMEBUFFER;
+	
+	std::vector<Texture*>::const_iterator it = std::find(m_textureUnits->begin(), m_textureUnits->end(), m_renderTarget);
+	return (unsigned) (it - m_textureUnits->begin());
+}
+
+void SoftwarePipeline::updateTargetSize()
+{
+	int width = target().width();
+	int height = target().height();
+	
+	if(m_rasterizer) m_rasterizer->setFrameSize(width, height);
+	if(m_visRasterizer) m_visRasterizer->setFrameSize(width, height);
+	m_depthRasterizer->setFrameSize(width, height);
+	if(m_inObject) m_configured.rasterizer->setFrameSize(width, height);
+	for(int i = 0; i < 3; i++){
+		if(m_levels[i].rasterizer) m_levels[i].rasterizer->setFrameSize(width, height);
+	}
+	if(m_program) m_program->setFrameSize(width, height);
 }
 
 // TODO: Implementation incomplete
@@ -557,7 +1268,8 @@ void SoftwarePipeline::clear(const buffer_bit bit)
 			break;
 		default:
 		case BUFFER_COLOR:
-			m_framebuffer->clear(0, 0, 0, 1);
+			if(m_renderTarget == NULL) m_frameDirty = true;
+			target().clear(0, 0, 0, 1);
 			break;
 	}
 }
@@ -569,30 +1281,95 @@ void SoftwarePipeline::swap(Vertex* va, int i, int j) const
 	va[j] = temp;
 }
 
+void SoftwarePipeline::swapCached(int i, int j)
+{
+	swap(m_vertexCache, i, j);
+	if(!m_assembling) return;
+	
+	std::swap(m_positionCache[i], m_positionCache[j]);
+	std::swap(m_colorCache[i], m_colorCache[j]);
+	std::swap(m_normalCache[i], m_normalCache[j]);
+	std::swap(m_texcoordCache[i], m_texcoordCache[j]);
+}
+
+void SoftwarePipeline::renderCached()
+{
+	if(m_assembling) m_vp->triangle(m_positionCache, m_colorCache, m_normalCache, m_texcoordCache, m_vertexCache);
+	renderTriangle(m_vertexCache);
+}
+
 void SoftwarePipeline::renderTriangle(const Vector3f* v, const Color3f* c, const Vector3f* n, const Vector2f* t)
 {
-	m_vp->triangle(v, c, n, t, m_vertexCache);
+	if(m_culled) return;
+	
+	if(m_drawQueue && m_drawQueue->isOpen()){
+		m_drawQueue->triangle(v, c, n, t);
+		return;
+	}
+	
+	if(m_pass == RENDER_PASS_DEPTH){
+		m_depthVP->triangle(v, c, n, t, m_vertexCache);
+	}
+	else if(m_program){
+		for (int k = 0; k < 3; k++) {
+			m_program->vertex(v[k], c[k], n[k], (t != NULL)? t[k]: Vector2f(), m_vertexCache[k]);
+		}
+	}
+	else{
+		m_vp->triangle(v, c, n, t, m_vertexCache);
+	}
 	
 	renderTriangle(m_vertexCache);
 }
 
 void SoftwarePipeline::renderTriangle(const Vertex* vertices)
 {
+	m_frameDirty = true;
+	
+	if (m_pass == RENDER_PASS_DEPTH) {
+		if (m_gbuffer || m_visbuffer) return;
+		
+		int count = m_depthClipper->clip(vertices, m_depthTriangle1, m_depthTriangle2);
+		if (count == 2) m_depthRasterizer->rasterize(m_depthTriangle2, *m_depthFP, target());
+		if (count >= 1) m_depthRasterizer->rasterize(m_depthTriangle1, *m_depthFP, target());
+		return;
+	}
+	
 	// See how many "unclipped" triangles we have
 	int numberOfTriangles = m_clipper->clip(vertices, m_triangle1, m_triangle2);
 	
 	// If we have none, just stop
 	if (numberOfTriangles == 0) return;
 	
+	if (m_program) {
+		if (numberOfTriangles == 2) m_program->rasterize(m_triangle2, target());
+		m_program->rasterize(m_triangle1, target());
+		return;
+	}
+	
+	if (m_visbuffer) {
+		const Texture* texture = NULL;
+		if (m_textureUnits->size() > (unsigned) m_textureIndex) texture = m_textureUnits->at(m_textureIndex);
+		
+		// only the depth is rasterized now, the fp runs in resolveVisibility()
+		if (numberOfTriangles == 2) {
+			m_visFP->setTriangle(m_visbuffer->addTriangle(m_triangle2, texture));
+			m_visRasterizer->rasterize(m_triangle2, *m_visFP, target());
+		}
+		m_visFP->setTriangle(m_visbuffer->addTriangle(m_triangle1, texture));
+		m_visRasterizer->rasterize(m_triangle1, *m_visFP, target());
+		return;
+	}
+	
 	// If we have two...render the second one
 	if (numberOfTriangles == 2) {
 		// Rasterize triangle, sending results to fp
-		m_rasterizer->rasterize(m_triangle2, *m_fp, *m_framebuffer);
+		m_rasterizer->rasterize(m_triangle2, *m_fp, target());
 	}
 	
 	// And if we have 1 or 2, render the first one
 	// Rasterize triangle, sending results to fp
-	m_rasterizer->rasterize(m_triangle1, *m_fp, *m_framebuffer);
+	m_rasterizer->rasterize(m_triangle1, *m_fp, target());
 }
 	
 }	// namespace pixelpipe
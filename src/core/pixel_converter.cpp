@@ -0,0 +1,227 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) && !defined(PIXELPIPE_NO_SSE2)
+#include <emmintrin.h>
+#endif
+
+#include "core/pixel_converter.h"
+#include "core/fastmath.h"
+
+namespace pixelpipe {
+
+//! 4x4 ordered dither thresholds, in 1/16 steps
+static const float BAYER[4][4] = {
+	{  0.5f / 16.0f,  8.5f / 16.0f,  2.5f / 16.0f, 10.5f / 16.0f },
+	{ 12.5f / 16.0f,  4.5f / 16.0f, 14.5f / 16.0f,  6.5f / 16.0f },
+	{  3.5f / 16.0f, 11.5f / 16.0f,  1.5f / 16.0f,  9.5f / 16.0f },
+	{ 15.5f / 16.0f,  7.5f / 16.0f, 13.5f / 16.0f,  5.5f / 16.0f }
+};
+
+static const int TABLE_SIZE = 4096;	//!< the number of entries of the sRGB table
+
+/**
+ * The exact linear to sRGB transfer function, for x in [0, 1].
+ */
+static inline float srgb(float x)
+{
+	return (x <= 0.0031308f) ? x * 12.92f : 1.055f * ::powf(x, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * Builds the table of 255 * srgb(i / (TABLE_SIZE - 1)).
+ */
+static std::vector<float> buildTable()
+{
+	std::vector<float> table(TABLE_SIZE);
+	for(int i = 0; i < TABLE_SIZE; i++) table[i] = 255.0f * srgb((float) i / (float) (TABLE_SIZE - 1));
+	return table;
+}
+
+/**
+ * The sRGB table, built on first use.
+ */
+static const float* srgbTable()
+{
+	static const std::vector<float> table = buildTable();
+	return &table[0];
+}
+
+#if defined(__SSE2__) && !defined(PIXELPIPE_NO_SSE2)
+
+/**
+ * The FastMath MATH_PRECISION_FAST approximation of the sRGB transfer function
+ * of four channels in [0, 1].
+ */
+static inline __m128 srgbPolynomial(__m128 x)
+{
+	// log2(x)
+	__m128i bits = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(127)));
+	__m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000))), _mm_set1_ps(1.0f));
+	__m128 p = _mm_set1_ps(0.0452682933f);
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.193516526f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.415245562f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.708865218f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.4418799f));
+	__m128 y = _mm_mul_ps(_mm_add_ps(e, _mm_mul_ps(p, t)), _mm_set1_ps(1.0f / 2.4f));
+
+	// exp2(y), y is in [-3.5, 0] above the linear segment
+	y = _mm_max_ps(y, _mm_set1_ps(-126.0f));
+	__m128i i = _mm_cvttps_epi32(y);
+	__m128 fi = _mm_cvtepi32_ps(i);
+	__m128 below = _mm_cmpgt_ps(fi, y);
+	fi = _mm_sub_ps(fi, _mm_and_ps(below, _mm_set1_ps(1.0f)));
+	i = _mm_add_epi32(i, _mm_castps_si128(below));
+	__m128 f = _mm_sub_ps(y, fi);
+	__m128 q = _mm_set1_ps(0.00187623341f);
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(0.00899258288f));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(0.0558236055f));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(0.24015453f));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(0.693152968f));
+	q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(0.999999927f));
+	__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+	__m128 curve = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.055f), _mm_mul_ps(q, scale)), _mm_set1_ps(0.055f));
+
+	__m128 linear = _mm_cmple_ps(x, _mm_set1_ps(0.0031308f));
+	return _mm_or_ps(_mm_and_ps(linear, _mm_mul_ps(x, _mm_set1_ps(12.92f))), _mm_andnot_ps(linear, curve));
+}
+
+/**
+ * Clamps and encodes one RGBA pixel, scaled to [0, 255].
+ */
+template<color_encoding ENCODING>
+static inline __m128 encode(__m128 v, const float* table)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	__m128 linear = _mm_mul_ps(v, _mm_set1_ps(255.0f));
+	if(ENCODING == COLOR_ENCODING_LINEAR) return linear;
+
+	__m128 color;
+	if(ENCODING == COLOR_ENCODING_SRGB_TABLE){
+		int index[4];
+		_mm_storeu_si128((__m128i*) index, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps((float) (TABLE_SIZE - 1))), _mm_set1_ps(0.5f))));
+		color = _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], 0.0f);
+	}
+	else{
+		color = _mm_mul_ps(srgbPolynomial(v), _mm_set1_ps(255.0f));
+	}
+
+	// the alpha channel stays linear
+	__m128 alpha = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+	return _mm_or_ps(_mm_andnot_ps(alpha, color), _mm_and_ps(alpha, linear));
+}
+
+template<color_encoding ENCODING>
+static void convertPixels(const float* src, unsigned srcChannels, unsigned width, unsigned y, unsigned char* dst,
+	bool bgr, unsigned channels, bool dither, const float* table)
+{
+	for(unsigned x = 0; x < width; x += 4){
+		unsigned count = std::min(4u, width - x);
+		__m128i pixels[4];
+		for(unsigned k = 0; k < 4; k++){
+			if(k >= count){
+				pixels[k] = _mm_setzero_si128();
+				continue;
+			}
+			const float* p = src + (size_t) (x + k) * srcChannels;
+			__m128 v = (srcChannels == 4) ? _mm_loadu_ps(p) : _mm_setr_ps(p[0], p[1], p[2], 1.0f);
+			v = encode<ENCODING>(v, table);
+			v = _mm_add_ps(v, _mm_set1_ps(dither ? BAYER[y & 3][(x + k) & 3] : 0.5f));
+			if(bgr) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+			pixels[k] = _mm_cvttps_epi32(v);
+		}
+		__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(pixels[0], pixels[1]), _mm_packs_epi32(pixels[2], pixels[3]));
+
+		unsigned char* out = dst + (size_t) x * channels;
+		if(count == 4 && channels == 4){
+			_mm_storeu_si128((__m128i*) out, bytes);
+		}
+		else{
+			unsigned char packed[16];
+			_mm_storeu_si128((__m128i*) packed, bytes);
+			for(unsigned k = 0; k < count; k++) memcpy(out + k * channels, packed + k * 4, channels);
+		}
+	}
+}
+
+#else
+
+template<color_encoding ENCODING>
+static void convertPixels(const float* src, unsigned srcChannels, unsigned width, unsigned y, unsigned char* dst,
+	bool bgr, unsigned channels, bool dither, const float* table)
+{
+	for(unsigned x = 0; x < width; x++){
+		const float* p = src + (size_t) x * srcChannels;
+		float offset = dither ? BAYER[y & 3][x & 3] : 0.5f;
+		float v[4];
+		for(unsigned c = 0; c < 4; c++){
+			float value = (c < srcChannels) ? p[c] : 1.0f;
+			value = (value > 0.0f) ? ((value < 1.0f) ? value : 1.0f) : 0.0f;
+			if(c == 3 || ENCODING == COLOR_ENCODING_LINEAR) v[c] = value * 255.0f;
+			else if(ENCODING == COLOR_ENCODING_SRGB_TABLE) v[c] = table[(int) (value * (TABLE_SIZE - 1) + 0.5f)];
+			else if(value <= 0.0031308f) v[c] = value * 12.92f * 255.0f;
+			else v[c] = (1.055f * FastMath::pow(value, 1.0f / 2.4f) - 0.055f) * 255.0f;
+		}
+		if(bgr) std::swap(v[0], v[2]);
+		unsigned char* out = dst + (size_t) x * channels;
+		for(unsigned c = 0; c < channels; c++) out[c] = (unsigned char) (v[c] + offset);
+	}
+}
+
+#endif
+
+PixelConverter::PixelConverter(channel_order order, color_encoding encoding, bool dither)
+	: m_order(order), m_encoding(encoding), m_dither(dither)
+{
+}
+
+void PixelConverter::convertRow(const float* src, unsigned srcChannels, unsigned width, unsigned y, unsigned char* dst) const
+{
+	bool bgr = (m_order == CHANNEL_ORDER_BGRA || m_order == CHANNEL_ORDER_BGR);
+	switch(m_encoding){
+		case COLOR_ENCODING_SRGB_TABLE:
+			convertPixels<COLOR_ENCODING_SRGB_TABLE>(src, srcChannels, width, y, dst, bgr, this->channels(), m_dither, srgbTable());
+			break;
+		case COLOR_ENCODING_SRGB_POLYNOMIAL:
+			convertPixels<COLOR_ENCODING_SRGB_POLYNOMIAL>(src, srcChannels, width, y, dst, bgr, this->channels(), m_dither, NULL);
+			break;
+		default:
+		case COLOR_ENCODING_LINEAR:
+			convertPixels<COLOR_ENCODING_LINEAR>(src, srcChannels, width, y, dst, bgr, this->channels(), m_dither, NULL);
+			break;
+	}
+}
+
+void PixelConverter::convert(const float* src, unsigned srcChannels, unsigned width, unsigned height, unsigned char* dst,
+	bool flip, unsigned threads) const
+{
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	if((size_t) width * height < PARALLEL_PIXELS) threads = 1;
+	threads = std::min(threads, std::max(1u, height));
+
+	unsigned band = (height + threads - 1) / threads;
+	std::vector<std::thread> workers;
+	for(unsigned first = band; first < height; first += band){
+		workers.push_back(std::thread(&PixelConverter::convertRows, this, src, srcChannels, width, height, dst, flip,
+			first, std::min(first + band, height)));
+	}
+	this->convertRows(src, srcChannels, width, height, dst, flip, 0, std::min(band, height));
+	for(unsigned i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+void PixelConverter::convertRows(const float* src, unsigned srcChannels, unsigned width, unsigned height, unsigned char* dst,
+	bool flip, unsigned first, unsigned last) const
+{
+	size_t srcRow = (size_t) width * srcChannels;
+	size_t dstRow = (size_t) width * this->channels();
+	for(unsigned y = first; y < last; y++){
+		unsigned source = flip ? height - 1 - y : y;
+		this->convertRow(src + source * srcRow, srcChannels, width, y, dst + y * dstRow);
+	}
+}
+
+}	// namespace pixelpipe
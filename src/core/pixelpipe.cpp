@@ -1,7 +1,9 @@
 #include <algorithm>
+#include <chrono>
 
 #include "core/pixelpipe.h"
 #include "core/common.h"
+#include "fragment/frag_bytecode.h"
 
 using namespace cg::vecmath;
 
@@ -38,6 +40,15 @@ PixelPipeWindow::PixelPipeWindow(std::string title, int width, int height, rende
 	m_state->getLights().push_back(pl2);
 	
 	m_mode = mode;
+	m_deferredShading = false;
+	m_visibilityBuffer = false;
+	m_drawOrder = DRAW_ORDER_SUBMISSION;
+	m_colorFormat = COLOR_FORMAT_RGBA8;
+	m_depthFormat = DEPTH_FORMAT_32F;
+	m_framebufferLayout = FRAMEBUFFER_LAYOUT_LINEAR;
+	m_frameCount = 1;
+	m_frameBudget = 0;
+	m_resolution = NULL;
 	
 	switch(m_mode){
 		case RENDER_OPENGL:
@@ -57,6 +68,7 @@ PixelPipeWindow::~PixelPipeWindow()
 	delete m_scene;
 	delete m_pipeline;
 	delete m_state;
+	delete m_resolution;
 }	
 
 int PixelPipeWindow::run()
@@ -68,6 +80,11 @@ void PixelPipeWindow::init()
 {	
 	GlutWindow::init();
 	
+	if(m_mode == RENDER_SOFTWARE){
+		static_cast<SoftwarePipeline*>(m_pipeline)->setFrameBufferFormat(m_colorFormat, m_depthFormat, m_framebufferLayout);
+		static_cast<SoftwarePipeline*>(m_pipeline)->setFrameCount(m_frameCount);
+		if(m_frameBudget > 0) m_resolution = new ResolutionController(m_frameBudget);
+	}
 	m_pipeline->init();
 	
 	m_scene = new SceneCube(*m_pipeline);
@@ -82,6 +99,15 @@ void PixelPipeWindow::init()
 		m_scene->setTexture(m_textures.at(1), 1);
 	}
 	
+	if(m_mode == RENDER_SOFTWARE){
+		static_cast<SoftwarePipeline*>(m_pipeline)->enableDeferredShading(m_deferredShading);
+		static_cast<SoftwarePipeline*>(m_pipeline)->enableVisibilityBuffer(m_visibilityBuffer);
+		static_cast<SoftwarePipeline*>(m_pipeline)->setDrawOrder(m_drawOrder);
+		if(!m_fragmentProgram.empty()){
+			static_cast<SoftwarePipeline*>(m_pipeline)->setFragmentProgram(ShaderBytecode::load(m_fragmentProgram));
+		}
+	}
+	
 	m_pipeline->configure();
 	
 	m_scene->init();
@@ -89,6 +115,8 @@ void PixelPipeWindow::init()
 
 int PixelPipeWindow::render() 
 {	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
 	m_pipeline->clearFrameBuffer();
 	
 	glEnable(GL_DEPTH_TEST);
@@ -115,7 +143,23 @@ int PixelPipeWindow::render()
 	m_pipeline->loadIdentity();
 	m_pipeline->lookAt(eye, target, up);
 	
-	m_scene->render();
+	if(m_state->getZPrepass()){
+		// lay down the depth of the visible surface, then shade only that surface
+		m_pipeline->setRenderPass(RENDER_PASS_DEPTH);
+		m_pipeline->pushMatrix();
+		m_scene->render();
+		m_pipeline->popMatrix();
+		
+		m_pipeline->setRenderPass(RENDER_PASS_SHADE);
+		m_pipeline->pushMatrix();
+		m_scene->render();
+		m_pipeline->popMatrix();
+		
+		m_pipeline->setRenderPass(RENDER_PASS_FORWARD);
+	}
+	else{
+		m_scene->render();
+	}
 	
     glDisable(GL_LIGHTING);
     glDisable(GL_COLOR_MATERIAL);
@@ -124,6 +168,11 @@ int PixelPipeWindow::render()
 
 	m_pipeline->drawFrameBuffer();
 	
+	if(m_resolution && m_mode == RENDER_SOFTWARE){
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		static_cast<SoftwarePipeline*>(m_pipeline)->setRenderScale(m_resolution->update(elapsed.count()));
+	}
+	
 	return 0;
 }
 
@@ -13,6 +13,7 @@ Rasterizer::Rasterizer(int newNa, int newNx, int newNy) {
 	m_attributes = newNa;
 	m_frameWidth = newNx;
 	m_frameHeight = newNy;
+	m_flat = false;
 	
 	int n = 5 + m_attributes;
 	// vData is intended to be a multi-dimensional array of size [3][5+m_attributes]
@@ -97,9 +98,25 @@ void Rasterizer::rasterize(const Vertex* vs, FragmentProcessor& fp, FrameBuffer&
 		return;
 	}
 	
+	// When flat shading only the barycentric coordinates and the depth are
+	// interpolated; the attributes of the provoking vertex are used as is.
+	int interpolated = 5 + m_attributes;
+	int texcoord = m_flat ? -1 : fp.texcoordAttribute();
+	if (texcoord < 0) {
+		for (int k = 0; k < 4; k++){
+			m_frag->derivatives[k] = 0;
+		}
+	}
+	if (m_flat) {
+		interpolated = 4;
+		for (int ia = 0; ia < m_attributes; ia++){
+			m_frag->attributes[1 + ia] = vs[2].attributes[ia];
+		}
+	}
+	
 	// Triangle setup: compute the initial values and the x and y increments
 	// for each attribute.
-	for (int k = 0; k < 5 + m_attributes; k++) {
+	for (int k = 0; k < interpolated; k++) {
 		float da1 = m_vData[1*n + k] - m_vData[0*n + k];
 		float da2 = m_vData[2*n + k] - m_vData[0*n + k];
 		m_xInc[k] = (da1 * dy2 - da2 * dy1) / det;
@@ -112,26 +129,40 @@ void Rasterizer::rasterize(const Vertex* vs, FragmentProcessor& fp, FrameBuffer&
 	// a fragment.  In our case this means calling the fragment processor to
 	// process it immediately.
 	for (m_frag->y = iyMin; m_frag->y <= iyMax; m_frag->y++) {
-		for (int k = 0; k < 5 + m_attributes; k++){
+		for (int k = 0; k < interpolated; k++){
 			m_pixData[k] = m_rowData[k];
 		}
 		for (m_frag->x = ixMin; m_frag->x <= ixMax; m_frag->x++) {
 			if (m_pixData[0] >= 0 && m_pixData[1] >= 0 && m_pixData[2] >= 0) {
 				m_frag->attributes[0] = m_pixData[3];
-				float w = 1.0f / m_pixData[4 + m_attributes];
-				for (int ia = 0; ia < m_attributes; ia++){
-					m_frag->attributes[1 + ia] = m_pixData[4 + ia] * w;
+				if (!m_flat) {
+					float w = 1.0f / m_pixData[4 + m_attributes];
+					for (int ia = 0; ia < m_attributes; ia++){
+						m_frag->attributes[1 + ia] = m_pixData[4 + ia] * w;
+					}
+					if (texcoord >= 0) {
+						// the derivatives of a = A / W are (dA - a dW) / W
+						int iw = 4 + m_attributes;
+						float u = m_frag->attributes[1 + texcoord];
+						float v = m_frag->attributes[2 + texcoord];
+						m_frag->derivatives[0] = (m_xInc[4 + texcoord] - u * m_xInc[iw]) * w;
+						m_frag->derivatives[1] = (m_xInc[5 + texcoord] - v * m_xInc[iw]) * w;
+						m_frag->derivatives[2] = (m_yInc[4 + texcoord] - u * m_yInc[iw]) * w;
+						m_frag->derivatives[3] = (m_yInc[5 + texcoord] - v * m_yInc[iw]) * w;
+					}
 				}
 				fp.fragment(*m_frag, fb);
 			}
-			for (int k = 0; k < 5 + m_attributes; k++){
+			for (int k = 0; k < interpolated; k++){
 				m_pixData[k] += m_xInc[k];
 			}
 		}
-		for (int k = 0; k < 5 + m_attributes; k++){
+		for (int k = 0; k < interpolated; k++){
 			m_rowData[k] += m_yInc[k];
 		}
 	}
+	
+	fp.flush(fb);
 }
 
 
@@ -0,0 +1,43 @@
+#include <math.h>
+#include <algorithm>
+
+#include "core/resolution.h"
+
+namespace pixelpipe {
+
+ResolutionController::ResolutionController(float budget, float minScale, float maxScale)
+	: m_budget(budget), m_minScale(minScale), m_maxScale(maxScale), m_scale(maxScale), m_time(0)
+{
+}
+
+float ResolutionController::update(float milliseconds)
+{
+	if(m_budget <= 0.0f || milliseconds <= 0.0f) return m_scale;
+
+	// an exponential moving average absorbs single slow frames
+	m_time = (m_time == 0.0f) ? milliseconds : m_time + 0.25f * (milliseconds - m_time);
+
+	float ratio = m_budget / m_time;
+	if(ratio > 0.95f && ratio < 1.05f) return m_scale;
+
+	float target = m_scale * sqrtf(ratio);
+	target = std::max(m_scale * 0.9f, std::min(target, m_scale * 1.1f));
+	target = floorf(target * 64.0f + 0.5f) / 64.0f;
+
+	// near the smallest scales the rounding cancels steps of a few percent
+	if(target == m_scale) target += (ratio > 1.0f ? 1.0f : -1.0f) / 64.0f;
+	target = std::max(m_minScale, std::min(target, m_maxScale));
+
+	// a step that would not bring the time closer to the budget is not taken,
+	// so the scale settles on one step instead of alternating between two
+	float predicted = ratio * (m_scale * m_scale) / (target * target);
+	if(fabsf(logf(predicted)) >= fabsf(logf(ratio))) return m_scale;
+
+	// the next frame times measure the new scale
+	m_time *= (target * target) / (m_scale * m_scale);
+	m_scale = target;
+
+	return m_scale;
+}
+
+}	// namespace pixelpipe
@@ -0,0 +1,42 @@
+
+#include "core/shader_program.h"
+#include "core/shader_stages.h"
+
+namespace pixelpipe {
+
+/**
+ * Instantiates the per-fragment lighting programs for a runtime light count.
+ */
+template<template<int> class Program>
+static ShaderProgram* createLitProgram(size_t lights, int width, int height)
+{
+	switch(lights){
+		case 1: return new typename Program<1>::type(width, height);
+		case 2: return new typename Program<2>::type(width, height);
+		case 3: return new typename Program<3>::type(width, height);
+		case 4: return new typename Program<4>::type(width, height);
+		default: return NULL;
+	}
+}
+
+ShaderProgram* createShaderProgram(const State& state, int width, int height)
+{
+	// this mirrors the selection made by SoftwarePipeline::configure()
+	if(state.getTexturing2D()){
+		return createLitProgram<TexturedPhongProgram>(state.getLights().size(), width, height);
+	}
+	else if(state.getShadeModel() == SHADE_FLAT){
+		// flat shading relies on the Rasterizer, keep the processors
+		return NULL;
+	}
+	else if(state.getLighting()){
+		if(state.getDepthTest()) return new SmoothShadedZBufferProgram(width, height);
+		else return new SmoothShadedProgram(width, height);
+	}
+	else{
+		if(state.getDepthTest()) return new ConstColorZBufferProgram(width, height);
+		else return new ConstColorProgram(width, height);
+	}
+}
+
+}	// namespace pixelpipe
@@ -20,6 +20,17 @@ State::State()
 	m_lightingEnabled = false;
 	m_depthTestEnabled = false;
 	m_texture2dEnabled = false;
+	m_mathPrecision = MATH_PRECISION_EXACT;
+	m_shadingLODEnabled = false;
+	m_zPrepassEnabled = false;
+	m_textureFilter = TEXTURE_FILTER_LINEAR;
+	m_mipmapFilter = MIPMAP_FILTER_BOX;
+	m_textureStorage = TEXTURE_STORAGE_NATIVE;
+	m_textureLayout = TEXTURE_LAYOUT_LINEAR;
+	m_phongThreshold = 96.0f;
+	m_gouraudThreshold = 12.0f;
+	
+	m_specularTable = new SpecularTable(specularExponent);
 	
 	this->lights = new std::vector<PointLight>();
 }
@@ -27,6 +38,7 @@ State::State()
 State::~State()
 {
 	// delete values ...
+	delete m_specularTable;
 }
 
 void State::setShadeModel(const shade_model value)
@@ -64,6 +76,45 @@ void State::enableTexturing2D(bool value)
 	this->m_texture2dEnabled = value;
 }
 
+void State::enableShadingLOD(bool value)
+{
+	this->m_shadingLODEnabled = value;
+}
+
+void State::enableZPrepass(bool value)
+{
+	this->m_zPrepassEnabled = value;
+}
+
+void State::setTextureFilter(texture_filter filter, mipmap_filter mipmaps)
+{
+	this->m_textureFilter = filter;
+	this->m_mipmapFilter = mipmaps;
+}
+
+void State::setTextureStorage(texture_storage storage)
+{
+	this->m_textureStorage = storage;
+}
+
+void State::setTextureLayout(texture_layout layout)
+{
+	this->m_textureLayout = layout;
+}
+
+void State::setShadingLODThresholds(float phong, float gouraud)
+{
+	if(gouraud > phong) throw "Invalid shading thresholds.";
+	
+	this->m_phongThreshold = phong;
+	this->m_gouraudThreshold = gouraud;
+}
+
+void State::setMathPrecision(const math_precision value)
+{
+	this->m_mathPrecision = value;
+}
+
 void State::setAmbientIntensity(float value)
 {
 	this->ambientIntensity = value;
@@ -72,6 +123,10 @@ void State::setAmbientIntensity(float value)
 void State::setSpecularExponent(float value)
 {
 	this->specularExponent = value;
+	
+	if(m_specularTable->getExponent() != value){
+		m_specularTable->rebuild(value);
+	}
 }
 
 void State::setSpecularColor(Color3f* color)
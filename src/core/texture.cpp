@@ -1,8 +1,13 @@
 #include <string>
+#include <string.h>
 #include <math.h>
+#include <thread>
+#include <algorithm>
 
 #include "core/common.h"
 #include "core/texture.h"
+#include "core/fastmath.h"
+#include "core/pixel_converter.h"
 
 namespace pixelpipe {
 	
@@ -12,6 +17,11 @@ using namespace cg::image;
 Texture::Texture()
 {
 	m_raster = NULL;
+	m_filter = TEXTURE_FILTER_LINEAR;
+	m_mipmapFilter = MIPMAP_FILTER_BOX;
+	m_format = TEXTURE_FORMAT_FLOAT;
+	m_layout = TEXTURE_LAYOUT_LINEAR;
+	m_sampler = NULL;
 }
 
 // TODO: Not supporting the last parameter yet!
@@ -43,6 +53,11 @@ Texture::Texture(const unsigned width, const unsigned height, const unsigned cha
 	}
 	*/
 	m_raster = new FloatRaster(width, height, channels);
+	m_filter = TEXTURE_FILTER_LINEAR;
+	m_mipmapFilter = MIPMAP_FILTER_BOX;
+	m_format = TEXTURE_FORMAT_FLOAT;
+	m_layout = TEXTURE_LAYOUT_LINEAR;
+	m_sampler = NULL;
 }
 
 Texture::Texture(std::string filename)
@@ -52,6 +67,11 @@ Texture::Texture(std::string filename)
 	///char* nom = (char*)'/Users/Caleb/Development/OpenSource/pixelpipe/resources/textures/carbonite.png';
 	ByteRaster* byte_image = cg::image::read_image(filename.c_str());	// only supports TIFF, JPEG, and PNG
 	m_raster = new FloatRaster(*byte_image);
+	m_filter = TEXTURE_FILTER_LINEAR;
+	m_mipmapFilter = MIPMAP_FILTER_BOX;
+	m_format = TEXTURE_FORMAT_FLOAT;
+	m_layout = TEXTURE_LAYOUT_LINEAR;
+	m_sampler = NULL;
 	// DEV() << "Texture::Texture(" << filename.c_str() << ")";
 
 	//reinterpret_cast<const char*>( interleaved_view_get_raw_data(imageView) ) 
@@ -61,6 +81,8 @@ Texture::Texture(std::string filename)
 
 Texture::~Texture()
 {
+	deleteMipmaps();
+	deleteTexels();
 	if(m_raster!=NULL) delete m_raster;
 }
 
@@ -76,17 +98,578 @@ int Texture::height() const
 
 void Texture::setTextureData(const unsigned width, const unsigned height, const unsigned channels, const void* data)
 {
+	deleteMipmaps();
+	deleteTexels();
 	if(m_raster!=NULL){
 		delete m_raster;
 	}
-	m_raster = new FloatRaster(width, height, channels, (float*) data);
+	// the raster constructor copies as many bytes as there are components
+	m_raster = new FloatRaster(width, height, channels);
+	memcpy(m_raster->head(), data, sizeof(float) * m_raster->length());
+	m_format = TEXTURE_FORMAT_FLOAT;
+	m_layout = TEXTURE_LAYOUT_LINEAR;
+	m_sampler = NULL;
 }
 
 void Texture::setTextureData(const cg::image::FloatRaster& buffer)
 {
+	deleteMipmaps();
+	deleteTexels();
+	m_format = TEXTURE_FORMAT_FLOAT;
+	m_layout = TEXTURE_LAYOUT_LINEAR;
+	m_sampler = NULL;
 	if(m_raster!=NULL) delete m_raster;
 	
-	*m_raster = buffer;
+	// the raster has no copy assignment, its data is copied
+	m_raster = new FloatRaster(buffer.width(), buffer.height(), buffer.channels());
+	memcpy(m_raster->head(), buffer.head(), sizeof(float) * buffer.length());
+}
+
+// Shifted into the exponent and mantissa of a float, a half is 2^-112 times
+// its value, subnormals included.
+float Texture::halfToFloat(const unsigned short h)
+{
+	unsigned bits = (unsigned) (h & 0x7fff) << 13;
+	if((h & 0x7c00) == 0x7c00) bits |= 0x7f800000;	// infinities and NaNs
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	if((h & 0x7c00) != 0x7c00) f *= 5.192296858534828e+33f;
+	return (h & 0x8000) ? -f : f;
+}
+
+unsigned short Texture::floatToHalf(const float f)
+{
+	unsigned bits;
+	memcpy(&bits, &f, sizeof(bits));
+	unsigned short sign = (bits >> 16) & 0x8000;
+	int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+	unsigned mantissa = bits & 0x7fffff;
+	
+	if(((bits >> 23) & 0xff) == 0xff) return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+	if(exponent >= 31) return sign | 0x7c00;
+	if(exponent <= 0){
+		if(exponent < -10) return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		unsigned short half = (unsigned short) (mantissa >> shift);
+		if((mantissa >> (shift - 1)) & 1) half++;
+		return sign | half;
+	}
+	
+	// a carry of the rounding moves on to the exponent
+	unsigned short half = sign | (unsigned short) (exponent << 10) | (unsigned short) (mantissa >> 13);
+	if(mantissa & 0x1000) half++;
+	return half;
+}
+
+/**
+ * Clamps a component to [0, 1] and rounds it to an integer in [0, max].
+ */
+static inline unsigned quantize(float f, unsigned max)
+{
+	f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+	return (unsigned) (f * max + 0.5f);
+}
+
+/**
+ * @return the number of components of a pixel of the given layout.
+ */
+static int components(pixel_format format)
+{
+	switch(format){
+		case PIXEL_FORMAT_RGB:
+		case PIXEL_FORMAT_BGR:
+			return 3;
+		case PIXEL_FORMAT_RGBA:
+		case PIXEL_FORMAT_BGRA:
+			return 4;
+		case PIXEL_FORMAT_LUMINANCE_ALPHA:
+			return 2;
+		default:
+			return 1;
+	}
+}
+
+/**
+ * Reads the component i of pixels of the given type, normalized to [0, 1]
+ * (the signed integer types to [-1, 1]).
+ */
+static float component(const void* data, pixel_type type, size_t i)
+{
+	switch(type){
+		case PIXEL_TYPE_BYTE:
+			return std::max(-1.0f, ((const signed char*) data)[i] / 127.0f);
+		case PIXEL_TYPE_UNSIGNED_BYTE:
+			return ((const unsigned char*) data)[i] / 255.0f;
+		case PIXEL_TYPE_UNSIGNED_SHORT:
+			return ((const unsigned short*) data)[i] / 65535.0f;
+		case PIXEL_TYPE_SHORT:
+			return std::max(-1.0f, ((const short*) data)[i] / 32767.0f);
+		case PIXEL_TYPE_UNSIGNED_INT:
+			return (float) (((const unsigned int*) data)[i] / 4294967295.0);
+		case PIXEL_TYPE_INT:
+			return (float) std::max(-1.0, ((const int*) data)[i] / 2147483647.0);
+		case PIXEL_TYPE_HALF_FLOAT:
+			return Texture::halfToFloat(((const unsigned short*) data)[i]);
+		default:
+			return ((const float*) data)[i];
+	}
+}
+
+/**
+ * Unpacks an RGB565 pixel, red in the high bits.
+ */
+static inline void unpack565(unsigned short p, float* rgba)
+{
+	rgba[0] = (p >> 11) * (1.0f / 31.0f);
+	rgba[1] = ((p >> 5) & 0x3f) * (1.0f / 63.0f);
+	rgba[2] = (p & 0x1f) * (1.0f / 31.0f);
+	rgba[3] = 1.0f;
+}
+
+/**
+ * Reads the pixel i of the data supplied to setTextureData() as RGBA.
+ */
+static void readPixel(const void* data, pixel_format format, pixel_type type, size_t i, float* rgba)
+{
+	if(type == PIXEL_TYPE_UNSIGNED_SHORT_5_6_5){
+		unpack565(((const unsigned short*) data)[i], rgba);
+		return;
+	}
+	
+	size_t first = i * components(format);
+	switch(format){
+		case PIXEL_FORMAT_RGB:
+		case PIXEL_FORMAT_RGBA:
+			rgba[0] = component(data, type, first);
+			rgba[1] = component(data, type, first + 1);
+			rgba[2] = component(data, type, first + 2);
+			rgba[3] = (format == PIXEL_FORMAT_RGBA) ? component(data, type, first + 3) : 1.0f;
+			break;
+		case PIXEL_FORMAT_BGR:
+		case PIXEL_FORMAT_BGRA:
+			rgba[0] = component(data, type, first + 2);
+			rgba[1] = component(data, type, first + 1);
+			rgba[2] = component(data, type, first);
+			rgba[3] = (format == PIXEL_FORMAT_BGRA) ? component(data, type, first + 3) : 1.0f;
+			break;
+		default:
+			rgba[0] = rgba[1] = rgba[2] = component(data, type, first);
+			rgba[3] = (format == PIXEL_FORMAT_LUMINANCE_ALPHA) ? component(data, type, first + 1) : 1.0f;
+			break;
+	}
+}
+
+/**
+ * Packs an RGBA color into a texel of a compact format.
+ */
+static inline void writeTexel(texture_format format, const float* rgba, unsigned char* texel)
+{
+	switch(format){
+		case TEXTURE_FORMAT_RGBA8:
+		case TEXTURE_FORMAT_RGB8:
+			texel[0] = (unsigned char) quantize(rgba[0], 255);
+			texel[1] = (unsigned char) quantize(rgba[1], 255);
+			texel[2] = (unsigned char) quantize(rgba[2], 255);
+			if(format == TEXTURE_FORMAT_RGBA8) texel[3] = (unsigned char) quantize(rgba[3], 255);
+			break;
+		case TEXTURE_FORMAT_L8:
+		case TEXTURE_FORMAT_LA8:
+			texel[0] = (unsigned char) quantize(0.299f * rgba[0] + 0.587f * rgba[1] + 0.114f * rgba[2], 255);
+			if(format == TEXTURE_FORMAT_LA8) texel[1] = (unsigned char) quantize(rgba[3], 255);
+			break;
+		case TEXTURE_FORMAT_RGB565:
+			*(unsigned short*) texel = (unsigned short) (quantize(rgba[0], 31) << 11 | quantize(rgba[1], 63) << 5 | quantize(rgba[2], 31));
+			break;
+		case TEXTURE_FORMAT_HALF:
+			for(int c = 0; c < 4; c++) ((unsigned short*) texel)[c] = Texture::floatToHalf(rgba[c]);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * Unpacks a texel of a compact format into an RGBA color.
+ */
+static inline void readTexel(texture_format format, const unsigned char* texel, float* rgba)
+{
+	switch(format){
+		case TEXTURE_FORMAT_RGBA8:
+		case TEXTURE_FORMAT_RGB8:
+			rgba[0] = texel[0] * (1.0f / 255.0f);
+			rgba[1] = texel[1] * (1.0f / 255.0f);
+			rgba[2] = texel[2] * (1.0f / 255.0f);
+			rgba[3] = (format == TEXTURE_FORMAT_RGBA8) ? texel[3] * (1.0f / 255.0f) : 1.0f;
+			break;
+		case TEXTURE_FORMAT_L8:
+		case TEXTURE_FORMAT_LA8:
+			rgba[0] = rgba[1] = rgba[2] = texel[0] * (1.0f / 255.0f);
+			rgba[3] = (format == TEXTURE_FORMAT_LA8) ? texel[1] * (1.0f / 255.0f) : 1.0f;
+			break;
+		case TEXTURE_FORMAT_RGB565:
+			unpack565(*(const unsigned short*) texel, rgba);
+			break;
+		case TEXTURE_FORMAT_HALF:
+			for(int c = 0; c < 4; c++) rgba[c] = Texture::halfToFloat(((const unsigned short*) texel)[c]);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * The position of the texels of a level in the linear (row major) layout. The
+ * texel (x, y) is at column(x) + row(y), so that the four texels of a bilinear
+ * sample share their columns and rows.
+ */
+struct LinearAddress {
+	size_t width;
+	
+	LinearAddress(const ByteRaster& level) : width(level.width()) {}
+	
+	inline size_t column(int x) const { return x; }
+	inline size_t row(int y) const { return y * width; }
+};
+
+/**
+ * The position of the texels of a level in blocks of B x B texels, row major
+ * within the blocks and between them.
+ */
+template<unsigned B>
+struct BlockedAddress {
+	size_t blockRow;	//!< the texels of a row of blocks
+	
+	BlockedAddress(const ByteRaster& level) : blockRow((size_t) level.width() * B) {}
+	
+	inline size_t column(int x) const { return (size_t) ((unsigned) x / B) * (B * B) + (unsigned) x % B; }
+	inline size_t row(int y) const { return ((unsigned) y / B) * blockRow + ((unsigned) y % B) * B; }
+};
+
+/**
+ * The position of the texels of a level in Morton (Z) order: the bits of the
+ * coordinates are interleaved within squares as large as the shorter side of
+ * the level, and the squares are row major.
+ */
+struct MortonAddress {
+	unsigned shift;		//!< the log2 of the side of the squares
+	unsigned mask;		//!< the coordinates within a square
+	size_t squareRow;	//!< the texels of a row of squares
+	
+	MortonAddress(const ByteRaster& level)
+	{
+		unsigned side = (unsigned) std::min(level.width(), level.height());
+#if defined(__GNUC__)
+		shift = __builtin_ctz(side);
+#else
+		for(shift = 0; (1u << shift) < side; shift++);
+#endif
+		mask = side - 1;
+		squareRow = (size_t) ((unsigned) level.width() >> shift) << (2 * shift);
+	}
+	
+	/**
+	 * Spreads the 16 low bits of v to the even bits.
+	 */
+	static inline size_t spread(unsigned v)
+	{
+		v &= 0xffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+	
+	inline size_t column(int x) const { return ((size_t) ((unsigned) x >> shift) << (2 * shift)) + spread((unsigned) x & mask); }
+	inline size_t row(int y) const { return ((unsigned) y >> shift) * squareRow + (spread((unsigned) y & mask) << 1); }
+};
+
+/**
+ * Computes the size of the raster that stores a level in a layout: blocked
+ * levels are padded to whole blocks, Morton levels to powers of two.
+ */
+static void storageSize(texture_layout layout, int width, int height, int& sw, int& sh)
+{
+	sw = width;
+	sh = height;
+	switch(layout){
+		case TEXTURE_LAYOUT_BLOCKED_4X4:
+			sw = (width + 3) & ~3;
+			sh = (height + 3) & ~3;
+			break;
+		case TEXTURE_LAYOUT_BLOCKED_8X8:
+			sw = (width + 7) & ~7;
+			sh = (height + 7) & ~7;
+			break;
+		case TEXTURE_LAYOUT_MORTON:
+			for(sw = 1; sw < width; sw <<= 1);
+			for(sh = 1; sh < height; sh <<= 1);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * @return the position of the texel (x, y) in a level stored in a layout.
+ */
+static size_t texelIndex(texture_layout layout, const ByteRaster& level, int x, int y)
+{
+	switch(layout){
+		case TEXTURE_LAYOUT_BLOCKED_4X4: {
+			BlockedAddress<4> address(level);
+			return address.row(y) + address.column(x);
+		}
+		case TEXTURE_LAYOUT_BLOCKED_8X8: {
+			BlockedAddress<8> address(level);
+			return address.row(y) + address.column(x);
+		}
+		case TEXTURE_LAYOUT_MORTON: {
+			MortonAddress address(level);
+			return address.row(y) + address.column(x);
+		}
+		default:
+			return (size_t) y * level.width() + x;
+	}
+}
+
+/**
+ * Allocates the raster of a level of a compact format, the padding is cleared.
+ */
+static ByteRaster* allocateLevel(texture_format format, texture_layout layout, int width, int height)
+{
+	int sw, sh;
+	storageSize(layout, width, height, sw, sh);
+	ByteRaster* level = new ByteRaster(sw, sh, Texture::texelSize(format));
+	if(sw != width || sh != height) memset(level->head(), 0, level->length());
+	return level;
+}
+
+/**
+ * Unpacks a level of a compact format into an RGBA float raster.
+ */
+static FloatRaster* unpackLevel(const ByteRaster& level, int width, int height, texture_format format, texture_layout layout)
+{
+	FloatRaster* raster = new FloatRaster(width, height, 4);
+	float* out = raster->head();
+	for(int y = 0; y < height; y++){
+		for(int x = 0; x < width; x++, out += 4) readTexel(format, level.head() + texelIndex(layout, level, x, y) * level.channels(), out);
+	}
+	return raster;
+}
+
+/**
+ * Packs an RGBA float raster into a level of a compact format.
+ */
+static ByteRaster* packLevel(const FloatRaster& raster, texture_format format, texture_layout layout)
+{
+	ByteRaster* level = allocateLevel(format, layout, raster.width(), raster.height());
+	const float* in = raster.head();
+	for(int y = 0; y < raster.height(); y++){
+		for(int x = 0; x < raster.width(); x++, in += 4) writeTexel(format, in, level->head() + texelIndex(layout, *level, x, y) * level->channels());
+	}
+	return level;
+}
+
+/**
+ * The four texels around a sample point and the weights between them, with
+ * texel centers at (i + 0.5) / size and repeating coordinates.
+ */
+struct TexelQuad {
+	int x0, x1, y0, y1;
+	float ax, ay;
+	
+	TexelQuad(int nx, int ny, float u, float v)
+	{
+		float x = u * nx - 0.5f;
+		float y = v * ny - 0.5f;
+		float fx = floorf(x);
+		float fy = floorf(y);
+		ax = x - fx;
+		ay = y - fy;
+		
+		x0 = (int) fx % nx;
+		y0 = (int) fy % ny;
+		if(x0 < 0) x0 += nx;
+		if(y0 < 0) y0 += ny;
+		x1 = (x0 + 1 == nx) ? 0 : x0 + 1;
+		y1 = (y0 + 1 == ny) ? 0 : y0 + 1;
+	}
+};
+
+/**
+ * Samples a level of 8 bit components bilinearly in integers: the weights
+ * have 8 bits and the four of them sum to 65536. Luminance formats of fewer
+ * than 3 components are returned as gray.
+ */
+template<int N, class A>
+static Color3f sampleBytes(const ByteRaster& level, int width, int height, float u, float v)
+{
+	TexelQuad q(width, height, u, v);
+	int wx = (int) (q.ax * 256.0f + 0.5f);
+	int wy = (int) (q.ay * 256.0f + 0.5f);
+	int w00 = (256 - wx) * (256 - wy), w10 = wx * (256 - wy);
+	int w01 = (256 - wx) * wy, w11 = wx * wy;
+	
+	A address(level);
+	size_t x0 = address.column(q.x0), x1 = address.column(q.x1);
+	size_t y0 = address.row(q.y0), y1 = address.row(q.y1);
+	const unsigned char* data = level.head();
+	const unsigned char* p00 = data + (y0 + x0) * N;
+	const unsigned char* p10 = data + (y0 + x1) * N;
+	const unsigned char* p01 = data + (y1 + x0) * N;
+	const unsigned char* p11 = data + (y1 + x1) * N;
+	
+	const float scale = 1.0f / (255.0f * 65536.0f);
+	if(N < 3){
+		float l = (p00[0] * w00 + p10[0] * w10 + p01[0] * w01 + p11[0] * w11) * scale;
+		return Color3f(l, l, l);
+	}
+	return Color3f((p00[0] * w00 + p10[0] * w10 + p01[0] * w01 + p11[0] * w11) * scale,
+		(p00[1] * w00 + p10[1] * w10 + p01[1] * w01 + p11[1] * w11) * scale,
+		(p00[2] * w00 + p10[2] * w10 + p01[2] * w01 + p11[2] * w11) * scale);
+}
+
+/**
+ * Samples a level of RGB565 or half float texels bilinearly, unpacking the four
+ * texels to floats.
+ */
+template<texture_format F, class A>
+static Color3f sampleUnpacked(const ByteRaster& level, int width, int height, float u, float v)
+{
+	int size = level.channels();
+	TexelQuad q(width, height, u, v);
+	
+	A address(level);
+	size_t x0 = address.column(q.x0), x1 = address.column(q.x1);
+	size_t y0 = address.row(q.y0), y1 = address.row(q.y1);
+	const unsigned char* data = level.head();
+	float c00[4], c10[4], c01[4], c11[4];
+	readTexel(F, data + (y0 + x0) * size, c00);
+	readTexel(F, data + (y0 + x1) * size, c10);
+	readTexel(F, data + (y1 + x0) * size, c01);
+	readTexel(F, data + (y1 + x1) * size, c11);
+	
+	float w00 = (1.0f - q.ax) * (1.0f - q.ay), w10 = q.ax * (1.0f - q.ay);
+	float w01 = (1.0f - q.ax) * q.ay, w11 = q.ax * q.ay;
+	return Color3f(c00[0] * w00 + c10[0] * w10 + c01[0] * w01 + c11[0] * w11,
+		c00[1] * w00 + c10[1] * w10 + c01[1] * w01 + c11[1] * w11,
+		c00[2] * w00 + c10[2] * w10 + c01[2] * w01 + c11[2] * w11);
+}
+
+typedef Color3f (*TexelSampler)(const ByteRaster& level, int width, int height, float u, float v);
+
+/**
+ * @return the sampler of a compact format in the layout addressed by A.
+ */
+template<class A>
+static TexelSampler samplerOf(texture_format format)
+{
+	switch(format){
+		case TEXTURE_FORMAT_RGBA8: return sampleBytes<4, A>;
+		case TEXTURE_FORMAT_RGB8: return sampleBytes<3, A>;
+		case TEXTURE_FORMAT_LA8: return sampleBytes<2, A>;
+		case TEXTURE_FORMAT_L8: return sampleBytes<1, A>;
+		case TEXTURE_FORMAT_RGB565: return sampleUnpacked<TEXTURE_FORMAT_RGB565, A>;
+		case TEXTURE_FORMAT_HALF: return sampleUnpacked<TEXTURE_FORMAT_HALF, A>;
+		default: return NULL;
+	}
+}
+
+void Texture::setTextureData(const unsigned width, const unsigned height, const pixel_format format, const pixel_type type, const void* data, const texture_format storage, const texture_layout layout)
+{
+	deleteMipmaps();
+	deleteTexels();
+	if(m_raster!=NULL) delete m_raster;
+	m_format = storage;
+	m_layout = TEXTURE_LAYOUT_LINEAR;
+	m_sampler = NULL;
+	
+	size_t count = (size_t) width * height;
+	float rgba[4];
+	if(storage == TEXTURE_FORMAT_FLOAT){
+		int channels = (type == PIXEL_TYPE_UNSIGNED_SHORT_5_6_5) ? 3 : components(format);
+		m_raster = new FloatRaster(width, height, channels);
+		float* texel = m_raster->head();
+		for(size_t i = 0; i < count; i++, texel += channels){
+			readPixel(data, format, type, i, rgba);
+			if(channels == 2){
+				texel[0] = rgba[0];
+				texel[1] = rgba[3];
+			}
+			else for(int c = 0; c < channels; c++) texel[c] = rgba[c];
+		}
+		return;
+	}
+	
+	// the raster of a compact texture only holds its size
+	m_raster = new FloatRaster(width, height, 0);
+	m_layout = layout;
+	ByteRaster* level = allocateLevel(storage, layout, width, height);
+	for(size_t i = 0; i < count; i++){
+		readPixel(data, format, type, i, rgba);
+		writeTexel(storage, rgba, level->head() + texelIndex(layout, *level, (int) (i % width), (int) (i / width)) * level->channels());
+	}
+	m_texels.push_back(level);
+	
+	switch(layout){
+		case TEXTURE_LAYOUT_BLOCKED_4X4: m_sampler = samplerOf<BlockedAddress<4> >(storage);
+			break;
+		case TEXTURE_LAYOUT_BLOCKED_8X8: m_sampler = samplerOf<BlockedAddress<8> >(storage);
+			break;
+		case TEXTURE_LAYOUT_MORTON: m_sampler = samplerOf<MortonAddress>(storage);
+			break;
+		default: m_sampler = samplerOf<LinearAddress>(storage);
+			break;
+	}
+}
+
+texture_format Texture::storageFormat(const pixel_format format, const pixel_type type, const texture_storage storage)
+{
+	if(storage == TEXTURE_STORAGE_RGB565) return TEXTURE_FORMAT_RGB565;
+	if(storage == TEXTURE_STORAGE_HALF) return TEXTURE_FORMAT_HALF;
+	if(storage == TEXTURE_STORAGE_NATIVE){
+		if(type == PIXEL_TYPE_FLOAT) return TEXTURE_FORMAT_FLOAT;
+		if(type == PIXEL_TYPE_HALF_FLOAT) return TEXTURE_FORMAT_HALF;
+		if(type == PIXEL_TYPE_UNSIGNED_SHORT_5_6_5) return TEXTURE_FORMAT_RGB565;
+	}
+	
+	// the other types keep 8 bits per component
+	if(type == PIXEL_TYPE_UNSIGNED_SHORT_5_6_5) return TEXTURE_FORMAT_RGB8;
+	switch(format){
+		case PIXEL_FORMAT_RGB:
+		case PIXEL_FORMAT_BGR:
+			return TEXTURE_FORMAT_RGB8;
+		case PIXEL_FORMAT_RGBA:
+		case PIXEL_FORMAT_BGRA:
+			return TEXTURE_FORMAT_RGBA8;
+		case PIXEL_FORMAT_LUMINANCE_ALPHA:
+			return TEXTURE_FORMAT_LA8;
+		default:
+			return TEXTURE_FORMAT_L8;
+	}
+}
+
+unsigned Texture::texelSize(const texture_format format)
+{
+	switch(format){
+		case TEXTURE_FORMAT_RGBA8: return 4;
+		case TEXTURE_FORMAT_RGB8: return 3;
+		case TEXTURE_FORMAT_LA8: return 2;
+		case TEXTURE_FORMAT_L8: return 1;
+		case TEXTURE_FORMAT_RGB565: return 2;
+		case TEXTURE_FORMAT_HALF: return 8;
+		default: return 0;
+	}
+}
+
+size_t Texture::memory() const
+{
+	size_t bytes = (m_raster!=NULL) ? sizeof(float) * m_raster->length() : 0;
+	for(unsigned i = 0; i < m_mipmaps.size(); i++) bytes += sizeof(float) * m_mipmaps[i]->length();
+	for(unsigned i = 0; i < m_texels.size(); i++) bytes += m_texels[i]->length();
+	return bytes;
 }
 
 // TODO: Re-implement this function, apparently this doesn't work
@@ -94,73 +677,291 @@ void Texture::write(std::string filename)
 {
 	if(m_raster==NULL) return;
 	
+	// a compact texture is written from its base level in floats
+	FloatRaster* unpacked = m_texels.empty() ? NULL : unpackLevel(*m_texels[0], width(), height(), m_format, m_layout);
+	const FloatRaster* raster = (unpacked != NULL) ? unpacked : m_raster;
+	
 	// IMG_PNG=1, IMG_TIFF=2, IMG_JPEG=3
-	ByteRaster* byte_image = new ByteRaster(*m_raster);
+	int channels = raster->channels();
+	ByteRaster* byte_image;
+	if(channels == 3 || channels == 4){
+		byte_image = new ByteRaster(raster->width(), raster->height(), channels);
+		PixelConverter converter(channels == 4 ? CHANNEL_ORDER_RGBA : CHANNEL_ORDER_RGB);
+		converter.convert(raster->head(), channels, raster->width(), raster->height(), byte_image->head());
+	}
+	else{
+		byte_image = new ByteRaster(*raster);
+	}
 	cg::image::write_image(filename.c_str(), *byte_image, IMG_PNG);
+	delete byte_image;
+	if(unpacked != NULL) delete unpacked;
 }
 
 Color3f Texture::sample(const float u, const float v) const
 {
-	Color3f cOut;
-	
-	float s = fabs(u);
-	float t = fabs(v);
-	
-	// TO-DO: Check for null input in cOut parameter...
-	int nx = m_raster->width();
-	int ny = m_raster->height();
-	int channels = m_raster->channels();
-	float iX = s * nx + 0.5;
-	float iY = t * ny + 0.5;
-	
-	// compute interpolation weights
-	int x = (int) std::floor(iX);
-	int y = (int) std::floor(iY);
-	float uRatio = iX - x;
-	float vRatio = iY - y;
-	float uWeighted = 1.0 - uRatio;
-	float vWeighted = 1.0 - vRatio;
-	
-	Color3f leftTop;
-	Color3f rightTop;
-	Color3f leftBottom;
-	Color3f rightBottom;
-	
-	// store color of first corner
-	int offset = channels * (nx * y + x);
-	if(offset >= m_raster->length()) offset = m_raster->length() - channels;
-	leftTop.set(m_raster->at(offset + 0), m_raster->at(offset + 1), m_raster->at(offset + 2));
-	leftTop *= uWeighted;
-	
-	// store color of second corner
-	offset = channels * (nx * y + x + 1);
-	if(offset >= m_raster->length()) offset = m_raster->length() - channels;
-	rightTop.set(m_raster->at(offset + 0), m_raster->at(offset + 1), m_raster->at(offset + 2));
-	rightTop *= uRatio;
-	
-	// apply interpolation
-	rightTop += leftTop;
-	rightTop *= vWeighted;
-	
-	// store color of third corner
-	offset = channels * (nx * (y+1) + x);
-	if(offset >= m_raster->length()) offset = m_raster->length() - channels;
-	leftBottom.set(m_raster->at(offset + 0), m_raster->at(offset + 1), m_raster->at(offset + 2));
-	leftBottom *= uWeighted;
-	
-	// store color of fourth corner
-	offset = channels * (nx * (y+1) + x + 1);
-	if(offset >= m_raster->length()) offset = m_raster->length() - channels;
-	rightBottom.set(m_raster->at(offset + 0), m_raster->at(offset + 1), m_raster->at(offset + 2));
-	rightBottom *= uRatio;
-	
-	// apply interpolation
-	rightBottom += leftBottom;
-	rightBottom *= vRatio;
-	
-	cOut = rightBottom + rightTop;
-	
-	return cOut;
-}
-
-}	// namespace pixelpipe
\ No newline at end of file
+	// float and compact levels share their addressing, only the storage differs
+	return sampleMip(0, u, v);
+}
+
+Color3f Texture::sampleLevel(const FloatRaster& level, float u, float v) const
+{
+	int nx = level.width();
+	int ny = level.height();
+	int channels = level.channels();
+	
+	float x = u * nx - 0.5f;
+	float y = v * ny - 0.5f;
+	float fx = floorf(x);
+	float fy = floorf(y);
+	float ax = x - fx;
+	float ay = y - fy;
+	
+	int x0 = (int) fx % nx, y0 = (int) fy % ny;
+	if(x0 < 0) x0 += nx;
+	if(y0 < 0) y0 += ny;
+	int x1 = (x0 + 1 == nx) ? 0 : x0 + 1;
+	int y1 = (y0 + 1 == ny) ? 0 : y0 + 1;
+	
+	const float* data = level.head();
+	const float* p00 = data + (y0 * nx + x0) * channels;
+	const float* p10 = data + (y0 * nx + x1) * channels;
+	const float* p01 = data + (y1 * nx + x0) * channels;
+	const float* p11 = data + (y1 * nx + x1) * channels;
+	
+	float w00 = (1.0f - ax) * (1.0f - ay), w10 = ax * (1.0f - ay);
+	float w01 = (1.0f - ax) * ay, w11 = ax * ay;
+	if(channels < 3){
+		// luminance, with or without alpha
+		float l = p00[0] * w00 + p10[0] * w10 + p01[0] * w01 + p11[0] * w11;
+		return Color3f(l, l, l);
+	}
+	return Color3f(p00[0] * w00 + p10[0] * w10 + p01[0] * w01 + p11[0] * w11,
+		p00[1] * w00 + p10[1] * w10 + p01[1] * w01 + p11[1] * w11,
+		p00[2] * w00 + p10[2] * w10 + p01[2] * w01 + p11[2] * w11);
+}
+
+Color3f Texture::sampleMip(int level, float u, float v) const
+{
+	if(m_sampler != NULL) return m_sampler(*m_texels[level], std::max(1, width() >> level), std::max(1, height() >> level), u, v);
+	return sampleLevel(level == 0 ? *m_raster : *m_mipmaps[level - 1], u, v);
+}
+
+float Texture::lod(const float* derivatives) const
+{
+	float w = (float) width(), h = (float) height();
+	float dx = derivatives[0] * w, dy = derivatives[1] * h;
+	float ex = derivatives[2] * w, ey = derivatives[3] * h;
+	float rho2 = std::max(dx * dx + dy * dy, ex * ex + ey * ey);
+	if(rho2 <= 1.0f) return 0.0f;
+	
+	// log2(sqrt(rho2)), the polynomial is accurate enough to blend levels
+	return 0.5f * FastMath::log2(rho2, MATH_PRECISION_FAST);
+}
+
+Color3f Texture::sample(const float u, const float v, const float* derivatives) const
+{
+	// magnified pixels sample the base level the same way with every filter
+	if(m_filter == TEXTURE_FILTER_LINEAR || levels() == 1) return sample(u, v);
+	
+	float lambda = lod(derivatives);
+	if(lambda <= 0.0f) return sample(u, v);
+	
+	int last = (int) levels() - 1;
+	if(m_filter == TEXTURE_FILTER_NEAREST_MIPMAP || lambda >= last){
+		int level = std::min((int) (lambda + 0.5f), last);
+		return sampleMip(level, u, v);
+	}
+	
+	int level = (int) lambda;
+	float t = lambda - level;
+	Color3f fine = sampleMip(level, u, v);
+	Color3f coarse = sampleMip(level + 1, u, v);
+	return fine * (1.0f - t) + coarse * t;
+}
+
+/**
+ * The weights of the taps that filter one texel of a mip level from the previous
+ * level. The taps of texel i start at the source texel 2 * i + first.
+ */
+struct MipKernel {
+	int taps;
+	int first;
+	float weights[8];
+	
+	MipKernel(mipmap_filter filter, int size)
+	{
+		if(size == 1){
+			// a dimension of a single texel is not reduced
+			taps = 1;
+			first = 0;
+			weights[0] = 1.0f;
+		}
+		else if(filter == MIPMAP_FILTER_KAISER){
+			// a sinc with a cutoff at the new Nyquist frequency, windowed by a
+			// Kaiser window (alpha = 4) over 4 source texels on each side
+			taps = 8;
+			first = -3;
+			float sum = 0.0f;
+			for(int k = 0; k < taps; k++){
+				float d = k + first - 0.5f;
+				float x = (float) PI * d * 0.5f;
+				float r = d / 4.0f;
+				weights[k] = (sinf(x) / x) * bessel(4.0f * sqrtf(std::max(0.0f, 1.0f - r * r))) / bessel(4.0f);
+				sum += weights[k];
+			}
+			for(int k = 0; k < taps; k++) weights[k] /= sum;
+		}
+		else{
+			taps = 2;
+			first = 0;
+			weights[0] = weights[1] = 0.5f;
+		}
+	}
+	
+	/**
+	 * The zeroth order modified Bessel function of the first kind.
+	 */
+	static float bessel(float x)
+	{
+		float sum = 1.0f, term = 1.0f;
+		for(int k = 1; k < 16; k++){
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+		}
+		return sum;
+	}
+	
+	/**
+	 * @return the source texel of a tap, repeating at the edges.
+	 */
+	static inline int wrap(int i, int size)
+	{
+		i %= size;
+		return i < 0 ? i + size : i;
+	}
+};
+
+/**
+ * Filters the rows [first, last) of a raster horizontally into a raster of width dw.
+ */
+static void reduceRows(const float* src, int sw, int channels, const MipKernel& kernel, float* dst, int dw, int first, int last)
+{
+	for(int y = first; y < last; y++){
+		const float* row = src + (size_t) y * sw * channels;
+		float* out = dst + (size_t) y * dw * channels;
+		for(int x = 0; x < dw; x++, out += channels){
+			for(int c = 0; c < channels; c++) out[c] = 0.0f;
+			for(int k = 0; k < kernel.taps; k++){
+				const float* texel = row + MipKernel::wrap(2 * x + kernel.first + k, sw) * channels;
+				for(int c = 0; c < channels; c++) out[c] += texel[c] * kernel.weights[k];
+			}
+		}
+	}
+}
+
+/**
+ * Filters a raster of height sh vertically into the rows [first, last) of a raster.
+ */
+static void reduceColumns(const float* src, int sh, int width, int channels, const MipKernel& kernel, float* dst, int first, int last)
+{
+	size_t rowLength = (size_t) width * channels;
+	for(int y = first; y < last; y++){
+		float* out = dst + (size_t) y * rowLength;
+		for(size_t i = 0; i < rowLength; i++) out[i] = 0.0f;
+		for(int k = 0; k < kernel.taps; k++){
+			const float* row = src + MipKernel::wrap(2 * y + kernel.first + k, sh) * rowLength;
+			for(size_t i = 0; i < rowLength; i++) out[i] += row[i] * kernel.weights[k];
+		}
+		// the negative lobes of the Kaiser filter may undershoot
+		for(size_t i = 0; i < rowLength; i++) out[i] = std::max(out[i], 0.0f);
+	}
+}
+
+/**
+ * Runs func(first, last) over bands of rows on worker threads. Small images
+ * are processed on the calling thread.
+ */
+template<class F>
+static void forRows(int rows, size_t rowLength, unsigned threads, F func)
+{
+	unsigned bands = std::min<unsigned>(threads, (unsigned) rows);
+	if(bands <= 1 || rows * rowLength < 16384){
+		func(0, rows);
+		return;
+	}
+	
+	std::vector<std::thread> workers;
+	for(unsigned i = 1; i < bands; i++){
+		workers.push_back(std::thread(func, (int) (rows * (size_t) i / bands), (int) (rows * (size_t) (i + 1) / bands)));
+	}
+	func(0, (int) (rows / bands));
+	for(unsigned i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+/**
+ * Appends the mip levels of a base level to a chain, down to 1x1.
+ */
+static void reduceChain(const FloatRaster* base, mipmap_filter filter, unsigned threads, std::vector<FloatRaster*>& chain)
+{
+	int channels = base->channels();
+	const FloatRaster* src = base;
+	std::vector<float> reduced;
+	while(src->width() > 1 || src->height() > 1){
+		int sw = src->width(), sh = src->height();
+		int dw = std::max(1, sw / 2), dh = std::max(1, sh / 2);
+		MipKernel horizontal(filter, sw);
+		MipKernel vertical(filter, sh);
+		FloatRaster* dst = new FloatRaster(dw, dh, channels);
+		
+		const float* in = src->head();
+		float* out = dst->head();
+		reduced.resize((size_t) dw * sh * channels);
+		float* rows = &reduced[0];
+		forRows(sh, (size_t) dw * channels, threads, [&](int first, int last){ reduceRows(in, sw, channels, horizontal, rows, dw, first, last); });
+		forRows(dh, (size_t) dw * channels, threads, [&](int first, int last){ reduceColumns(rows, sh, dw, channels, vertical, out, first, last); });
+		
+		chain.push_back(dst);
+		src = dst;
+	}
+}
+
+void Texture::generateMipmaps(mipmap_filter filter, unsigned threads)
+{
+	deleteMipmaps();
+	m_mipmapFilter = filter;
+	if(m_raster == NULL) return;
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	
+	if(m_texels.empty()){
+		reduceChain(m_raster, filter, threads, m_mipmaps);
+		return;
+	}
+	
+	// the levels of a compact format are filtered in floats and packed again
+	FloatRaster* base = unpackLevel(*m_texels[0], width(), height(), m_format, m_layout);
+	std::vector<FloatRaster*> chain;
+	reduceChain(base, filter, threads, chain);
+	for(unsigned i = 0; i < chain.size(); i++){
+		m_texels.push_back(packLevel(*chain[i], m_format, m_layout));
+		delete chain[i];
+	}
+	delete base;
+}
+
+void Texture::deleteMipmaps()
+{
+	for(unsigned i = 0; i < m_mipmaps.size(); i++) delete m_mipmaps[i];
+	m_mipmaps.clear();
+	
+	for(unsigned i = 1; i < m_texels.size(); i++) delete m_texels[i];
+	if(m_texels.size() > 1) m_texels.resize(1);
+}
+
+void Texture::deleteTexels()
+{
+	for(unsigned i = 0; i < m_texels.size(); i++) delete m_texels[i];
+	m_texels.clear();
+	m_sampler = NULL;
+}
+
+}	// namespace pixelpipe
@@ -0,0 +1,128 @@
+#include <algorithm>
+
+#include "core/visbuffer.h"
+
+namespace pixelpipe {
+
+const unsigned VisibilityBuffer::DRAW_BITS;
+const unsigned VisibilityBuffer::TRIANGLE_BITS;
+const uint32_t VisibilityBuffer::MAX_TRIANGLES;
+const uint32_t VisibilityBuffer::INVALID_ID;
+
+VisibilityBuffer::VisibilityBuffer(const unsigned width, const unsigned height, int attributes)
+{
+	m_width = width;
+	m_height = height;
+	m_depth.resize((size_t) width * height);
+	m_ids.resize((size_t) width * height);
+	
+	setAttributeCount(attributes);
+}
+
+void VisibilityBuffer::setAttributeCount(int count)
+{
+	m_attributes = count;
+	m_stride = 4 + count;
+	
+	clear();
+}
+
+void VisibilityBuffer::clear()
+{
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+	std::fill(m_ids.begin(), m_ids.end(), INVALID_ID);
+	m_vertices.clear();
+	m_draws.clear();
+}
+
+uint32_t VisibilityBuffer::addTriangle(const Vertex* vs, const Texture* texture)
+{
+	uint32_t index = (uint32_t) triangleCount();
+	
+	if(m_draws.empty() || m_draws.back().texture != texture || index - m_draws.back().first > MAX_TRIANGLES - 1){
+		if(m_draws.size() >= (1u << DRAW_BITS)) throw "Too many draws for the visibility buffer.";
+		
+		Draw draw;
+		draw.texture = texture;
+		draw.first = index;
+		m_draws.push_back(draw);
+	}
+	
+	// keep the vertices in the form the rasterizer interpolates them
+	for(int iv = 0; iv < 3; iv++){
+		float invW = 1.0f / vs[iv].v.w;
+		m_vertices.push_back(vs[iv].v.x * invW);
+		m_vertices.push_back(vs[iv].v.y * invW);
+		m_vertices.push_back(vs[iv].v.z * invW);
+		m_vertices.push_back(invW);
+		for(int ia = 0; ia < m_attributes; ia++){
+			m_vertices.push_back(vs[iv].attributes[ia] * invW);
+		}
+	}
+	
+	uint32_t draw = (uint32_t) m_draws.size() - 1;
+	return (draw << TRIANGLE_BITS) | (index - m_draws[draw].first);
+}
+
+void VisibilityBuffer::resolve(FragmentProcessor& fp, FrameBuffer& fb)
+{
+	Fragment frag(1 + m_attributes);
+	uint32_t currentDraw = INVALID_ID;
+	int texcoord = fp.texcoordAttribute();
+	
+	for(unsigned y = 0; y < m_height; y++){
+		for(unsigned x = 0; x < m_width; x++){
+			uint32_t id = m_ids[y * m_width + x];
+			if(id == INVALID_ID) continue;
+			
+			uint32_t draw = drawOf(id);
+			if(draw != currentDraw){
+				// batching processors must finish with the previous texture
+				fp.flush(fb);
+				fp.setTexture(m_draws[draw].texture);
+				currentDraw = draw;
+			}
+			
+			const float* v0 = &m_vertices[(size_t) (m_draws[draw].first + triangleOf(id)) * 3 * m_stride];
+			const float* v1 = v0 + m_stride;
+			const float* v2 = v1 + m_stride;
+			
+			// reconstruct the screen space barycentric coordinates of the pixel
+			float dx1 = v1[0] - v0[0], dy1 = v1[1] - v0[1];
+			float dx2 = v2[0] - v0[0], dy2 = v2[1] - v0[1];
+			float px = x - v0[0], py = y - v0[1];
+			float invDet = 1.0f / (dx1 * dy2 - dx2 * dy1);
+			float b1 = (px * dy2 - dx2 * py) * invDet;
+			float b2 = (dx1 * py - px * dy1) * invDet;
+			float b0 = 1.0f - b1 - b2;
+			
+			// perspective correct interpolation, as done by the Rasterizer
+			float w = 1.0f / (b0 * v0[3] + b1 * v1[3] + b2 * v2[3]);
+			for(int ia = 0; ia < m_attributes; ia++){
+				frag.attributes[1 + ia] = (b0 * v0[4 + ia] + b1 * v1[4 + ia] + b2 * v2[4 + ia]) * w;
+			}
+			if(texcoord >= 0){
+				// the screen space derivatives of the barycentric coordinates
+				float b1x = dy2 * invDet, b1y = -dx2 * invDet;
+				float b2x = -dy1 * invDet, b2y = dx1 * invDet;
+				float wx = (v1[3] - v0[3]) * b1x + (v2[3] - v0[3]) * b2x;
+				float wy = (v1[3] - v0[3]) * b1y + (v2[3] - v0[3]) * b2y;
+				for(int k = 0; k < 2; k++){
+					const int ia = 4 + texcoord + k;
+					float a = frag.attributes[1 + texcoord + k];
+					frag.derivatives[k] = ((v1[ia] - v0[ia]) * b1x + (v2[ia] - v0[ia]) * b2x - a * wx) * w;
+					frag.derivatives[2 + k] = ((v1[ia] - v0[ia]) * b1y + (v2[ia] - v0[ia]) * b2y - a * wy) * w;
+				}
+			}
+			
+			frag.x = x;
+			frag.y = y;
+			frag.attributes[0] = m_depth[y * m_width + x];
+			fp.fragment(frag, fb);
+		}
+	}
+	
+	fp.flush(fb);
+}
+
+}	// namespace pixelpipe
@@ -0,0 +1,493 @@
+#include <math.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+#include "fragment/frag_bytecode.h"
+
+namespace pixelpipe {
+
+/**
+ * The text form of the opcodes, indexed by bytecode_op.
+ */
+static const char* s_opNames[] = {
+	"mov", "add", "sub", "mul", "mad", "div", "min", "max", "sat", "rsq",
+	"sqrt", "pow", "exp2", "log2", "spec", "dot3", "nrm3", "tex", "out"
+};
+
+/**
+ * The number of operands of each opcode, indexed by bytecode_op.
+ */
+static const int s_opOperands[] = {
+	1, 2, 2, 2, 3, 2, 2, 2, 1, 1,
+	1, 2, 1, 1, 1, 2, 1, 2, 3
+};
+
+/**
+ * @return the number of registers written by an opcode
+ */
+static int resultSize(int op)
+{
+	return (op == BYTECODE_NRM3 || op == BYTECODE_TEX) ? 3 : 1;
+}
+
+/**
+ * @return the light read by a lightN uniform, or -1 for other names
+ */
+static int lightIndex(const std::string& name)
+{
+	if(name.size() <= 5 || name.compare(0, 5, "light") != 0) return -1;
+	if(name.find_first_not_of("0123456789", 5) != std::string::npos) return -1;
+
+	return atoi(name.c_str() + 5);
+}
+
+ShaderBytecode::ShaderBytecode(int varyings)
+{
+	if(varyings < 0) throw "Invalid varying count.";
+
+	m_varyings = varyings;
+	m_depthTest = true;
+	m_vertex = PROGRAM_VERTEX_SHADED;
+	m_lights = 0;
+	m_revision = 0;
+	m_initial.resize(1 + varyings, 0.0f);
+}
+
+int ShaderBytecode::varying(int i) const
+{
+	if(i < 0 || i > m_varyings) throw "Varying index out of range.";
+
+	return i;
+}
+
+int ShaderBytecode::constant(float value)
+{
+	std::map<float, int>::iterator it = m_constants.find(value);
+	if(it != m_constants.end()) return it->second;
+
+	int reg = allocate(1, value);
+	m_constants[value] = reg;
+
+	return reg;
+}
+
+int ShaderBytecode::uniform(const std::string& name, int components)
+{
+	std::map<std::string, int>::iterator it = m_uniforms.find(name);
+	if(it != m_uniforms.end()) return it->second;
+
+	int reg = allocate(components);
+	m_uniforms[name] = reg;
+	if(lightIndex(name) >= m_lights) m_lights = lightIndex(name) + 1;
+
+	return reg;
+}
+
+void ShaderBytecode::setUniform(const std::string& name, const float* values, int components)
+{
+	std::map<std::string, int>::iterator it = m_uniforms.find(name);
+	if(it == m_uniforms.end()) return;
+
+	for(int i = 0; i < components && it->second + i < (int) m_initial.size(); i++){
+		m_initial[it->second + i] = values[i];
+	}
+	m_revision++;
+}
+
+int ShaderBytecode::temp(int components)
+{
+	return allocate(components);
+}
+
+int ShaderBytecode::emit(bytecode_op op, int a, int b, int c)
+{
+	int dst = temp(resultSize(op));
+	emitTo(dst, op, a, b, c);
+
+	return dst;
+}
+
+void ShaderBytecode::emitTo(int dst, bytecode_op op, int a, int b, int c)
+{
+	Instruction instr;
+	instr.op = (unsigned short) op;
+	instr.dst = (unsigned short) checked(dst);
+	instr.a = (unsigned short) checked(a);
+	instr.b = (unsigned short) checked(b);
+	instr.c = (unsigned short) checked(c);
+
+	// vector operands read three consecutive registers
+	if(op == BYTECODE_DOT3 || op == BYTECODE_NRM3){
+		checked(a + 2);
+		if(op == BYTECODE_DOT3) checked(b + 2);
+	}
+	if(resultSize(op) == 3) checked(dst + 2);
+
+	m_code.push_back(instr);
+}
+
+int ShaderBytecode::allocate(int components, float value)
+{
+	if(components < 1) throw "Invalid register count.";
+	if(m_initial.size() + components > 0xffff) throw "Too many registers.";
+
+	int reg = (int) m_initial.size();
+	m_initial.resize(m_initial.size() + components, value);
+
+	return reg;
+}
+
+int ShaderBytecode::checked(int reg) const
+{
+	if(reg < 0 || reg >= (int) m_initial.size()) throw "Register out of range.";
+
+	return reg;
+}
+
+ShaderBytecode* ShaderBytecode::load(const std::string& filename)
+{
+	std::ifstream in(filename.c_str());
+	if(!in) throw "Unable to open fragment program.";
+
+	std::stringstream source;
+	source << in.rdbuf();
+
+	return compile(source.str());
+}
+
+/**
+ * Resolves a single operand of the text form.
+ *
+ * @return the register of the operand
+ */
+static int parseOperand(ShaderBytecode& program, const std::map<std::string, int>& names, const std::string& token)
+{
+	if(token.empty()) throw "Missing operand.";
+
+	// numeric literal
+	char* end = NULL;
+	float value = (float) strtod(token.c_str(), &end);
+	if(end != token.c_str() && *end == '\0') return program.constant(value);
+
+	// optional component selector
+	std::string name = token;
+	int component = 0;
+	size_t dot = token.find('.');
+	if(dot != std::string::npos){
+		name = token.substr(0, dot);
+		std::string selector = token.substr(dot + 1);
+		if(selector == "x" || selector == "r") component = 0;
+		else if(selector == "y" || selector == "g") component = 1;
+		else if(selector == "z" || selector == "b") component = 2;
+		else throw "Invalid component selector.";
+	}
+
+	// interpolated attribute
+	if(name.size() > 1 && name[0] == 'v' && name.find_first_not_of("0123456789", 1) == std::string::npos){
+		return program.varying(atoi(name.c_str() + 1) + component);
+	}
+
+	// temporaries
+	std::map<std::string, int>::const_iterator it = names.find(name);
+	if(it != names.end()) return it->second + component;
+
+	// uniforms, the built-in ones are sized by the BytecodeFP
+	if(name == "ambient") return program.uniform(name, 1) + component;
+	if(name == "specular_color") return program.uniform(name, 3) + component;
+	if(lightIndex(name) >= 0) return program.uniform(name, 3) + component;
+
+	it = program.uniforms().find(name);
+	if(it != program.uniforms().end()) return it->second + component;
+
+	throw "Unknown operand.";
+}
+
+ShaderBytecode* ShaderBytecode::compile(const std::string& source)
+{
+	std::istringstream lines(source);
+	std::string line;
+	std::map<std::string, int> names;
+	ShaderBytecode* program = NULL;
+	bool depthTest = true;
+	program_vertex vertex = PROGRAM_VERTEX_SHADED;
+	bool output = false;
+
+	try {
+		while(std::getline(lines, line)){
+			size_t comment = line.find('#');
+			if(comment != std::string::npos) line.erase(comment);
+
+			std::istringstream tokens(line);
+			std::vector<std::string> words;
+			std::string word;
+			while(tokens >> word) words.push_back(word);
+			if(words.empty()) continue;
+
+			if(words[0] == "varyings"){
+				if(program != NULL || words.size() != 2) throw "The varyings statement must come first.";
+				program = new ShaderBytecode(atoi(words[1].c_str()));
+				continue;
+			}
+			if(program == NULL) throw "The varyings statement must come first.";
+
+			if(words[0] == "depthtest"){
+				if(words.size() != 2) throw "Invalid depthtest statement.";
+				depthTest = (words[1] != "off");
+			}
+			else if(words[0] == "vertex"){
+				if(words.size() != 2) throw "Invalid vertex statement.";
+				if(words[1] == "shaded") vertex = PROGRAM_VERTEX_SHADED;
+				else if(words[1] == "textured") vertex = PROGRAM_VERTEX_TEXTURED;
+				else throw "Unknown vertex processor.";
+			}
+			else if(words[0] == "uniform"){
+				// uniform <name> [components]
+				if(words.size() < 2 || words.size() > 3) throw "Invalid uniform statement.";
+				program->uniform(words[1], words.size() == 3 ? atoi(words[2].c_str()) : 1);
+			}
+			else if(words[0] == "out"){
+				if(words.size() != 4) throw "The out statement takes three operands.";
+				program->output(parseOperand(*program, names, words[1]), parseOperand(*program, names, words[2]), parseOperand(*program, names, words[3]));
+				output = true;
+			}
+			else{
+				// <name> = <op> <operands...>
+				if(words.size() < 4 || words[1] != "=") throw "Invalid statement.";
+
+				int op = -1;
+				for(int i = 0; i < BYTECODE_OUT; i++){
+					if(words[2] == s_opNames[i]) op = i;
+				}
+				if(op < 0) throw "Unknown instruction.";
+				if((int) words.size() - 3 != s_opOperands[op]) throw "Wrong number of operands.";
+
+				int operands[3] = { 0, 0, 0 };
+				for(int i = 0; i < s_opOperands[op]; i++){
+					operands[i] = parseOperand(*program, names, words[3 + i]);
+				}
+
+				// temporaries are single assignment, each statement gets fresh registers
+				names[words[0]] = program->emit((bytecode_op) op, operands[0], operands[1], operands[2]);
+			}
+		}
+
+		if(program == NULL) throw "Empty fragment program.";
+		if(!output) throw "The fragment program has no out statement.";
+	}
+	catch(...) {
+		delete program;
+		throw;
+	}
+
+	program->setDepthTest(depthTest);
+	program->setVertexProcessor(vertex);
+
+	return program;
+}
+
+BytecodeFP::BytecodeFP(ShaderBytecode* program)
+{
+	m_program = program;
+	m_texture = NULL;
+	m_count = 0;
+	m_attributes = 1 + program->nAttr();
+	m_stale = true;
+	m_revision = program->revision();
+	m_registers = new float[program->registerCount() * LANES];
+
+	for(int r = 0; r < program->registerCount(); r++){
+		broadcast(r, &program->initialValues()[r], 1);
+	}
+
+	// the built-in uniforms are resolved once, refreshUniforms() only compares values
+	const std::map<std::string, int>& uniforms = program->uniforms();
+	std::map<std::string, int>::const_iterator it = uniforms.find("ambient");
+	m_ambient = (it != uniforms.end()) ? it->second : -1;
+	it = uniforms.find("specular_color");
+	m_specularColor = (it != uniforms.end()) ? it->second : -1;
+
+	m_lights.resize(program->lightCount(), -1);
+	for(it = uniforms.begin(); it != uniforms.end(); ++it){
+		if(lightIndex(it->first) >= 0) m_lights[lightIndex(it->first)] = it->second;
+	}
+	m_current.resize(4 + 3 * m_lights.size());
+}
+
+BytecodeFP::~BytecodeFP()
+{
+	delete [] m_registers;
+	delete m_program;
+}
+
+void BytecodeFP::fragment(Fragment& f, FrameBuffer& fb)
+{
+	if(m_program->getDepthTest() && !depthTest(f, fb)) return;
+
+	// transpose the fragment into its lane
+	for(int k = 0; k < m_attributes; k++){
+		m_registers[k * LANES + m_count] = f.attributes[k];
+	}
+	m_x[m_count] = f.x;
+	m_y[m_count] = f.y;
+
+	if(++m_count == LANES) execute(fb);
+}
+
+void BytecodeFP::flush(FrameBuffer& fb)
+{
+	if(m_count > 0) execute(fb);
+
+	// the State may change between triangles
+	m_stale = true;
+}
+
+void BytecodeFP::broadcast(int reg, const float* values, int components)
+{
+	for(int k = 0; k < components; k++){
+		for(int i = 0; i < LANES; i++){
+			m_registers[(reg + k) * LANES + i] = values[k];
+		}
+	}
+}
+
+void BytecodeFP::refreshUniforms()
+{
+	State* state = State::getInstance();
+	std::vector<PointLight>& lights = state->getLights();
+
+	// values set through getProgram(), temporaries are always written before they are read
+	if(m_revision != m_program->revision()){
+		const std::vector<float>& initial = m_program->initialValues();
+		for(int r = m_attributes; r < (int) initial.size(); r++) broadcast(r, &initial[r], 1);
+		m_revision = m_program->revision();
+		m_state.clear();
+	}
+
+	m_current[0] = state->getAmbientIntensity();
+	cg::vecmath::Color3f& specular = state->getSpecularColor();
+	m_current[1] = specular.x;
+	m_current[2] = specular.y;
+	m_current[3] = specular.z;
+	for(unsigned i = 0; i < m_lights.size(); i++){
+		float* intensity = &m_current[4 + 3 * i];
+		intensity[0] = intensity[1] = intensity[2] = 0.0f;
+		if(i < lights.size()){
+			intensity[0] = lights.at(i).getIntensity().x;
+			intensity[1] = lights.at(i).getIntensity().y;
+			intensity[2] = lights.at(i).getIntensity().z;
+		}
+	}
+
+	// the registers are only rewritten when the State changed
+	if(m_current != m_state){
+		if(m_ambient >= 0) broadcast(m_ambient, &m_current[0], 1);
+		if(m_specularColor >= 0) broadcast(m_specularColor, &m_current[1], 3);
+		for(unsigned i = 0; i < m_lights.size(); i++){
+			if(m_lights[i] >= 0) broadcast(m_lights[i], &m_current[4 + 3 * i], 3);
+		}
+		m_state = m_current;
+	}
+
+	m_stale = false;
+}
+
+void BytecodeFP::execute(FrameBuffer& fb)
+{
+	if(m_stale) refreshUniforms();
+
+	const std::vector<ShaderBytecode::Instruction>& code = m_program->code();
+	const ShaderBytecode::Instruction* instr = code.empty() ? NULL : &code[0];
+	const ShaderBytecode::Instruction* last = instr + code.size();
+	float* R = m_registers;
+	const int count = m_count;
+	const math_precision precision = State::getInstance()->getMathPrecision();
+
+	// the lane loops have a constant trip count so that the compiler can unroll and vectorize them
+	for(; instr != last; ++instr){
+		float* d = R + instr->dst * LANES;
+		const float* a = R + instr->a * LANES;
+		const float* b = R + instr->b * LANES;
+		const float* c = R + instr->c * LANES;
+
+		switch(instr->op){
+			case BYTECODE_MOV:
+				for(int i = 0; i < LANES; i++) d[i] = a[i];
+				break;
+			case BYTECODE_ADD:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] + b[i];
+				break;
+			case BYTECODE_SUB:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] - b[i];
+				break;
+			case BYTECODE_MUL:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] * b[i];
+				break;
+			case BYTECODE_MAD:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] * b[i] + c[i];
+				break;
+			case BYTECODE_DIV:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] / b[i];
+				break;
+			case BYTECODE_MIN:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] < b[i] ? a[i] : b[i];
+				break;
+			case BYTECODE_MAX:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] > b[i] ? a[i] : b[i];
+				break;
+			case BYTECODE_SAT:
+				for(int i = 0; i < LANES; i++) d[i] = a[i] < 0.0f ? 0.0f : (a[i] > 1.0f ? 1.0f : a[i]);
+				break;
+			case BYTECODE_RSQ:
+				for(int i = 0; i < LANES; i++) d[i] = FastMath::rsqrt(a[i], precision);
+				break;
+			case BYTECODE_SQRT:
+				for(int i = 0; i < LANES; i++) d[i] = sqrtf(a[i]);
+				break;
+			case BYTECODE_POW:
+				for(int i = 0; i < count; i++) d[i] = FastMath::pow(a[i], b[i], precision);
+				break;
+			case BYTECODE_EXP2:
+				for(int i = 0; i < count; i++) d[i] = FastMath::exp2(a[i], precision);
+				break;
+			case BYTECODE_LOG2:
+				for(int i = 0; i < count; i++) d[i] = FastMath::log2(a[i], precision);
+				break;
+			case BYTECODE_SPEC:
+				for(int i = 0; i < count; i++) d[i] = State::getInstance()->specular(a[i]);
+				break;
+			case BYTECODE_DOT3:
+				for(int i = 0; i < LANES; i++){
+					d[i] = a[i] * b[i] + a[LANES + i] * b[LANES + i] + a[2*LANES + i] * b[2*LANES + i];
+				}
+				break;
+			case BYTECODE_NRM3:
+				for(int i = 0; i < LANES; i++){
+					float len2 = a[i] * a[i] + a[LANES + i] * a[LANES + i] + a[2*LANES + i] * a[2*LANES + i];
+					float s = len2 > 0.0f ? FastMath::rsqrt(len2, precision) : 0.0f;
+					d[i] = a[i] * s;
+					d[LANES + i] = a[LANES + i] * s;
+					d[2*LANES + i] = a[2*LANES + i] * s;
+				}
+				break;
+			case BYTECODE_TEX:
+				for(int i = 0; i < count; i++){
+					cg::vecmath::Color3f texel(0.0f, 0.0f, 0.0f);
+					if(m_texture != NULL) texel = m_texture->sample(a[i], b[i]);
+					d[i] = texel.x;
+					d[LANES + i] = texel.y;
+					d[2*LANES + i] = texel.z;
+				}
+				break;
+			case BYTECODE_OUT:
+				for(int i = 0; i < count; i++){
+					fb.set(m_x[i], m_y[i], a[i], b[i], c[i], R[i]);
+				}
+				break;
+		}
+	}
+
+	m_count = 0;
+}
+
+}	// namespace pixelpipe
@@ -0,0 +1,27 @@
+#include "fragment/frag_gbuffer.h"
+
+namespace pixelpipe {
+
+GBufferFP::GBufferFP(GBuffer* gbuffer)
+{
+	m_gbuffer = gbuffer;
+	m_texture = NULL;
+}
+
+void GBufferFP::fragment(Fragment& f, FrameBuffer& fb)
+{
+	if(f.attributes[0] < m_gbuffer->getDepth(f.x, f.y)){
+		float albedo[3] = { f.attributes[1], f.attributes[2], f.attributes[3] };
+		
+		if(m_texture != NULL && State::getInstance()->getTexturing2D()){
+			cg::vecmath::Color3f texColor = m_texture->sample(f.attributes[7], f.attributes[8], f.derivatives);
+			albedo[0] = texColor.x;
+			albedo[1] = texColor.y;
+			albedo[2] = texColor.z;
+		}
+		
+		m_gbuffer->set(f.x, f.y, f.attributes[0], f.attributes + 4, albedo, f.attributes[7], f.attributes[8]);
+	}
+}
+
+}
@@ -10,18 +10,20 @@ PhongShadedFP::PhongShadedFP()
 
 void PhongShadedFP::fragment(Fragment& f, FrameBuffer& fb)
 {
-	if(f.attributes[0] < fb.getZ(f.x, f.y)){
+	if(depthTest(f, fb)){
+		math_precision precision = State::getInstance()->getMathPrecision();
+		
 		//get normal
 		normal.x = f.attributes[4];
 		normal.y = f.attributes[5];
 		normal.z = f.attributes[6];
-		normal.normalize();
+		FastMath::normalize(normal, precision);
 		
 		//get viewVector
 		viewVector.x = f.attributes[7];
 		viewVector.y = f.attributes[8];
 		viewVector.z = f.attributes[9];
-		viewVector.normalize();
+		FastMath::normalize(viewVector, precision);
 				
 		//add lighting
 		outColor.set(0.0,0.0,0.0);
@@ -33,13 +35,13 @@ void PhongShadedFP::fragment(Fragment& f, FrameBuffer& fb)
 			lightVector.x = f.attributes[10 + position];
 			lightVector.y = f.attributes[11 + position];
 			lightVector.z = f.attributes[12 + position];				
-			lightVector.normalize();
+			FastMath::normalize(lightVector, precision);
 			
 			//get halfVector
 			halfVector.x = f.attributes[13 + position];
 			halfVector.y = f.attributes[14 + position];
 			halfVector.z = f.attributes[15 + position];	
-			halfVector.normalize();
+			FastMath::normalize(halfVector, precision);
 			
 			//compute dot products
 			nDotL = dot(normal, lightVector);
@@ -51,7 +53,7 @@ void PhongShadedFP::fragment(Fragment& f, FrameBuffer& fb)
 	   		outColor.z += f.attributes[3] * nDotL * State::getInstance()->getLights().at(i).getIntensity().z;
 	   
 	   		//calculate specular intensity
-			specularIntensity = std::pow(nDotH, State::getInstance()->getSpecularExponent());
+			specularIntensity = State::getInstance()->specular(nDotH);
 			if(specularIntensity < 0.0){
 				specularIntensity = 0.0;
 			}
@@ -11,21 +11,23 @@ TexturedPhongFP::TexturedPhongFP()
 
 void TexturedPhongFP::fragment(Fragment& f, FrameBuffer& fb)
 {
-	if(f.attributes[0] < fb.getZ(f.x, f.y)){
+	if(depthTest(f, fb)){
+		math_precision precision = State::getInstance()->getMathPrecision();
+		
 		//get normal
 		normal.x = f.attributes[4];
 		normal.y = f.attributes[5];
 		normal.z = f.attributes[6];
-		normal.normalize();
+		FastMath::normalize(normal, precision);
 		
 		//get viewVector
 		viewVector.x = f.attributes[7];
 		viewVector.y = f.attributes[8];
 		viewVector.z = f.attributes[9];
-		viewVector.normalize();
+		FastMath::normalize(viewVector, precision);
 
 		//sample the texture
-		texColor = m_texture->sample(f.attributes[1], f.attributes[2]);
+		texColor = m_texture->sample(f.attributes[1], f.attributes[2], f.derivatives);
 		
 		//add lighting
 		outColor.set(0.0,0.0,0.0);
@@ -37,13 +39,13 @@ void TexturedPhongFP::fragment(Fragment& f, FrameBuffer& fb)
 			lightVector.x = f.attributes[10 + position];
 			lightVector.y = f.attributes[11 + position];
 			lightVector.z = f.attributes[12 + position];				
-			lightVector.normalize();
+			FastMath::normalize(lightVector, precision);
 			
 			//get halfVector
 			halfVector.x = f.attributes[13 + position];
 			halfVector.y = f.attributes[14 + position];
 			halfVector.z = f.attributes[15 + position];	
-			halfVector.normalize();
+			FastMath::normalize(halfVector, precision);
 			
 			//compute dot products
 			nDotL = dot(normal, lightVector);
@@ -55,7 +57,7 @@ void TexturedPhongFP::fragment(Fragment& f, FrameBuffer& fb)
 	   		outColor.z += texColor.z * nDotL * State::getInstance()->getLights().at(i).getIntensity().z;
 	   
 	   		//calculate specular intensity
-			specularIntensity = std::pow(nDotH, State::getInstance()->getSpecularExponent());
+			specularIntensity = State::getInstance()->specular(nDotH);
 			if(specularIntensity < 0.0){
 				specularIntensity = 0.0;
 			}
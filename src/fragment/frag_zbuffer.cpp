@@ -5,7 +5,7 @@ namespace pixelpipe {
 
 void ZBufferFP::fragment(Fragment& f, FrameBuffer& fb)
 {	
-	if(f.attributes[0] < fb.getZ(f.x, f.y)){
+	if(depthTest(f, fb)){
 		fb.set(f.x, f.y, f.attributes[1], f.attributes[2], f.attributes[3], f.attributes[0]);
 	}
 }
@@ -0,0 +1,23 @@
+#include "vertex/vert_depth.h"
+
+using namespace cg::vecmath;
+
+namespace pixelpipe {
+
+void DepthOnlyVP::triangle(const Vector3f* vs, const Color3f* cs_ign, const Vector3f* ns_ign, const Vector2f* ts_ign, Vertex* output)
+{
+	for (int k = 0; k < 3; k++) {
+		output[k].v.set(vs[k].x, vs[k].y, vs[k].z, 1.0f);
+		Vector4f temp = output[k].v;
+		output[k].v = MVP * temp;
+	}
+}
+
+void DepthOnlyVP::vertex(const Vector3f& v, const Color3f& c_ign, const Vector3f& n_ign, const Vector2f& t_ign, Vertex& output)
+{
+	output.v.set(v.x, v.y, v.z, 1.0f);
+	Vector4f temp = output.v;
+	output.v = MVP * temp;
+}
+
+}
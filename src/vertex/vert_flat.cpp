@@ -0,0 +1,42 @@
+#include "vertex/vert_flat.h"
+
+namespace pixelpipe {
+
+using namespace cg::vecmath;
+
+FlatShadedVP::FlatShadedVP() : SmoothShadedVP(), face(3)
+{
+}
+
+void FlatShadedVP::triangle(const Vector3f* vs, const Color3f* cs, const Vector3f* ns, const Vector2f* ts, Vertex* output)
+{
+	Vector3f centroid = vs[0] + vs[1];
+	centroid += vs[2];
+	centroid *= (1.0f / 3.0f);
+	
+	Color3f color = cs[0];
+	color += cs[1];
+	color += cs[2];
+	color *= (1.0f / 3.0f);
+	
+	// fall back on the geometric normal when the vertex normals cancel out
+	Vector3f faceNormal = ns[0] + ns[1];
+	faceNormal += ns[2];
+	if(dot(faceNormal, faceNormal) == 0.0f){
+		faceNormal = cross(vs[1] - vs[0], vs[2] - vs[0]);
+	}
+	
+	// light the triangle once
+	SmoothShadedVP::vertex(centroid, color, faceNormal, Vector2f(), face);
+	
+	for (int k = 0; k < 3; k++) {
+		output[k].setAttrs(nAttr());
+		vert.set(vs[k].x, vs[k].y, vs[k].z, 1.0f);
+		output[k].v = MVP * vert;
+		output[k].attributes[0] = face.attributes[0];
+		output[k].attributes[1] = face.attributes[1];
+		output[k].attributes[2] = face.attributes[2];
+	}
+}
+
+}
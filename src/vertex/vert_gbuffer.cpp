@@ -0,0 +1,39 @@
+#include "vertex/vert_gbuffer.h"
+
+namespace pixelpipe {
+
+using namespace cg::vecmath;
+
+void GBufferVP::vertex(const Vector3f& v, const Color3f& c, const Vector3f& n, const Vector2f& t, Vertex& output)
+{
+	output.setAttrs(nAttr());
+	
+	//output color
+	output.attributes[0] = c.x;
+	output.attributes[1] = c.y;
+	output.attributes[2] = c.z;
+	
+	//output the eye space normal, it is normalized after interpolation
+	normal.set(n.x, n.y, n.z, 0.0f);
+	Vector4f temp = normal;
+	normal = modelViewMatrix * temp;
+	output.attributes[3] = normal.x;
+	output.attributes[4] = normal.y;
+	output.attributes[5] = normal.z;
+	
+	//output texture coordinates
+	output.attributes[6] = t.x;
+	output.attributes[7] = t.y;
+	
+	vert.set(v.x, v.y, v.z, 1.0f);
+	output.v = MVP * vert;
+}
+
+void GBufferVP::triangle(const Vector3f* vs, const Color3f* cs, const Vector3f* ns, const Vector2f* ts, Vertex* output)
+{
+	for (int k = 0; k < 3; k++) {
+		vertex(vs[k], cs[k], ns[k], (ts != NULL)? ts[k] : Vector2f(), output[k]);
+	}
+}
+
+}
@@ -13,6 +13,8 @@ SmoothShadedVP::SmoothShadedVP() : VertexProcessor()
 
 void SmoothShadedVP::vertex(const Vector3f& v, const Color3f& c, const Vector3f& n, const Vector2f& t, Vertex& output)
 {
+	math_precision precision = State::getInstance()->getMathPrecision();
+	
 	//transform vertex
 	vert.set(v.x, v.y, v.z, 1.0f);
 	Vector4f temp = vert;
@@ -21,17 +23,17 @@ void SmoothShadedVP::vertex(const Vector3f& v, const Color3f& c, const Vector3f&
 
 	//transform normals
 	Vector3f temp3 = n;
-	temp3.normalize();
+	FastMath::normalize(temp3, precision);
 	normal.set(temp3.x, temp3.y, temp3.z, 0.0f);
 	temp = normal;
 	normal = modelViewMatrix * temp;
 	transformedNormal.set(normal.x, normal.y, normal.z);
-	transformedNormal.normalize();
+	FastMath::normalize(transformedNormal, precision);
 
 	//calculate view vector
 	viewVector = 0.0;
 	viewVector = viewVector - transformedVertex;
-	viewVector.normalize();
+	FastMath::normalize(viewVector, precision);
 	
 	// we start with the ambient color.
 	outColor.set(State::getInstance()->getAmbientIntensity(), State::getInstance()->getAmbientIntensity(), State::getInstance()->getAmbientIntensity());
@@ -41,7 +43,7 @@ void SmoothShadedVP::vertex(const Vector3f& v, const Color3f& c, const Vector3f&
 	for(int i=0; i<len; i++){
 		lightVector = State::getInstance()->getLights().at(i).getPosition();
 		lightVector = lightVector - transformedVertex;
-		lightVector.normalize();
+		FastMath::normalize(lightVector, precision);
 
 		//calculate N dot L
 		nDotL = (float) dot(transformedNormal, lightVector);
@@ -55,12 +57,12 @@ void SmoothShadedVP::vertex(const Vector3f& v, const Color3f& c, const Vector3f&
 		halfVector = 0.0;
 		halfVector = viewVector;
 		halfVector += lightVector;
-		halfVector.normalize();
+		FastMath::normalize(halfVector, precision);
 
 		nDotH = (float) dot(transformedNormal, halfVector);
 
 		//calculate specular intensity
-		float specularIntensity = std::pow(nDotH, State::getInstance()->getSpecularExponent());
+		float specularIntensity = State::getInstance()->specular(nDotH);
 		if(specularIntensity < 0.0f){
 			specularIntensity = 0.0f;
 		}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <math.h>
+
+#include "core/framebuffer.h"
+#include "core/state.h"
+#include "fragment/frag_phong.h"
+#include "fragment/frag_bytecode.h"
+
+#include "check.h"
+
+#ifndef PIXELPIPE_SHADER_DIR
+#define PIXELPIPE_SHADER_DIR "resources/shaders"
+#endif
+
+using namespace pixelpipe;
+
+static const int WIDTH = 512;
+static const int HEIGHT = 512;
+static const int TRIANGLE = 32;	//!< the number of fragments between two flushes, like a small triangle
+
+/**
+ * A small deterministic generator, so that every run shades the same fragments.
+ */
+static float random(unsigned& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / 16777216.0f;
+}
+
+/**
+ * Fills one fragment per pixel with the varyings of FragmentShadedVP: depth,
+ * color, then the normal, view, light and half vectors, which are left
+ * unnormalized as the rasterizer would interpolate them.
+ */
+static void fill(std::vector<float>& attributes, int length)
+{
+	unsigned seed = 1;
+	attributes.resize((size_t) WIDTH * HEIGHT * length);
+	for(size_t i = 0; i < (size_t) WIDTH * HEIGHT; i++){
+		float* a = &attributes[i * length];
+		a[0] = 0.05f + 0.9f * random(seed);
+		for(int k = 1; k < 4; k++) a[k] = random(seed);
+		for(int k = 4; k < length; k++) a[k] = 2.0f * random(seed) - 1.0f;
+	}
+}
+
+/**
+ * Shades every pixel once, flushing the processor every TRIANGLE fragments.
+ */
+static void shade(FragmentProcessor& fp, FrameBuffer& fb, const std::vector<float>& attributes, int length)
+{
+	Fragment f(length);
+	fb.clear(0, 0, 0, 1);
+	for(int i = 0; i < WIDTH * HEIGHT; i++){
+		f.x = i % WIDTH;
+		f.y = i / WIDTH;
+		for(int k = 0; k < length; k++) f.attributes[k] = attributes[(size_t) i * length + k];
+		fp.fragment(f, fb);
+		if(i % TRIANGLE == TRIANGLE - 1) fp.flush(fb);
+	}
+	fp.flush(fb);
+}
+
+/**
+ * @return the best time of three runs, in milliseconds
+ */
+static double benchmark(FragmentProcessor& fp, FrameBuffer& fb, const std::vector<float>& attributes, int length)
+{
+	double best = 0.0;
+	for(int run = 0; run < 3; run++){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		shade(fp, fb, attributes, length);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if(run == 0 || ms < best) best = ms;
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string filename = (argc > 1) ? argv[1] : PIXELPIPE_SHADER_DIR "/phong.pps";
+
+	// the lights of the headless renderer
+	State* state = State::getInstance();
+	state->getLights().push_back(PointLight(cg::vecmath::Vector3f(-2.0, -2.0, 0), cg::vecmath::Color3f(1.0, 0.5, 0.5)));
+	state->getLights().push_back(PointLight(cg::vecmath::Vector3f(2.0, 2.0, 0), cg::vecmath::Color3f(0.5, 0.5, 1.0)));
+
+	ShaderBytecode* program = NULL;
+	try {
+		program = ShaderBytecode::load(filename);
+	}
+	catch(const char* error) {
+		std::cout << "  FAIL " << filename << ": " << error << std::endl;
+		return 1;
+	}
+
+	PhongShadedFP native;
+	BytecodeFP interpreted(program);
+	const int length = 1 + native.nAttr();
+	if(interpreted.nAttr() != native.nAttr()){
+		std::cout << "  FAIL " << filename << " expects " << interpreted.nAttr() << " varyings, PhongShadedFP " << native.nAttr() << std::endl;
+		return 1;
+	}
+
+	std::vector<float> attributes;
+	fill(attributes, length);
+
+	FrameBuffer expected(WIDTH, HEIGHT, COLOR_FORMAT_FLOAT);
+	FrameBuffer actual(WIDTH, HEIGHT, COLOR_FORMAT_FLOAT);
+
+	const math_precision tiers[3] = { MATH_PRECISION_EXACT, MATH_PRECISION_FAST, MATH_PRECISION_FASTEST };
+	const char* names[3] = { "exact", "fast", "fastest" };
+
+	std::cout << std::fixed;
+	for(int t = 0; t < 3; t++){
+		state->setMathPrecision(tiers[t]);
+		std::cout << names[t] << std::endl;
+
+		// both processors shade the same fragments, the colors must agree
+		shade(native, expected, attributes, length);
+		shade(interpreted, actual, attributes, length);
+		double error = 0.0;
+		for(int y = 0; y < HEIGHT; y++){
+			for(int x = 0; x < WIDTH; x++){
+				cg::vecmath::Color3f a = actual.getColor(x, y);
+				cg::vecmath::Color3f b = expected.getColor(x, y);
+				error = std::max(error, (double) std::max(fabs(a.x - b.x), std::max(fabs(a.y - b.y), fabs(a.z - b.z))));
+			}
+		}
+		std::cout << std::setprecision(7);
+		reportBound("max color difference", error, 1e-5);
+
+		// the interpreter must stay within an order of magnitude of the native processor
+		double nativeMs = benchmark(native, expected, attributes, length);
+		double interpretedMs = benchmark(interpreted, actual, attributes, length);
+		std::cout << std::setprecision(2) << "        PhongShadedFP " << nativeMs << " ms, BytecodeFP " << interpretedMs << " ms per " << WIDTH << "x" << HEIGHT << " frame" << std::endl;
+		reportBound("slowdown", interpretedMs / nativeMs, 10.0);
+	}
+
+	return finish();
+}
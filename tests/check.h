@@ -0,0 +1,63 @@
+#ifndef __PIPELINE_TESTS_CHECK_H
+#define __PIPELINE_TESTS_CHECK_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*
+ * The reporting shared by the test programs. Every check prints one line,
+ * "  ok   " or "  FAIL " followed by its name and details, and the program ends
+ * with return finish(), which prints the summary and fails if any check did.
+ */
+
+static int failures = 0;
+
+/**
+ * Reports a check and counts it if it failed.
+ * @return ok
+ */
+static inline bool report(const std::string& name, bool ok, const std::string& detail = "")
+{
+	std::cout << (ok ? "  ok   " : "  FAIL ") << name << (detail.empty() ? "" : ": ") << detail << std::endl;
+	if(!ok) failures++;
+	return ok;
+}
+
+/**
+ * Reports a measured value, which passes when it is at most bound. The values
+ * are printed with the formatting flags of std::cout.
+ */
+template<class T>
+static inline bool reportBound(const std::string& name, T value, T bound)
+{
+	std::ostringstream detail;
+	detail.copyfmt(std::cout);
+	detail << value << " (bound " << bound << ")";
+	return report(name, value <= bound, detail.str());
+}
+
+/**
+ * Reports a number of mismatches, which passes when there are none.
+ */
+static inline bool reportMismatches(const std::string& name, long mismatches, const std::string& what = "mismatches")
+{
+	return report(name, mismatches == 0, std::to_string(mismatches) + " " + what);
+}
+
+/**
+ * Prints the summary of the checks.
+ * @return the exit status of the test program
+ */
+static inline int finish()
+{
+	if(failures > 0){
+		std::cout << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,338 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "core/damage.h"
+#include "core/frame_stream.h"
+#include "core/pixel_converter.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static std::string describe(const std::vector<unsigned>& tiles)
+{
+	std::string text = "tiles";
+	for(size_t i = 0; i < tiles.size(); i++) text += " " + std::to_string(tiles[i]);
+	return text;
+}
+
+static std::string describe(const std::vector<DamageRect>& regions)
+{
+	std::string text;
+	for(size_t i = 0; i < regions.size(); i++){
+		const DamageRect& r = regions[i];
+		text += (i ? " " : "") + std::string("(") + std::to_string(r.x) + "," + std::to_string(r.y) + " " + std::to_string(r.width) + "x" + std::to_string(r.height) + ")";
+	}
+	return text;
+}
+
+/**
+ * Compares the reported rectangles with the expected ones, as (x, y, width, height) quadruples.
+ */
+static bool sameRegions(const std::vector<DamageRect>& regions, const std::vector<unsigned>& expected)
+{
+	if(regions.size() * 4 != expected.size()) return false;
+	for(size_t i = 0; i < regions.size(); i++){
+		const DamageRect& r = regions[i];
+		if(r.x != expected[i * 4] || r.y != expected[i * 4 + 1] || r.width != expected[i * 4 + 2] || r.height != expected[i * 4 + 3]) return false;
+	}
+	return true;
+}
+
+/**
+ * Renders the reference frame: a gradient over the bottom half, the top half
+ * left at the clear color.
+ */
+static void draw(FrameBuffer& fb)
+{
+	fb.clear(0.1f, 0.2f, 0.3f, 1.0f);
+	for(int y = 0; y < (int) fb.regionHeight() / 2; y++){
+		for(int x = 0; x < (int) fb.regionWidth(); x++) fb.set(x, y, x / 64.0f, y / 64.0f, 0.5f, 0.0f);
+	}
+}
+
+/**
+ * Checks the damaged tiles and rectangles between frames of a 37x21 frame, 5x3
+ * tiles with clipped tiles on the right and at the top.
+ */
+static void checkTiles()
+{
+	FrameBuffer fb(37, 21);
+	DamageTracker damage;
+
+	draw(fb);
+	damage.update(fb);
+	report("first frame damages every tile", damage.getTiles().size() == 15 && sameRegions(damage.getRegions(), { 0, 0, 37, 21 }), describe(damage.getRegions()));
+
+	draw(fb);
+	damage.update(fb);
+	report("same frame is not damaged", damage.empty() && damage.getRegions().empty(), describe(damage.getTiles()));
+
+	// one pixel of the tile (2, 1)
+	draw(fb);
+	fb.set(20, 10, 1.0f, 0.0f, 0.0f, 0.0f);
+	damage.update(fb);
+	report("one changed tile", damage.getTiles() == std::vector<unsigned>({ 7 }) && damage.damaged(2, 1) && sameRegions(damage.getRegions(), { 16, 8, 8, 8 }), describe(damage.getRegions()));
+
+	// restoring the frame damages the same tile again
+	draw(fb);
+	damage.update(fb);
+	report("restored tile", damage.getTiles() == std::vector<unsigned>({ 7 }), describe(damage.getTiles()));
+
+	// a 2x2 block of tiles and the clipped top right tile
+	draw(fb);
+	fb.set(9, 1, 1.0f, 0.0f, 0.0f, 0.0f);
+	fb.set(17, 1, 1.0f, 0.0f, 0.0f, 0.0f);
+	fb.set(9, 9, 1.0f, 0.0f, 0.0f, 0.0f);
+	fb.set(17, 9, 1.0f, 0.0f, 0.0f, 0.0f);
+	fb.set(36, 20, 1.0f, 0.0f, 0.0f, 0.0f);
+	damage.update(fb);
+	report("block of tiles", damage.getTiles() == std::vector<unsigned>({ 1, 2, 6, 7, 14 })
+		&& sameRegions(damage.getRegions(), { 8, 0, 16, 16, 32, 16, 5, 5 }), describe(damage.getRegions()));
+
+	// an L of three tiles
+	draw(fb);
+	damage.update(fb);
+	draw(fb);
+	fb.set(0, 0, 1.0f, 0.0f, 0.0f, 0.0f);
+	fb.set(8, 0, 1.0f, 0.0f, 0.0f, 0.0f);
+	fb.set(0, 8, 1.0f, 0.0f, 0.0f, 0.0f);
+	damage.update(fb);
+	report("runs of different widths are not merged", sameRegions(damage.getRegions(), { 0, 0, 16, 8, 0, 8, 8, 8 }), describe(damage.getRegions()));
+
+	// cleared tiles are compared by their clear color
+	draw(fb);
+	damage.update(fb);
+	fb.clear(0.1f, 0.2f, 0.3f, 1.0f);
+	for(int y = 0; y < 21 / 2; y++) for(int x = 0; x < 37; x++) fb.set(x, y, x / 64.0f, y / 64.0f, 0.5f, 0.0f);
+	damage.update(fb);
+	report("same clear color", damage.empty(), describe(damage.getTiles()));
+	fb.clear(0.3f, 0.2f, 0.1f, 1.0f);
+	damage.update(fb);
+	report("new clear color damages every tile", damage.getTiles().size() == 15, describe(damage.getTiles()));
+
+	damage.reset();
+	damage.update(fb);
+	report("reset damages every tile", damage.getTiles().size() == 15, describe(damage.getTiles()));
+}
+
+/**
+ * Renders into a region of a 64x48 frame. Every pixel of the upscaled frame
+ * that changes must lie in a damaged tile, and tiles far from the change must
+ * not be damaged.
+ */
+static void checkUpscaled()
+{
+	FrameBuffer fb(64, 48);
+	DamageTracker damage;
+	fb.setRegion(32, 24);
+
+	draw(fb);
+	damage.update(fb);
+	std::vector<unsigned char> before((const unsigned char*) fb.getColorData(), (const unsigned char*) fb.getColorData() + 64 * 48 * 4);
+	report("first scaled frame damages every tile", damage.getTiles().size() == 48, describe(damage.getTiles()));
+
+	// one pixel of the region tile (1, 1)
+	draw(fb);
+	fb.set(12, 9, 1.0f, 1.0f, 1.0f, 0.0f);
+	damage.update(fb);
+	const unsigned char* after = (const unsigned char*) fb.getColorData();
+
+	int missed = 0, changed = 0;
+	for(int y = 0; y < 48; y++){
+		for(int x = 0; x < 64; x++){
+			if(memcmp(&before[(y * 64 + x) * 4], after + (y * 64 + x) * 4, 4) == 0) continue;
+			changed++;
+			if(!damage.damaged(x / 8, y / 8)) missed++;
+		}
+	}
+	report("changed upscaled pixels are damaged", changed > 0 && missed == 0, std::to_string(changed) + " changed, " + std::to_string(missed) + " missed, " + describe(damage.getTiles()));
+	// a region tile covers 16x16 pixels of the frame, plus the bilinear footprint
+	report("distant tiles are not damaged", !damage.damaged(0, 5) && !damage.damaged(7, 0) && !damage.damaged(7, 5) && damage.getTiles().size() <= 16, describe(damage.getRegions()));
+
+	fb.setRegion(48, 36);
+	draw(fb);
+	damage.update(fb);
+	report("new region damages every tile", damage.getTiles().size() == 48, describe(damage.getTiles()));
+}
+
+/**
+ * A tile of a delta frame.
+ */
+struct DeltaTile {
+	uint16_t x, y, width, height;
+	std::vector<unsigned char> pixels;
+};
+
+/**
+ * Reads one frame of a delta stream.
+ *
+ * @return false when the header is not valid
+ */
+static bool readDelta(FILE* file, unsigned width, unsigned height, std::vector<DeltaTile>& tiles)
+{
+	uint32_t header[5];
+	if(fread(header, sizeof(header), 1, file) != 1) return false;
+	if(header[0] != 0x54445050u || header[1] != width || header[2] != height || header[3] != (uint32_t) FrameBuffer::TILE_SIZE) return false;
+
+	tiles.resize(header[4]);
+	for(size_t i = 0; i < tiles.size(); i++){
+		uint16_t rect[4];
+		if(fread(rect, sizeof(rect), 1, file) != 1) return false;
+		tiles[i].x = rect[0];
+		tiles[i].y = rect[1];
+		tiles[i].width = rect[2];
+		tiles[i].height = rect[3];
+		tiles[i].pixels.resize((size_t) rect[2] * rect[3] * 3);
+		if(fread(&tiles[i].pixels[0], 1, tiles[i].pixels.size(), file) != tiles[i].pixels.size()) return false;
+	}
+	return true;
+}
+
+/**
+ * @return whether the packed pixels of the tiles match the frame, which is stored bottom row first
+ */
+static bool samePixels(const std::vector<DeltaTile>& tiles, const unsigned char* color, unsigned width, unsigned height)
+{
+	for(size_t i = 0; i < tiles.size(); i++){
+		const DeltaTile& tile = tiles[i];
+		for(unsigned y = 0; y < tile.height; y++){
+			for(unsigned x = 0; x < tile.width; x++){
+				const unsigned char* expected = color + ((size_t) (height - 1 - (tile.y + y)) * width + tile.x + x) * 4;
+				if(memcmp(&tile.pixels[((size_t) y * tile.width + x) * 3], expected, 3) != 0) return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Streams three delta frames: the first frame, a frame with one changed tile,
+ * and a frame without damage information.
+ */
+static void checkDelta()
+{
+	const unsigned width = 37, height = 21;
+	const char* path = "damage_test.delta";
+	FrameBuffer fb(width, height);
+	DamageTracker damage;
+	std::vector<std::vector<unsigned char> > frames;
+
+	{
+		FrameStream stream(path, STREAM_FORMAT_DELTA, 30, 2);
+
+		draw(fb);
+		damage.update(fb);
+		const unsigned char* color = (const unsigned char*) fb.getColorData();
+		frames.push_back(std::vector<unsigned char>(color, color + width * height * 4));
+		stream.consume(color, width, height, COLOR_FORMAT_RGBA8, &damage);
+
+		draw(fb);
+		fb.set(20, 10, 1.0f, 0.0f, 0.0f, 0.0f);
+		damage.update(fb);
+		color = (const unsigned char*) fb.getColorData();
+		frames.push_back(std::vector<unsigned char>(color, color + width * height * 4));
+		stream.consume(color, width, height, COLOR_FORMAT_RGBA8, &damage);
+
+		stream.consume(color, width, height, COLOR_FORMAT_RGBA8, NULL);
+		frames.push_back(frames.back());
+	}
+
+	FILE* file = fopen(path, "rb");
+	if(file == NULL){
+		report("delta stream", false, "unable to open the stream");
+		return;
+	}
+
+	std::vector<DeltaTile> tiles;
+	bool ok = readDelta(file, width, height, tiles);
+	report("first delta frame holds every tile", ok && tiles.size() == 15 && samePixels(tiles, &frames[0][0], width, height), std::to_string(tiles.size()) + " tiles");
+
+	// the top right tile is clipped to 5x5, and at the top of the image
+	bool clipped = false;
+	for(size_t i = 0; i < tiles.size(); i++){
+		if(tiles[i].x == 32 && tiles[i].y == 0 && tiles[i].width == 5 && tiles[i].height == 5) clipped = true;
+	}
+	report("clipped edge tile", clipped);
+
+	// the tile (2, 1) is rows [8, 16) from the bottom, rows [5, 13) from the top
+	ok = readDelta(file, width, height, tiles);
+	report("second delta frame holds the changed tile", ok && tiles.size() == 1 && tiles[0].x == 16 && tiles[0].y == 5
+		&& tiles[0].width == 8 && tiles[0].height == 8 && samePixels(tiles, &frames[1][0], width, height),
+		tiles.empty() ? "no tiles" : std::to_string(tiles[0].x) + "," + std::to_string(tiles[0].y) + " " + std::to_string(tiles[0].width) + "x" + std::to_string(tiles[0].height));
+	if(ok && tiles.size() == 1){
+		// the changed pixel (20, 10) is at (4, 5) from the top left of the packed tile
+		const unsigned char* pixel = &tiles[0].pixels[(5 * 8 + 4) * 3];
+		report("packed bytes of the changed pixel", pixel[0] == 255 && pixel[1] == 0 && pixel[2] == 0,
+			std::to_string(pixel[0]) + " " + std::to_string(pixel[1]) + " " + std::to_string(pixel[2]));
+	}
+
+	ok = readDelta(file, width, height, tiles);
+	report("delta frame without damage holds every tile", ok && tiles.size() == 15 && samePixels(tiles, &frames[2][0], width, height), std::to_string(tiles.size()) + " tiles");
+
+	report("end of stream", fgetc(file) == EOF);
+	fclose(file);
+	remove(path);
+}
+
+/**
+ * Streams a float frame as RGB and as a delta frame, sRGB encoded and
+ * dithered. Both must hold the image of a PixelConverter with the same
+ * settings, top row first.
+ */
+static void checkFloat()
+{
+	const unsigned width = 37, height = 21;
+	const char* path = "damage_test.float";
+	FrameBuffer fb(width, height, COLOR_FORMAT_FLOAT);
+	draw(fb);
+	const float* color = (const float*) fb.getColorData();
+
+	std::vector<unsigned char> expected(width * height * 3);
+	PixelConverter converter(CHANNEL_ORDER_RGB, COLOR_ENCODING_SRGB_TABLE, true);
+	converter.convert(color, 4, width, height, &expected[0], true);
+
+	const stream_format formats[2] = { STREAM_FORMAT_RGB, STREAM_FORMAT_DELTA };
+	for(int f = 0; f < 2; f++){
+		{
+			FrameStream stream(path, formats[f], 30, 2);
+			stream.setEncoding(COLOR_ENCODING_SRGB_TABLE, true);
+			stream.consume(color, width, height, COLOR_FORMAT_FLOAT, NULL);
+		}
+
+		FILE* file = fopen(path, "rb");
+		std::vector<unsigned char> frame(width * height * 3);
+		bool ok = file != NULL;
+		if(ok && formats[f] == STREAM_FORMAT_RGB) ok = fread(&frame[0], 1, frame.size(), file) == frame.size();
+		else if(ok){
+			std::vector<DeltaTile> tiles;
+			ok = readDelta(file, width, height, tiles);
+			for(size_t i = 0; ok && i < tiles.size(); i++){
+				for(unsigned y = 0; y < tiles[i].height; y++){
+					memcpy(&frame[((size_t) (tiles[i].y + y) * width + tiles[i].x) * 3], &tiles[i].pixels[(size_t) y * tiles[i].width * 3], tiles[i].width * 3);
+				}
+			}
+		}
+		if(file != NULL) fclose(file);
+		remove(path);
+		report(std::string(formats[f] == STREAM_FORMAT_RGB ? "rgb" : "delta") + " stream of a float frame is converted", ok && frame == expected);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "tiles" << std::endl;
+	checkTiles();
+	std::cout << "upscaled region" << std::endl;
+	checkUpscaled();
+	std::cout << "delta stream" << std::endl;
+	checkDelta();
+	std::cout << "float stream" << std::endl;
+	checkFloat();
+
+	return finish();
+}
@@ -0,0 +1,92 @@
+
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+#include "core/fastmath.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static float relative(float approx, float exact)
+{
+	return fabs(approx - exact) / std::max(fabs(exact), 1e-30f);
+}
+
+int main(int argc, char* argv[])
+{
+	const math_precision tiers[2] = { MATH_PRECISION_FAST, MATH_PRECISION_FASTEST };
+	const char* names[2] = { "fast", "fastest" };
+	const float expBound[2] = { 1e-6f, 1e-4f };
+	const float logBound[2] = { 2e-5f, 1e-3f };
+	const float powBound[2] = { 1.5e-5f, 7e-4f };
+	const float rsqrtBound[2] = { 1e-5f, 2e-3f };
+
+	for(int t = 0; t < 2; t++){
+		math_precision p = tiers[t];
+		std::cout << names[t] << std::endl;
+
+		float err = 0;
+		for(float x = -20.0f; x <= 20.0f; x += 0.001f){
+			err = std::max(err, relative(FastMath::exp2(x, p), exp2f(x)));
+		}
+		reportBound("exp2", err, expBound[t]);
+
+		err = 0;
+		for(float x = -10.0f; x <= 10.0f; x += 0.001f){
+			err = std::max(err, relative(FastMath::exp(x, p), expf(x)));
+		}
+		reportBound("exp", err, expBound[t] * 2);
+
+		err = 0;
+		for(float x = 1e-4f; x <= 1e4f; x *= 1.001f){
+			err = std::max(err, (float) fabs(FastMath::log2(x, p) - log2f(x)));
+		}
+		reportBound("log2 (absolute)", err, logBound[t]);
+
+		// the range used by the specular term; the relative error of exp2(y * log2(x))
+		// grows linearly with the exponent, so it is measured per unit of exponent
+		err = 0;
+		for(float x = 0.05f; x <= 1.0f; x += 0.0001f){
+			for(float y = 1.0f; y <= 128.0f; y *= 2.0f){
+				float exact = powf(x, y);
+				if(exact < 1e-6f) continue;
+				err = std::max(err, relative(FastMath::pow(x, y, p), exact) / y);
+			}
+		}
+		reportBound("pow (per unit exponent)", err, powBound[t]);
+
+		err = 0;
+		for(float x = 1e-4f; x <= 1e4f; x *= 1.001f){
+			err = std::max(err, relative(FastMath::rsqrt(x, p), 1.0f / sqrtf(x)));
+		}
+		reportBound("rsqrt", err, rsqrtBound[t]);
+
+		err = 0;
+		for(float x = -3.0f; x <= 3.0f; x += 0.01f){
+			cg::vecmath::Vector3f v(x, 1.0f - x, 0.5f);
+			FastMath::normalize(v, p);
+			err = std::max(err, (float) fabs(sqrtf(v.x * v.x + v.y * v.y + v.z * v.z) - 1.0f));
+		}
+		reportBound("normalize (length)", err, rsqrtBound[t] * 2);
+	}
+
+	std::cout << "specular table" << std::endl;
+	SpecularTable table(40.0f);
+	float err = 0;
+	for(float x = -0.5f; x <= 1.5f; x += 0.0001f){
+		float c = std::min(std::max(x, 0.0f), 1.0f);
+		err = std::max(err, (float) fabs(table.lookup(x) - powf(c, 40.0f)));
+	}
+	reportBound("lookup 40 (absolute)", err, 1e-3f);
+
+	table.rebuild(8.0f);
+	err = 0;
+	for(float x = 0.0f; x <= 1.0f; x += 0.0001f){
+		err = std::max(err, (float) fabs(table.lookup(x) - powf(x, 8.0f)));
+	}
+	reportBound("lookup 8 (absolute)", err, 1e-4f);
+
+	return finish();
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+
+#include "core/frame_ring.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static const unsigned SLOTS = 3;
+static const int FRAMES = 10;
+static const int DELAY = 20;	//!< the time the consumer takes per frame, in milliseconds
+
+/**
+ * Records the frames it receives, identified by the red byte of their first
+ * pixel, and takes DELAY milliseconds over each of them.
+ */
+class SlowConsumer : public FrameConsumer {
+public:
+	std::mutex mutex;
+	std::vector<int> frames;				//!< the consumed frames, in order
+	std::atomic<const void*> busy;			//!< the color data being consumed, or NULL
+	std::atomic<int> completed;				//!< the number of consumed frames
+
+	SlowConsumer() : busy(NULL), completed(0) {}
+
+	virtual void consume(const void* color, unsigned width, unsigned height, color_format format, const DamageTracker* damage)
+	{
+		busy = color;
+		std::this_thread::sleep_for(std::chrono::milliseconds(DELAY));
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			frames.push_back(((const unsigned char*) color)[0]);
+		}
+		busy = NULL;
+		completed++;
+	}
+};
+
+/**
+ * Renders frame i: its number in the red byte of the first pixel.
+ */
+static void render(FrameBuffer& fb, int i)
+{
+	fb.clear(0.0f, 0.0f, 0.0f, 1.0f);
+	fb.set(0, 0, i / 255.0f, 0.0f, 0.0f, 0.0f);
+}
+
+/**
+ * Checks that the consumer received every frame, in the order of submission.
+ */
+static void checkConsumed(const std::string& name, SlowConsumer& consumer)
+{
+	bool ordered = consumer.frames.size() == (size_t) FRAMES;
+	for(size_t i = 0; ordered && i < consumer.frames.size(); i++) ordered = consumer.frames[i] == (int) i;
+	report(name + " drains the queue", consumer.completed == FRAMES, std::to_string(consumer.completed) + " of " + std::to_string(FRAMES) + " frames");
+	report(name + " leaves the frames consumed in order", ordered);
+}
+
+/**
+ * Submits more frames than there are framebuffers to a consumer slower than
+ * the renderer. A submit() that makes a framebuffer in flight the render
+ * target must block until its frame is consumed, and finish() must then
+ * leave every frame consumed.
+ */
+static void checkSubmit()
+{
+	FrameRing ring(SLOTS, 16, 16, COLOR_FORMAT_RGBA8, DEPTH_FORMAT_32F, FRAMEBUFFER_LAYOUT_LINEAR);
+	SlowConsumer consumer;
+	ring.setConsumer(&consumer);
+
+	int early = 0, reused = 0, blocked = 0;
+	for(int i = 0; i < FRAMES; i++){
+		render(ring.current(), i);
+
+		// the next render target holds frame i + 1 - SLOTS
+		int previous = i + 1 - (int) SLOTS;
+		bool inFlight = previous >= 0 && consumer.completed < previous + 1;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ring.submit();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if(previous >= 0 && consumer.completed < previous + 1) early++;
+		if(ring.current().getColorData() == consumer.busy.load()) reused++;
+		if(inFlight && ms >= DELAY / 4) blocked++;
+	}
+	report("submit returns once the next render target is idle", early == 0 && reused == 0, std::to_string(early) + " early, " + std::to_string(reused) + " in flight");
+	report("submit blocks on a render target in flight", blocked >= FRAMES - (int) SLOTS, std::to_string(blocked) + " blocking submits");
+	report("frames in flight after the last submit", consumer.completed < FRAMES, std::to_string(FRAMES - consumer.completed));
+
+	ring.finish();
+	checkConsumed("finish", consumer);
+
+	const void* color;
+	const FrameBuffer* fb = ring.latest(&color);
+	report("latest after finish is the last frame", fb != NULL && color != NULL && ((const unsigned char*) color)[0] == FRAMES - 1);
+}
+
+/**
+ * Polls latest() after every submit(): it must only return completed frames,
+ * never the render target or the frame being consumed.
+ */
+static void checkLatest()
+{
+	FrameRing ring(SLOTS, 16, 16, COLOR_FORMAT_RGBA8, DEPTH_FORMAT_32F, FRAMEBUFFER_LAYOUT_LINEAR);
+	SlowConsumer consumer;
+	ring.setConsumer(&consumer);
+
+	const void* color;
+	report("latest before the first frame", ring.latest(&color) == NULL && color == NULL);
+
+	int incomplete = 0, rendering = 0;
+	for(int i = 0; i < FRAMES; i++){
+		render(ring.current(), i);
+		ring.submit();
+
+		const FrameBuffer* fb = ring.latest(&color);
+		if(fb == NULL || color == NULL) incomplete++;
+		else{
+			if(fb == &ring.current() || color == consumer.busy.load()) rendering++;
+			int frame = ((const unsigned char*) color)[0];
+			if(frame > i || frame + 1 > consumer.completed) incomplete++;
+		}
+	}
+	reportMismatches("latest returns completed frames", incomplete, "incomplete");
+	reportMismatches("latest avoids the render target and the consumed frame", rendering);
+
+	ring.finish();
+	checkConsumed("finish after latest", consumer);
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "submit" << std::endl;
+	checkSubmit();
+	std::cout << "latest" << std::endl;
+	checkLatest();
+
+	return finish();
+}
@@ -0,0 +1,301 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "core/framebuffer.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static const char* colorNames[3] = { "rgba8", "rgb10a2", "float" };
+static const char* depthNames[3] = { "32f", "24", "16" };
+static const char* layoutNames[3] = { "linear", "tiled", "top down" };
+
+static const int colorSizes[3] = { 4, 4, 16 };
+static const int depthSizes[3] = { 4, 4, 2 };
+
+//! the largest difference between a depth and its stored value, in each depth format
+static const float depthBound[3] = { 0.0f, 1.0f / 16777215.0f + 1e-6f, 1.0f / 65535.0f + 1e-6f };
+
+static std::string describe(int c, int d, int l, int width, int height)
+{
+	return std::string(colorNames[c]) + "/" + depthNames[d] + " " + layoutNames[l] + " " + std::to_string(width) + "x" + std::to_string(height);
+}
+
+/**
+ * @return the depth written at a pixel, in [-1, 1]
+ */
+static float depthAt(int x, int y)
+{
+	return -1.0f + 2.0f * ((x * 7 + y * 13) % 101) / 100.0f;
+}
+
+/**
+ * Clears the buffer and writes the left two thirds of it, so that the tiles on
+ * the right keep their clear values. Every third pixel only gets a depth.
+ */
+static void draw(FrameBuffer& fb)
+{
+	int width = fb.width(), height = fb.height();
+
+	fb.clear(0.25f, 0.5f, 0.75f, 1.0f);
+	for(int y = 0; y < height; y++){
+		for(int x = 0; x < width * 2 / 3; x++){
+			if((x + y) % 3 == 0) fb.setZ(x, y, depthAt(x, y));
+			else fb.set(x, y, x / (float) width, y / (float) height, ((x * y) % 17) / 16.0f, depthAt(x, y));
+		}
+	}
+}
+
+/**
+ * Decodes pixel i of the data returned by getColorData().
+ */
+static void decodeColor(color_format format, const void* data, size_t i, float* rgb)
+{
+	switch(format){
+		case COLOR_FORMAT_RGBA8:{
+			const unsigned char* p = (const unsigned char*) data + i * 4;
+			for(int k = 0; k < 3; k++) rgb[k] = p[k] / 255.0f;
+			break;
+		}
+		case COLOR_FORMAT_RGB10A2:{
+			uint32_t word = ((const uint32_t*) data)[i];
+			for(int k = 0; k < 3; k++) rgb[k] = ((word >> (10 * k)) & 1023) / 1023.0f;
+			break;
+		}
+		default:
+		case COLOR_FORMAT_FLOAT:{
+			const float* p = (const float*) data + i * 4;
+			for(int k = 0; k < 3; k++) rgb[k] = p[k];
+			break;
+		}
+	}
+}
+
+/**
+ * Decodes pixel i of the data returned by getDepthData() into [-1, 1].
+ */
+static float decodeDepth(depth_format format, const void* data, size_t i)
+{
+	switch(format){
+		case DEPTH_FORMAT_24: return ((const uint32_t*) data)[i] * (2.0f / 16777215.0f) - 1.0f;
+		case DEPTH_FORMAT_16: return ((const uint16_t*) data)[i] * (2.0f / 65535.0f) - 1.0f;
+		default:
+		case DEPTH_FORMAT_32F: return ((const float*) data)[i];
+	}
+}
+
+/**
+ * Draws the same frame in every format and layout. The row major data of the
+ * tiled and top down layouts must be identical to the linear layout of the
+ * same formats, and decode to the linear RGBA8 / 32F frame within the
+ * precision of the formats.
+ */
+static void checkLayouts(int width, int height)
+{
+	FrameBuffer reference(width, height, COLOR_FORMAT_RGBA8, DEPTH_FORMAT_32F, FRAMEBUFFER_LAYOUT_LINEAR);
+	draw(reference);
+	std::vector<unsigned char> referenceColor((const unsigned char*) reference.getColorData(), (const unsigned char*) reference.getColorData() + (size_t) width * height * 4);
+	std::vector<float> referenceDepth((const float*) reference.getDepthData(), (const float*) reference.getDepthData() + (size_t) width * height);
+
+	const float colorBound[3] = { 0.0f, 0.5f / 255.0f + 0.5f / 1023.0f, 0.5f / 255.0f };
+
+	for(int c = 0; c < 3; c++){
+		for(int d = 0; d < 3; d++){
+			FrameBuffer linear(width, height, (color_format) c, (depth_format) d, FRAMEBUFFER_LAYOUT_LINEAR);
+			draw(linear);
+			size_t colorBytes = (size_t) width * height * colorSizes[c];
+			size_t depthBytes = (size_t) width * height * depthSizes[d];
+			std::vector<unsigned char> linearColor((const unsigned char*) linear.getColorData(), (const unsigned char*) linear.getColorData() + colorBytes);
+			std::vector<unsigned char> linearDepth((const unsigned char*) linear.getDepthData(), (const unsigned char*) linear.getDepthData() + depthBytes);
+
+			for(int l = 0; l < 3; l++){
+				FrameBuffer fb(width, height, (color_format) c, (depth_format) d, (framebuffer_layout) l);
+				draw(fb);
+
+				const unsigned char* color = (const unsigned char*) fb.getColorData();
+				const unsigned char* depth = (const unsigned char*) fb.getDepthData();
+				int mismatches = 0;
+				for(size_t i = 0; i < colorBytes; i++) if(color[i] != linearColor[i]) mismatches++;
+				for(size_t i = 0; i < depthBytes; i++) if(depth[i] != linearDepth[i]) mismatches++;
+
+				for(size_t i = 0; i < (size_t) width * height; i++){
+					float rgb[3];
+					decodeColor((color_format) c, color, i, rgb);
+					for(int k = 0; k < 3; k++){
+						if(fabs(rgb[k] - referenceColor[i * 4 + k] / 255.0f) > colorBound[c] + 1e-6f) mismatches++;
+					}
+					if(fabs(decodeDepth((depth_format) d, depth, i) - referenceDepth[i]) > depthBound[d]) mismatches++;
+				}
+
+				// the accessors read the planes in place
+				for(int y = 0; y < height; y++){
+					for(int x = 0; x < width; x++){
+						size_t i = (size_t) y * width + x;
+						cg::vecmath::Color3f a = fb.getColor(x, y);
+						float rgb[3];
+						decodeColor((color_format) c, &linearColor[0], i, rgb);
+						if(a.x != rgb[0] || a.y != rgb[1] || a.z != rgb[2]) mismatches++;
+						if(fb.getZ(x, y) != decodeDepth((depth_format) d, &linearDepth[0], i)) mismatches++;
+					}
+				}
+
+				reportMismatches(describe(c, d, l, width, height), mismatches);
+			}
+		}
+	}
+}
+
+/**
+ * The depth written by set() must pass an equal test with the same value in
+ * every depth format, and fail it a few steps of the format away, as the
+ * shading pass after a depth prepass relies on. The 24 bit conversion is done
+ * in float arithmetic, which rounds to about one step, so its margin is wider.
+ */
+static void checkDepthEqual(int width, int height)
+{
+	const float steps[3] = { 0.0f, 4.0f * 2.0f / 16777215.0f, 1.5f * 2.0f / 65535.0f };
+
+	for(int d = 0; d < 3; d++){
+		for(int l = 0; l < 3; l++){
+			FrameBuffer fb(width, height, COLOR_FORMAT_RGBA8, (depth_format) d, (framebuffer_layout) l);
+			draw(fb);
+
+			int mismatches = 0;
+			for(int y = 0; y < height; y++){
+				for(int x = 0; x < width; x++){
+					// the right third still holds the clear depth
+					float z = (x < width * 2 / 3) ? depthAt(x, y) : 1.0f;
+					float step = (d == DEPTH_FORMAT_32F) ? fabs(z) * 1e-6f + 1e-7f : steps[d];
+
+					if(!fb.testZ(x, y, z, DEPTH_FUNC_EQUAL)) mismatches++;
+					if(!fb.testZ(x, y, z, DEPTH_FUNC_LEQUAL)) mismatches++;
+					if(fb.testZ(x, y, z, DEPTH_FUNC_LESS)) mismatches++;
+					if(z - step >= -1.0f && !fb.testZ(x, y, z - step, DEPTH_FUNC_LESS)) mismatches++;
+					if(z - step >= -1.0f && fb.testZ(x, y, z - step, DEPTH_FUNC_EQUAL)) mismatches++;
+					if(z + step <= 1.0f && fb.testZ(x, y, z + step, DEPTH_FUNC_EQUAL)) mismatches++;
+				}
+			}
+
+			reportMismatches(std::string("equal depth ") + depthNames[d] + " " + layoutNames[l] + " " + std::to_string(width) + "x" + std::to_string(height), mismatches);
+		}
+	}
+}
+
+/**
+ * A cleared tile is only filled by its first write: until then the depth test
+ * and the accessors see the clear values without writing the tile, and a
+ * second clear resets the written tiles.
+ */
+static void checkLazyClear(int width, int height)
+{
+	for(int d = 0; d < 3; d++){
+		for(int l = 0; l < 3; l++){
+			FrameBuffer fb(width, height, COLOR_FORMAT_RGBA8, (depth_format) d, (framebuffer_layout) l);
+			int tiles = fb.tilesX() * fb.tilesY();
+			int mismatches = 0;
+
+			fb.clear(0.0f, 1.0f, 0.0f, 0.0f);
+			for(int y = 0; y < height; y++){
+				for(int x = 0; x < width; x++){
+					if(!fb.testZ(x, y, -0.5f, DEPTH_FUNC_LESS)) mismatches++;
+					if(fb.testZ(x, y, 0.5f, DEPTH_FUNC_LESS)) mismatches++;
+					if(!fb.testZ(x, y, 0.0f, DEPTH_FUNC_EQUAL)) mismatches++;
+					if(fabs(fb.getZ(x, y)) > depthBound[d]) mismatches++;
+				}
+			}
+			for(int t = 0; t < tiles; t++) if(fb.tileWritten(t)) mismatches++;
+
+			// one pixel in the last, partial tile materializes only that tile
+			int x0 = width - 1, y0 = height - 1;
+			fb.set(x0, y0, 1.0f, 0.0f, 0.0f, -0.5f);
+			for(int t = 0; t < tiles; t++) if(fb.tileWritten(t) != (t == tiles - 1)) mismatches++;
+			for(int y = 0; y < height; y++){
+				for(int x = 0; x < width; x++){
+					bool written = (x == x0 && y == y0);
+					cg::vecmath::Color3f c = fb.getColor(x, y);
+					if(c.x != (written ? 1.0f : 0.0f) || c.y != (written ? 0.0f : 1.0f) || c.z != 0.0f) mismatches++;
+					if(fabs(fb.getZ(x, y) - (written ? -0.5f : 0.0f)) > depthBound[d]) mismatches++;
+					if(fb.testZ(x, y, 0.0f, DEPTH_FUNC_EQUAL) == written) mismatches++;
+				}
+			}
+
+			// the raw data of the whole frame holds the clear values around the pixel
+			const unsigned char* color = (const unsigned char*) fb.getColorData();
+			for(size_t i = 0; i < (size_t) width * height; i++){
+				bool written = (i == (size_t) y0 * width + x0);
+				if(color[i * 4] != (written ? 255 : 0) || color[i * 4 + 1] != (written ? 0 : 255) || color[i * 4 + 3] != 255) mismatches++;
+				if(fabs(decodeDepth((depth_format) d, fb.getDepthData(), i) - (written ? -0.5f : 0.0f)) > depthBound[d]) mismatches++;
+			}
+
+			// a second clear hides the written pixel again
+			fb.clear(0.0f, 0.0f, 1.0f, 1.0f);
+			cg::vecmath::Color3f c = fb.getColor(x0, y0);
+			if(c.x != 0.0f || c.y != 0.0f || c.z != 1.0f || fb.getZ(x0, y0) != 1.0f) mismatches++;
+			color = (const unsigned char*) fb.getColorData();
+			for(size_t i = 0; i < (size_t) width * height; i++){
+				if(color[i * 4] != 0 || color[i * 4 + 1] != 0 || color[i * 4 + 2] != 255) mismatches++;
+			}
+
+			reportMismatches(std::string("lazy clear ") + depthNames[d] + " " + layoutNames[l] + " " + std::to_string(width) + "x" + std::to_string(height), mismatches);
+		}
+	}
+}
+
+/**
+ * Unpacks the rows of the color data of every format into 8 bit RGB, from the
+ * second pixel of each row. The bytes must be the decoded colors clamped and
+ * rounded, except RGB10A2, which keeps the top 8 of its 10 bits.
+ */
+static void checkUnpack(int width, int height)
+{
+	for(int c = 0; c < 3; c++){
+		FrameBuffer fb(width, height, (color_format) c);
+		draw(fb);
+		// out of range colors, which only the float format keeps
+		fb.set(1, 0, 1.5f, -0.25f, 0.5f, 0.0f);
+		const void* data = fb.getColorData();
+
+		int tolerance = (c == COLOR_FORMAT_RGB10A2) ? 1 : 0;
+		long mismatches = 0;
+		std::vector<unsigned char> row(width * 3);
+		for(int y = 0; y < height; y++){
+			size_t first = (size_t) y * width + 1;
+			FrameBuffer::unpackRow(data, (color_format) c, first, width - 1, &row[0]);
+			for(int x = 0; x < width - 1; x++){
+				float rgb[3];
+				decodeColor((color_format) c, data, first + x, rgb);
+				for(int k = 0; k < 3; k++){
+					int expected = (int) (std::min(std::max(rgb[k], 0.0f), 1.0f) * 255.0f + 0.5f);
+					if(abs(row[x * 3 + k] - expected) > tolerance) mismatches++;
+				}
+			}
+		}
+		reportMismatches(std::string("unpack ") + colorNames[c] + " " + std::to_string(width) + "x" + std::to_string(height), mismatches);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// 37x21 leaves partial tiles on the right and at the top
+	const int sizes[2][2] = { { 64, 48 }, { 37, 21 } };
+
+	for(int s = 0; s < 2; s++){
+		std::cout << "layouts and formats" << std::endl;
+		checkLayouts(sizes[s][0], sizes[s][1]);
+		std::cout << "depth test" << std::endl;
+		checkDepthEqual(sizes[s][0], sizes[s][1]);
+		std::cout << "lazy clear" << std::endl;
+		checkLazyClear(sizes[s][0], sizes[s][1]);
+		std::cout << "unpack" << std::endl;
+		checkUnpack(sizes[s][0], sizes[s][1]);
+	}
+
+	return finish();
+}
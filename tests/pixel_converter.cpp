@@ -0,0 +1,158 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <math.h>
+
+#include "core/pixel_converter.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static const char* orderNames[4] = { "rgba", "bgra", "rgb", "bgr" };
+static const char* encodingNames[3] = { "linear", "srgb table", "srgb polynomial" };
+
+//! the 4x4 ordered dither thresholds of the converter
+static const float BAYER[4][4] = {
+	{  0.5f / 16.0f,  8.5f / 16.0f,  2.5f / 16.0f, 10.5f / 16.0f },
+	{ 12.5f / 16.0f,  4.5f / 16.0f, 14.5f / 16.0f,  6.5f / 16.0f },
+	{  3.5f / 16.0f, 11.5f / 16.0f,  1.5f / 16.0f,  9.5f / 16.0f },
+	{ 15.5f / 16.0f,  7.5f / 16.0f, 13.5f / 16.0f,  5.5f / 16.0f }
+};
+
+/**
+ * The exact sRGB transfer function, in double precision.
+ */
+static double srgb(double x)
+{
+	return (x <= 0.0031308) ? x * 12.92 : 1.055 * pow(x, 1.0 / 2.4) - 0.055;
+}
+
+/**
+ * The 8 bit value of a channel, quantized exactly.
+ */
+static int exact(float value, bool encoded, float offset)
+{
+	value = (value > 0.0f) ? ((value < 1.0f) ? value : 1.0f) : 0.0f;
+	if(encoded) return (int) floor(255.0 * srgb(value) + offset);
+	return (int) floor(255.0 * value + offset);
+}
+
+/**
+ * The 8 bit value of a linear channel as computed before the converter existed,
+ * which the linear encoding must reproduce byte for byte.
+ */
+static int previous(float value)
+{
+	value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (unsigned char) (value * 255.0f + 0.5f);
+}
+
+/**
+ * Fills rows of pixels that sweep [-0.05, 1.05] with a different phase per
+ * channel, so every 8 bit step and both clamps are crossed.
+ */
+static void fill(std::vector<float>& pixels, unsigned channels, unsigned width, unsigned height)
+{
+	pixels.resize((size_t) width * height * channels);
+	for(unsigned y = 0; y < height; y++){
+		for(unsigned x = 0; x < width; x++){
+			for(unsigned c = 0; c < channels; c++){
+				unsigned i = (x * 7 + c * 1361 + y * 97) % 4096;
+				pixels[((size_t) y * width + x) * channels + c] = -0.05f + 1.1f * i / 4095.0f;
+			}
+		}
+	}
+}
+
+/**
+ * Converts rows in every channel order and compares each byte with the exact
+ * conversion. The linear channels (all of them in the linear encoding, alpha
+ * otherwise) must be exact, and the rounded linear ones must also match the
+ * conversion used before the PixelConverter. The 3 byte orders drop alpha.
+ */
+static void checkEncoding(color_encoding encoding, bool dither, unsigned srcChannels, int bound)
+{
+	// an odd width exercises the partial groups of the SSE2 path
+	const unsigned width = 4099, height = 4;
+	std::vector<float> pixels;
+	fill(pixels, srcChannels, width, height);
+
+	for(int o = 0; o < 4; o++){
+		PixelConverter converter((channel_order) o, encoding, dither);
+		unsigned channels = converter.channels();
+		bool bgr = (o == CHANNEL_ORDER_BGRA || o == CHANNEL_ORDER_BGR);
+		std::vector<unsigned char> row(width * channels);
+
+		int colorError = 0, linearError = 0;
+		for(unsigned y = 0; y < height; y++){
+			converter.convertRow(&pixels[(size_t) y * width * srcChannels], srcChannels, width, y, &row[0]);
+			for(unsigned x = 0; x < width; x++){
+				const float* p = &pixels[((size_t) y * width + x) * srcChannels];
+				float offset = dither ? BAYER[y & 3][x & 3] : 0.5f;
+				for(unsigned c = 0; c < channels; c++){
+					unsigned source = (bgr && c < 3) ? 2 - c : c;
+					float value = (source < srcChannels) ? p[source] : 1.0f;
+					bool encoded = source < 3 && encoding != COLOR_ENCODING_LINEAR;
+					int actual = row[x * channels + c];
+					int error = abs(actual - exact(value, encoded, offset));
+
+					if(encoded) colorError = std::max(colorError, error);
+					else linearError = std::max(linearError, error);
+					if(encoding == COLOR_ENCODING_LINEAR && !dither) linearError = std::max(linearError, abs(actual - previous(value)));
+				}
+			}
+		}
+
+		std::string name = std::string(encodingNames[encoding]) + (dither ? " dithered " : " rounded ") + orderNames[o] + " from " + std::to_string(srcChannels) + " channels";
+		if(encoding != COLOR_ENCODING_LINEAR) reportBound(name, colorError, bound);
+		if(encoding == COLOR_ENCODING_LINEAR) reportBound(name, linearError, 0);
+		else if(channels == 4) reportBound(name + ", alpha", linearError, 0);
+	}
+}
+
+/**
+ * Converting a whole image across threads, with the rows flipped, must give
+ * the same bytes as converting each row on its own.
+ */
+static void checkImage()
+{
+	const unsigned width = 301, height = 299;
+	std::vector<float> pixels;
+	fill(pixels, 4, width, height);
+
+	PixelConverter converter(CHANNEL_ORDER_BGRA, COLOR_ENCODING_SRGB_POLYNOMIAL, true);
+	std::vector<unsigned char> image((size_t) width * height * 4);
+	std::vector<unsigned char> rows(image.size());
+	converter.convert(&pixels[0], 4, width, height, &image[0], true, 4);
+	for(unsigned y = 0; y < height; y++){
+		converter.convertRow(&pixels[(size_t) (height - 1 - y) * width * 4], 4, width, y, &rows[(size_t) y * width * 4]);
+	}
+
+	int error = 0;
+	for(size_t i = 0; i < image.size(); i++) error = std::max(error, abs(image[i] - rows[i]));
+	reportBound("flipped image across 4 threads", error, 0);
+}
+
+int main(int argc, char* argv[])
+{
+#if defined(__SSE2__) && !defined(PIXELPIPE_NO_SSE2)
+	std::cout << "SSE2 path" << std::endl;
+#else
+	std::cout << "scalar path" << std::endl;
+#endif
+
+	// the table and the polynomials are within one step of the exact encoding
+	const int bounds[3] = { 0, 1, 1 };
+	for(int e = 0; e < 3; e++){
+		for(int d = 0; d < 2; d++){
+			checkEncoding((color_encoding) e, d == 1, 4, bounds[e]);
+			checkEncoding((color_encoding) e, d == 1, 3, bounds[e]);
+		}
+	}
+	checkImage();
+
+	return finish();
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <math.h>
+
+#include "core/resolution.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static const float BUDGET = 16.0f;
+
+/**
+ * @return the frame time of a frame whose cost at full scale is cost, the
+ * time following the number of pixels.
+ */
+static float frameTime(float cost, float scale)
+{
+	return cost * scale * scale;
+}
+
+/**
+ * @return whether a scale is a whole number of steps of 1/64
+ */
+static bool quantized(float scale)
+{
+	return scale * 64.0f == floorf(scale * 64.0f);
+}
+
+/**
+ * Runs frames of a constant cost and returns the scales picked after each.
+ */
+static std::vector<float> run(ResolutionController& controller, float cost, int frames)
+{
+	std::vector<float> scales;
+	for(int i = 0; i < frames; i++) scales.push_back(controller.update(frameTime(cost, controller.getScale())));
+	return scales;
+}
+
+/**
+ * @return the number of changes of scale in the last frames of a run
+ */
+static int changes(const std::vector<float>& scales, int last)
+{
+	int count = 0;
+	for(size_t i = scales.size() - last; i < scales.size(); i++) if(scales[i] != scales[i - 1]) count++;
+	return count;
+}
+
+/**
+ * From full scale, frames that cost 1.5 to 6 times the budget must settle on
+ * a scale whose time is within 5% of the budget, and stay there.
+ */
+static void checkConvergence()
+{
+	int far = 0, oscillating = 0;
+	for(float cost = 1.5f * BUDGET; cost <= 6.0f * BUDGET; cost += 0.25f){
+		ResolutionController controller(BUDGET);
+		std::vector<float> scales = run(controller, cost, 200);
+		float ratio = BUDGET / frameTime(cost, scales.back());
+		if(ratio <= 0.95f || ratio >= 1.05f) far++;
+		if(changes(scales, 100) != 0) oscillating++;
+	}
+	reportMismatches("settles within 5% of the budget", far, "costs outside");
+	reportMismatches("settled scale stays", oscillating, "costs oscillating");
+}
+
+/**
+ * Frame times within 5% of the budget, even noisy ones, never change the
+ * scale, and a single slow frame is absorbed by the moving average.
+ */
+static void checkDeadband()
+{
+	ResolutionController controller(BUDGET);
+	int count = 0;
+	for(int i = 0; i < 200; i++){
+		float noise = (i % 2) ? 1.04f : 0.96f;
+		if(controller.update(BUDGET * noise * ((i % 7) ? 1.0f : 1.01f)) != 1.0f) count++;
+	}
+	controller.update(BUDGET * 1.1f);
+	if(controller.getScale() != 1.0f) count++;
+	reportMismatches("times within 5% keep the scale", count, "changes");
+
+	ResolutionController fast(BUDGET, 0.25f, 1.0f);
+	run(fast, BUDGET * 4.0f, 200);
+	float scale = fast.getScale();
+	int moved = 0;
+	for(int i = 0; i < 200; i++) if(fast.update(frameTime(BUDGET * 4.0f, scale) * ((i % 2) ? 1.045f : 0.955f)) != scale) moved++;
+	reportMismatches("times within 5% keep a reduced scale", moved, "changes");
+}
+
+/**
+ * A sudden change of cost moves the scale by at most 10% per frame, in steps
+ * of 1/64 and within [minScale, maxScale], and rescales the smoothed time to
+ * the new scale.
+ */
+static void checkClamps()
+{
+	ResolutionController controller(BUDGET, 0.25f, 1.0f);
+	const float costs[4] = { BUDGET * 10.0f, BUDGET * 0.5f, BUDGET * 100.0f, BUDGET * 0.01f };
+	int steep = 0, unquantized = 0, outside = 0, rescaled = 0;
+	for(int c = 0; c < 4; c++){
+		for(int i = 0; i < 100; i++){
+			float scale = controller.getScale();
+			float time = frameTime(costs[c], scale);
+			float previous = controller.getFrameTime();
+			float next = controller.update(time);
+			if(fabs(next - scale) > 0.1f * scale + 0.5f / 64.0f) steep++;
+			if(!quantized(next)) unquantized++;
+			if(next < 0.25f || next > 1.0f) outside++;
+
+			// the average of the new frame, measured at the old scale, moved to the new one
+			float smoothed = (previous == 0.0f) ? time : previous + 0.25f * (time - previous);
+			float expected = smoothed * (next * next) / (scale * scale);
+			if(fabs(controller.getFrameTime() - expected) > 1e-4f * expected) rescaled++;
+		}
+	}
+	reportMismatches("at most 10% per frame", steep, "steeper steps");
+	reportMismatches("steps of 1/64", unquantized, "scales off the steps");
+	reportMismatches("within the smallest and largest scales", outside, "scales outside");
+	reportMismatches("smoothed time follows the scale", rescaled);
+	report("unreachable budget settles on the smallest scale", run(controller, BUDGET * 100.0f, 200).back() == 0.25f);
+	report("generous budget settles on the largest scale", run(controller, BUDGET * 0.01f, 200).back() == 1.0f);
+}
+
+/**
+ * Near the smallest scale, a step of 1/64 changes the time by more than the
+ * 5% deadband. For costs whose budget falls between two steps, the scale must
+ * settle on the step nearest the budget rather than on the first one whose
+ * rounding cancels the step, and must not alternate between the two.
+ */
+static void checkSmallScales()
+{
+	int stalled = 0, oscillating = 0;
+	for(float cost = BUDGET * 9.0f; cost <= BUDGET * 16.0f; cost += 0.05f){
+		ResolutionController controller(BUDGET);
+		std::vector<float> scales = run(controller, cost, 300);
+		if(changes(scales, 100) != 0) oscillating++;
+
+		// outside of the deadband, neither neighbouring step may be nearer the budget
+		float scale = scales.back();
+		float ratio = BUDGET / frameTime(cost, scale);
+		if(ratio > 0.95f && ratio < 1.05f) continue;
+		for(int k = -1; k <= 1; k += 2){
+			float neighbour = scale + k / 64.0f;
+			if(neighbour < 0.25f || neighbour > 1.0f) continue;
+			if(fabs(logf(BUDGET / frameTime(cost, neighbour))) < fabs(logf(ratio))) stalled++;
+		}
+	}
+	reportMismatches("settles on the step nearest the budget", stalled, "costs stalled");
+	reportMismatches("small scales stay", oscillating, "costs oscillating");
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "resolution controller" << std::endl;
+	checkConvergence();
+	checkDeadband();
+	checkClamps();
+	checkSmallScales();
+
+	return finish();
+}
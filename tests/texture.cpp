@@ -0,0 +1,338 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <math.h>
+
+#include "core/texture.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static const char* layoutNames[4] = { "row major", "4x4 blocks", "8x8 blocks", "morton" };
+
+/**
+ * Fills an RGBA8 image with a pattern that differs between neighbouring texels.
+ */
+static void fill(std::vector<unsigned char>& pixels, int width, int height)
+{
+	pixels.resize((size_t) width * height * 4);
+	for(int y = 0; y < height; y++){
+		for(int x = 0; x < width; x++){
+			unsigned char* p = &pixels[((size_t) y * width + x) * 4];
+			p[0] = (unsigned char) (x * 37 + y * 11);
+			p[1] = (unsigned char) ((x ^ y) * 29);
+			p[2] = (unsigned char) (x * y * 7);
+			p[3] = (unsigned char) (255 - x * 5);
+		}
+	}
+}
+
+/**
+ * @return the largest difference between the components of two colors
+ */
+static float difference(const cg::vecmath::Color3f& a, const cg::vecmath::Color3f& b)
+{
+	return std::max(fabs(a.x - b.x), std::max(fabs(a.y - b.y), fabs(a.z - b.z)));
+}
+
+/**
+ * Samples the same 8 bit pixels stored as floats and as RGBA8 in every layout.
+ * Both hold the same texel values, so the samples may only differ by the 8 bit
+ * weights of the RGBA8 filter: the texels must be addressed the same way,
+ * inside, on the texel centers and edges, and outside of [0, 1].
+ */
+static void checkStorage(int width, int height)
+{
+	std::vector<unsigned char> pixels;
+	fill(pixels, width, height);
+
+	Texture reference;
+	reference.setTextureData(width, height, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], TEXTURE_FORMAT_FLOAT);
+
+	for(int l = 0; l < 4; l++){
+		Texture texture;
+		texture.setTextureData(width, height, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], TEXTURE_FORMAT_RGBA8, (texture_layout) l);
+
+		float error = 0.0f;
+		for(int i = 0; i < 20000; i++){
+			float u = (i % 997) / 331.0f - 1.0f;
+			float v = (i % 991) / 293.0f - 1.0f;
+			error = std::max(error, difference(texture.sample(u, v), reference.sample(u, v)));
+		}
+
+		// texel centers and the edges between texels, where s * size is whole
+		for(int y = -2; y <= 2 * height + 2; y++){
+			for(int x = -2; x <= 2 * width + 2; x++){
+				float u = x * 0.5f / width, v = y * 0.5f / height;
+				error = std::max(error, difference(texture.sample(u, v), reference.sample(u, v)));
+			}
+		}
+
+		reportBound(std::string("float and rgba8 ") + layoutNames[l] + " " + std::to_string(width) + "x" + std::to_string(height), error, 1.0f / 255.0f);
+	}
+}
+
+/**
+ * A sample on a texel center returns the texel, in every storage format.
+ */
+static void checkCenters(int width, int height)
+{
+	std::vector<unsigned char> pixels;
+	fill(pixels, width, height);
+
+	Texture texture;
+	texture.setTextureData(width, height, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], TEXTURE_FORMAT_FLOAT);
+
+	float error = 0.0f;
+	for(int y = 0; y < height; y++){
+		for(int x = 0; x < width; x++){
+			const unsigned char* p = &pixels[((size_t) y * width + x) * 4];
+			cg::vecmath::Color3f texel(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f);
+			error = std::max(error, difference(texture.sample((x + 0.5f) / width, (y + 0.5f) / height), texel));
+		}
+	}
+	reportBound("float texel centers " + std::to_string(width) + "x" + std::to_string(height), error, 1e-6f);
+}
+
+/**
+ * Every filter samples magnified pixels in the base level like sample(u, v),
+ * and the blend with the next level starts from there as the level of detail
+ * rises above 0.
+ */
+static void checkFilters(texture_format format, int width, int height)
+{
+	const char* filterNames[3] = { "linear", "nearest mip level", "trilinear" };
+	std::vector<unsigned char> pixels;
+	fill(pixels, width, height);
+
+	Texture texture;
+	texture.setTextureData(width, height, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], format);
+	texture.generateMipmaps();
+	std::string name = std::string(format == TEXTURE_FORMAT_FLOAT ? "float " : "rgba8 ") + std::to_string(width) + "x" + std::to_string(height);
+
+	for(int f = 0; f < 3; f++){
+		texture.setFilter((texture_filter) f);
+		float magnified = 0.0f, blended = 0.0f;
+		for(int i = 0; i < 20000; i++){
+			float u = (i % 997) / 331.0f - 1.0f;
+			float v = (i % 991) / 293.0f - 1.0f;
+			cg::vecmath::Color3f base = texture.sample(u, v);
+
+			// half a texel and just over one texel per pixel
+			float half[4] = { 0.5f / width, 0.0f, 0.0f, 0.5f / height };
+			float over[4] = { 1.02f / width, 0.0f, 0.0f, 1.02f / height };
+			magnified = std::max(magnified, difference(texture.sample(u, v, half), base));
+			if(f == TEXTURE_FILTER_TRILINEAR) blended = std::max(blended, difference(texture.sample(u, v, over), base));
+		}
+		reportBound(std::string("magnified ") + filterNames[f] + " " + name, magnified, 0.0f);
+		if(f == TEXTURE_FILTER_TRILINEAR) reportBound("level of detail 0.03 " + name, blended, 0.03f);
+	}
+}
+
+/**
+ * @return the value of a half float, computed from its fields in double precision
+ */
+static double halfValue(unsigned short h)
+{
+	int exponent = (h >> 10) & 31, mantissa = h & 1023;
+	double value = (exponent == 0) ? ldexp(mantissa, -24) : ldexp(1024 + mantissa, exponent - 25);
+	return (h & 0x8000) ? -value : value;
+}
+
+/**
+ * Converts every half float to a float, and floats between every pair of
+ * consecutive halves back to the nearest of them. The pairs cover the
+ * subnormals, the step from the subnormals to the normals and the rounding
+ * carries of the mantissa into the exponent.
+ */
+static void checkHalf()
+{
+	int mismatches = 0;
+	for(unsigned h = 0; h < 65536; h++){
+		float f = Texture::halfToFloat((unsigned short) h);
+		bool special = ((h >> 10) & 31) == 31;
+		if(special && (h & 1023) == 0 && (!isinf(f) || (f < 0.0f) != ((h & 0x8000) != 0))) mismatches++;
+		if(special && (h & 1023) != 0 && !isnan(f)) mismatches++;
+		if(!special && (double) f != halfValue((unsigned short) h)) mismatches++;
+	}
+	reportMismatches("half to float", mismatches);
+
+	mismatches = 0;
+	for(unsigned h = 0; h < 0x7c00; h++){
+		for(unsigned sign = 0; sign <= 0x8000; sign += 0x8000){
+			unsigned short low = (unsigned short) (sign | h), high = (unsigned short) (sign | (h + 1));
+			double a = halfValue(low), b = halfValue(high);
+			if(Texture::floatToHalf((float) a) != low) mismatches++;
+			if(Texture::floatToHalf((float) (a + 0.25 * (b - a))) != low) mismatches++;
+			if(Texture::floatToHalf((float) (a + 0.75 * (b - a))) != high) mismatches++;
+		}
+	}
+	reportMismatches("float to nearest half", mismatches);
+
+	// 65504 is the largest half, 65520 lies halfway to the next power of two
+	const float specials[8] = { 65519.0f, 65520.0f, 1e9f, INFINITY, -INFINITY, 1e-9f, -1e-9f, NAN };
+	const unsigned short halves[7] = { 0x7bff, 0x7c00, 0x7c00, 0x7c00, 0xfc00, 0x0000, 0x8000 };
+	mismatches = 0;
+	for(int i = 0; i < 7; i++) if(Texture::floatToHalf(specials[i]) != halves[i]) mismatches++;
+	if(!isnan(Texture::halfToFloat(Texture::floatToHalf(specials[7])))) mismatches++;
+	reportMismatches("half overflow, underflow and NaN", mismatches);
+}
+
+/**
+ * A source of pixels for setTextureData() and the storage it is converted to.
+ */
+struct FormatCase {
+	const char* name;
+	pixel_format format;
+	pixel_type type;
+	texture_format storage;
+	float bound;		//!< the largest difference between a texel and its source
+};
+
+/**
+ * Encodes the colors of a reference image in the pixels of a case, and
+ * replaces the reference with the values the pixels hold.
+ */
+static void encode(const FormatCase& c, std::vector<float>& rgba, std::vector<unsigned char>& data)
+{
+	size_t count = rgba.size() / 4;
+	bool bgr = (c.format == PIXEL_FORMAT_BGR || c.format == PIXEL_FORMAT_BGRA);
+	int components = (c.format == PIXEL_FORMAT_RGB || c.format == PIXEL_FORMAT_BGR) ? 3
+		: (c.format == PIXEL_FORMAT_LUMINANCE) ? 1 : (c.format == PIXEL_FORMAT_LUMINANCE_ALPHA) ? 2 : 4;
+
+	if(c.type == PIXEL_TYPE_UNSIGNED_SHORT_5_6_5){
+		data.resize(count * 2);
+		for(size_t i = 0; i < count; i++){
+			float* p = &rgba[i * 4];
+			unsigned r = (unsigned) (p[0] * 31.0f + 0.5f), g = (unsigned) (p[1] * 63.0f + 0.5f), b = (unsigned) (p[2] * 31.0f + 0.5f);
+			((unsigned short*) &data[0])[i] = (unsigned short) (r << 11 | g << 5 | b);
+			p[0] = r / 31.0f;
+			p[1] = g / 63.0f;
+			p[2] = b / 31.0f;
+			p[3] = 1.0f;
+		}
+		return;
+	}
+
+	size_t size = (c.type == PIXEL_TYPE_FLOAT) ? 4 : (c.type == PIXEL_TYPE_HALF_FLOAT) ? 2 : 1;
+	data.resize(count * components * size);
+	for(size_t i = 0; i < count; i++){
+		float* p = &rgba[i * 4];
+		float source[4] = { p[0], p[1], p[2], p[3] };
+		if(components < 3) source[1] = p[3];
+		if(bgr) std::swap(source[0], source[2]);
+
+		for(int k = 0; k < components; k++){
+			size_t j = i * components + k;
+			if(c.type == PIXEL_TYPE_FLOAT) ((float*) &data[0])[j] = source[k];
+			else if(c.type == PIXEL_TYPE_HALF_FLOAT){
+				unsigned short h = Texture::floatToHalf(source[k]);
+				((unsigned short*) &data[0])[j] = h;
+				source[k] = Texture::halfToFloat(h);
+			}
+			else{
+				unsigned char b = (unsigned char) (source[k] * 255.0f + 0.5f);
+				data[j] = b;
+				source[k] = b / 255.0f;
+			}
+		}
+
+		if(bgr) std::swap(source[0], source[2]);
+		if(components < 3){
+			p[0] = p[1] = p[2] = source[0];
+			p[3] = (components == 2) ? source[1] : 1.0f;
+		}
+		else{
+			for(int k = 0; k < 3; k++) p[k] = source[k];
+			p[3] = (components == 4) ? source[3] : 1.0f;
+		}
+	}
+}
+
+/**
+ * Stores pixels of every layout and type in every storage format. The texels
+ * of a float texture must hold the source values exactly, swizzled to RGB(A)
+ * or as luminance and alpha; a sample on a texel center of a compact texture
+ * must return its source color, or the luminance of it, within the precision
+ * of the format.
+ */
+static void checkFormats()
+{
+	const FormatCase cases[] = {
+		{ "rgba bytes to float", PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_FLOAT, 0.0f },
+		{ "bgra bytes to float", PIXEL_FORMAT_BGRA, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_FLOAT, 0.0f },
+		{ "bgr bytes to float", PIXEL_FORMAT_BGR, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_FLOAT, 0.0f },
+		{ "luminance alpha bytes to float", PIXEL_FORMAT_LUMINANCE_ALPHA, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_FLOAT, 0.0f },
+		{ "halves to float", PIXEL_FORMAT_RGBA, PIXEL_TYPE_HALF_FLOAT, TEXTURE_FORMAT_FLOAT, 0.0f },
+		{ "rgb565 to float", PIXEL_FORMAT_RGB, PIXEL_TYPE_UNSIGNED_SHORT_5_6_5, TEXTURE_FORMAT_FLOAT, 0.0f },
+		{ "bgra bytes to rgba8", PIXEL_FORMAT_BGRA, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_RGBA8, 0.0f },
+		{ "bgr bytes to rgb8", PIXEL_FORMAT_BGR, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_RGB8, 0.0f },
+		{ "floats to rgba8", PIXEL_FORMAT_RGBA, PIXEL_TYPE_FLOAT, TEXTURE_FORMAT_RGBA8, 0.5f / 255.0f },
+		{ "rgb bytes to l8", PIXEL_FORMAT_RGB, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_L8, 0.5f / 255.0f },
+		{ "luminance bytes to l8", PIXEL_FORMAT_LUMINANCE, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_L8, 0.0f },
+		{ "luminance alpha bytes to la8", PIXEL_FORMAT_LUMINANCE_ALPHA, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_LA8, 0.0f },
+		{ "bgra bytes to la8", PIXEL_FORMAT_BGRA, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_LA8, 0.5f / 255.0f },
+		{ "floats to rgb565", PIXEL_FORMAT_RGB, PIXEL_TYPE_FLOAT, TEXTURE_FORMAT_RGB565, 0.5f / 31.0f },
+		{ "rgb565 to rgb565", PIXEL_FORMAT_RGB, PIXEL_TYPE_UNSIGNED_SHORT_5_6_5, TEXTURE_FORMAT_RGB565, 0.0f },
+		{ "bgr bytes to half", PIXEL_FORMAT_BGR, PIXEL_TYPE_UNSIGNED_BYTE, TEXTURE_FORMAT_HALF, 1.0f / 2048.0f },
+		{ "halves to half", PIXEL_FORMAT_RGBA, PIXEL_TYPE_HALF_FLOAT, TEXTURE_FORMAT_HALF, 0.0f }
+	};
+	const int width = 19, height = 11;
+
+	for(size_t n = 0; n < sizeof(cases) / sizeof(cases[0]); n++){
+		const FormatCase& c = cases[n];
+		std::vector<float> rgba((size_t) width * height * 4);
+		for(size_t i = 0; i < rgba.size(); i++) rgba[i] = ((i * 151 + i / 4 * 37) % 1000) / 999.0f;
+		std::vector<unsigned char> data;
+		encode(c, rgba, data);
+
+		Texture texture;
+		texture.setTextureData(width, height, c.format, c.type, &data[0], c.storage);
+		bool luminance = (c.storage == TEXTURE_FORMAT_L8 || c.storage == TEXTURE_FORMAT_LA8);
+
+		float error = 0.0f;
+		for(int y = 0; y < height; y++){
+			for(int x = 0; x < width; x++){
+				const float* p = &rgba[((size_t) y * width + x) * 4];
+				float expected[4] = { p[0], p[1], p[2], p[3] };
+				if(luminance) expected[0] = expected[1] = expected[2] = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+
+				if(c.storage == TEXTURE_FORMAT_FLOAT){
+					// luminance alpha is kept in two channels, RGB565 in three
+					const cg::image::FloatRaster& raster = texture.getTextureData();
+					const float* texel = raster.head() + ((size_t) y * width + x) * raster.channels();
+					if(raster.channels() == 2){
+						error = std::max(error, std::max(fabs(texel[0] - expected[0]), fabs(texel[1] - expected[3])));
+					}
+					else for(int k = 0; k < raster.channels(); k++) error = std::max(error, (float) fabs(texel[k] - expected[k]));
+				}
+				else{
+					cg::vecmath::Color3f sample = texture.sample((x + 0.5f) / width, (y + 0.5f) / height);
+					error = std::max(error, difference(sample, cg::vecmath::Color3f(expected[0], expected[1], expected[2])));
+				}
+			}
+		}
+		reportBound(c.name, error, c.bound + 1e-6f);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "storage" << std::endl;
+	checkCenters(16, 16);
+	checkCenters(13, 7);
+	checkStorage(16, 16);
+	checkStorage(13, 7);
+	std::cout << "filters" << std::endl;
+	checkFilters(TEXTURE_FORMAT_FLOAT, 16, 16);
+	checkFilters(TEXTURE_FORMAT_RGBA8, 16, 16);
+	checkFilters(TEXTURE_FORMAT_FLOAT, 13, 7);
+	checkFilters(TEXTURE_FORMAT_RGBA8, 13, 7);
+	std::cout << "formats" << std::endl;
+	checkHalf();
+	checkFormats();
+
+	return finish();
+}
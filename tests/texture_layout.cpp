@@ -0,0 +1,129 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <math.h>
+
+#include "core/texture.h"
+
+#include "check.h"
+
+using namespace pixelpipe;
+
+static const char* layoutNames[4] = { "row major", "4x4 blocks", "8x8 blocks", "morton" };
+
+/**
+ * Fills an RGBA8 image with a pattern that differs between neighbouring texels.
+ */
+static void fill(std::vector<unsigned char>& pixels, int width, int height)
+{
+	pixels.resize((size_t) width * height * 4);
+	for(int y = 0; y < height; y++){
+		for(int x = 0; x < width; x++){
+			unsigned char* p = &pixels[((size_t) y * width + x) * 4];
+			p[0] = (unsigned char) (x * 7 + y * 3);
+			p[1] = (unsigned char) (x ^ y);
+			p[2] = (unsigned char) (((x / 16) + (y / 16)) * 40);
+			p[3] = 255;
+		}
+	}
+}
+
+/**
+ * Compares the samples of a texture in every layout with the row major one,
+ * the results must be identical.
+ */
+static void checkLayouts(int width, int height)
+{
+	std::vector<unsigned char> pixels;
+	fill(pixels, width, height);
+
+	Texture linear;
+	linear.setTextureData(width, height, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], TEXTURE_FORMAT_RGBA8);
+	linear.generateMipmaps();
+	linear.setFilter(TEXTURE_FILTER_TRILINEAR);
+
+	for(int l = 1; l < 4; l++){
+		Texture texture;
+		texture.setTextureData(width, height, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], TEXTURE_FORMAT_RGBA8, (texture_layout) l);
+		texture.generateMipmaps();
+		texture.setFilter(TEXTURE_FILTER_TRILINEAR);
+
+		int mismatches = 0;
+		for(int i = 0; i < 20000; i++){
+			float u = (i % 997) / 331.0f - 1.0f;
+			float v = (i % 991) / 293.0f - 1.0f;
+			float derivatives[4] = { (i % 7) * 0.002f, 0.0f, 0.0f, (i % 5) * 0.002f };
+			cg::vecmath::Color3f a = texture.sample(u, v, derivatives);
+			cg::vecmath::Color3f b = linear.sample(u, v, derivatives);
+			if(a.x != b.x || a.y != b.y || a.z != b.z) mismatches++;
+		}
+
+		reportMismatches(std::string(layoutNames[l]) + " " + std::to_string(width) + "x" + std::to_string(height), mismatches, "mismatched samples");
+	}
+}
+
+/**
+ * Samples a screen of size x size pixels mapped onto the texture through a
+ * rotation and a scale, in scanline order, and returns the best time of three.
+ */
+static double benchmark(const Texture& texture, int size, float angle, float scale, double& sum)
+{
+	float c = cosf(angle) * scale / texture.width();
+	float s = sinf(angle) * scale / texture.height();
+
+	double best = 0.0;
+	for(int run = 0; run < 3; run++){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int y = 0; y < size; y++){
+			for(int x = 0; x < size; x++){
+				float dx = x - size * 0.5f, dy = y - size * 0.5f;
+				sum += texture.sample(0.5f + dx * c - dy * s, 0.5f + dx * s + dy * c).x;
+			}
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if(run == 0 || ms < best) best = ms;
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	std::cout << "layouts" << std::endl;
+	checkLayouts(256, 256);
+	checkLayouts(512, 128);
+	checkLayouts(300, 170);
+
+	// a texture much larger than the caches, sampled at one and two texels per pixel
+	const int size = 4096;
+	std::vector<unsigned char> pixels;
+	fill(pixels, size, size);
+
+	Texture textures[4];
+	for(int l = 0; l < 4; l++){
+		textures[l].setTextureData(size, size, PIXEL_FORMAT_RGBA, PIXEL_TYPE_UNSIGNED_BYTE, &pixels[0], TEXTURE_FORMAT_RGBA8, (texture_layout) l);
+	}
+
+	const float angles[4] = { 0.0f, 30.0f, 45.0f, 90.0f };
+	const float scales[2] = { 1.0f, 2.0f };
+	double sum = 0.0;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "rotated sampling of a " << size << "x" << size << " RGBA8 texture, ms per 2048x2048 frame" << std::endl;
+	std::cout << std::setw(18) << "angle / scale";
+	for(int l = 0; l < 4; l++) std::cout << std::setw(12) << layoutNames[l];
+	std::cout << std::endl;
+
+	for(int s = 0; s < 2; s++){
+		for(int a = 0; a < 4; a++){
+			std::cout << std::setw(12) << angles[a] << " / " << std::setw(3) << scales[s];
+			for(int l = 0; l < 4; l++){
+				double ms = benchmark(textures[l], 2048, angles[a] * (float) PI / 180.0f, scales[s], sum);
+				std::cout << std::setw(12) << ms;
+			}
+			std::cout << std::endl;
+		}
+	}
+	std::cout << "(checksum " << sum << ")" << std::endl;
+
+	return finish();
+}